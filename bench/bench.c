@@ -0,0 +1,205 @@
+/**
+ * @file bench.c
+ * @brief Simulator throughput benchmark over the synthetic workloads.
+ *
+ * Runs every workload against every directory scheme at 4 to 256 cores and
+ * reports simulated accesses per host second and the peak resident set of
+ * each run, so slowdowns and memory growth in the simulator itself show up
+ * as soon as they land. Each run happens in a child process so its peak
+ * RSS is its own.
+ *
+ * Build it from every file in src/ except main.c, linked with -lpthread -lm,
+ * with NUM_PROCESSORS raised to the largest core count to measure, e.g.
+ * -DNUM_PROCESSORS=256.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "compare.h"
+#include "simulator.h"
+#include "system.h"
+#include "workload.h"
+
+/** @brief Smallest core count measured */
+#define BENCH_MIN_CORES 4
+
+/** @brief Largest core count measured, if NUM_PROCESSORS allows */
+#define BENCH_MAX_CORES 256
+
+/** @brief Default accesses per run */
+#define BENCH_DEFAULT_ACCESSES 2000000UL
+
+/**
+ * @brief Prints information about what parameters the program requires and it's format.
+ *
+*/
+static void displayUsage(void) {
+   printf("Usage: ./dirbench [-h] [-n <accesses>] [-w <workload>[,...]] [-d <scheme>[,...]]\n"
+          "                  [-P <proto>] [-p <maxprocs>]\n");
+   printf("  -h            Print this help message\n");
+   printf("  -n <count>    Accesses per run (default %lu)\n", BENCH_DEFAULT_ACCESSES);
+   printf("  -w <names>    Workloads to run (default all)\n");
+   printf("  -d <schemes>  Directory schemes to run (default all): ");
+   listDirectorySchemes();
+   printf("  -P <proto>    Cache protocol: msi, mesi, moesi (default msi)\n");
+   printf("  -p <procs>    Largest core count (default %d, at most %d)\n",
+          NUM_PROCESSORS < BENCH_MAX_CORES ? NUM_PROCESSORS : BENCH_MAX_CORES, NUM_PROCESSORS);
+}
+
+/**
+ * @brief Seconds on the monotonic clock
+ *
+ * @return double
+ */
+static double nowSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Run one workload on one machine and print its row
+ *
+ * @param config            machine to build
+ * @param workloadConfig    workload to run on it
+ * @return int              0 on success
+ */
+static int runOne(const system_config_t *config, const workload_config_t *workloadConfig) {
+    system_t *sys = initializeSystem(config);
+    workload_t *workload = createWorkload(workloadConfig);
+    if (sys == NULL || workload == NULL) {
+        fprintf(stderr, "Could not set up %s on %s with %d cores\n",
+                workloadKindName(workloadConfig->kind), config->dirOps->name,
+                config->numProcessors);
+        cleanupSystem(sys);
+        freeWorkload(workload);
+        return 1;
+    }
+
+    double start = nowSeconds();
+    unsigned long records = runLockstepWorkload(workload, &sys, 1);
+    double elapsed = nowSeconds() - start;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("%-18s %-16s %6d %12lu %10.3f %14.0f %12ld %10.2f\n",
+           workloadKindName(workloadConfig->kind), config->dirOps->name, config->numProcessors,
+           records, elapsed, elapsed > 0 ? records / elapsed : 0.0, usage.ru_maxrss,
+           averageMissLatency(sys));
+    fflush(stdout);
+
+    freeWorkload(workload);
+    cleanupSystem(sys);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    system_config_t base;
+    defaultSimulatorConfig(&base);
+    workload_config_t workloadBase = {
+        .accesses = BENCH_DEFAULT_ACCESSES,
+        .footprintLines = DEFAULT_WORKLOAD_LINES,
+        .lineBits = base.b,
+        .writePercent = -1,
+        .seed = 1,
+    };
+    const directory_ops_t *schemes[MAX_SYSTEMS];
+    int numSchemes = 0;
+    workload_kind kinds[NUM_WORKLOADS];
+    int numKinds = 0;
+    int maxCores = NUM_PROCESSORS < BENCH_MAX_CORES ? NUM_PROCESSORS : BENCH_MAX_CORES;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hn:w:d:P:p:")) != -1) {
+        switch (opt) {
+            case 'h':
+                displayUsage();
+                return 0;
+            case 'n':
+                workloadBase.accesses = strtoul(optarg, NULL, 0);
+                break;
+            case 'w':
+                for (char *name = strtok(optarg, ","); name != NULL; name = strtok(NULL, ",")) {
+                    if (numKinds == NUM_WORKLOADS || !parseWorkloadKind(name, &kinds[numKinds])) {
+                        fprintf(stderr, "Unknown or too many workloads: %s\n", name);
+                        return 1;
+                    }
+                    numKinds++;
+                }
+                break;
+            case 'd':
+                for (char *name = strtok(optarg, ","); name != NULL; name = strtok(NULL, ",")) {
+                    if (numSchemes == MAX_SYSTEMS || (schemes[numSchemes] = findDirectoryOps(name)) == NULL) {
+                        fprintf(stderr, "Unknown or too many directory schemes: %s\n", name);
+                        return 1;
+                    }
+                    numSchemes++;
+                }
+                break;
+            case 'P':
+                if (!parseProtocol(optarg, &base.protocol)) {
+                    fprintf(stderr, "Unknown protocol: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'p':
+                maxCores = atoi(optarg);
+                if (maxCores > NUM_PROCESSORS) {
+                    fprintf(stderr, "Built for at most %d processors\n", NUM_PROCESSORS);
+                    return 1;
+                }
+                break;
+            default:
+                displayUsage();
+                return 1;
+        }
+    }
+    if (numKinds == 0) {
+        for (int k = 0; k < NUM_WORKLOADS; k++) {
+            kinds[numKinds++] = (workload_kind)k;
+        }
+    }
+    if (numSchemes == 0) {
+        while (numSchemes < MAX_SYSTEMS && directoryScheme(numSchemes) != NULL) {
+            schemes[numSchemes] = directoryScheme(numSchemes);
+            numSchemes++;
+        }
+    }
+
+    printf("%-18s %-16s %6s %12s %10s %14s %12s %10s\n", "workload", "scheme", "cores",
+           "accesses", "seconds", "accesses/s", "peak RSS KB", "miss lat");
+    fflush(stdout);
+    int failures = 0;
+    for (int k = 0; k < numKinds; k++) {
+        for (int d = 0; d < numSchemes; d++) {
+            for (int cores = BENCH_MIN_CORES; cores <= maxCores; cores *= 2) {
+                system_config_t config = base;
+                config.numProcessors = cores;
+                config.dirOps = schemes[d];
+                workload_config_t workloadConfig = workloadBase;
+                workloadConfig.kind = kinds[k];
+                workloadConfig.numProcessors = cores;
+
+                pid_t child = fork();
+                if (child < 0) {
+                    perror("fork");
+                    return 1;
+                }
+                if (child == 0) {
+                    exit(runOne(&config, &workloadConfig));
+                }
+                int status;
+                if (waitpid(child, &status, 0) < 0 || !WIFEXITED(status) ||
+                    WEXITSTATUS(status) != 0) {
+                    failures++;
+                }
+            }
+        }
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file accounting.h
+ * @brief Directory storage overhead and dynamic energy of a simulated machine.
+ *
+ * Storage follows from the scheme's entry layout and the cache geometry;
+ * energy multiplies the events counted during the run by a cost per event.
+ * Together they give both sides of the bits-versus-traffic trade-off
+ * between directory schemes from a single run.
+ */
+
+#ifndef ACCOUNTING_H
+#define ACCOUNTING_H
+
+#include <stdbool.h>
+
+/** @brief Physical address width assumed for directory tags */
+#define PHYSICAL_ADDRESS_BITS 48
+
+/** @brief Default energy of a directory lookup or update, in picojoules */
+#define DEFAULT_DIRECTORY_PJ 15.0
+
+/** @brief Default energy of a cache tag and data lookup, in picojoules */
+#define DEFAULT_CACHE_PJ 10.0
+
+/** @brief Default energy of a message crossing the network, in picojoules */
+#define DEFAULT_HOP_PJ 60.0
+
+/** @brief Default energy of reading or writing a line of DRAM, in picojoules */
+#define DEFAULT_DRAM_PJ 10000.0
+
+struct system;
+
+/**
+ * @brief Energy of each kind of event, in picojoules
+ *
+*/
+typedef struct energy_costs {
+    double directoryLookup;
+    double cacheLookup;
+    double hop;
+    double dramAccess;
+} energy_costs_t;
+
+/**
+ * @brief Directory storage of a machine
+ *
+*/
+typedef struct storage_report {
+    unsigned int entryBits;             // State and sharer bits of one entry
+    unsigned int tagBits;               // Tag of an entry in a directory sized to the caches
+    double overheadPercent;             // entryBits over the data bits of a line or sector
+    unsigned long sparseEntries;        // One entry per line or sector the caches can hold
+    unsigned long sparseBytes;          // SRAM of those entries, tags included
+    unsigned long liveEntries;          // Entries in use at the end of the run
+    unsigned long liveBytes;
+} storage_report_t;
+
+/**
+ * @brief Event counts of a run and their energy
+ *
+*/
+typedef struct energy_report {
+    unsigned long directoryLookups;     // Requests and notices handled by a home directory
+    unsigned long cacheLookups;         // Processor accesses plus invalidation and forward probes
+    unsigned long hops;                 // Messages that crossed the network
+    unsigned long dramAccesses;         // Lines read from or written to memory
+    double directoryPJ, cachePJ, hopPJ, dramPJ;
+    double totalPJ;
+} energy_report_t;
+
+// Function declarations for storage and energy accounting
+void defaultEnergyCosts(energy_costs_t *costs);
+bool parseEnergyCosts(const char *text, energy_costs_t *costs);
+void computeStorage(const struct system *sys, storage_report_t *report);
+void computeEnergy(const struct system *sys, energy_report_t *report);
+void printAccounting(const struct system *sys);
+
+#endif // ACCOUNTING_H
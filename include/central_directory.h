@@ -1,6 +1,6 @@
 /**
  * @file central_directory.h
- * @brief Implement a central directory based cache coherence protocol. 
+ * @brief Implement a central directory based cache coherence protocol.
  */
 
 #ifndef CENTRAL_DIRECTORY_H
@@ -8,34 +8,21 @@
 
 #include <stdbool.h>
 #include <pthread.h>
-#include <directory.h> 
+#include <directory.h>
+#include <line_table.h>
 
-// Directory entry for each block in the main memory
-// Directory entry for each block in the main memory
+// Directory entry for each block with live sharers
 typedef struct {
     directory_state state;
-    bool existsInCache[NUM_PROCESSORS]; // Presence bits for each cache
-    int owner; // Owner of the line if in exclusive/modified state
-    pthread_mutex_t lock; // Mutex for synchronizing access to this entry
+    sharer_set_t existsInCache; // Presence bits for each cache
+    int owner; // Owner of the line if in exclusive/modified/owned state
 } directory_entry_t;
 
 typedef struct {
-    directory_entry_t* lines;
-    int numLines;
+    line_table_t* lines; // Entries keyed on the full block number
     pthread_mutex_t lock; // Mutex for synchronizing access to the directory
-    interconnect_t* interconnect;  // Pointer to the interconnect
 } directory_t;
 
-// Function declarations for directory
-directory_t* initializeDirectory();
-void updateDirectoryEntry();
-bool checkCacheConsistency();
-void freeDirectory(directory_t* directory);
-
-// Function declarations for directory based protocol
-void initializeSystem(void);
-
-// Function declarations for benchmarking / testing 
-void displayUsage(void);
+// The central directory is used through centralDirectoryOps (directory.h)
 
 #endif // CENTRAL_DIRECTORY_H
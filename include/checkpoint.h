@@ -0,0 +1,139 @@
+/**
+ * @file checkpoint.h
+ * @brief Snapshots of a warmed-up machine that later runs can branch from.
+ *
+ * A checkpoint holds every cache line, every directory entry, the
+ * first-touch page placement and all counters of a system, together with
+ * where in the trace it was taken. The file is a header followed by arrays
+ * of fixed-size records, so a restore maps it and reads the records in
+ * place.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "system.h"
+
+/** @brief First eight bytes of every checkpoint ("DIRSNAP" and a NUL) */
+#define CHECKPOINT_MAGIC 0x0050414e53524944UL
+
+/** @brief Bumped whenever a record layout changes */
+#define CHECKPOINT_VERSION 6
+
+/** @brief Longest directory scheme name stored in a checkpoint */
+#define CHECKPOINT_NAME_LEN 32
+
+/**
+ * @brief Start of a checkpoint file
+ *
+ * Section offsets are in bytes from the start of the file.
+*/
+typedef struct checkpoint_header {
+    unsigned long magic;
+    unsigned int version;
+    unsigned int numProcessors;
+    unsigned int s, E, b;                   // Cache geometry
+    unsigned int sectorBits;
+    unsigned int sharerWords;               // SHARER_WORDS of the build that wrote it
+    unsigned int homePolicy;                // home_policy
+    unsigned int homeGranularityBits;
+    unsigned int numMessageTypes;           // NUM_MESSAGE_TYPES of the build that wrote it
+    char scheme[CHECKPOINT_NAME_LEN];       // Directory scheme it was taken from
+
+    unsigned long traceRecords;             // Records simulated before the checkpoint
+    long traceOffset;                       // Byte offset in the trace file just after them
+    unsigned long accessCount;
+    unsigned long droppedCount;
+    unsigned long messageCount[NUM_MESSAGE_TYPES];
+    unsigned long localMessages;
+    unsigned long remoteMessages;
+    unsigned long hopCycles;
+    unsigned long headerBytes;
+    unsigned long dataBytes;
+
+    unsigned long cacheOffset;              // numProcessors checkpoint_cache_t
+    unsigned long lineOffset;               // numProcessors * 2^s * E checkpoint_line_t
+    unsigned long sectorOffset;             // Sectors of every line, 2^(b - sectorBits) per line
+    unsigned long homeOffset;               // numProcessors checkpoint_home_t
+    unsigned long entryOffset;              // numEntries checkpoint_entry_t, grouped by home
+    unsigned long numEntries;
+    unsigned long pageOffset;               // numPages checkpoint_page_t
+    unsigned long numPages;
+} checkpoint_header_t;
+
+/**
+ * @brief Counters of one cache
+ *
+*/
+typedef struct checkpoint_cache {
+    unsigned int protocol;
+    unsigned long hitCount, missCount, sectorMissCount, evictionCount, dirtyEvictionCount;
+    unsigned long localMissCount, remoteMissCount;
+    unsigned long upgradeCount, silentUpgradeCount, writebacksAvoided, invalidationCount;
+    unsigned long cycleCount, missLatencyCycles;
+    unsigned long writeThroughCount, unallocatedWriteCount, writeStallCycles;
+    unsigned long victimHitCount, victimMissCount;
+    unsigned long secondaryMissCount, secondaryStallCycles, mshrFullStalls, mshrStallCycles;
+    unsigned long atomicCount, fenceCount, fenceStallCycles;
+} checkpoint_cache_t;
+
+/**
+ * @brief One cache line, in set order then way order
+ *
+*/
+typedef struct checkpoint_line {
+    unsigned long tag;
+    unsigned long lruCounter;
+    unsigned char valid;
+} checkpoint_line_t;
+
+/**
+ * @brief One sector, in the order of the lines then sector order
+ *
+*/
+typedef struct checkpoint_sector {
+    unsigned int state;                     // block_state
+    unsigned char valid;
+    unsigned char isDirty;
+} checkpoint_sector_t;
+
+/**
+ * @brief Counters and directory entries of one home node
+ *
+*/
+typedef struct checkpoint_home {
+    unsigned long memoryReads, memoryWrites, forwardCount;
+    unsigned long directoryLookups, cacheProbes;
+    unsigned long firstEntry;               // Index of its first checkpoint_entry_t
+    unsigned long numEntries;
+} checkpoint_home_t;
+
+/**
+ * @brief One directory entry
+ *
+*/
+typedef struct checkpoint_entry {
+    unsigned long block;
+    int state;                              // directory_state
+    int owner;
+    unsigned long sharers[SHARER_WORDS];
+} checkpoint_entry_t;
+
+/**
+ * @brief One page placed by first touch
+ *
+*/
+typedef struct checkpoint_page {
+    unsigned long page;
+    long home;
+} checkpoint_page_t;
+
+// Function declarations for checkpoints
+bool saveCheckpoint(system_t *sys, const char *path, unsigned long traceRecords,
+                    long traceOffset);
+bool restoreCheckpoint(system_t *sys, const char *path, unsigned long *traceRecords,
+                       long *traceOffset);
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,102 @@
+/**
+ * @file coherence_checker.h
+ * @brief Sampled checks of the coherence invariants across caches and
+ *        directories.
+ *
+ * A checked line must have at most one writable copy and no other copy
+ * next to it (single writer, multiple readers), at most one OWNED copy,
+ * a directory entry listing exactly the caches that hold it, and a
+ * directory state and owner that match those copies. Under a snooping bus
+ * only the invariants between the copies apply, and a line of a region
+ * private to one core may only be held by that core, with no entry.
+ */
+
+#ifndef COHERENCE_CHECKER_H
+#define COHERENCE_CHECKER_H
+
+#include <stdbool.h>
+#include <time.h>
+
+/** @brief Violations described in full before only being counted */
+#define CHECK_REPORT_LIMIT 10
+
+/**
+ * @brief Which accesses get their line checked
+ *
+ */
+typedef enum {
+    CHECK_OFF,
+    CHECK_EVERY_ACCESS,     // The line of every access
+    CHECK_EVERY_NTH,        // The line of every Nth access
+    CHECK_SAMPLED_LINES     // Every access to one line in N, picked by hashing the block
+} check_mode;
+
+/**
+ * @brief Invariant a line broke
+ *
+ */
+typedef enum {
+    VIOLATION_MULTIPLE_WRITERS,     // More than one EXCLUSIVE or MODIFIED copy
+    VIOLATION_WRITER_WITH_READERS,  // A writable copy next to other valid copies
+    VIOLATION_MULTIPLE_OWNERS,      // More than one OWNED copy
+    VIOLATION_UNTRACKED_COPY,       // A cache holds the line without the directory knowing
+    VIOLATION_STALE_SHARER,         // The directory lists a cache that does not hold the line
+    VIOLATION_OWNER_MISMATCH,       // Directory state or owner disagrees with the copies
+    VIOLATION_MALFORMED_ENTRY,      // The scheme's own entry invariants are broken
+    NUM_VIOLATION_KINDS
+} violation_kind;
+
+/**
+ * @brief Struct representing the coherence checker of one machine
+ *
+*/
+typedef struct coherence_checker {
+    check_mode mode;
+    unsigned long period;              // N of every Nth access or one line in N
+    unsigned long countdown;           // Accesses left until the next check (CHECK_EVERY_NTH)
+
+    unsigned long linesChecked;
+    unsigned long violations[NUM_VIOLATION_KINDS];
+    unsigned long reported;            // Violations described on stderr
+    struct timespec started;           // When the checker was created
+    double checkSeconds;               // Time spent checking
+} coherence_checker_t;
+
+struct system;
+
+/**
+ * @brief Whether the line of this access is to be checked.
+ *
+ * @param checker
+ * @param block
+ * @return bool
+ */
+static inline bool checkDue(coherence_checker_t *checker, unsigned long block) {
+    switch (checker->mode) {
+        case CHECK_EVERY_ACCESS:
+            return true;
+        case CHECK_EVERY_NTH:
+            if (--checker->countdown != 0) {
+                return false;
+            }
+            checker->countdown = checker->period;
+            return true;
+        case CHECK_SAMPLED_LINES:
+            // Fibonacci hashing spreads neighbouring blocks over the sample
+            return (block * 0x9e3779b97f4a7c15UL >> 32) % checker->period == 0;
+        default:
+            return false;
+    }
+}
+
+// Function declarations for the coherence checker
+coherence_checker_t *createCoherenceChecker(check_mode mode, unsigned long period);
+bool checkLine(coherence_checker_t *checker, struct system *sys, unsigned long address);
+unsigned long checkMachine(coherence_checker_t *checker, struct system *sys);
+unsigned long totalViolations(const coherence_checker_t *checker);
+void printCheckerReport(const coherence_checker_t *checker);
+bool parseCheckMode(const char *text, check_mode *mode, unsigned long *period);
+const char *violationName(violation_kind kind);
+void freeCoherenceChecker(coherence_checker_t *checker);
+
+#endif // COHERENCE_CHECKER_H
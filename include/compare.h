@@ -0,0 +1,26 @@
+/**
+ * @file compare.h
+ * @brief Drive several systems in lockstep from one decoded trace.
+ */
+
+#ifndef COMPARE_H
+#define COMPARE_H
+
+#include <stdio.h>
+#include "system.h"
+#include "trace_pipeline.h"
+#include "workload.h"
+
+/** @brief Most systems that can be compared in one run */
+#define MAX_SYSTEMS 32
+
+// Function declarations for comparison mode
+unsigned long runLockstep(FILE *trace, system_t **systems, int numSystems);
+unsigned long runLockstepPipelined(trace_input_t *input, system_t **systems, int numSystems,
+                                   int numDecoders, ingest_stats_t *stats);
+unsigned long runLockstepUntil(FILE *trace, system_t **systems, int numSystems,
+                               unsigned long maxRecords);
+unsigned long runLockstepWorkload(workload_t *workload, system_t **systems, int numSystems);
+void printComparison(system_t **systems, int numSystems);
+
+#endif // COMPARE_H
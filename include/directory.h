@@ -1,19 +1,113 @@
 /**
  * @file directory.h
- * @brief 
+ * @brief Operations table shared by every directory scheme.
+ *
+ * Each scheme (central full-map, limited pointer, hybrid, ...) keeps its own entry
+ * layout private and exports a directory_ops_t, so the protocol engine and
+ * the comparison mode can drive any of them through the same calls.
  */
 
 #ifndef DIRECTORY_H
 #define DIRECTORY_H
 
-#define NUM_PROCESSORS 4  
+#include <stdbool.h>
+#include "line_table.h"
+
+#ifndef NUM_PROCESSORS
+#define NUM_PROCESSORS 4
+#endif
+/** @brief Initial directory entries per home node; slices grow as lines are shared */
 #define NUM_LINES 256
 
-// States for a cache line for a directory based approach 
+/** @brief Bits encoding a directory_state in hardware */
+#define DIRECTORY_STATE_BITS 2
+
+/** @brief Number of words in a sharer bit vector */
+#define SHARER_WORDS ((NUM_PROCESSORS + 63) / 64)
+
+// States for a cache line for a directory based approach
 typedef enum {
     DIR_UNCACHED,
     DIR_SHARED,
-    DIR_EXCLUSIVE_MODIFIED
+    DIR_EXCLUSIVE_MODIFIED,
+    DIR_OWNED               // Shared, but the owner holds the only up to date copy (MOESI)
 } directory_state;
 
-#endif // DIRECTORY_H
\ No newline at end of file
+/**
+ * @brief Set of processors holding a line, one bit per processor.
+ *
+ */
+typedef struct sharer_set {
+    unsigned long bits[SHARER_WORDS];
+} sharer_set_t;
+
+/** @brief Called once per tracked line by forEachLine */
+typedef void (*directory_visit_fn)(void *arg, unsigned long block, directory_state state,
+                                   int owner, const sharer_set_t *sharers);
+
+/**
+ * @brief Operations every directory scheme implements.
+ *
+ * Blocks are memory addresses shifted right by the block bits. The
+ * directory handle is whatever the scheme's create returns. Entries are
+ * keyed on the full block number, so distinct lines never alias, and only
+ * lines some cache holds take up an entry.
+ */
+typedef struct directory_ops {
+    const char *name;
+
+    // Allocate a directory slice with room for numLines entries before it grows
+    void *(*create)(int numLines);
+    void (*destroy)(void *directory);
+
+    // State of the line and its owner (-1 if none)
+    directory_state (*getState)(void *directory, unsigned long block, int *owner);
+    // Processors the directory believes hold the line
+    void (*getSharers)(void *directory, unsigned long block, sharer_set_t *sharers);
+
+    // Set the state of the line; processorId becomes owner in DIR_EXCLUSIVE_MODIFIED and DIR_OWNED
+    void (*setState)(void *directory, unsigned long block, int processorId, directory_state newState);
+    // Record a sharer; returns a sharer (never the owner) dropped to make room, or -1
+    int (*addSharer)(void *directory, unsigned long block, int processorId);
+    void (*removeSharer)(void *directory, unsigned long block, int processorId);
+    // Forget every sharer and return the line to DIR_UNCACHED
+    void (*invalidate)(void *directory, unsigned long block);
+
+    // Check the line's entry is well formed and lists processorId (-1 to skip that)
+    bool (*checkConsistency)(void *directory, unsigned long block, int processorId);
+
+    // Occupancy of the hash table holding the live entries
+    void (*tableStats)(void *directory, line_table_stats_t *stats);
+    // Visit every line some cache holds, in no particular order (checkpoints)
+    void (*forEachLine)(void *directory, directory_visit_fn visit, void *arg);
+
+    // State and sharer bits of one entry in hardware, tag excluded
+    unsigned int (*entryBits)(int numProcessors);
+
+    // Print counters of the scheme's own after a home's table stats, NULL if it has none
+    void (*printStats)(void *directory, int homeId);
+
+    // Requests are broadcast on a snooping bus; the scheme tracks nothing
+    bool broadcast;
+} directory_ops_t;
+
+// Directory schemes
+extern const directory_ops_t centralDirectoryOps;
+extern const directory_ops_t limitedPointerDirectoryOps;
+extern const directory_ops_t hybridDirectoryOps;
+extern const directory_ops_t snoopBusOps;
+
+// Function declarations for directory schemes
+const directory_ops_t *findDirectoryOps(const char *name);
+const directory_ops_t *directoryScheme(int index);
+void listDirectorySchemes(void);
+unsigned int processorIdBits(int numProcessors);
+
+// Function declarations for sharer sets
+void sharerSetClear(sharer_set_t *set);
+void sharerSetAdd(sharer_set_t *set, int processorId);
+void sharerSetRemove(sharer_set_t *set, int processorId);
+bool sharerSetHas(const sharer_set_t *set, int processorId);
+int sharerSetCount(const sharer_set_t *set);
+
+#endif // DIRECTORY_H
@@ -0,0 +1,114 @@
+/**
+ * @file dram.h
+ * @brief Memory controller of a home node: banks with open row buffers,
+ *        a bounded read/write queue and first-ready scheduling.
+ *
+ * Requests reach the controller in simulation order, but stamped with the
+ * requesting core's clock, so they do not arrive in time order. Each bank
+ * keeps its recent schedule as busy intervals, and a request takes the
+ * earliest gap after its arrival that is long enough for it. A row hit
+ * may go into a gap ahead of requests already scheduled, as a first-ready
+ * scheduler would let it; a request that opens another row may only do so
+ * if the request after the gap was not counting on the open row. Latencies
+ * already reported are never changed.
+ */
+
+#ifndef DRAM_H
+#define DRAM_H
+
+#include <stdbool.h>
+
+/** @brief log2 of the bytes in a row of a bank */
+#define DRAM_ROW_BITS 11
+
+/** @brief Cycles from a column command on the open row to the first data */
+#define DRAM_CAS_CYCLES 30
+
+/** @brief Cycles to open a row */
+#define DRAM_RCD_CYCLES 30
+
+/** @brief Cycles to close the open row */
+#define DRAM_RP_CYCLES 30
+
+/** @brief Cycles to transfer a line once the data starts */
+#define DRAM_BURST_CYCLES 10
+
+/** @brief Banks per controller when only the queue depth is given */
+#define DEFAULT_DRAM_BANKS 8
+
+/** @brief Requests a controller holds at once when no depth is given */
+#define DEFAULT_DRAM_QUEUE 16
+
+/** @brief Most banks per controller */
+#define MAX_DRAM_BANKS 64
+
+/** @brief Deepest read/write queue, and requests remembered to track it */
+#define MAX_DRAM_QUEUE 64
+
+/** @brief Busy intervals remembered per bank */
+#define DRAM_BANK_RESERVATIONS 16
+
+/** @brief Row of a bank whose row buffer is closed */
+#define DRAM_NO_ROW (~0UL)
+
+/**
+ * @brief One request's use of a bank
+ *
+*/
+typedef struct dram_reservation {
+    unsigned long start;        // Cycle the bank starts on the request
+    unsigned long end;          // Cycle the data has been transferred
+    unsigned long row;          // Row left open afterwards
+} dram_reservation_t;
+
+/**
+ * @brief Recent schedule of one bank, sorted by start
+ *
+*/
+typedef struct dram_bank {
+    dram_reservation_t reservations[DRAM_BANK_RESERVATIONS];
+    int count;
+    unsigned long rowBefore;    // Row open before the first remembered reservation
+} dram_bank_t;
+
+/**
+ * @brief Arrival and completion of a request, for queue occupancy
+ *
+*/
+typedef struct dram_request {
+    unsigned long arrival;
+    unsigned long end;
+} dram_request_t;
+
+/**
+ * @brief Memory controller of one home node
+ *
+*/
+typedef struct dram_controller {
+    int numBanks;
+    unsigned int bankBits;          // log2 of numBanks
+    int queueDepth;                 // Requests the controller holds at once
+    dram_bank_t banks[MAX_DRAM_BANKS];
+    dram_request_t recent[MAX_DRAM_QUEUE];  // Latest requests, a ring
+    int nextRecent;
+
+    unsigned long reads;            // Lines read for misses
+    unsigned long writes;           // Lines written back
+    unsigned long rowHits;          // Requests to the open row
+    unsigned long rowEmpty;         // Requests to a bank with no open row
+    unsigned long rowConflicts;     // Requests that closed another row first
+    unsigned long queueFullStalls;  // Requests that found the queue full
+    unsigned long queueCycles;      // Cycles requests waited for a queue entry
+    unsigned long bankCycles;       // Cycles requests waited for their bank
+    unsigned long readCycles;       // Cycles from arrival to data, summed over reads
+} dram_controller_t;
+
+// Function declarations for the memory controller
+dram_controller_t *createDramController(int numBanks, int queueDepth);
+unsigned long dramAccess(dram_controller_t *dram, unsigned long address, unsigned long arrival,
+                         bool isWrite);
+bool parseDramConfig(const char *text, int *numBanks, int *queueDepth);
+void printDramController(const dram_controller_t *dram, int home);
+void freeDramController(dram_controller_t *dram);
+
+#endif // DRAM_H
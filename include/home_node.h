@@ -0,0 +1,57 @@
+/**
+ * @file home_node.h
+ * @brief Map memory addresses to their home node on a NUMA machine.
+ */
+
+#ifndef HOME_NODE_H
+#define HOME_NODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "line_table.h"
+
+/** @brief Default interleaving unit for line interleaving (64 byte lines) */
+#define DEFAULT_LINE_BITS 6
+
+/** @brief Default interleaving unit for page interleaving and first touch (4 KB pages) */
+#define DEFAULT_PAGE_BITS 12
+
+/** @brief Initial number of slots in the first-touch page table */
+#define FIRST_TOUCH_INITIAL_SLOTS 1024
+
+/**
+ * @brief Policy used to pick the home node of an address.
+ *
+ */
+typedef enum {
+    HOME_LINE_INTERLEAVE,   // Consecutive cache lines rotate across the nodes
+    HOME_PAGE_INTERLEAVE,   // Consecutive pages rotate across the nodes
+    HOME_XOR_INTERLEAVE,    // Interleave on an XOR-fold of all the upper address bits
+    HOME_FIRST_TOUCH        // A page lives on the first node that touches it
+} home_policy;
+
+/**
+ * @brief Struct representing the home node mapping of the machine
+ *
+ * Every interleaving unit (line or page, 1 << granularityBits bytes) is
+ * owned by exactly one node. First touch keeps a table of the pages that
+ * have already been placed.
+*/
+typedef struct home_map {
+    home_policy policy;            // Placement policy
+    int numNodes;                  // Number of home nodes (one per processor)
+    unsigned int granularityBits;  // log2 of the interleaving unit in bytes
+    unsigned int xorFoldBits;      // Width of each fold for XOR interleaving
+
+    line_table_t *pages;           // First touch: home node of every page placed so far
+} home_map_t;
+
+// Function declarations for home node mapping
+home_map_t *createHomeMap(home_policy policy, int numNodes, unsigned int granularityBits);
+int homeNode(home_map_t *map, unsigned long address, int requesterId);
+int peekHomeNode(home_map_t *map, unsigned long address, int requesterId);
+bool parseHomePolicy(const char *name, home_policy *policy);
+const char *homePolicyName(home_policy policy);
+void freeHomeMap(home_map_t *map);
+
+#endif // HOME_NODE_H
@@ -0,0 +1,53 @@
+/**
+ * @file hybrid_directory.h
+ * @brief Directory whose entries switch between limited pointers and a
+ *        full bit vector as their sharer count changes.
+ */
+
+#ifndef HYBRID_DIRECTORY_H
+#define HYBRID_DIRECTORY_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <directory.h>
+#include <line_table.h>
+
+/** @brief Sharer pointers in an entry before it is promoted to a full vector */
+#define HYBRID_POINTERS 2
+
+/** @brief Sharers left when a promoted entry goes back to pointers */
+#define HYBRID_DEMOTE_SHARERS 1
+
+/** @brief Full vectors the pool starts with; it doubles when they run out */
+#define HYBRID_INITIAL_VECTORS 16
+
+// Directory entry for each block with live sharers
+typedef struct {
+    directory_state state;
+    int owner; // Owner of the line if in exclusive/modified/owned state
+    int numSharedBy; // Sharers, in the pointers or in the full vector
+    int vector; // Index of the entry's full vector in the pool, -1 while it uses pointers
+    int nodes[HYBRID_POINTERS]; // Which nodes have this line while it uses pointers
+} hybrid_directory_entry_t;
+
+// Side pool of full bit vectors for the entries with more sharers than pointers
+typedef struct {
+    sharer_set_t* vectors;
+    int* freeList; // Indexes of the unused vectors
+    int numFree;
+    int capacity;
+    int inUse;
+    int peak; // Most vectors in use at once
+} sharer_vector_pool_t;
+
+typedef struct {
+    line_table_t* lines; // Entries keyed on the full block number
+    sharer_vector_pool_t pool;
+    unsigned long promotions; // Entries moved from pointers to a full vector
+    unsigned long demotions; // Entries that gave their full vector back
+    pthread_mutex_t lock; // Mutex for synchronizing access to the directory
+} hybrid_directory_t;
+
+// The hybrid directory is used through hybridDirectoryOps (directory.h)
+
+#endif // HYBRID_DIRECTORY_H
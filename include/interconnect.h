@@ -1,6 +1,6 @@
 /**
  * @file interconnect.h
- * @brief 
+ * @brief Point-to-point network between the processors and home nodes.
  */
 
 #ifndef INTERCONNECT_H
@@ -9,6 +9,12 @@
 #include <stdbool.h>
 #include <pthread.h>
 
+/** @brief Number of clock cycles for a message to cross the network */
+#define HOP_CYCLES 20
+
+/** @brief Bytes of type, address and node ids every message carries */
+#define MESSAGE_HEADER_BYTES 8
+
 typedef enum {
     READ_REQUEST,       // Cache to Memory
     READ_ACKNOWLEDGE,   // Memory to Cache
@@ -17,36 +23,63 @@ typedef enum {
     WRITE_REQUEST,      // Cache to Memory
     WRITE_UPDATE,       // Cache to Memory or Cache to Cache (depending on policy)
     WRITE_ACKNOWLEDGE,  // Memory to Cache
-    UPDATE              // Memory to Cache
+    UPDATE,             // Memory to Cache
+    FETCH,              // Memory to Cache: owner writes back and keeps a shared copy
+    EVICTION_NOTICE,    // Cache to Memory: a clean line was replaced
+    FORWARD_READ,       // Memory to Cache: owner sends the line to the requester
+    FORWARD_WRITE,      // Memory to Cache: owner hands the line over to the requester
+    SHARING_WRITEBACK,  // Cache to Memory: owner kept a shared copy after a forwarded read
+    OWNERSHIP_TRANSFER, // Cache to Memory: owner gave up a clean or forwarded-write line, no data
+    NACK,               // Cache to Memory: forwarded request for a line the cache no longer holds
+    EXCLUSIVE_ACKNOWLEDGE, // Memory to Cache: read granted as the only copy (MESI/MOESI)
+    DATA_REPLY,         // Cache to Memory: owner's dirty data relayed without updating memory
+    OWNED_ACK,          // Cache to Memory: owner kept the dirty line as OWNED after a forwarded read
+    WRITE_THROUGH,      // Cache to Memory: stores written through without taking ownership
+    WRITE_THROUGH_ACK,  // Memory to Cache: the stores reached memory, other copies invalidated
+    NUM_MESSAGE_TYPES
 } message_type;
 
 typedef struct {
-    message_type type;  // The type of message being sent
-    int sourceId;       // ID of the sending cache or memory
-    int destId;         // ID of the destination cache or memory
-    int address;        // The memory address involved in the message
+    message_type type;      // The type of message being sent
+    int sourceId;           // ID of the sending cache or memory
+    int destId;             // ID of the destination cache or memory
+    unsigned long address;  // The memory address involved in the message
+    int requesterId;        // Processor whose miss started the transaction
+    unsigned long latency;  // Cycles since the transaction started, on delivery
+    unsigned int dataBytes; // Bytes of line data carried, 0 for control messages
 } message_t;
 
+struct processor;
+struct snoop_bus;
+
 typedef struct interconnect {
-    message_t* queue;
-    int capacity;
-    int count;
+    struct processor* processors;   // Nodes attached to the interconnect
+    int numNodes;                   // Number of nodes
+    struct snoop_bus* bus;          // Carries every request when snooping, NULL otherwise
+    unsigned long messageCount[NUM_MESSAGE_TYPES];  // Messages sent, by type
+    unsigned long localMessages;    // Messages whose source is their destination
+    unsigned long remoteMessages;   // Messages that crossed the network
+    unsigned long hopCycles;        // Cycles spent by all messages crossing the network
+    unsigned long headerBytes;      // Header bytes that crossed the network
+    unsigned long dataBytes;        // Line data bytes that crossed the network
     pthread_mutex_t mutex;  // Mutex for thread-safe access
 } interconnect_t;
 
-// Function declarations for interconnect 
+// Function declarations for interconnect
 // Initialize the interconnect
-interconnect_t *createInterconnect(int num_processors);
+interconnect_t *createInterconnect(struct processor *processors, int numNodes);
 
 // Send a message via the interconnect
 void interconnectSendMessage(interconnect_t *interconnect, message_t message);
 
-// Process messages from the interconnect queue
-void interconnectProcessMessages(interconnect_t *interconnect);
-
 // Free resources associated with the interconnect
-void interconnectFree(interconnect_t *interconnect);
+void freeInterconnect(interconnect_t *interconnect);
+
+int broadcastMessage(int source, message_t message, interconnect_t *interconnect);
 
-int broadcastMessage(int source, message_t message);
+unsigned long interconnectTotalMessages(const interconnect_t *interconnect);
+unsigned long interconnectTotalBytes(const interconnect_t *interconnect);
+bool messageCarriesData(message_type type);
+const char *messageTypeName(message_type type);
 
 #endif // INTERCONNECT_H
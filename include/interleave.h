@@ -0,0 +1,107 @@
+/**
+ * @file interleave.h
+ * @brief Interleaving of the processors' access streams, its record and
+ *        replay, and the spread of results across interleavings.
+ *
+ * A trace fixes one global order of its records. Split into one stream
+ * per processor, the streams can be interleaved other ways: by one thread
+ * per processor issuing its stream in whatever order the threads happen to
+ * run, or deterministically, by letting the processor with the earliest
+ * clock go next and breaking near ties with a seeded arbiter at the home
+ * node the contending accesses go to. Any interleaving can be recorded to
+ * a compact log of runs of one processor's records and replayed exactly,
+ * with neither threads nor arbitration.
+ */
+
+#ifndef INTERLEAVE_H
+#define INTERLEAVE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "system.h"
+#include "trace_input.h"
+#include "workload.h"
+
+/** @brief Most seeds, or thread runs, one command line can ask for */
+#define MAX_INTERLEAVE_SEEDS 64
+
+/** @brief Accesses whose processors' clocks are this close contend for a home */
+#define INTERLEAVE_WINDOW_CYCLES HOP_CYCLES
+
+/** @brief "DSIL" in a little-endian interleaving log header */
+#define INTERLEAVE_LOG_MAGIC 0x4c495344u
+
+/** @brief Bumped whenever the log layout changes */
+#define INTERLEAVE_LOG_VERSION 1
+
+/**
+ * @brief How the processors' streams are interleaved
+ *
+ */
+typedef enum {
+    INTERLEAVE_TRACE,       // Trace order
+    INTERLEAVE_THREADS,     // One thread per processor, in whatever order they run
+    INTERLEAVE_SEEDED       // Earliest clock first, near ties arbitrated from a seed
+} interleave_mode;
+
+/**
+ * @brief Interleaving asked for on the command line
+ *
+ */
+typedef struct interleave_config {
+    interleave_mode mode;
+    unsigned long seeds[MAX_INTERLEAVE_SEEDS];  // Seeds, or thread runs numbered from 1
+    int numSeeds;
+    const char *recordPath;             // Log to record the interleaving to, NULL for none
+    const char *replayPath;             // Log to replay instead of interleaving, NULL for none
+} interleave_config_t;
+
+/**
+ * @brief Every record of a trace, and each processor's stream of them
+ *
+*/
+typedef struct processor_streams {
+    access_t *records;                  // In trace order
+    unsigned long count;
+    unsigned long *positions[NUM_PROCESSORS];   // Each processor's records, in trace order
+    unsigned long lengths[NUM_PROCESSORS];
+    unsigned long stray;                // Records naming no possible processor
+    unsigned long hash;                 // Of the records in trace order, checked on replay
+} processor_streams_t;
+
+/**
+ * @brief What one interleaved run did
+ *
+ */
+typedef struct interleave_run {
+    unsigned long records;              // Records in the streams, dropped ones included
+    unsigned long runs;                 // Runs of consecutive records by one processor
+    unsigned long arbitrations;         // Seeded: accesses picked by an arbiter
+    unsigned long contested;            // Seeded: of those, picked among several processors
+    long logBytes;                      // Recording: size of the log
+} interleave_run_t;
+
+/**
+ * @brief Key metrics of every system under every seed
+ *
+ */
+typedef struct seed_variance {
+    int numSystems;
+    int numSeeds;
+    bool threads;                       // Runs of the threaded mode rather than seeds
+    double *values;                     // [system][seed][metric]
+} seed_variance_t;
+
+// Function declarations for interleaving
+bool parseInterleaveMode(const char *text, interleave_config_t *config);
+processor_streams_t *loadStreams(trace_input_t *input, workload_t *workload);
+bool runInterleaving(const processor_streams_t *streams, system_t *sys,
+                     const interleave_config_t *config, unsigned long seed,
+                     interleave_run_t *run);
+seed_variance_t *measureSeedVariance(const processor_streams_t *streams, system_t **systems,
+                                     int numSystems, const interleave_config_t *config);
+void printSeedVariance(seed_variance_t *variance, system_t **systems);
+void freeSeedVariance(seed_variance_t *variance);
+void freeStreams(processor_streams_t *streams);
+
+#endif // INTERLEAVE_H
@@ -0,0 +1,139 @@
+/**
+ * @file interval_stats.h
+ * @brief Periodic snapshots of a machine's counters, streamed to a file by
+ *        a background writer thread.
+ *
+ * The simulator copies its cumulative counters into a preallocated ring of
+ * snapshots every interval; the writer turns consecutive snapshots into
+ * per-interval deltas and writes them as CSV or binary records. Between
+ * snapshots the simulator only bumps a counter and compares it.
+ */
+
+#ifndef INTERVAL_STATS_H
+#define INTERVAL_STATS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "directory.h"
+
+/** @brief Snapshots the simulator can get ahead of the writer */
+#define INTERVAL_RING_SNAPSHOTS 64
+
+/** @brief First eight bytes of a binary interval file ("DIRSTAT" and a NUL) */
+#define INTERVAL_MAGIC 0x0054415453524944UL
+
+/** @brief Bumped whenever the binary record layout changes */
+#define INTERVAL_VERSION 1
+
+/**
+ * @brief What the snapshot period is counted in
+ *
+ */
+typedef enum {
+    INTERVAL_ACCESSES,      // Trace records simulated
+    INTERVAL_CYCLES         // Machine clock: cycles of the busiest processor
+} interval_unit;
+
+/**
+ * @brief File format written by the writer thread
+ *
+ */
+typedef enum { INTERVAL_CSV, INTERVAL_BINARY } interval_format;
+
+/**
+ * @brief Counters of one node: its core and cache, and its home directory
+ *
+*/
+typedef struct interval_counters {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long upgrades;
+    unsigned long invalidations;
+    unsigned long evictions;
+    unsigned long cycles;
+    unsigned long memoryReads;         // Home side from here on
+    unsigned long memoryWrites;
+    unsigned long forwards;
+} interval_counters_t;
+
+/**
+ * @brief Counters of the whole machine at the end of an interval
+ *
+ * Cumulative in the ring, per interval once written out.
+*/
+typedef struct interval_snapshot {
+    unsigned long interval;            // Index of the interval, from 0
+    unsigned long accesses;            // Records simulated by its end
+    unsigned long cycles;              // Machine clock at its end
+    unsigned long messages;
+    interval_counters_t nodes[NUM_PROCESSORS];
+} interval_snapshot_t;
+
+/**
+ * @brief Start of a binary interval file
+ *
+ * Each interval follows as the four leading fields of interval_snapshot_t
+ * and then numProcessors interval_counters_t, recordSize bytes in all.
+*/
+typedef struct interval_file_header {
+    unsigned long magic;
+    unsigned int version;
+    unsigned int numProcessors;
+    unsigned int unit;                 // interval_unit
+    unsigned int recordSize;           // Bytes per interval
+    unsigned long period;
+} interval_file_header_t;
+
+/**
+ * @brief Struct representing the interval statistics of one machine
+ *
+ * The simulator fills ring[head % INTERVAL_RING_SNAPSHOTS] and the writer
+ * drains ring[tail % INTERVAL_RING_SNAPSHOTS]; head and tail only grow.
+*/
+typedef struct interval_stats {
+    interval_unit unit;
+    unsigned long period;
+    unsigned long count;               // Accesses so far, when counting accesses
+    unsigned long nextSnapshot;        // Count or clock at which the next snapshot is due
+    unsigned long lastAccesses;        // Accesses at the last published snapshot
+    int numProcessors;
+    interval_format format;
+    FILE *out;
+
+    interval_snapshot_t ring[INTERVAL_RING_SNAPSHOTS];
+    unsigned long head;                // Snapshots published by the simulator
+    unsigned long tail;                // Snapshots written out
+    unsigned long writerStalls;        // Snapshots that waited for a free slot
+    bool done;
+    bool writeFailed;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+    interval_snapshot_t previous;      // Writer side: last snapshot written
+} interval_stats_t;
+
+/**
+ * @brief Count one access and tell whether a snapshot is due.
+ *
+ * @param stats
+ * @param cycles            cycle count of the processor that just accessed
+ * @return bool
+ */
+static inline bool intervalDue(interval_stats_t *stats, unsigned long cycles) {
+    unsigned long now = stats->unit == INTERVAL_ACCESSES ? ++stats->count : cycles;
+    return now >= stats->nextSnapshot;
+}
+
+// Function declarations for interval statistics
+interval_stats_t *createIntervalStats(const char *path, interval_format format,
+                                      interval_unit unit, unsigned long period,
+                                      int numProcessors);
+interval_snapshot_t *beginSnapshot(interval_stats_t *stats);
+void publishSnapshot(interval_stats_t *stats, unsigned long now);
+void printIntervalStats(const interval_stats_t *stats);
+bool parseIntervalPeriod(const char *text, unsigned long *period, interval_unit *unit);
+bool freeIntervalStats(interval_stats_t *stats);
+
+#endif // INTERVAL_STATS_H
@@ -1,6 +1,6 @@
 /**
  * @file limited_pointer_dir.h
- * @brief Implement a central directory based cache coherence protocol. 
+ * @brief Implement a central directory based cache coherence protocol.
  */
 
 #ifndef LIMITED_POINTER_DIR_H
@@ -8,36 +8,24 @@
 
 #include <stdbool.h>
 #include <pthread.h>
-#include <directory.h> 
+#include <directory.h>
+#include <line_table.h>
 
 #define NUM_POINTERS 10
 
-// Directory entry for each block in the main memory
+// Directory entry for each block with live sharers
 typedef struct {
-    directory_state state; // Q: Does each cache need to track the state too?  
-    int nodes[NUM_POINTERS]; // Which node has this line 
-    int owner; // Owner of the line if in exclusive/modified state
-    pthread_mutex_t lock; // Mutex for synchronizing access to this entry
+    directory_state state; // Q: Does each cache need to track the state too?
+    int nodes[NUM_POINTERS]; // Which node has this line
+    int owner; // Owner of the line if in exclusive/modified/owned state
     int numSharedBy; // number of nodes this line is shared by
 } lp_directory_entry_t;
 
 typedef struct {
-    lp_directory_entry_t* lines;
-    int numLines;
+    line_table_t* lines; // Entries keyed on the full block number
     pthread_mutex_t lock; // Mutex for synchronizing access to the directory
-    interconnect_t* interconnect;  // Pointer to the interconnect
 } lp_directory_t;
 
-// Function declarations for directory
-lp_directory_t* initializeDirectory();
-void updateDirectoryEntry();
-bool checkCacheConsistency();
-void freeDirectory(directory_t* directory);
-
-// Function declarations for directory based protocol
-void initializeSystem(void);
-
-// Function declarations for benchmarking / testing 
-void displayUsage(void);
+// The limited pointer directory is used through limitedPointerDirectoryOps (directory.h)
 
 #endif // LIMITED_POINTER_DIR_H
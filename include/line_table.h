@@ -0,0 +1,82 @@
+/**
+ * @file line_table.h
+ * @brief Hash table keyed on full block (or page) numbers.
+ *
+ * Traces use sparse 64 bit addresses, so per-line state is kept in an
+ * open-addressing robin-hood table that only holds live keys. Entries are
+ * stored inline next to their key, and the table grows incrementally: a
+ * few slots of the old table move over on every insert or remove instead
+ * of rehashing everything at once.
+ */
+
+#ifndef LINE_TABLE_H
+#define LINE_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** @brief Smallest number of slots a table is created with */
+#define LINE_TABLE_MIN_SLOTS 16
+
+/** @brief Grow once the table is this many percent full */
+#define LINE_TABLE_MAX_LOAD 75
+
+/** @brief Old slots moved to the new table per insert or remove while growing */
+#define LINE_TABLE_MIGRATE_STEP 8
+
+/**
+ * @brief One array of slots
+ *
+ * Each slot is a slot_header_t (line_table.c) followed by the caller's
+ * entry, slotSize bytes in all.
+*/
+typedef struct line_table_array {
+    unsigned char *slots;
+    size_t numSlots;               // Always a power of two
+    size_t count;                  // Live keys in this array
+} line_table_array_t;
+
+/**
+ * @brief Struct representing a hash table of per-line entries
+ *
+ * While growing, keys live in either old or current; every key is found
+ * in exactly one of them.
+*/
+typedef struct line_table {
+    line_table_array_t current;
+    line_table_array_t old;        // Being drained into current, numSlots 0 if not growing
+    size_t migrateCursor;          // Next slot of old to move
+    size_t entrySize;              // Bytes of caller data per entry
+    size_t slotSize;               // Bytes per slot, header included
+    unsigned char *scratch;        // Two slots of room for robin-hood swaps
+
+    unsigned long lookups;         // Finds, inserts and removes
+    unsigned long probes;          // Slots examined by those lookups
+} line_table_t;
+
+/**
+ * @brief Occupancy of a line table, for reports
+ *
+*/
+typedef struct line_table_stats {
+    size_t entries;                // Live keys
+    size_t slots;                  // Slots allocated, both arrays while growing
+    double loadFactor;             // entries / slots of the current array
+    double averageProbe;           // Slots examined per lookup
+    unsigned int maxDisplacement;  // Furthest any key sits from its home slot
+} line_table_stats_t;
+
+/** @brief Called once per key by lineTableForEach */
+typedef void (*line_table_visit_fn)(void *arg, unsigned long key, void *entry);
+
+// Function declarations for line tables
+line_table_t *createLineTable(size_t entrySize, size_t initialSlots);
+void *lineTableFind(line_table_t *table, unsigned long key);
+void *lineTableInsert(line_table_t *table, unsigned long key, bool *created);
+void lineTableRemove(line_table_t *table, unsigned long key);
+size_t lineTableCount(const line_table_t *table);
+void lineTableForEach(line_table_t *table, line_table_visit_fn visit, void *arg);
+void lineTableStats(const line_table_t *table, line_table_stats_t *stats);
+void freeLineTable(line_table_t *table);
+
+#endif // LINE_TABLE_H
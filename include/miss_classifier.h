@@ -0,0 +1,64 @@
+/**
+ * @file miss_classifier.h
+ * @brief Splits a cache's misses into cold, capacity, conflict and
+ *        coherence misses.
+ */
+
+#ifndef MISS_CLASSIFIER_H
+#define MISS_CLASSIFIER_H
+
+#include <stdbool.h>
+#include "line_table.h"
+#include "sharing_profile.h"
+
+/** @brief Marks the end of the shadow LRU list, or a block not in the shadow cache */
+#define SHADOW_NONE 0xffffffffU
+
+/**
+ * @brief Cause of a cache miss.
+ *
+ */
+typedef enum {
+    MISS_COLD,              // First reference to the line by this cache
+    MISS_CAPACITY,          // Would also miss in a fully associative cache of the same size
+    MISS_CONFLICT,          // Would hit in a fully associative cache of the same size
+    MISS_TRUE_SHARING,      // Copy invalidated, and the wanted word was written since
+    MISS_FALSE_SHARING,     // Copy invalidated for a write to another word of the line
+    NUM_MISS_CLASSES
+} miss_class;
+
+/**
+ * @brief One line of the shadow cache, linked in LRU order
+ *
+*/
+typedef struct shadow_line {
+    unsigned long block;
+    unsigned int prev;                 // Toward the most recently used line
+    unsigned int next;                 // Toward the least recently used line
+} shadow_line_t;
+
+/**
+ * @brief Struct representing the miss classifier of one cache
+ *
+ * The shadow cache is fully associative with as many lines as the real
+ * one and replaces the least recently used line. It sees every access,
+ * hits included, so a miss it would have hit is a conflict miss.
+*/
+typedef struct miss_classifier {
+    unsigned int lineBits;             // log2 of the line size in bytes
+    unsigned int capacity;             // Lines in the shadow cache
+    unsigned int used;                 // Lines of it filled so far
+    shadow_line_t *shadow;             // capacity lines
+    unsigned int mru;                  // Most recently used line, SHADOW_NONE if empty
+    unsigned int lru;                  // Least recently used line, SHADOW_NONE if empty
+    line_table_t *blocks;              // Every block referenced: index into shadow or SHADOW_NONE
+} miss_classifier_t;
+
+// Function declarations for miss classification
+miss_classifier_t *createMissClassifier(unsigned int s, unsigned int E, unsigned int b);
+miss_class classifyAccess(miss_classifier_t *classifier, unsigned long address, bool missed,
+                          profile_miss_kind coherence);
+const char *missClassName(miss_class missClass);
+void freeMissClassifier(miss_classifier_t *classifier);
+
+#endif // MISS_CLASSIFIER_H
@@ -1,25 +1,42 @@
 /**
  * @file processor.h
- * @brief 
+ * @brief A node of the machine: private cache plus the home directory slice
+ *        for the memory it owns.
  */
 
 #ifndef PROCESSOR_H
 #define PROCESSOR_H
 
+#include "directory.h"
+#include "dram.h"
 #include "interconnect.h"
+#include "region_tracker.h"
 #include "single_cache.h"
 
-#define NUM_PROCESSORS 4  
-#define NUM_LINES 256
-
-// States for a cache line for a directory based approach 
 typedef struct processor {
     int processor_id;
     interconnect_t* interconnect;
-    cache_t* cache; 
-    directory_t* directory; // central directory struct for now; how can we make this OO so limited pointer, central, and sparse are subclasses of directory? 
+    cache_t* cache;
+    miss_classifier_t* classifier;  // NULL unless misses are classified
+    void* directory;                // directory slice for the lines homed here
+    const directory_ops_t* dirOps;  // scheme implementing the directory slice
+    dram_controller_t* dram;        // memory controller, NULL for a flat MISS_CYCLES
+    region_tracker_t* regions;      // shared by every home, NULL unless private regions
+                                    // skip the directory
+    bool forwarding;                // forward misses to the owner (3-hop) instead of
+                                    // fetching through the home node (4-hop)
+
+    unsigned long memoryReads;      // lines supplied by this node's memory
+    unsigned long memoryWrites;     // lines written back to this node's memory
+    unsigned long forwardCount;     // misses this home forwarded to an owner
+    unsigned long directoryLookups; // requests and notices that read or updated this directory
+    unsigned long cacheProbes;      // invalidations and forwards that looked up this cache
+
+    unsigned long replyLatency;     // latest reply seen by the transaction in progress
+    message_type lastReply;         // last reply seen by the transaction in progress
+    bool replyHadData;              // some reply to the transaction carried dirty data
 } processor_t;
 
-void processMessage(processor_t* processor, message_t* message); 
+void processMessage(processor_t* processor, message_t* message);
 
-#endif // PROCESSOR_H
\ No newline at end of file
+#endif // PROCESSOR_H
@@ -1,6 +1,6 @@
 /**
  * @file queue.h
- * @brief 
+ * @brief Thread-safe FIFO queue, optionally bounded.
  */
 
 #ifndef QUEUE_H
@@ -20,14 +20,19 @@ typedef struct {
     QueueNode* front;
     QueueNode* rear;
     int size;
+    int capacity;           // Most elements held before enqueue blocks, 0 for no limit
+    bool closed;            // No more elements will be added
     pthread_mutex_t lock;
-    pthread_cond_t cond;
+    pthread_cond_t cond;    // Signalled when an element is added or the queue is closed
+    pthread_cond_t notFull; // Signalled when an element is removed or the queue is closed
 } Queue;
 
 // Function declarations
 Queue* createQueue();
+Queue* createBoundedQueue(int capacity);
 void enqueue(Queue* q, void* data);
 void* dequeue(Queue* q);
+void closeQueue(Queue* q);
 void* peekQueue(const Queue* q);
 int queueSize(const Queue* q);
 bool isQueueEmpty(const Queue* q);
@@ -0,0 +1,74 @@
+/**
+ * @file region_tracker.h
+ * @brief Coarse regions private to one core, whose misses skip the directory.
+ *
+ * The tracker remembers, for every region any core has missed in, which
+ * core that was. Until a second core misses there, no other cache can hold
+ * a line of the region, so its misses and evictions need neither a
+ * directory lookup nor an entry. The first miss by a second core makes the
+ * region shared for good: the home probes the first core for the lines of
+ * the region it holds and enters them in their directories, and from then
+ * on the region's lines are tracked one by one.
+ */
+
+#ifndef REGION_TRACKER_H
+#define REGION_TRACKER_H
+
+#include <stdbool.h>
+#include "home_node.h"
+#include "interconnect.h"
+#include "line_table.h"
+
+/** @brief Suggested log2 of the region size in bytes */
+#define REGION_DEFAULT_BITS 12
+
+/** @brief Initial number of regions in the tracker */
+#define REGION_INITIAL_REGIONS 256
+
+/** @brief Cycles the region probe to the first core adds to a miss that shares a region */
+#define REGION_PROBE_CYCLES (2 * HOP_CYCLES)
+
+struct processor;
+
+/**
+ * @brief One region some core has missed in
+ *
+*/
+typedef struct region {
+    int owner;                          // Only core to have missed in it, -1 once shared
+} region_t;
+
+/**
+ * @brief Struct representing the region tracker of a machine
+ *
+*/
+typedef struct region_tracker {
+    unsigned int regionBits;            // log2 of the region size in bytes
+    unsigned int sectorBits;            // log2 of the coherence unit in bytes
+    struct processor *processors;       // Caches probed and directories filled on sharing
+    home_map_t *homeMap;
+    line_table_t *regions;              // region_t, by region number
+
+    unsigned long privateRegions;       // Regions currently private to one core
+    unsigned long sharedRegions;        // Regions a second core has missed in
+    unsigned long filteredMisses;       // Misses and write-throughs that skipped the directory
+    unsigned long trackedMisses;        // Misses and write-throughs that went through it
+    unsigned long filteredNotices;      // Evictions from private regions the directory never saw
+    unsigned long handedOver;           // Lines entered in the directory when regions became shared
+    unsigned long untrackedLines;       // Cached lines of private regions, without an entry
+    unsigned long peakUntrackedLines;
+} region_tracker_t;
+
+// Function declarations for the region tracker
+region_tracker_t *createRegionTracker(unsigned int regionBits, unsigned int sectorBits,
+                                      struct processor *processors, home_map_t *homeMap);
+bool regionMiss(region_tracker_t *tracker, int requesterId, unsigned long address, bool fills,
+                unsigned long *latency);
+bool regionEviction(region_tracker_t *tracker, int processorId, unsigned long address);
+bool regionPrivateTo(region_tracker_t *tracker, unsigned long address, int *owner);
+void shareRegion(region_tracker_t *tracker, unsigned long address);
+void shareAllRegions(region_tracker_t *tracker);
+void printRegionTracker(const region_tracker_t *tracker, unsigned long directoryEntries);
+void freeRegionTracker(region_tracker_t *tracker);
+
+#endif // REGION_TRACKER_H
@@ -0,0 +1,112 @@
+/**
+ * @file sharing_profile.h
+ * @brief Per-line sharing pattern profiler with word-granularity false
+ *        sharing detection.
+ */
+
+#ifndef SHARING_PROFILE_H
+#define SHARING_PROFILE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "directory.h"
+#include "line_table.h"
+
+/** @brief Bytes per word when telling false sharing from true sharing */
+#define PROFILE_WORD_BYTES 8
+
+/** @brief Most words per line tracked (word masks are one unsigned long) */
+#define PROFILE_MAX_WORDS 64
+
+/** @brief Default number of lines listed in the report */
+#define PROFILE_DEFAULT_TOP_LINES 10
+
+/** @brief Initial number of lines in the profile table */
+#define PROFILE_INITIAL_LINES 4096
+
+/**
+ * @brief Sharing pattern of a line over the whole run.
+ *
+ */
+typedef enum {
+    SHARING_PRIVATE,            // Only one processor ever touched it
+    SHARING_READ_ONLY,          // Several readers, never written
+    SHARING_PRODUCER_CONSUMER,  // One writer, other processors read it
+    SHARING_MIGRATORY,          // Read then written by one processor after another
+    SHARING_WIDELY_SHARED,      // Several writers without a migratory pattern
+    NUM_SHARING_CLASSES
+} sharing_class;
+
+/**
+ * @brief Profile of one line
+ *
+ * Followed in the line table by one profile_word_t per word of the line.
+*/
+typedef struct line_profile {
+    unsigned long reads;
+    unsigned long writes;
+    unsigned long invalidations;       // Copies invalidated by the directory
+    unsigned long trueSharingMisses;   // Coherence misses on a word another processor wrote
+    unsigned long falseSharingMisses;  // Coherence misses on a word nobody else wrote
+    unsigned long writerChanges;       // Writes by a processor other than the previous writer
+    unsigned long migratoryHandoffs;   // Of those, writes right after the same processor's read
+    unsigned long sharedWords;         // Words touched by more than one processor
+    unsigned long writtenWords;        // Words ever written
+    sharer_set_t readers;
+    sharer_set_t writers;
+    int lastWriter;                    // -1 if never written
+    int lastAccessor;
+    bool lastAccessWasRead;
+} line_profile_t;
+
+/**
+ * @brief History of one word of a line
+ *
+*/
+typedef struct profile_word {
+    unsigned long lastWriteTime;       // Access number of the last write
+    int lastWriter;                    // -1 if never written
+    int lastAccessor;                  // -1 if never touched
+} profile_word_t;
+
+/**
+ * @brief Struct representing the sharing profile of a machine
+ *
+ * Every access and every invalidation of a cached copy is reported here.
+ * lostCopies remembers, per processor, when each of its copies was
+ * invalidated, so the next miss on that line can be classified.
+*/
+typedef struct sharing_profile {
+    int numProcessors;
+    unsigned int lineBits;             // log2 of the line size in bytes
+    unsigned int wordsPerLine;
+    unsigned long clock;               // Accesses profiled so far
+    line_table_t *lines;               // line_profile_t and its words, by block
+    line_table_t *lostCopies[NUM_PROCESSORS];  // Invalidation time, by block
+
+    unsigned long coherenceMisses;
+    unsigned long trueSharingMisses;
+    unsigned long falseSharingMisses;
+} sharing_profile_t;
+
+/**
+ * @brief Kind of miss seen by the profile
+ *
+ */
+typedef enum {
+    PROFILE_NOT_COHERENCE,      // The processor had not lost a copy of the line
+    PROFILE_TRUE_SHARING,
+    PROFILE_FALSE_SHARING
+} profile_miss_kind;
+
+// Function declarations for sharing profiles
+sharing_profile_t *createSharingProfile(int numProcessors, unsigned int lineBits);
+profile_miss_kind profileAccess(sharing_profile_t *profile, int processorId,
+                                unsigned long address, bool isWrite, bool missed);
+void profileInvalidation(sharing_profile_t *profile, int processorId, unsigned long address);
+sharing_class classifyLine(const sharing_profile_t *profile, const line_profile_t *line);
+const char *sharingClassName(sharing_class sharingClass);
+void printSharingProfile(sharing_profile_t *profile, int topLines);
+void freeSharingProfile(sharing_profile_t *profile);
+
+#endif // SHARING_PROFILE_H
@@ -0,0 +1,80 @@
+/**
+ * @file simulator.h
+ * @brief Library interface for embedding the simulator in other programs.
+ *
+ * A simulator_t is an opaque handle owning one simulated machine. Handles
+ * share no state, so independent simulators can run on different threads
+ * at once; one handle must not be used by two threads at the same time.
+ * Link every file in src/ except main.c, with -lpthread -lm.
+ *
+ *     system_config_t config;
+ *     defaultSimulatorConfig(&config);
+ *     config.protocol = PROTOCOL_MESI;
+ *     simulator_t *sim = createSimulator(&config);
+ *     simulateBatch(sim, records, count);     // as often as needed
+ *     simulator_stats_t stats;
+ *     simulatorStats(sim, &stats);
+ *     destroySimulator(sim);
+ */
+
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stddef.h>
+#include "system.h"
+
+/** @brief Default interval between snapshots, in accesses */
+#define DEFAULT_STATS_PERIOD 10000
+
+/** @brief A simulated machine, used only through the functions below */
+typedef struct simulator simulator_t;
+
+/**
+ * @brief Counters of one processor and the home node on it
+ *
+*/
+typedef struct simulator_node_stats {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long upgrades;             // Write hits that needed ownership
+    unsigned long evictions;
+    unsigned long invalidations;        // Lines invalidated by a directory
+    unsigned long cycles;               // Clock cycles spent on accesses
+    unsigned long memoryReads;          // Lines supplied by this node's memory
+    unsigned long memoryWrites;         // Lines written back to this node's memory
+    unsigned long directoryLookups;     // Requests and notices handled by its directory slice
+    unsigned long atomics;
+    unsigned long fences;               // Counting the ones atomics imply
+} simulator_node_stats_t;
+
+/**
+ * @brief Counters of a whole machine
+ *
+*/
+typedef struct simulator_stats {
+    int numProcessors;
+    unsigned long accesses;             // Records simulated
+    unsigned long dropped;              // Records naming a processor that does not exist
+    unsigned long cycles;               // Machine clock: cycles of the busiest processor
+    double averageMissLatency;          // Cycles a miss or upgrade waited on the directory
+    unsigned long messages;
+    unsigned long remoteMessages;       // Messages that crossed the network
+    unsigned long networkBytes;
+    unsigned long messageCount[NUM_MESSAGE_TYPES];
+    unsigned long violations;           // Coherence violations, 0 unless checking
+    unsigned long atomicHandoffs;       // Atomics by a processor other than the line's previous one
+    unsigned long contendedAtomics;     // Atomics issued while another processor's was in flight
+    simulator_node_stats_t nodes[NUM_PROCESSORS];
+} simulator_stats_t;
+
+// Function declarations for the simulator library
+void defaultSimulatorConfig(system_config_t *config);
+simulator_t *createSimulator(const system_config_t *config);
+size_t simulateBatch(simulator_t *sim, const access_t *records, size_t count);
+void finishSimulator(simulator_t *sim);
+void simulatorStats(const simulator_t *sim, simulator_stats_t *stats);
+const char *simulatorLabel(const simulator_t *sim);
+void printSimulatorSummary(const simulator_t *sim);
+void destroySimulator(simulator_t *sim);
+
+#endif // SIMULATOR_H
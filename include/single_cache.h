@@ -8,11 +8,26 @@
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include "home_node.h"
+#include "interconnect.h"
+#include "miss_classifier.h"
+#include "sharing_profile.h"
+#include "write_buffer.h"
 
 /** @brief Number of clock cycles for hit */
 #define HIT_CYCLES 4
 
-/** @brief Number of clock cycles for miss */
+/** @brief Extra clock cycles to swap a line back in from the victim cache */
+#define VICTIM_SWAP_CYCLES 2
+
+/** @brief Most lines in a victim cache */
+#define MAX_VICTIM_LINES 64
+
+/** @brief Most miss status holding registers per cache */
+#define MAX_MSHRS 64
+
+/** @brief Number of clock cycles for the home node's memory to supply a line,
+ *         unless a memory controller is modelled */
 #define MISS_CYCLES 100
 
 
@@ -20,7 +35,42 @@
  * @brief The state that a given block can be in.
  * 
  */
-typedef enum { INVALID, SHARED, EXCLUSIVE, MODIFIED } block_state;
+typedef enum { INVALID, SHARED, EXCLUSIVE, MODIFIED, OWNED } block_state;
+
+/**
+ * @brief Cache-side coherence protocol.
+ * 
+ * MSI installs every read as SHARED. MESI grants EXCLUSIVE to a sole
+ * reader, which can then write without telling the directory. MOESI adds
+ * OWNED, so a dirty line can be shared without writing it back to memory.
+ */
+typedef enum { PROTOCOL_MSI, PROTOCOL_MESI, PROTOCOL_MOESI } coherence_protocol;
+
+/**
+ * @brief What a write hit does.
+ * 
+ * Write-back keeps the store in the cache, after taking ownership of the
+ * line if needed. Write-through sends every store on to the home node,
+ * which updates memory and invalidates the other copies; the line never
+ * becomes dirty. Either can be combined with no-write-allocate, under
+ * which a write miss is sent on the same way instead of filling the line.
+ */
+typedef enum { POLICY_WRITE_BACK, POLICY_WRITE_THROUGH } write_policy;
+
+/** @brief Most sectors a line is split into */
+#define MAX_SECTORS 64
+
+/**
+ * @brief Struct representing one sector of a line
+ * 
+ * Coherence is kept per sector: each one is fetched, invalidated and
+ * tracked by the directory on its own. An unsectored line has one sector.
+*/
+typedef struct sector {
+    bool valid;                 // Represents valid bit
+    bool isDirty;               // Represents dirty bit for the sector
+    block_state state;          // State of the sector (MESI)
+} sector_t;
 
 /**
  * @brief Struct representing each line/block in a cache
@@ -30,9 +80,8 @@ typedef enum { INVALID, SHARED, EXCLUSIVE, MODIFIED } block_state;
 typedef struct line {
     unsigned long lineNum;     // Index of the line 
     unsigned long tag;          // Represents tag bits
-    bool valid;                 // Represents valid bit
-    bool isDirty;               // Represents dirty bit for each cache line
-    CacheLineState state;       // State of the cache line (MESI)
+    bool valid;                 // Tag is valid: some sector is valid or being filled
+    sector_t *sectors;          // Per-sector valid, dirty and coherence state
 } line_t;
 
 /**
@@ -41,11 +90,48 @@ typedef struct line {
 */
 typedef struct set {
     line_t *lines;                // Array of lines in the set
+    sector_t *sectors;            // Sectors of every line in the set
     unsigned long *lruCounter;    // Array to keep track of LRU order
     unsigned long maxLines;       // Total number of lines in the set
 } set_t;
 
 
+/**
+ * @brief Line held by the victim cache after it was replaced in its set
+ * 
+ * The home directories still list the cache for its valid sectors, and
+ * their probes find the line here until it is swapped back into its set
+ * or cast out.
+*/
+typedef struct victim_line {
+    unsigned long block;        // Address of the line shifted right by the block bits
+    bool valid;
+    unsigned long insertedAt;   // Insertion order; the oldest line is cast out
+    sector_t *sectors;          // Sectors as they were in the set
+} victim_line_t;
+
+/**
+ * @brief Small fully associative cache of replaced lines
+ * 
+ * A hit swaps the line back into its set, so lines are never used in
+ * place and casting out the oldest one is LRU.
+*/
+typedef struct victim_cache {
+    victim_line_t *lines;
+    sector_t *sectors;          // Sectors of every line
+    unsigned long numLines;
+    unsigned long insertions;   // Lines put in so far
+} victim_cache_t;
+
+/**
+ * @brief Miss status holding register: one miss in flight
+ * 
+*/
+typedef struct mshr {
+    unsigned long block;        // Sector being filled
+    unsigned long readyAt;      // Cycle the fill completes; the register is free from then on
+} mshr_t;
+
 /**
  * @brief Struct representing the cache
  * 
@@ -54,21 +140,108 @@ typedef struct set {
 typedef struct cache {
     int processor_id;                         // Processor that this cache belongs to
     interconnect_t* interconnect;             // Pointer to the interconnect
+    home_map_t* homeMap;                      // Maps addresses to their home node
+    coherence_protocol protocol;              // MSI, MESI or MOESI
+    sharing_profile_t* profile;               // Told about invalidations, NULL if not profiling
+    write_policy writePolicy;                 // Write-back or write-through
+    bool writeAllocate;                       // Write misses fill the line
+    write_buffer_t* writeBuffer;              // Stores waiting to be written through, NULL for none
+    victim_cache_t* victims;                  // Replaced lines still held, NULL for none
+    mshr_t* mshrs;                            // Misses in flight, NULL for a blocking cache
+    unsigned long numMSHRs;
 
     unsigned long S;                          // Number of set bits
     unsigned long E;                          // Associativity: number of lines per set
     unsigned long B;                          // Number of block bits
+    unsigned long sectorBits;                 // log2 of the sector size, B for unsectored lines
+    unsigned long numSectors;                 // Sectors per line
     struct set *setList;                      // Array of Sets
 
     unsigned long hitCount;                   // number of hits
     unsigned long missCount;                  // number of misses
+    unsigned long sectorMissCount;            // of those, misses on a line whose tag was present
     unsigned long evictionCount;              // number of evictions
     unsigned long dirtyEvictionCount;         // number of evictions of dirty lines
+    unsigned long localMissCount;             // number of misses homed at this processor
+    unsigned long remoteMissCount;            // number of misses homed at another processor
+    unsigned long upgradeCount;               // number of write hits that needed ownership
+    unsigned long silentUpgradeCount;         // number of EXCLUSIVE to MODIFIED upgrades without a message
+    unsigned long writebacksAvoided;          // number of MODIFIED lines shared as OWNED instead of written back
+    unsigned long invalidationCount;          // number of lines invalidated by a directory
+    unsigned long cycleCount;                 // clock cycles spent on accesses
+    unsigned long missLatencyCycles;          // clock cycles spent waiting on the directory
+    unsigned long writeThroughCount;          // write-through messages sent to home nodes
+    unsigned long unallocatedWriteCount;      // write misses sent on without filling the line
+    unsigned long writeStallCycles;           // clock cycles spent waiting for stores to drain
+    unsigned long writeLatency;               // latency of the last write-through
+    unsigned long victimHitCount;             // misses in the sets found in the victim cache
+    unsigned long victimMissCount;            // misses in the sets not found there either
+    unsigned long secondaryMissCount;         // accesses to sectors whose fill was still in flight
+    unsigned long secondaryStallCycles;       // clock cycles those accesses waited for the fill
+    unsigned long mshrFullStalls;             // misses that found every MSHR busy
+    unsigned long mshrStallCycles;            // clock cycles those misses waited
+    unsigned long atomicCount;                // atomic read-modify-writes performed
+    unsigned long fenceCount;                 // fences, counting the ones atomics imply
+    unsigned long fenceStallCycles;           // clock cycles fences waited for earlier accesses
+    unsigned long missClassCount[NUM_MISS_CLASSES];  // misses by cause, zero unless classified
 } cache_t; 
 
+/**
+ * @brief Summary of a cache's statistics
+ * 
+*/
+typedef struct {
+    unsigned long hits;             // number of hits
+    unsigned long misses;           // number of misses
+    unsigned long evictions;        // number of evictions
+    unsigned long dirty_bytes;      // number of dirty bytes left in the cache
+    unsigned long dirty_evictions;  // number of dirty bytes evicted
+    unsigned long miss_classes[NUM_MISS_CLASSES];  // misses by cause, zero unless classified
+} csim_stats_t;
+
 
 // Function declarations
-cache_t *initializeCache(unsigned int s, unsigned int e, unsigned int b, int processor_id);
+cache_t *initializeCache(unsigned int s, unsigned int e, unsigned int b, unsigned int sectorBits,
+                         int processor_id);
+void connectCacheToInterconnect(cache_t *cache, interconnect_t *interconnect);
+void connectCacheToHomeMap(cache_t *cache, home_map_t *homeMap);
+void connectCacheToProfile(cache_t *cache, sharing_profile_t *profile);
+void setCacheProtocol(cache_t *cache, coherence_protocol protocol);
+bool parseProtocol(const char *name, coherence_protocol *protocol);
+const char *protocolName(coherence_protocol protocol);
+void setCacheWritePolicy(cache_t *cache, write_policy policy, bool writeAllocate);
+bool attachWriteBuffer(cache_t *cache, int depth, drain_policy drain);
+bool attachVictimCache(cache_t *cache, unsigned long numLines);
+bool attachMSHRs(cache_t *cache, unsigned long numMSHRs);
+void cacheFlushVictims(cache_t *cache);
+void cacheWaitForMisses(cache_t *cache);
+void drainWriteBuffer(cache_t *cache);
+bool parseWritePolicy(const char *text, write_policy *policy, bool *writeAllocate);
+const char *writePolicyName(write_policy policy, bool writeAllocate);
+void updateLRUCounter(set_t *set, unsigned long lineNum);
+int readFromCache(cache_t *cache, unsigned long address);
+int writeToCache(cache_t *cache, unsigned long address);
+int atomicToCache(cache_t *cache, unsigned long address);
+void fenceCache(cache_t *cache);
+int cacheMissHandler(cache_t *cache, unsigned long address, bool isDirty);
+void freeCache(cache_t *cache);
+
+// Function declarations for requests from the directory
+block_state cacheInvalidateLine(cache_t *cache, unsigned long address);
+block_state cacheDowngradeLine(cache_t *cache, unsigned long address);
+block_state cacheLineState(cache_t *cache, unsigned long address);
+void cacheCompleteMiss(cache_t *cache, unsigned long address, block_state state,
+                       unsigned long latency);
+void cacheCompleteWrite(cache_t *cache, unsigned long latency);
+
+// Function declarations for reporting
+void printCache(cache_t *C);
+const csim_stats_t *makeSummary(cache_t *C);
+void printMissLocality(const cache_t *C);
+void printMissClasses(cache_t *C);
+void printWritePolicy(const cache_t *C);
+void printMissHandling(const cache_t *C);
+void printSynchronization(const cache_t *C);
 
 
 
@@ -0,0 +1,80 @@
+/**
+ * @file snoop_bus.h
+ * @brief Snooping bus that replaces the directories and the network when
+ *        the "snoop" scheme is selected.
+ *
+ * Requests that would go to a home directory are broadcast on a single
+ * split-transaction bus instead. Every other cache looks the line up and
+ * answers: a dirty owner supplies the data, any copy asserts the shared
+ * line, and a write invalidates them all. Each transaction holds the bus
+ * for its address and snoop phases plus its data transfer, and requests
+ * wait for a gap in the bus schedule after they are issued, as they do for
+ * a DRAM bank. Memory stays interleaved across the home nodes, and is
+ * reached through their controllers.
+ */
+
+#ifndef SNOOP_BUS_H
+#define SNOOP_BUS_H
+
+#include "directory.h"
+#include "interconnect.h"
+
+/** @brief Cycles to win arbitration for the bus */
+#define BUS_ARBITRATION_CYCLES 2
+
+/** @brief Cycles the address of a request holds the bus */
+#define BUS_ADDRESS_CYCLES 2
+
+/** @brief Cycles for every cache to look up its tags and answer a snoop */
+#define SNOOP_CYCLES 4
+
+/** @brief Cycles a snoop takes from the core of each cache it looks up */
+#define SNOOP_TAG_CYCLES 1
+
+/** @brief Cycles a dirty owner takes to put its data on the bus */
+#define CACHE_SUPPLY_CYCLES 10
+
+/** @brief Bytes the bus moves per cycle */
+#define BUS_WIDTH_BYTES 16
+
+/** @brief Busy intervals of the bus kept for scheduling, oldest gaps are given up first */
+#define BUS_RESERVATIONS 32
+
+struct processor;
+
+/**
+ * @brief One transaction's use of the bus
+ *
+*/
+typedef struct bus_reservation {
+    unsigned long start;
+    unsigned long end;
+} bus_reservation_t;
+
+/**
+ * @brief Struct representing a snooping bus
+ *
+*/
+typedef struct snoop_bus {
+    struct processor *processors;       // Caches snooping the bus and home memories
+    int numNodes;
+    interconnect_t *interconnect;       // Keeps the message and byte counts
+    bus_reservation_t reservations[BUS_RESERVATIONS];  // Recent schedule, sorted by start
+    int count;
+
+    unsigned long transactions;         // Requests, writebacks and write-throughs
+    unsigned long dataTransfers;        // Transactions that moved a sector of data
+    unsigned long cacheToCache;         // Sectors a dirty owner supplied
+    unsigned long snoopLookups;         // Tag lookups by caches other than the requester
+    unsigned long busyCycles;           // Cycles the bus was held
+    unsigned long waitCycles;           // Cycles requests waited for the bus
+} snoop_bus_t;
+
+// Function declarations for the snooping bus
+snoop_bus_t *createSnoopBus(struct processor *processors, int numNodes,
+                            interconnect_t *interconnect);
+void busTransaction(snoop_bus_t *bus, const message_t *message);
+void printSnoopBus(const snoop_bus_t *bus, unsigned long machineCycles);
+void freeSnoopBus(snoop_bus_t *bus);
+
+#endif // SNOOP_BUS_H
@@ -0,0 +1,60 @@
+/**
+ * @file sync_profile.h
+ * @brief Per-line contention and ownership ping-pong of atomic operations.
+ */
+
+#ifndef SYNC_PROFILE_H
+#define SYNC_PROFILE_H
+
+#include <stdbool.h>
+#include "directory.h"
+#include "line_table.h"
+#include "trace.h"
+
+/** @brief Lines listed in the report, most handed off first */
+#define SYNC_TOP_LINES 10
+
+/** @brief Initial number of lines in the profile table */
+#define SYNC_INITIAL_LINES 64
+
+/**
+ * @brief Atomics on one line
+ *
+*/
+typedef struct sync_line {
+    unsigned long testAndSets;
+    unsigned long compareAndSwaps;
+    unsigned long fetchAdds;
+    unsigned long ownershipRequests;   // Atomics that had to get the line from the directory
+    unsigned long handoffs;            // Atomics by a processor other than the previous one
+    unsigned long contended;           // Atomics issued while another processor's was in flight
+    unsigned long cycles;              // Cycles the atomics took, fence waits included
+    sharer_set_t processors;           // Processors that performed atomics on it
+    int lastProcessor;
+    int busyProcessor;                 // Processor whose atomic completes last
+    unsigned long busyUntil;           // Cycle that atomic completes
+} sync_line_t;
+
+/**
+ * @brief Struct representing the synchronization profile of a machine
+ *
+ * Processors keep their own clocks, so two atomics overlap when one is
+ * issued before the other's completion cycle on its processor's clock.
+*/
+typedef struct sync_profile {
+    unsigned int sectorBits;           // log2 of the coherence unit in bytes
+    line_table_t *lines;               // sync_line_t, by sector
+
+    unsigned long atomics;
+    unsigned long handoffs;
+    unsigned long contended;
+} sync_profile_t;
+
+// Function declarations for synchronization profiles
+sync_profile_t *createSyncProfile(unsigned int sectorBits);
+void profileAtomic(sync_profile_t *profile, const access_t *access, unsigned long issuedAt,
+                   unsigned long completedAt, bool neededOwnership);
+void printSyncProfile(sync_profile_t *profile, int topLines);
+void freeSyncProfile(sync_profile_t *profile);
+
+#endif // SYNC_PROFILE_H
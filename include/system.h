@@ -0,0 +1,97 @@
+/**
+ * @file system.h
+ * @brief A complete simulated machine: processors, caches, directory slices,
+ *        interconnect and home node mapping.
+ *
+ * All state lives in the system_t, so several systems with different
+ * directory schemes or cache configurations can consume the same trace.
+ */
+
+#ifndef SYSTEM_H
+#define SYSTEM_H
+
+#include "accounting.h"
+#include "coherence_checker.h"
+#include "directory.h"
+#include "home_node.h"
+#include "interconnect.h"
+#include "interval_stats.h"
+#include "processor.h"
+#include "region_tracker.h"
+#include "snoop_bus.h"
+#include "sync_profile.h"
+#include "trace.h"
+
+/** @brief Longest system label used in reports */
+#define SYSTEM_LABEL_LEN 96
+
+/**
+ * @brief Parameters of a simulated machine
+ *
+*/
+typedef struct system_config {
+    int numProcessors;                  // Number of processors (at most NUM_PROCESSORS)
+    unsigned int s;                     // Number of set bits
+    unsigned int E;                     // Associativity
+    unsigned int b;                     // Number of block bits
+    unsigned int sectorBits;            // log2 of the sector size, 0 for unsectored lines
+    const directory_ops_t *dirOps;      // Directory scheme
+    int directoryLines;                 // Initial entries in each home node's directory slice
+    home_policy homePolicy;             // How addresses are placed on home nodes
+    unsigned int homeGranularityBits;   // log2 of the interleaving unit in bytes
+    bool forwarding;                    // 3-hop request forwarding instead of 4-hop
+    coherence_protocol protocol;        // Cache side protocol: MSI, MESI or MOESI
+    write_policy writePolicy;           // Write-back or write-through
+    bool noWriteAllocate;               // Write misses are sent on without filling the line
+    int writeBufferDepth;               // Coalescing write buffer entries per core, 0 for none
+    drain_policy writeBufferDrain;
+    int victimLines;                    // Victim cache lines per core, 0 for none
+    int mshrs;                          // Misses in flight per core, 0 for blocking caches
+    int dramBanks;                      // Banks of each home's memory controller, 0 for MISS_CYCLES
+    int dramQueueDepth;                 // Requests each memory controller holds at once
+    unsigned int regionBits;            // log2 of the size of private regions, 0 for none
+    int profileTopLines;                // Lines listed by the sharing profile, 0 to not profile
+    bool classifyMisses;                // Split misses into cold, capacity, conflict, coherence
+    const char *statsPath;              // Interval statistics file, NULL for none
+    interval_format statsFormat;
+    interval_unit statsUnit;
+    unsigned long statsPeriod;          // Accesses or cycles per interval
+    check_mode checkMode;               // Which accesses get their line checked for coherence
+    unsigned long checkPeriod;          // N of every Nth access or one line in N
+    bool accounting;                    // Report directory storage and dynamic energy
+    energy_costs_t energyCosts;         // Cost of each event, in picojoules
+} system_config_t;
+
+/**
+ * @brief Struct representing a simulated machine
+ *
+*/
+typedef struct system {
+    system_config_t config;
+    char label[SYSTEM_LABEL_LEN];       // Scheme and cache configuration, for reports
+    processor_t processors[NUM_PROCESSORS];
+    interconnect_t *interconnect;
+    snoop_bus_t *bus;                   // NULL unless the scheme snoops instead of a directory
+    region_tracker_t *regions;          // NULL unless misses to private regions skip the directory
+    home_map_t *homeMap;
+    sharing_profile_t *profile;         // NULL unless profiling sharing patterns
+    interval_stats_t *intervals;        // NULL unless writing interval statistics
+    coherence_checker_t *checker;       // NULL unless checking coherence invariants
+    sync_profile_t *syncProfile;        // Contention on the lines atomics touched
+
+    unsigned long accessCount;          // Records simulated
+    unsigned long droppedCount;         // Records naming a processor that does not exist
+} system_t;
+
+// Function declarations for the simulated machine
+system_t *initializeSystem(const system_config_t *config);
+void systemAccess(system_t *sys, const access_t *access);
+void simulateAccesses(system_t *sys, const access_t *accesses, size_t count);
+void executeInstruction(system_t *sys, char *request_line);
+void finishSystem(system_t *sys);
+void printSystemSummary(const system_t *sys);
+double averageMissLatency(const system_t *sys);
+unsigned long machineCycles(const system_t *sys);
+void cleanupSystem(system_t *sys);
+
+#endif // SYSTEM_H
@@ -0,0 +1,53 @@
+/**
+ * @file trace.h
+ * @brief Decode "<pid> <R|W> <hexaddr>" trace lines into fixed-size records.
+ *
+ * Synchronization is recorded with the same layout: T (test-and-set),
+ * C (compare-and-swap) and A (fetch-and-add) are atomic read-modify-writes,
+ * and F is a fence, whose address may be left out.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/** @brief Longest trace line that is decoded */
+#define MAX_TRACE_LINE 256
+
+/** @brief Number of records decoded at a time when streaming a trace */
+#define TRACE_CHUNK_RECORDS 65536
+
+/**
+ * @brief Kind of memory access in a trace record.
+ *
+ */
+typedef enum {
+    ACCESS_READ,
+    ACCESS_WRITE,
+    ACCESS_TEST_AND_SET,        // Atomic read-modify-writes, performed with ownership
+    ACCESS_COMPARE_AND_SWAP,
+    ACCESS_FETCH_ADD,
+    ACCESS_FENCE,               // Waits for earlier accesses, touches no memory
+    NUM_ACCESS_TYPES
+} access_type;
+
+/**
+ * @brief One decoded trace record
+ *
+*/
+typedef struct access {
+    unsigned long address;  // Memory address being accessed
+    int processorId;        // Processor making the access
+    access_type type;       // Read, write, atomic or fence
+} access_t;
+
+// Function declarations for trace decoding
+bool decodeTraceLine(const char *line, access_t *access);
+size_t decodeTraceChunk(FILE *trace, access_t *records, size_t maxRecords);
+char accessTypeLetter(access_type type);
+bool isAtomicAccess(access_type type);
+
+#endif // TRACE_H
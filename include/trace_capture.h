@@ -0,0 +1,178 @@
+/**
+ * @file trace_capture.h
+ * @brief Capture the loads and stores of a multithreaded program as a trace
+ *        the simulator can run.
+ *
+ * Instrumented code marks its shared accesses with CAPTURE_LOAD and
+ * CAPTURE_STORE. Each thread appends timestamped records to its own
+ * preallocated buffers without locks; a background thread writes full
+ * buffers to one binary file per thread. mergeCapture then interleaves the
+ * files by timestamp into "<pid> <R|W> <hexaddr>" lines.
+ *
+ * The library is self-contained: link src/trace_capture.c into the program
+ * with -lpthread. Until captureStart is called, or after captureStop, a
+ * marked access costs one load and a branch; building with
+ * -DNO_TRACE_CAPTURE removes the marks entirely.
+ */
+
+#ifndef TRACE_CAPTURE_H
+#define TRACE_CAPTURE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+/** @brief First eight bytes of every per-thread capture file ("DIRCAPT" and a NUL) */
+#define CAPTURE_MAGIC 0x0054504143524944UL
+
+/** @brief Bumped whenever the capture file layout changes */
+#define CAPTURE_VERSION 1
+
+/** @brief Most threads captured at once, and per-thread files merged */
+#define CAPTURE_MAX_THREADS 256
+
+/** @brief Records per buffer, and per write to the thread's file */
+#define CAPTURE_BUFFER_RECORDS 32768
+
+/** @brief Buffers per thread; a thread waits only if all of them are unwritten */
+#define CAPTURE_BUFFERS_PER_THREAD 4
+
+/** @brief Longest file name prefix */
+#define CAPTURE_PREFIX_LEN 240
+
+/** @brief Records read at a time from each file while merging */
+#define CAPTURE_MERGE_RECORDS 4096
+
+/** @brief Microseconds the writer sleeps when no buffer is full */
+#define CAPTURE_POLL_MICROSECONDS 500
+
+/** @brief Set in a record's address for a store */
+#define CAPTURE_WRITE_BIT (1UL << 63)
+
+/**
+ * @brief One captured access
+ *
+*/
+typedef struct capture_record {
+    unsigned long timestamp;    // Time stamp counter, or nanoseconds without one
+    unsigned long address;      // Address, with CAPTURE_WRITE_BIT for stores
+} capture_record_t;
+
+/**
+ * @brief Start of every per-thread capture file, followed by its records
+ *
+*/
+typedef struct capture_header {
+    unsigned long magic;
+    unsigned int version;
+    int processorId;            // pid written for this thread's accesses
+} capture_header_t;
+
+/**
+ * @brief One preallocated buffer of a thread
+ *
+ * full is set by the thread once the buffer holds its records and cleared
+ * by the writer once they are on disk; nobody else touches the buffer in
+ * between, so no lock is needed.
+*/
+typedef struct capture_buffer {
+    capture_record_t *records;
+    unsigned int count;
+    int full;
+} capture_buffer_t;
+
+/**
+ * @brief Capture state of one thread
+ *
+*/
+typedef struct capture_thread {
+    capture_buffer_t buffers[CAPTURE_BUFFERS_PER_THREAD];
+    capture_buffer_t *current;  // Buffer being filled
+    unsigned int next;          // Index of the buffer after it
+    unsigned int writeNext;     // Index of the next buffer the writer expects
+    int processorId;
+    FILE *file;
+    unsigned long records;      // Records handed to the writer
+    unsigned long waits;        // Times every buffer was full and the thread had to wait
+} capture_thread_t;
+
+/**
+ * @brief Totals of a finished capture
+ *
+*/
+typedef struct capture_stats {
+    int threads;
+    unsigned long records;
+    unsigned long bytesWritten;
+    unsigned long waits;
+    bool writeFailed;
+} capture_stats_t;
+
+/** @brief Generation of the running capture, 0 when none is running */
+extern unsigned int captureGeneration;
+
+/** @brief Capture state of the calling thread, valid if its generation is current */
+extern __thread capture_thread_t *captureThread;
+extern __thread unsigned int captureThreadGeneration;
+
+// Function declarations for trace capture
+bool captureStart(const char *prefix);
+capture_thread_t *captureAttachThread(unsigned int generation, int processorId);
+void captureBufferFull(capture_thread_t *thread);
+bool captureThreadProcessor(int processorId);
+bool captureStop(capture_stats_t *stats);
+long mergeCapture(const char *prefix, FILE *out);
+
+/**
+ * @brief Current time stamp, from the time stamp counter where there is one
+ *
+ * @return unsigned long
+ */
+static inline unsigned long captureTimestamp(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long)now.tv_sec * 1000000000UL + (unsigned long)now.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Record one access of the calling thread.
+ *
+ * @param address
+ * @param isWrite
+ */
+static inline void captureAccess(const volatile void *address, bool isWrite) {
+    unsigned int generation = __atomic_load_n(&captureGeneration, __ATOMIC_RELAXED);
+    if (generation == 0) {
+        return;
+    }
+    capture_thread_t *thread = captureThread;
+    if (captureThreadGeneration != generation) {
+        thread = captureAttachThread(generation, -1);
+    }
+    if (thread == NULL) {
+        return;  // The thread could not be given buffers
+    }
+    capture_buffer_t *buffer = thread->current;
+    capture_record_t *record = &buffer->records[buffer->count];
+    record->timestamp = captureTimestamp();
+    record->address = (unsigned long)address | (isWrite ? CAPTURE_WRITE_BIT : 0);
+    if (++buffer->count == CAPTURE_BUFFER_RECORDS) {
+        captureBufferFull(thread);
+    }
+}
+
+#ifdef NO_TRACE_CAPTURE
+#define CAPTURE_LOAD(address) ((void)0)
+#define CAPTURE_STORE(address) ((void)0)
+#else
+/** @brief Record a load from address */
+#define CAPTURE_LOAD(address) captureAccess((address), false)
+/** @brief Record a store to address */
+#define CAPTURE_STORE(address) captureAccess((address), true)
+#endif
+
+#endif // TRACE_CAPTURE_H
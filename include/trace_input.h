@@ -0,0 +1,80 @@
+/**
+ * @file trace_input.h
+ * @brief Trace files read as a byte stream, plain or compressed.
+ *
+ * gzip and zstd traces are recognized by their magic bytes and
+ * decompressed on a separate thread into two buffers that take turns:
+ * while the reader drains one, the other is being filled. Support for
+ * each format is compiled in with -DHAVE_ZLIB (link -lz) and -DHAVE_ZSTD
+ * (link -lzstd).
+ */
+
+#ifndef TRACE_INPUT_H
+#define TRACE_INPUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <pthread.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/** @brief Bytes of decompressed text per buffer */
+#define DECOMPRESS_BUFFER_BYTES (1024 * 1024)
+
+/** @brief Bytes of compressed input read at a time */
+#define COMPRESSED_READ_BYTES (256 * 1024)
+
+/**
+ * @brief Compression of a trace file
+ *
+ */
+typedef enum { TRACE_PLAIN, TRACE_GZIP, TRACE_ZSTD } trace_compression;
+
+/**
+ * @brief Struct representing an open trace file
+ *
+ * Plain files are read straight from file. Compressed files are read by
+ * the decompression thread only; the two buffers are handed back and forth
+ * under lock.
+*/
+typedef struct trace_input {
+    FILE *file;
+    trace_compression compression;
+
+    unsigned char *compressed;          // COMPRESSED_READ_BYTES of input
+    size_t compressedLength;            // Bytes of it not yet consumed by the decompressor
+#ifdef HAVE_ZLIB
+    z_stream zstream;
+#endif
+#ifdef HAVE_ZSTD
+    ZSTD_DStream *zstd;
+    size_t compressedOffset;
+    size_t zstdStatus;                  // Last ZSTD_decompressStream result, 0 between frames
+#endif
+
+    char *buffers[2];                   // DECOMPRESS_BUFFER_BYTES each
+    size_t lengths[2];
+    bool full[2];                       // Filled and not yet drained by the reader
+    int readIndex;                      // Buffer the reader drains next
+    size_t readOffset;                  // Bytes of it already read
+    bool ended;                         // The decompressor published its last buffer
+    bool stopping;                      // The reader closed the input early
+    bool failed;                        // Read or decompression error
+    pthread_t decompressor;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;             // A buffer was filled or drained
+} trace_input_t;
+
+// Function declarations for trace input
+trace_input_t *openTraceInput(const char *path);
+size_t readTraceInput(trace_input_t *input, char *buffer, size_t length);
+bool traceInputFailed(const trace_input_t *input);
+const char *compressionName(trace_compression compression);
+void closeTraceInput(trace_input_t *input);
+
+#endif // TRACE_INPUT_H
@@ -0,0 +1,109 @@
+/**
+ * @file trace_pipeline.h
+ * @brief Read and decode a trace on background threads while the systems
+ *        simulate.
+ *
+ * A reader thread fills large text chunks with sequential reads (of the
+ * decompressed text, for compressed traces), decoder
+ * threads turn chunks into batches of access_t records, and a dispatcher
+ * thread puts the batches back in trace order for the simulation thread.
+ * Stages are joined by bounded queues, and chunks and batches come from
+ * fixed pools, so a slow stage holds up the ones before it instead of
+ * letting memory grow.
+ */
+
+#ifndef TRACE_PIPELINE_H
+#define TRACE_PIPELINE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "queue.h"
+#include "trace.h"
+#include "trace_input.h"
+
+/** @brief Bytes of trace text per chunk */
+#define PIPELINE_CHUNK_BYTES (256 * 1024)
+
+/** @brief Most records a chunk can hold: a fence line "0F\n" takes 3 bytes,
+ *         and the last line of the trace may have no newline */
+#define PIPELINE_BATCH_RECORDS ((PIPELINE_CHUNK_BYTES + 1) / 3)
+
+/** @brief Text chunks in flight between the reader and the decoders */
+#define PIPELINE_TEXT_CHUNKS 8
+
+/** @brief Record batches in flight between the decoders and the simulation */
+#define PIPELINE_BATCHES 8
+
+/** @brief Default number of decoder threads */
+#define DEFAULT_DECODER_THREADS 2
+
+/** @brief Most decoder threads */
+#define MAX_DECODER_THREADS 16
+
+/**
+ * @brief Trace text handed from the reader to a decoder
+ *
+ * Always ends on a line boundary, except at the end of the file.
+*/
+typedef struct text_chunk {
+    unsigned long sequence;         // Position of the chunk in the trace
+    size_t length;
+    char text[PIPELINE_CHUNK_BYTES + 1];    // NUL terminated
+} text_chunk_t;
+
+/**
+ * @brief Decoded records of one chunk
+ *
+*/
+typedef struct record_batch {
+    unsigned long sequence;         // Sequence of the chunk it was decoded from
+    size_t count;
+    access_t records[PIPELINE_BATCH_RECORDS];
+} record_batch_t;
+
+/**
+ * @brief What a pipeline did, reported once it stops
+ *
+*/
+typedef struct ingest_stats {
+    unsigned long bytesRead;
+    unsigned long batches;          // Batches handed to the simulation
+    unsigned long simulationWaits;  // Of those, batches the simulation had to wait for
+    bool readFailed;                // The trace could not be read to its end
+} ingest_stats_t;
+
+/**
+ * @brief Struct representing a running trace pipeline
+ *
+*/
+typedef struct trace_pipeline {
+    trace_input_t *input;
+    int numDecoders;
+    int runningDecoders;            // Decoders that have not seen the end of the text
+    pthread_mutex_t lock;           // Protects runningDecoders
+
+    text_chunk_t *chunks;           // PIPELINE_TEXT_CHUNKS chunks
+    record_batch_t *batches;        // PIPELINE_BATCHES batches
+    Queue *freeChunks;
+    Queue *freeBatches;
+    Queue *text;                    // Reader to decoders
+    Queue *decoded;                 // Decoders to dispatcher, in any order
+    Queue *ready;                   // Dispatcher to simulation, in trace order
+
+    pthread_t reader;
+    pthread_t decoders[MAX_DECODER_THREADS];
+    pthread_t dispatcher;
+    bool finished;                  // The simulation has seen the last batch
+
+    ingest_stats_t stats;
+    bool readFailed;
+} trace_pipeline_t;
+
+// Function declarations for the trace pipeline
+trace_pipeline_t *startTracePipeline(trace_input_t *input, int numDecoders);
+record_batch_t *nextBatch(trace_pipeline_t *pipeline);
+void releaseBatch(trace_pipeline_t *pipeline, record_batch_t *batch);
+bool stopTracePipeline(trace_pipeline_t *pipeline, ingest_stats_t *stats);
+
+#endif // TRACE_PIPELINE_H
@@ -0,0 +1,89 @@
+/**
+ * @file workload.h
+ * @brief Synthetic sharing patterns generated straight into trace records.
+ */
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "trace.h"
+
+/** @brief Default number of accesses a workload generates */
+#define DEFAULT_WORKLOAD_ACCESSES 1000000UL
+
+/** @brief Default number of distinct lines a workload touches */
+#define DEFAULT_WORKLOAD_LINES 512UL
+
+/** @brief Lines written by a producer before its consumer reads them */
+#define PRODUCER_BATCH_LINES 16
+
+/** @brief Batches in each producer-consumer pair's ring buffer */
+#define PRODUCER_BUFFER_BATCHES 4
+
+/** @brief Data lines read and written inside each critical section */
+#define CRITICAL_SECTION_LINES 4
+
+/** @brief Bytes per word when picking offsets within a line */
+#define WORKLOAD_WORD_BYTES 8
+
+/**
+ * @brief Sharing pattern produced by a workload.
+ *
+ */
+typedef enum {
+    WORKLOAD_PRODUCER_CONSUMER, // Pairs of processors hand batches of lines to each other
+    WORKLOAD_MIGRATORY,         // Objects are read then written by one processor after another
+    WORKLOAD_FALSE_SHARING,     // Processors write their own words of the same lines
+    WORKLOAD_READ_MOSTLY,       // Everyone reads a shared table that is rarely written
+    WORKLOAD_LOCK_CONTENTION,   // Spin on a few locks guarding small critical sections
+    WORKLOAD_UNIFORM_RANDOM,    // Any processor, any line, reads and writes mixed
+    NUM_WORKLOADS
+} workload_kind;
+
+/**
+ * @brief Parameters of a synthetic workload
+ *
+*/
+typedef struct workload_config {
+    workload_kind kind;
+    int numProcessors;             // Processors issuing accesses
+    unsigned long accesses;        // Records to generate
+    unsigned long footprintLines;  // Distinct lines the workload touches
+    unsigned int lineBits;         // log2 of the line size in bytes
+    int writePercent;              // Share of writes, -1 for the pattern's own default
+    unsigned long seed;            // Same seed, same trace
+} workload_config_t;
+
+/**
+ * @brief Struct representing a workload being generated
+ *
+ * Patterns that span several accesses (a migratory read then write, a
+ * lock acquire and release) are stepped one access at a time.
+*/
+typedef struct workload {
+    workload_config_t config;
+    unsigned long generated;       // Records generated so far
+    unsigned long rng;             // xorshift state
+    int writePercent;              // Resolved write share
+
+    int *phase;                    // Per processor: step of its current state machine
+    unsigned long *target;         // Per processor: lock its state machine works on
+    int *lockHolder;               // Lock contention: processor holding each lock, -1 if free
+    unsigned long numLocks;        // Lock contention: number of lock lines
+    int pendingProcessor;          // Migratory: processor whose write follows its read
+    unsigned long pendingLine;     // Migratory: line that write goes to
+    int lastProcessor;             // Migratory: last processor to own an object
+} workload_t;
+
+// Function declarations for synthetic workloads
+workload_t *createWorkload(const workload_config_t *config);
+size_t generateAccesses(workload_t *workload, access_t *records, size_t maxRecords);
+unsigned long writeWorkloadTrace(workload_t *workload, FILE *out);
+bool parseWorkloadKind(const char *name, workload_kind *kind);
+const char *workloadKindName(workload_kind kind);
+void freeWorkload(workload_t *workload);
+
+#endif // WORKLOAD_H
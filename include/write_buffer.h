@@ -0,0 +1,76 @@
+/**
+ * @file write_buffer.h
+ * @brief Per-core coalescing write buffer for write-through and
+ *        non-allocating stores.
+ *
+ * Stores that go to the home node without taking ownership of the line
+ * wait here in FIFO order. A store to a sector that already has an entry
+ * is merged into it, so one write-through message carries all of them.
+ * The cache drains the oldest entry when the buffer is full, and under
+ * the timed policy also once an entry has waited long enough.
+ */
+
+#ifndef WRITE_BUFFER_H
+#define WRITE_BUFFER_H
+
+#include <stdbool.h>
+
+/** @brief Deepest write buffer */
+#define MAX_WRITE_BUFFER_DEPTH 64
+
+/** @brief Cycles an entry waits under the timed drain policy */
+#define WRITE_BUFFER_DRAIN_DELAY 200
+
+/** @brief Bytes written by one store */
+#define WRITE_BUFFER_WORD_BYTES 8
+
+/**
+ * @brief When buffered stores are sent to the home node
+ *
+ */
+typedef enum {
+    DRAIN_WHEN_FULL,    // Only to make room, or before a load of the same sector
+    DRAIN_AFTER_DELAY   // Also once an entry is WRITE_BUFFER_DRAIN_DELAY cycles old
+} drain_policy;
+
+/**
+ * @brief Stores to one sector waiting to be written through
+ *
+*/
+typedef struct write_buffer_entry {
+    unsigned long block;        // Sector number
+    unsigned long wordMask;     // Words of the sector written
+    unsigned long stores;       // Stores merged into the entry
+    unsigned long enqueuedAt;   // Core's cycle count when the entry was made
+} write_buffer_entry_t;
+
+/**
+ * @brief Ring of entries of one core
+ *
+*/
+typedef struct write_buffer {
+    write_buffer_entry_t entries[MAX_WRITE_BUFFER_DEPTH];
+    int head;                       // Index of the oldest entry
+    int count;                      // Entries in use
+    int depth;                      // Entries the buffer may hold
+    drain_policy drain;
+
+    unsigned long stores;           // Stores put in the buffer
+    unsigned long coalescedStores;  // of those, merged into an existing entry
+    unsigned long drains;           // Entries written through
+    unsigned long fullStalls;       // Stores that found the buffer full
+    unsigned long loadDrains;       // Loads that had to wait for their sector's entry
+} write_buffer_t;
+
+// Function declarations for the write buffer
+write_buffer_t *createWriteBuffer(int depth, drain_policy drain);
+write_buffer_entry_t *writeBufferFind(write_buffer_t *buffer, unsigned long block);
+write_buffer_entry_t *writeBufferOldest(write_buffer_t *buffer);
+void writeBufferPush(write_buffer_t *buffer, unsigned long block, unsigned long wordMask,
+                     unsigned long now);
+void writeBufferPop(write_buffer_t *buffer);
+bool parseWriteBuffer(const char *text, int *depth, drain_policy *drain);
+const char *drainPolicyName(drain_policy drain);
+void freeWriteBuffer(write_buffer_t *buffer);
+
+#endif // WRITE_BUFFER_H
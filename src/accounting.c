@@ -0,0 +1,136 @@
+/**
+ * @file accounting.c
+ * @brief Directory storage overhead and dynamic energy of a simulated machine.
+ *
+ * A full directory keeps one entry per memory line, so its cost is the
+ * entry's bits over the line's data bits. A directory sized to the caches
+ * keeps one entry per line the caches can hold, each with a tag; it is
+ * indexed by the caches' set bits, so the tag is the rest of the block
+ * number. With sectored lines every sector has an entry of its own.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "accounting.h"
+#include "system.h"
+
+/**
+ * @brief Fill in the default cost of every event.
+ *
+ * @param costs
+ */
+void defaultEnergyCosts(energy_costs_t *costs) {
+    costs->directoryLookup = DEFAULT_DIRECTORY_PJ;
+    costs->cacheLookup = DEFAULT_CACHE_PJ;
+    costs->hop = DEFAULT_HOP_PJ;
+    costs->dramAccess = DEFAULT_DRAM_PJ;
+}
+
+/**
+ * @brief Parse "<directory>:<cache>:<hop>:<dram>" costs in picojoules.
+ *
+ * @param text
+ * @param costs             left untouched on failure
+ * @return bool             false if the text is malformed
+ */
+bool parseEnergyCosts(const char *text, energy_costs_t *costs) {
+    double values[4];
+    const char *cursor = text;
+    for (int i = 0; i < 4; i++) {
+        char *end;
+        values[i] = strtod(cursor, &end);
+        if (end == cursor || values[i] < 0 || *end != (i < 3 ? ':' : '\0')) {
+            return false;
+        }
+        cursor = end + 1;
+    }
+    costs->directoryLookup = values[0];
+    costs->cacheLookup = values[1];
+    costs->hop = values[2];
+    costs->dramAccess = values[3];
+    return true;
+}
+
+/**
+ * @brief Directory storage of a machine's scheme and cache configuration.
+ *
+ * @param sys
+ * @param report
+ */
+void computeStorage(const system_t *sys, storage_report_t *report) {
+    const system_config_t *config = &sys->config;
+    memset(report, 0, sizeof(*report));
+    report->entryBits = config->dirOps->entryBits(config->numProcessors);
+    unsigned int indexBits = config->b + config->s;
+    report->tagBits = indexBits < PHYSICAL_ADDRESS_BITS ? PHYSICAL_ADDRESS_BITS - indexBits : 0;
+    report->overheadPercent = 100.0 * report->entryBits / (8.0 * (1UL << config->sectorBits));
+
+    unsigned long bitsPerEntry = report->entryBits + report->tagBits;
+    report->sparseEntries = (unsigned long)config->numProcessors * (1UL << config->s) * config->E *
+                            (1UL << (config->b - config->sectorBits));
+    report->sparseBytes = (report->sparseEntries * bitsPerEntry + 7) / 8;
+    for (int i = 0; i < config->numProcessors; i++) {
+        const processor_t *home = &sys->processors[i];
+        line_table_stats_t stats;
+        home->dirOps->tableStats(home->directory, &stats);
+        report->liveEntries += stats.entries;
+    }
+    report->liveBytes = (report->liveEntries * bitsPerEntry + 7) / 8;
+}
+
+/**
+ * @brief Events counted during the run and their energy.
+ *
+ * @param sys
+ * @param report
+ */
+void computeEnergy(const system_t *sys, energy_report_t *report) {
+    const energy_costs_t *costs = &sys->config.energyCosts;
+    memset(report, 0, sizeof(*report));
+    for (int i = 0; i < sys->config.numProcessors; i++) {
+        const processor_t *node = &sys->processors[i];
+        report->directoryLookups += node->directoryLookups;
+        report->cacheLookups += node->cache->hitCount + node->cache->missCount +
+                                node->cache->secondaryMissCount + node->cacheProbes;
+        report->dramAccesses += node->memoryReads + node->memoryWrites;
+    }
+    report->hops = sys->interconnect->remoteMessages;
+
+    report->directoryPJ = report->directoryLookups * costs->directoryLookup;
+    report->cachePJ = report->cacheLookups * costs->cacheLookup;
+    report->hopPJ = report->hops * costs->hop;
+    report->dramPJ = report->dramAccesses * costs->dramAccess;
+    report->totalPJ = report->directoryPJ + report->cachePJ + report->hopPJ + report->dramPJ;
+}
+
+/**
+ * @brief Print the directory storage and the energy of the run.
+ *
+ * @param sys
+ */
+void printAccounting(const system_t *sys) {
+    storage_report_t storage;
+    energy_report_t energy;
+    computeStorage(sys, &storage);
+    computeEnergy(sys, &energy);
+
+    printf("Directory storage: %u bits per entry (%.2f%% of a %lu byte %s for a full "
+           "directory), %u tag bits\n", storage.entryBits, storage.overheadPercent,
+           1UL << sys->config.sectorBits, sys->config.sectorBits != sys->config.b ? "sector" : "line",
+           storage.tagBits);
+    printf("  sized to the caches: %lu entries, %.2f KB; in use at the end: %lu entries, "
+           "%.2f KB\n", storage.sparseEntries, storage.sparseBytes / 1024.0,
+           storage.liveEntries, storage.liveBytes / 1024.0);
+
+    double total = energy.totalPJ > 0 ? energy.totalPJ : 1;
+    printf("Dynamic energy: %.2f uJ, %.2f pJ per access\n", energy.totalPJ / 1e6,
+           sys->accessCount ? energy.totalPJ / sys->accessCount : 0.0);
+    printf("  directory lookups: %lu, %.2f uJ (%.1f%%)\n", energy.directoryLookups,
+           energy.directoryPJ / 1e6, 100 * energy.directoryPJ / total);
+    printf("  cache lookups: %lu, %.2f uJ (%.1f%%)\n", energy.cacheLookups,
+           energy.cachePJ / 1e6, 100 * energy.cachePJ / total);
+    printf("  network hops: %lu, %.2f uJ (%.1f%%)\n", energy.hops, energy.hopPJ / 1e6,
+           100 * energy.hopPJ / total);
+    printf("  DRAM accesses: %lu, %.2f uJ (%.1f%%)\n", energy.dramAccesses,
+           energy.dramPJ / 1e6, 100 * energy.dramPJ / total);
+}
@@ -1,208 +1,316 @@
 /**
  * @file central_directory.c
- * @brief Implement a central directory based cache coherence protocol. 
+ * @brief Implement a central directory based cache coherence protocol.
  */
+#include <stdlib.h>
+#include <central_directory.h>
 
 /**
  * @brief Initialize the directory
- * 
- * @param numLines 
- * @return directory_t* 
+ *
+ * @param numLines          initial capacity, the slice grows past it
+ * @return void*
  */
-directory_t* initializeDirectory(int numLines) {
+static void* initializeDirectory(int numLines) {
     directory_t* dir = (directory_t*)malloc(sizeof(directory_t));
-    dir->lines = (directory_entry_t*)malloc(sizeof(directory_entry_t) * numLines);
-    dir->numLines = numLines;
-    pthread_mutex_init(&dir->lock, NULL);
-    
-    for (int i = 0; i < numLines; i++) {
-        dir->lines[i].state = DIR_UNCACHED;
-        for(int j = 0; j < NUM_PROCESSORS; j++){
-            dir->lines[i].existsInCache[j] = false;
-        }
-        dir->lines[i].owner = -1;
-        pthread_mutex_init(&dir->lines[i].lock, NULL);
+    if (dir == NULL) {
+        return NULL;
     }
+    dir->lines = createLineTable(sizeof(directory_entry_t), (size_t)numLines);
+    if (dir->lines == NULL) {
+        free(dir);
+        return NULL;
+    }
+    pthread_mutex_init(&dir->lock, NULL);
     return dir;
 }
 
 /**
- * @brief Helper function to find the directory index for a given address
- * 
- * @param address 
- * @return int 
+ * @brief Helper function to find the directory entry for a given block
+ *
+ * @param directory
+ * @param block
+ * @return directory_entry_t*  NULL if no cache holds the block
  */
- // Are you assuming a NUMA machine? The central directory source has a single directory for all caches so we can just index into the directoyr using the address 
- // if NUMA machines, the mmenry is split across processors (slide deck #12) so we should find the home node for this address and then search for the entry there. 
-int directoryIndex(int address) {
-    return address % NUM_LINES; // IS THIS CORRECT
+static directory_entry_t* directoryEntry(directory_t* directory, unsigned long block) {
+    return lineTableFind(directory->lines, block);
 }
 
 /**
- * @brief Update the directory entry for a given address
- * 
- * @param directory 
- * @param address 
- * @param processorId 
- * @param newState 
+ * @brief Find the directory entry for a given block, creating an uncached one
+ *
+ * @param directory
+ * @param block
+ * @return directory_entry_t*  NULL if out of memory
  */
-void updateDirectoryEntry(directory_t* directory, int address, int processorId, directory_state newState) {
-    int index = directoryIndex(address);
-    pthread_mutex_lock(&directory->lines[index].lock);
-    directory->lines[index].state = newState;
-    directory->lines[index].owner = (newState == DIR_EXCLUSIVE_MODIFIED) ? processorId : -1;
-    pthread_mutex_unlock(&directory->lines[index].lock);
+static directory_entry_t* claimEntry(directory_t* directory, unsigned long block) {
+    bool created;
+    directory_entry_t* entry = lineTableInsert(directory->lines, block, &created);
+    if (entry != NULL && created) {
+        entry->state = DIR_UNCACHED;
+        sharerSetClear(&entry->existsInCache);
+        entry->owner = -1;
+    }
+    return entry;
 }
 
 /**
- * @brief Invalidate the directory entry for a given address
- * 
- * @param directory 
- * @param address 
+ * @brief Get the state and owner of the directory entry for a given block
+ *
+ * @param dir
+ * @param block
+ * @param owner             filled in with the owner, -1 if none
+ * @return directory_state
  */
-void invalidateDirectoryEntry(directory_t* directory, int address) {
-   int index = directoryIndex(address);
-   pthread_mutex_lock(&directory->lines[index].lock);
-   directory->lines[index].state = DIR_UNCACHED;
-   for(int j = 0; j < NUM_PROCESSORS; j++){
-      directory->lines[index].existsInCache[j] = false;
-   }
-   directory->lines[index].owner = -1;
-   pthread_mutex_unlock(&directory->lines[index].lock);
+static directory_state getDirectoryState(void* dir, unsigned long block, int* owner) {
+    directory_t* directory = dir;
+    pthread_mutex_lock(&directory->lock);
+    directory_entry_t* entry = directoryEntry(directory, block);
+    directory_state state = entry != NULL ? entry->state : DIR_UNCACHED;
+    if (owner != NULL) {
+        *owner = entry != NULL ? entry->owner : -1;
+    }
+    pthread_mutex_unlock(&directory->lock);
+    return state;
 }
 
 /**
- * @brief Add a processor to the directory entry's existsInCache bits
- * 
- * @param directory 
- * @param address 
- * @param processorId 
- */
-void addProcessorToEntry(directory_t* directory, int address, int processorId) {
-   int index = directoryIndex(address);
-   pthread_mutex_lock(&directory->lines[index].lock);
-   directory->lines[index].existsInCache[processorId] = true;
-   pthread_mutex_unlock(&directory->lines[index].lock);
+ * @brief Get the processors whose existsInCache bit is set
+ *
+ * @param dir
+ * @param block
+ * @param sharers
+ */
+static void getSharers(void* dir, unsigned long block, sharer_set_t* sharers) {
+    directory_t* directory = dir;
+    pthread_mutex_lock(&directory->lock);
+    directory_entry_t* entry = directoryEntry(directory, block);
+    if (entry != NULL) {
+        *sharers = entry->existsInCache;
+    } else {
+        sharerSetClear(sharers);
+    }
+    pthread_mutex_unlock(&directory->lock);
 }
 
 /**
- * @brief Remove a processor from the directory entry's existsInCache bits
- * 
- * @param directory 
- * @param address 
- * @param processorId 
- */
-void removeProcessorFromEntry(directory_t* directory, int address, int processorId) {
-   int index = directoryIndex(address);
-   pthread_mutex_lock(&directory->lines[index].lock);
-   directory->lines[index].existsInCache[processorId] = false;
-   pthread_mutex_unlock(&directory->lines[index].lock);
+ * @brief Update the directory entry for a given block
+ *
+ * @param dir
+ * @param block
+ * @param processorId
+ * @param newState
+ */
+static void updateDirectoryEntry(void* dir, unsigned long block, int processorId, directory_state newState) {
+    directory_t* directory = dir;
+    pthread_mutex_lock(&directory->lock);
+    if (newState == DIR_UNCACHED) {
+        lineTableRemove(directory->lines, block);
+    } else {
+        directory_entry_t* entry = claimEntry(directory, block);
+        if (entry != NULL) {
+            entry->state = newState;
+            entry->owner = (newState == DIR_EXCLUSIVE_MODIFIED || newState == DIR_OWNED) ? processorId : -1;
+        }
+    }
+    pthread_mutex_unlock(&directory->lock);
 }
 
 /**
- * @brief Broadcast an invalidate to all processors except the owner for a given address
- * 
- * @param directory 
- * @param address 
- */
-void broadcastInvalidate(directory_t* directory, int address) {
-    int index = directoryIndex(address);
-    pthread_mutex_lock(&directory->lines[index].lock);
-    if(directory->lines[index].state != DIR_UNCACHED) {
-        // Send invalidate message to all processors except the owner
-        for(int j = 0; j < NUM_PROCESSORS; j++){
-            if(j != directory->lines[index].owner){
-                // sendMessage(INVALIDATE, address, j);
-            }
-        }
-    }
-    pthread_mutex_unlock(&directory->lines[index].lock);
+ * @brief Invalidate the directory entry for a given block
+ *
+ * @param dir
+ * @param block
+ */
+static void invalidateDirectoryEntry(void* dir, unsigned long block) {
+   directory_t* directory = dir;
+   pthread_mutex_lock(&directory->lock);
+   lineTableRemove(directory->lines, block);
+   pthread_mutex_unlock(&directory->lock);
 }
 
+/**
+ * @brief Add a processor to the directory entry's existsInCache bits
+ *
+ * @param dir
+ * @param block
+ * @param processorId
+ * @return int              always -1, a full bit vector never overflows
+ */
+static int addProcessorToEntry(void* dir, unsigned long block, int processorId) {
+   directory_t* directory = dir;
+   pthread_mutex_lock(&directory->lock);
+   directory_entry_t* entry = claimEntry(directory, block);
+   if (entry != NULL) {
+      sharerSetAdd(&entry->existsInCache, processorId);
+   }
+   pthread_mutex_unlock(&directory->lock);
+   return -1;
+}
 
-// Check if the cache is in a consistent state with the directory
-bool checkCacheConsistency(directory_t* directory, int lineIndex, int processorId) {
-   // Implement consistency checking logic here
-   return true; // placeholder return
+/**
+ * @brief Remove a processor from the directory entry's existsInCache bits
+ *
+ * The entry is dropped once no cache holds the line.
+ *
+ * @param dir
+ * @param block
+ * @param processorId
+ */
+static void removeProcessorFromEntry(void* dir, unsigned long block, int processorId) {
+   directory_t* directory = dir;
+   pthread_mutex_lock(&directory->lock);
+   directory_entry_t* entry = directoryEntry(directory, block);
+   if (entry != NULL) {
+      sharerSetRemove(&entry->existsInCache, processorId);
+      if (entry->owner == processorId) {
+         // The owner's copy is gone; any remaining sharers hold clean copies
+         entry->owner = -1;
+         entry->state = DIR_SHARED;
+      }
+      if (sharerSetCount(&entry->existsInCache) == 0) {
+         lineTableRemove(directory->lines, block);
+      }
+   }
+   pthread_mutex_unlock(&directory->lock);
 }
 
 
 /**
- * @brief Free the directory
- * 
- * @param dir 
+ * @brief Check that the entry for a block is well formed
+ *
+ * A live entry has at least one sharer and is not DIR_UNCACHED. An
+ * exclusive entry has its owner as the only sharer; an owned entry lists
+ * its owner among the sharers; a shared entry has no owner.
+ *
+ * @param dir
+ * @param block
+ * @param processorId       processor that must be listed as a sharer, -1 for none
+ * @return bool             false if the entry breaks an invariant
  */
-void freeDirectory(directory_t* dir) {
-   if(dir != NULL) {
-      if(dir->lines != NULL) {
-         for(int i = 0; i < dir->numLines; i++) {
-            pthread_mutex_destroy(&dir->lines[i].lock);
-         }
-         free(dir->lines);
+static bool checkCacheConsistency(void* dir, unsigned long block, int processorId) {
+   directory_t* directory = dir;
+   bool consistent;
+   pthread_mutex_lock(&directory->lock);
+   directory_entry_t* entry = directoryEntry(directory, block);
+   if (entry == NULL) {
+      consistent = processorId < 0;
+   } else {
+      int sharers = sharerSetCount(&entry->existsInCache);
+      bool ownerListed = entry->owner >= 0 && entry->owner < NUM_PROCESSORS &&
+                         sharerSetHas(&entry->existsInCache, entry->owner);
+      switch (entry->state) {
+         case DIR_SHARED:
+            consistent = sharers > 0 && entry->owner == -1;
+            break;
+         case DIR_EXCLUSIVE_MODIFIED:
+            consistent = sharers == 1 && ownerListed;
+            break;
+         case DIR_OWNED:
+            consistent = ownerListed;
+            break;
+         default:
+            consistent = false;
+            break;
+      }
+      if (processorId >= 0 && !sharerSetHas(&entry->existsInCache, processorId)) {
+         consistent = false;
       }
-      pthread_mutex_destroy(&dir->lock);
-      free(dir);
    }
+   pthread_mutex_unlock(&directory->lock);
+   return consistent;
 }
 
 /**
- * @brief initializeSystem
- * 
+ * @brief Report the occupancy of the entry table
+ *
+ * @param dir
+ * @param stats
  */
-void initializeSystem(void) {
+static void getTableStats(void* dir, line_table_stats_t* stats) {
+   directory_t* directory = dir;
+   pthread_mutex_lock(&directory->lock);
+   lineTableStats(directory->lines, stats);
+   pthread_mutex_unlock(&directory->lock);
+}
 
-    // Initialize and connect all caches to the interconnect
-    for (int i = 0; i < NUM_PROCESSORS; ++i) {
-        // Initialize the central directory
-        directories[i] = initializeDirectory(NUM_LINES);
-        caches[i] = initializeCache(S, E, B, i);  // Initialize cache for processor 'i'
-        connectCacheToInterconnect(caches[i], interconnect[i]);
-        processors[i]->cache = caches[i];
-        processor[i]->directory = directories[i];
-    }
 
-    // Connect the interconnect to the central directory
-    // connectInterconnectToDirectory(interconnect, directory);
+/**
+ * @brief Directory visitor passed through lineTableForEach
+ *
+ */
+typedef struct {
+   directory_visit_fn visit;
+   void* arg;
+} line_visitor_t;
 
+/**
+ * @brief Hand one entry to the directory visitor
+ *
+ * @param arg               line_visitor_t
+ * @param block
+ * @param entry
+ */
+static void visitEntry(void* arg, unsigned long block, void* entry) {
+   line_visitor_t* visitor = arg;
+   directory_entry_t* e = entry;
+   visitor->visit(visitor->arg, block, e->state, e->owner, &e->existsInCache);
 }
 
 /**
- * @brief cleanup System
- * 
+ * @brief Visit every line some cache holds
+ *
+ * @param dir
+ * @param visit
+ * @param arg
  */
-void cleanupSystem(void) {
-    // Cleanup caches
-    for (int i = 0; i < NUM_PROCESSORS; ++i) {
-        if (caches[i] != NULL) {
-            freeCache(caches[i]);
-        }
-    }
-
-    // Cleanup interconnect
-    if (interconnect != NULL) {
-        freeInterconnect(interconnect);
-    }
-
-    // Finally, free the central directory
-    if (directory != NULL) {
-        freeDirectory(directory);
-    }
+static void forEachLine(void* dir, directory_visit_fn visit, void* arg) {
+   directory_t* directory = dir;
+   line_visitor_t visitor = { visit, arg };
+   pthread_mutex_lock(&directory->lock);
+   lineTableForEach(directory->lines, visitEntry, &visitor);
+   pthread_mutex_unlock(&directory->lock);
 }
 
+
 /**
- * @brief 
- * 
- * @param request_line 
+ * @brief Free the directory
+ *
+ * @param directory
  */
-void executeInstruction(char *request_line) {
-   // Implement instruction execution logic...
+static void freeDirectory(void* directory) {
+   directory_t* dir = directory;
+   if(dir != NULL) {
+      freeLineTable(dir->lines);
+      pthread_mutex_destroy(&dir->lock);
+      free(dir);
+   }
 }
 
 /**
- * @brief Prints information about what parameters the program requires and it's format.
- * 
-*/
-void displayUsage(void) {
-   return;
+ * @brief Hardware bits of an entry: state, a presence bit per processor and
+ *        an owner pointer for lines shared while owned
+ *
+ * @param numProcessors
+ * @return unsigned int
+ */
+static unsigned int entryBits(int numProcessors) {
+   return DIRECTORY_STATE_BITS + (unsigned int)numProcessors + processorIdBits(numProcessors);
 }
 
+/** @brief Full bit vector directory, one presence bit per processor */
+const directory_ops_t centralDirectoryOps = {
+    .name = "central",
+    .create = initializeDirectory,
+    .destroy = freeDirectory,
+    .getState = getDirectoryState,
+    .getSharers = getSharers,
+    .setState = updateDirectoryEntry,
+    .addSharer = addProcessorToEntry,
+    .removeSharer = removeProcessorFromEntry,
+    .invalidate = invalidateDirectoryEntry,
+    .checkConsistency = checkCacheConsistency,
+    .tableStats = getTableStats,
+    .forEachLine = forEachLine,
+    .entryBits = entryBits,
+};
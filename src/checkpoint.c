@@ -0,0 +1,404 @@
+/**
+ * @file checkpoint.c
+ * @brief Snapshots of a warmed-up machine that later runs can branch from.
+ *
+ * Warming caches and directories up is a large share of a long trace, and
+ * runs that only differ in something that matters after the warmup (3-hop
+ * forwarding, the directory scheme, ...) can all start from one snapshot.
+ * Cache geometry, protocol and home placement must match the machine the
+ * snapshot was taken from; the directory scheme may differ, in which case sharers
+ * the new scheme cannot track are invalidated on restore.
+ */
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "checkpoint.h"
+
+/**
+ * @brief Writer state passed through forEachLine
+ *
+ */
+typedef struct entry_writer {
+    FILE *out;
+    unsigned long written;      // Entries written for the current home
+    unsigned long limit;        // Entries the header has room for
+    bool ok;
+} entry_writer_t;
+
+/**
+ * @brief Write one directory entry
+ *
+ * @param arg               entry_writer_t
+ * @param block
+ * @param state
+ * @param owner
+ * @param sharers
+ */
+static void writeEntry(void *arg, unsigned long block, directory_state state, int owner,
+                       const sharer_set_t *sharers) {
+    entry_writer_t *writer = arg;
+    if (writer->written == writer->limit) {
+        writer->ok = false;
+        return;
+    }
+    checkpoint_entry_t record;
+    memset(&record, 0, sizeof(record));
+    record.block = block;
+    record.state = state;
+    record.owner = owner;
+    memcpy(record.sharers, sharers->bits, sizeof(record.sharers));
+    writer->ok &= fwrite(&record, sizeof(record), 1, writer->out) == 1;
+    writer->written++;
+}
+
+/**
+ * @brief Write one first-touch page
+ *
+ * @param arg               entry_writer_t
+ * @param page
+ * @param entry             home node of the page
+ */
+static void writePage(void *arg, unsigned long page, void *entry) {
+    entry_writer_t *writer = arg;
+    checkpoint_page_t record = { .page = page, .home = *(int *)entry };
+    writer->ok &= fwrite(&record, sizeof(record), 1, writer->out) == 1;
+    writer->written++;
+}
+
+/**
+ * @brief Write a checkpoint of a machine.
+ *
+ * Buffered stores are written through, the victim caches are cast out and
+ * misses in flight complete first, so the checkpoint holds only the sets.
+ * Private regions are shared, so the directories list every cached line.
+ *
+ * @param sys
+ * @param path              file to create
+ * @param traceRecords      records simulated so far
+ * @param traceOffset       byte offset in the trace just past those records
+ * @return true             checkpoint written
+ */
+bool saveCheckpoint(system_t *sys, const char *path, unsigned long traceRecords,
+                    long traceOffset) {
+    const system_config_t *config = &sys->config;
+    int numProcessors = config->numProcessors;
+    unsigned long numSets = 1UL << config->s;
+    for (int p = 0; p < numProcessors; p++) {
+        drainWriteBuffer(sys->processors[p].cache);
+        cacheFlushVictims(sys->processors[p].cache);
+        cacheWaitForMisses(sys->processors[p].cache);
+    }
+    if (sys->regions != NULL) {
+        shareAllRegions(sys->regions);
+    }
+
+    checkpoint_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CHECKPOINT_MAGIC;
+    header.version = CHECKPOINT_VERSION;
+    header.numProcessors = (unsigned int)numProcessors;
+    header.s = config->s;
+    header.E = config->E;
+    header.b = config->b;
+    header.sectorBits = config->sectorBits;
+    header.sharerWords = SHARER_WORDS;
+    header.homePolicy = config->homePolicy;
+    header.homeGranularityBits = config->homeGranularityBits;
+    header.numMessageTypes = NUM_MESSAGE_TYPES;
+    strncpy(header.scheme, config->dirOps->name, CHECKPOINT_NAME_LEN - 1);
+    header.traceRecords = traceRecords;
+    header.traceOffset = traceOffset;
+    header.accessCount = sys->accessCount;
+    header.droppedCount = sys->droppedCount;
+    memcpy(header.messageCount, sys->interconnect->messageCount, sizeof(header.messageCount));
+    header.localMessages = sys->interconnect->localMessages;
+    header.remoteMessages = sys->interconnect->remoteMessages;
+    header.hopCycles = sys->interconnect->hopCycles;
+    header.headerBytes = sys->interconnect->headerBytes;
+    header.dataBytes = sys->interconnect->dataBytes;
+
+    checkpoint_home_t homes[NUM_PROCESSORS];
+    for (int p = 0; p < numProcessors; p++) {
+        const processor_t *home = &sys->processors[p];
+        line_table_stats_t stats;
+        home->dirOps->tableStats(home->directory, &stats);
+        homes[p].memoryReads = home->memoryReads;
+        homes[p].memoryWrites = home->memoryWrites;
+        homes[p].forwardCount = home->forwardCount;
+        homes[p].directoryLookups = home->directoryLookups;
+        homes[p].cacheProbes = home->cacheProbes;
+        homes[p].firstEntry = header.numEntries;
+        homes[p].numEntries = stats.entries;
+        header.numEntries += stats.entries;
+    }
+    header.numPages = sys->homeMap->pages != NULL ? lineTableCount(sys->homeMap->pages) : 0;
+    header.cacheOffset = sizeof(header);
+    header.lineOffset = header.cacheOffset + numProcessors * sizeof(checkpoint_cache_t);
+    unsigned long numLines = numProcessors * numSets * config->E;
+    unsigned long numSectors = 1UL << (config->b - config->sectorBits);
+    header.sectorOffset = header.lineOffset + numLines * sizeof(checkpoint_line_t);
+    header.homeOffset = header.sectorOffset + numLines * numSectors * sizeof(checkpoint_sector_t);
+    header.entryOffset = header.homeOffset + numProcessors * sizeof(checkpoint_home_t);
+    header.pageOffset = header.entryOffset + header.numEntries * sizeof(checkpoint_entry_t);
+
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+
+    for (int p = 0; ok && p < numProcessors; p++) {
+        const cache_t *C = sys->processors[p].cache;
+        checkpoint_cache_t record = {
+            .protocol = C->protocol,
+            .hitCount = C->hitCount, .missCount = C->missCount,
+            .sectorMissCount = C->sectorMissCount,
+            .evictionCount = C->evictionCount, .dirtyEvictionCount = C->dirtyEvictionCount,
+            .localMissCount = C->localMissCount, .remoteMissCount = C->remoteMissCount,
+            .upgradeCount = C->upgradeCount, .silentUpgradeCount = C->silentUpgradeCount,
+            .writebacksAvoided = C->writebacksAvoided,
+            .invalidationCount = C->invalidationCount,
+            .cycleCount = C->cycleCount, .missLatencyCycles = C->missLatencyCycles,
+            .writeThroughCount = C->writeThroughCount,
+            .unallocatedWriteCount = C->unallocatedWriteCount,
+            .writeStallCycles = C->writeStallCycles,
+            .victimHitCount = C->victimHitCount, .victimMissCount = C->victimMissCount,
+            .secondaryMissCount = C->secondaryMissCount,
+            .secondaryStallCycles = C->secondaryStallCycles, .mshrFullStalls = C->mshrFullStalls,
+            .mshrStallCycles = C->mshrStallCycles,
+            .atomicCount = C->atomicCount, .fenceCount = C->fenceCount,
+            .fenceStallCycles = C->fenceStallCycles,
+        };
+        ok = fwrite(&record, sizeof(record), 1, out) == 1;
+    }
+    for (int p = 0; ok && p < numProcessors; p++) {
+        const cache_t *C = sys->processors[p].cache;
+        for (unsigned long i = 0; ok && i < numSets; i++) {
+            const set_t *set = &C->setList[i];
+            for (unsigned long j = 0; ok && j < set->maxLines; j++) {
+                checkpoint_line_t record;
+                memset(&record, 0, sizeof(record));
+                record.tag = set->lines[j].tag;
+                record.lruCounter = set->lruCounter[j];
+                record.valid = set->lines[j].valid;
+                ok = fwrite(&record, sizeof(record), 1, out) == 1;
+            }
+        }
+    }
+    for (int p = 0; ok && p < numProcessors; p++) {
+        const cache_t *C = sys->processors[p].cache;
+        for (unsigned long i = 0; ok && i < numSets * C->E * C->numSectors; i++) {
+            const sector_t *sector = &C->setList[i / (C->E * C->numSectors)]
+                                          .sectors[i % (C->E * C->numSectors)];
+            checkpoint_sector_t record;
+            memset(&record, 0, sizeof(record));
+            record.state = sector->state;
+            record.valid = sector->valid;
+            record.isDirty = sector->isDirty;
+            ok = fwrite(&record, sizeof(record), 1, out) == 1;
+        }
+    }
+    ok = ok && fwrite(homes, sizeof(checkpoint_home_t), numProcessors, out) ==
+                   (size_t)numProcessors;
+    for (int p = 0; ok && p < numProcessors; p++) {
+        const processor_t *home = &sys->processors[p];
+        entry_writer_t writer = { out, 0, homes[p].numEntries, true };
+        home->dirOps->forEachLine(home->directory, writeEntry, &writer);
+        ok = writer.ok && writer.written == homes[p].numEntries;
+    }
+    if (ok && sys->homeMap->pages != NULL) {
+        entry_writer_t writer = { out, 0, header.numPages, true };
+        lineTableForEach(sys->homeMap->pages, writePage, &writer);
+        ok = writer.ok;
+    }
+
+    ok &= fclose(out) == 0;
+    return ok;
+}
+
+/**
+ * @brief Whether a checkpoint matches the machine it is restored into
+ *
+ * @param header
+ * @param size              size of the file in bytes
+ * @param config
+ * @return bool
+ */
+static bool checkpointFits(const checkpoint_header_t *header, size_t size,
+                           const system_config_t *config) {
+    if (header->magic != CHECKPOINT_MAGIC || header->version != CHECKPOINT_VERSION ||
+        header->sharerWords != SHARER_WORDS || header->numMessageTypes != NUM_MESSAGE_TYPES) {
+        fprintf(stderr, "Checkpoint was written by an incompatible build\n");
+        return false;
+    }
+    if (header->numProcessors != (unsigned int)config->numProcessors || header->s != config->s ||
+        header->E != config->E || header->b != config->b ||
+        header->sectorBits != config->sectorBits ||
+        header->homePolicy != (unsigned int)config->homePolicy ||
+        header->homeGranularityBits != config->homeGranularityBits) {
+        fprintf(stderr, "Checkpoint was taken with a different cache geometry or home placement\n");
+        return false;
+    }
+    if (size < header->pageOffset + header->numPages * sizeof(checkpoint_page_t)) {
+        fprintf(stderr, "Checkpoint is truncated\n");
+        return false;
+    }
+    // Lines in E or O, and DIR_OWNED entries, mean nothing to an MSI machine
+    const checkpoint_cache_t *caches =
+        (const checkpoint_cache_t *)((const unsigned char *)header + header->cacheOffset);
+    for (unsigned int p = 0; p < header->numProcessors; p++) {
+        if (caches[p].protocol != (unsigned int)config->protocol) {
+            fprintf(stderr, "Checkpoint was taken with the %s protocol\n",
+                    protocolName((coherence_protocol)caches[p].protocol));
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Load the state of a checkpoint into a newly created machine.
+ *
+ * @param sys               machine with the geometry of the checkpoint, not yet run
+ * @param path
+ * @param traceRecords      filled in with the records simulated before the checkpoint
+ * @param traceOffset       filled in with the trace byte offset to resume from
+ * @return true             state restored
+ */
+bool restoreCheckpoint(system_t *sys, const char *path, unsigned long *traceRecords,
+                       long *traceOffset) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(checkpoint_header_t)) {
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t)info.st_size;
+    const unsigned char *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+
+    const checkpoint_header_t *header = (const checkpoint_header_t *)base;
+    if (!checkpointFits(header, size, &sys->config)) {
+        munmap((void *)base, size);
+        return false;
+    }
+    int numProcessors = sys->config.numProcessors;
+    unsigned long numSets = 1UL << sys->config.s;
+    const checkpoint_cache_t *caches = (const checkpoint_cache_t *)(base + header->cacheOffset);
+    const checkpoint_line_t *lines = (const checkpoint_line_t *)(base + header->lineOffset);
+    const checkpoint_sector_t *sectors =
+        (const checkpoint_sector_t *)(base + header->sectorOffset);
+    const checkpoint_home_t *homes = (const checkpoint_home_t *)(base + header->homeOffset);
+    const checkpoint_entry_t *entries = (const checkpoint_entry_t *)(base + header->entryOffset);
+    const checkpoint_page_t *pages = (const checkpoint_page_t *)(base + header->pageOffset);
+
+    for (int p = 0; p < numProcessors; p++) {
+        cache_t *C = sys->processors[p].cache;
+        const checkpoint_cache_t *record = &caches[p];
+        C->hitCount = record->hitCount;
+        C->missCount = record->missCount;
+        C->sectorMissCount = record->sectorMissCount;
+        C->evictionCount = record->evictionCount;
+        C->dirtyEvictionCount = record->dirtyEvictionCount;
+        C->localMissCount = record->localMissCount;
+        C->remoteMissCount = record->remoteMissCount;
+        C->upgradeCount = record->upgradeCount;
+        C->silentUpgradeCount = record->silentUpgradeCount;
+        C->writebacksAvoided = record->writebacksAvoided;
+        C->invalidationCount = record->invalidationCount;
+        C->cycleCount = record->cycleCount;
+        C->missLatencyCycles = record->missLatencyCycles;
+        C->writeThroughCount = record->writeThroughCount;
+        C->unallocatedWriteCount = record->unallocatedWriteCount;
+        C->writeStallCycles = record->writeStallCycles;
+        C->victimHitCount = record->victimHitCount;
+        C->victimMissCount = record->victimMissCount;
+        C->secondaryMissCount = record->secondaryMissCount;
+        C->secondaryStallCycles = record->secondaryStallCycles;
+        C->mshrFullStalls = record->mshrFullStalls;
+        C->mshrStallCycles = record->mshrStallCycles;
+        C->atomicCount = record->atomicCount;
+        C->fenceCount = record->fenceCount;
+        C->fenceStallCycles = record->fenceStallCycles;
+
+        for (unsigned long i = 0; i < numSets; i++) {
+            set_t *set = &C->setList[i];
+            for (unsigned long j = 0; j < set->maxLines; j++) {
+                const checkpoint_line_t *line = lines++;
+                set->lines[j].tag = line->tag;
+                set->lines[j].valid = line->valid;
+                set->lruCounter[j] = line->lruCounter;
+            }
+            for (unsigned long k = 0; k < set->maxLines * C->numSectors; k++) {
+                const checkpoint_sector_t *sector = sectors++;
+                set->sectors[k].valid = sector->valid;
+                set->sectors[k].isDirty = sector->isDirty;
+                set->sectors[k].state = (block_state)sector->state;
+            }
+        }
+    }
+
+    for (int p = 0; p < numProcessors; p++) {
+        processor_t *home = &sys->processors[p];
+        home->memoryReads = homes[p].memoryReads;
+        home->memoryWrites = homes[p].memoryWrites;
+        home->forwardCount = homes[p].forwardCount;
+        home->directoryLookups = homes[p].directoryLookups;
+        home->cacheProbes = homes[p].cacheProbes;
+        for (unsigned long e = 0; e < homes[p].numEntries; e++) {
+            const checkpoint_entry_t *entry = &entries[homes[p].firstEntry + e];
+            sharer_set_t sharers;
+            memcpy(sharers.bits, entry->sharers, sizeof(sharers.bits));
+            home->dirOps->setState(home->directory, entry->block, entry->owner,
+                                   (directory_state)entry->state);
+            if (sys->regions != NULL) {
+                // Regions the machine had lines of are not private to whoever misses first
+                shareRegion(sys->regions, entry->block << sys->config.sectorBits);
+            }
+            for (int i = 0; i < numProcessors; i++) {
+                if (!sharerSetHas(&sharers, i)) {
+                    continue;
+                }
+                int dropped = home->dirOps->addSharer(home->directory, entry->block, i);
+                if (dropped >= 0) {
+                    // The scheme restored into tracks fewer sharers than the one saved
+                    cacheInvalidateLine(sys->processors[dropped].cache,
+                                        entry->block << sys->config.sectorBits);
+                }
+            }
+        }
+    }
+
+    if (sys->homeMap->pages != NULL) {
+        for (unsigned long i = 0; i < header->numPages; i++) {
+            int *home = lineTableInsert(sys->homeMap->pages, pages[i].page, NULL);
+            if (home != NULL) {
+                *home = (int)pages[i].home;
+            }
+        }
+    }
+
+    interconnect_t *net = sys->interconnect;
+    memcpy(net->messageCount, header->messageCount, sizeof(net->messageCount));
+    net->localMessages = header->localMessages;
+    net->remoteMessages = header->remoteMessages;
+    net->hopCycles = header->hopCycles;
+    net->headerBytes = header->headerBytes;
+    net->dataBytes = header->dataBytes;
+    sys->accessCount = header->accessCount;
+    sys->droppedCount = header->droppedCount;
+    *traceRecords = header->traceRecords;
+    *traceOffset = header->traceOffset;
+
+    munmap((void *)base, size);
+    return true;
+}
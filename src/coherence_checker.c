@@ -0,0 +1,341 @@
+/**
+ * @file coherence_checker.c
+ * @brief Sampled checks of the coherence invariants across caches and
+ *        directories.
+ *
+ * A check looks the line up in every cache and in its home directory
+ * slice, so it costs one probe per processor. Checking one access in N,
+ * or only the lines that hash into a 1-in-N sample, keeps that cost low
+ * enough to leave on in long sweeps; checking every access is for
+ * debugging a protocol change.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "coherence_checker.h"
+#include "system.h"
+
+/** @brief Names used in reports, indexed by violation_kind */
+static const char *const violationNames[NUM_VIOLATION_KINDS] = {
+    "multiple writers", "writer with readers", "multiple owners", "untracked copy",
+    "stale sharer", "owner mismatch", "malformed entry",
+};
+
+/** @brief Letters used for cache states in violation reports, indexed by block_state */
+static const char blockStateLetters[] = "ISEMO";
+
+/**
+ * @brief Seconds between two instants
+ *
+ * @param from
+ * @param to
+ * @return double
+ */
+static double elapsedSeconds(const struct timespec *from, const struct timespec *to) {
+    return (double)(to->tv_sec - from->tv_sec) + (double)(to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+/**
+ * @brief Create a coherence checker.
+ *
+ * @param mode
+ * @param period            N for CHECK_EVERY_NTH and CHECK_SAMPLED_LINES
+ * @return coherence_checker_t*     newly allocated checker, NULL on failure
+ */
+coherence_checker_t *createCoherenceChecker(check_mode mode, unsigned long period) {
+    if ((mode == CHECK_EVERY_NTH || mode == CHECK_SAMPLED_LINES) && period == 0) {
+        return NULL;
+    }
+    coherence_checker_t *checker = calloc(1, sizeof(coherence_checker_t));
+    if (checker == NULL) {
+        return NULL;
+    }
+    checker->mode = mode;
+    checker->period = period;
+    checker->countdown = period;
+    clock_gettime(CLOCK_MONOTONIC, &checker->started);
+    return checker;
+}
+
+/**
+ * @brief Count a violation and describe the first few on stderr
+ *
+ * @param checker
+ * @param sys
+ * @param kind
+ * @param block
+ * @param states            state of the line in every cache
+ * @param dirState
+ * @param dirOwner
+ */
+static void reportViolation(coherence_checker_t *checker, const system_t *sys,
+                            violation_kind kind, unsigned long block,
+                            const block_state *states, directory_state dirState, int dirOwner) {
+    checker->violations[kind]++;
+    if (checker->reported++ >= CHECK_REPORT_LIMIT) {
+        return;
+    }
+    fprintf(stderr, "%s: coherence violation (%s) on line %lx after %lu accesses: "
+                    "directory state %d owner %d, copies:",
+            sys->label, violationNames[kind], block << sys->config.sectorBits, sys->accessCount,
+            dirState, dirOwner);
+    for (int i = 0; i < sys->config.numProcessors; i++) {
+        if (states[i] != INVALID) {
+            fprintf(stderr, " P%d=%c", i, blockStateLetters[states[i]]);
+        }
+    }
+    fprintf(stderr, "\n");
+}
+
+/**
+ * @brief Check every invariant of one line.
+ *
+ * @param checker
+ * @param sys
+ * @param address           any address in the line
+ * @return bool             whether the line is coherent
+ */
+bool checkLine(coherence_checker_t *checker, system_t *sys, unsigned long address) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    unsigned long block = address >> sys->config.sectorBits;
+    unsigned long lineAddress = block << sys->config.sectorBits;
+    block_state states[NUM_PROCESSORS];
+    sharer_set_t holders;
+    sharerSetClear(&holders);
+    int copies = 0, writers = 0, owners = 0, writer = -1, owner = -1;
+    for (int i = 0; i < sys->config.numProcessors; i++) {
+        states[i] = cacheLineState(sys->processors[i].cache, lineAddress);
+        if (states[i] == INVALID) {
+            continue;
+        }
+        sharerSetAdd(&holders, i);
+        copies++;
+        if (states[i] == EXCLUSIVE || states[i] == MODIFIED) {
+            writers++;
+            writer = i;
+        } else if (states[i] == OWNED) {
+            owners++;
+            owner = i;
+        }
+    }
+
+    // Peek so that checking never places a first-touch page; a line whose
+    // page has no home yet has no directory entry to compare with
+    int homeId = peekHomeNode(sys->homeMap, lineAddress, -1);
+    processor_t *home = homeId >= 0 ? &sys->processors[homeId] : NULL;
+    int dirOwner = -1;
+    directory_state dirState = DIR_UNCACHED;
+    sharer_set_t listed;
+    sharerSetClear(&listed);
+    if (home != NULL) {
+        dirState = home->dirOps->getState(home->directory, block, &dirOwner);
+        home->dirOps->getSharers(home->directory, block, &listed);
+    }
+
+    bool violated[NUM_VIOLATION_KINDS] = { false };
+    violated[VIOLATION_MULTIPLE_WRITERS] = writers > 1;
+    violated[VIOLATION_WRITER_WITH_READERS] = writers == 1 && copies > 1;
+    violated[VIOLATION_MULTIPLE_OWNERS] = owners > 1;
+    int regionOwner;
+    if (sys->regions != NULL && regionPrivateTo(sys->regions, lineAddress, &regionOwner)) {
+        // Only the region's core may hold the line, and the directory stays out of it
+        for (int i = 0; i < SHARER_WORDS; i++) {
+            unsigned long allowed = i == regionOwner / 64 ? 1UL << (regionOwner % 64) : 0;
+            violated[VIOLATION_UNTRACKED_COPY] |= (holders.bits[i] & ~allowed) != 0;
+            violated[VIOLATION_STALE_SHARER] |= listed.bits[i] != 0;
+        }
+        violated[VIOLATION_OWNER_MISMATCH] = dirState != DIR_UNCACHED;
+    } else if (home != NULL && !home->dirOps->broadcast) {
+        // A snooping bus has no directory to agree with the copies
+        for (int i = 0; i < SHARER_WORDS; i++) {
+            violated[VIOLATION_UNTRACKED_COPY] |= (holders.bits[i] & ~listed.bits[i]) != 0;
+            violated[VIOLATION_STALE_SHARER] |= (listed.bits[i] & ~holders.bits[i]) != 0;
+        }
+        if (writers == 1) {
+            violated[VIOLATION_OWNER_MISMATCH] = dirState != DIR_EXCLUSIVE_MODIFIED ||
+                                                 dirOwner != writer;
+        } else if (owners == 1) {
+            violated[VIOLATION_OWNER_MISMATCH] = dirState != DIR_OWNED || dirOwner != owner;
+        } else if (writers == 0 && owners == 0) {
+            violated[VIOLATION_OWNER_MISMATCH] = dirState != (copies ? DIR_SHARED : DIR_UNCACHED);
+        }
+        violated[VIOLATION_MALFORMED_ENTRY] = !home->dirOps->checkConsistency(home->directory,
+                                                                              block, -1);
+    }
+
+    bool coherent = true;
+    for (int kind = 0; kind < NUM_VIOLATION_KINDS; kind++) {
+        if (violated[kind]) {
+            reportViolation(checker, sys, kind, block, states, dirState, dirOwner);
+            coherent = false;
+        }
+    }
+    checker->linesChecked++;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    checker->checkSeconds += elapsedSeconds(&start, &end);
+    return coherent;
+}
+
+/**
+ * @brief Blocks collected from the directories before checking them
+ *
+ */
+typedef struct block_list {
+    unsigned long *blocks;
+    size_t count;
+    size_t capacity;
+    bool failed;
+} block_list_t;
+
+/**
+ * @brief Collect one directory entry
+ *
+ * @param arg               block_list_t
+ * @param block
+ * @param state
+ * @param owner
+ * @param sharers
+ */
+static void collectBlock(void *arg, unsigned long block, directory_state state, int owner,
+                         const sharer_set_t *sharers) {
+    (void)state;
+    (void)owner;
+    (void)sharers;
+    block_list_t *list = arg;
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? 2 * list->capacity : NUM_LINES;
+        unsigned long *blocks = realloc(list->blocks, capacity * sizeof(unsigned long));
+        if (blocks == NULL) {
+            list->failed = true;
+            return;
+        }
+        list->blocks = blocks;
+        list->capacity = capacity;
+    }
+    list->blocks[list->count++] = block;
+}
+
+/**
+ * @brief Check every line held by a cache or tracked by a directory.
+ *
+ * @param checker
+ * @param sys
+ * @return unsigned long    number of incoherent lines found
+ */
+unsigned long checkMachine(coherence_checker_t *checker, system_t *sys) {
+    unsigned long incoherent = 0;
+    for (int i = 0; i < sys->config.numProcessors; i++) {
+        const cache_t *C = sys->processors[i].cache;
+        for (unsigned long set = 0; set < (1UL << C->S); set++) {
+            for (unsigned long way = 0; way < C->E; way++) {
+                const line_t *line = &C->setList[set].lines[way];
+                for (unsigned long sector = 0; line->valid && sector < C->numSectors; sector++) {
+                    if (line->sectors[sector].valid) {
+                        unsigned long address = (line->tag << (C->S + C->B)) | (set << C->B) |
+                                                (sector << C->sectorBits);
+                        incoherent += !checkLine(checker, sys, address);
+                    }
+                }
+            }
+        }
+    }
+
+    // Entries no cache holds any more are only found through the directories
+    for (int i = 0; i < sys->config.numProcessors; i++) {
+        processor_t *home = &sys->processors[i];
+        block_list_t list = { NULL, 0, 0, false };
+        home->dirOps->forEachLine(home->directory, collectBlock, &list);
+        for (size_t j = 0; j < list.count; j++) {
+            incoherent += !checkLine(checker, sys, list.blocks[j] << sys->config.sectorBits);
+        }
+        free(list.blocks);
+    }
+    return incoherent;
+}
+
+/**
+ * @brief Violations of every kind found so far.
+ *
+ * @param checker
+ * @return unsigned long
+ */
+unsigned long totalViolations(const coherence_checker_t *checker) {
+    unsigned long total = 0;
+    for (int kind = 0; kind < NUM_VIOLATION_KINDS; kind++) {
+        total += checker->violations[kind];
+    }
+    return total;
+}
+
+/**
+ * @brief Print what was checked, what was found and what it cost.
+ *
+ * @param checker
+ */
+void printCheckerReport(const coherence_checker_t *checker) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double total = elapsedSeconds(&checker->started, &now);
+    printf("Coherence checks: %lu lines, violations: %lu, time: %.3f s "
+           "(%.1f ns per line, %.1f%% of the run)\n",
+           checker->linesChecked, totalViolations(checker), checker->checkSeconds,
+           checker->linesChecked ? checker->checkSeconds * 1e9 / checker->linesChecked : 0.0,
+           total > 0 ? 100.0 * checker->checkSeconds / total : 0.0);
+    for (int kind = 0; kind < NUM_VIOLATION_KINDS; kind++) {
+        if (checker->violations[kind] != 0) {
+            printf("  %s: %lu\n", violationNames[kind], checker->violations[kind]);
+        }
+    }
+}
+
+/**
+ * @brief Parse a checking mode from the command line.
+ *
+ * @param text              "all", "every:<n>" or "sample:<n>"
+ * @param mode
+ * @param period
+ * @return bool             false if text is not a valid mode
+ */
+bool parseCheckMode(const char *text, check_mode *mode, unsigned long *period) {
+    if (strcmp(text, "all") == 0) {
+        *mode = CHECK_EVERY_ACCESS;
+        *period = 1;
+        return true;
+    }
+    const char *colon = strchr(text, ':');
+    if (colon == NULL) {
+        return false;
+    }
+    size_t length = (size_t)(colon - text);
+    if (length == 5 && strncmp(text, "every", length) == 0) {
+        *mode = CHECK_EVERY_NTH;
+    } else if (length == 6 && strncmp(text, "sample", length) == 0) {
+        *mode = CHECK_SAMPLED_LINES;
+    } else {
+        return false;
+    }
+    char *end;
+    *period = strtoul(colon + 1, &end, 0);
+    return *end == '\0' && *period > 0;
+}
+
+/**
+ * @brief Name of a violation, for reports.
+ *
+ * @param kind
+ * @return const char*
+ */
+const char *violationName(violation_kind kind) {
+    return (kind >= 0 && kind < NUM_VIOLATION_KINDS) ? violationNames[kind] : "unknown";
+}
+
+/**
+ * @brief Free a coherence checker.
+ *
+ * @param checker
+ */
+void freeCoherenceChecker(coherence_checker_t *checker) {
+    free(checker);
+}
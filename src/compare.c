@@ -0,0 +1,208 @@
+/**
+ * @file compare.c
+ * @brief Drive several systems in lockstep from one decoded trace.
+ *
+ * The trace is decoded (or a synthetic workload generated) a chunk at a
+ * time and every system consumes the chunk before the next one is
+ * produced, so each line is parsed once no matter how many directory
+ * schemes and cache configurations are compared. Whole traces are read
+ * and decoded by a pipeline of background threads, so the simulation
+ * thread does not wait on either.
+ */
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compare.h"
+#include "trace_pipeline.h"
+
+/**
+ * @brief Where the records of a lockstep run come from
+ *
+ */
+typedef struct record_source {
+    FILE *trace;                // Trace file, or NULL to use the workload
+    workload_t *workload;
+    unsigned long remaining;    // Records still to be produced
+} record_source_t;
+
+/**
+ * @brief Produce the next chunk of records
+ *
+ * @param source
+ * @param records
+ * @param maxRecords
+ * @return size_t           0 once the source is exhausted
+ */
+static size_t nextChunk(record_source_t *source, access_t *records, size_t maxRecords) {
+    if (maxRecords > source->remaining) {
+        maxRecords = source->remaining;
+    }
+    size_t count;
+    if (source->trace != NULL) {
+        count = decodeTraceChunk(source->trace, records, maxRecords);
+    } else {
+        count = generateAccesses(source->workload, records, maxRecords);
+    }
+    source->remaining -= count;
+    return count;
+}
+
+/**
+ * @brief Drive every system from a record source
+ *
+ * @param source
+ * @param systems
+ * @param numSystems
+ * @return unsigned long    number of records consumed
+ */
+static unsigned long runSource(record_source_t *source, system_t **systems, int numSystems) {
+    access_t *records = malloc(TRACE_CHUNK_RECORDS * sizeof(access_t));
+    if (records == NULL) {
+        return 0;
+    }
+
+    unsigned long total = 0;
+    size_t count;
+    while ((count = nextChunk(source, records, TRACE_CHUNK_RECORDS)) > 0) {
+        for (int i = 0; i < numSystems; i++) {
+            simulateAccesses(systems[i], records, count);
+        }
+        total += count;
+    }
+
+    free(records);
+    return total;
+}
+
+/**
+ * @brief Run a trace through every system
+ *
+ * @param trace             open trace file
+ * @param systems           systems to drive
+ * @param numSystems        number of systems
+ * @return unsigned long    number of records decoded
+ */
+unsigned long runLockstep(FILE *trace, system_t **systems, int numSystems) {
+    return runLockstepUntil(trace, systems, numSystems, ULONG_MAX);
+}
+
+/**
+ * @brief Run a trace through every system, reading and decoding it on
+ *        background threads
+ *
+ * Plain traces fall back to decoding on the calling thread if the
+ * pipeline cannot be started. A trace that could not be read to its end
+ * is reported through stats->readFailed.
+ *
+ * @param input             open trace
+ * @param systems           systems to drive
+ * @param numSystems        number of systems
+ * @param numDecoders       decoder threads
+ * @param stats             filled in with what the pipeline did, may be NULL
+ * @return unsigned long    number of records decoded
+ */
+unsigned long runLockstepPipelined(trace_input_t *input, system_t **systems, int numSystems,
+                                   int numDecoders, ingest_stats_t *stats) {
+    if (stats != NULL) {
+        memset(stats, 0, sizeof(*stats));
+    }
+    trace_pipeline_t *pipeline = startTracePipeline(input, numDecoders);
+    if (pipeline == NULL) {
+        if (input->compression != TRACE_PLAIN) {
+            fprintf(stderr, "Could not start reading the trace\n");
+            if (stats != NULL) {
+                stats->readFailed = true;
+            }
+            return 0;
+        }
+        unsigned long total = runLockstep(input->file, systems, numSystems);
+        if (stats != NULL) {
+            stats->readFailed = ferror(input->file) != 0;
+        }
+        return total;
+    }
+
+    unsigned long total = 0;
+    record_batch_t *batch;
+    while ((batch = nextBatch(pipeline)) != NULL) {
+        for (int i = 0; i < numSystems; i++) {
+            simulateAccesses(systems[i], batch->records, batch->count);
+        }
+        total += batch->count;
+        releaseBatch(pipeline, batch);
+    }
+    stopTracePipeline(pipeline, stats);
+    return total;
+}
+
+/**
+ * @brief Run at most a given number of trace records through every system
+ *
+ * The trace is left positioned just after the last record consumed, so a
+ * checkpoint can record where to resume.
+ *
+ * @param trace             open trace file
+ * @param systems           systems to drive
+ * @param numSystems        number of systems
+ * @param maxRecords
+ * @return unsigned long    number of records decoded
+ */
+unsigned long runLockstepUntil(FILE *trace, system_t **systems, int numSystems,
+                               unsigned long maxRecords) {
+    record_source_t source = { .trace = trace, .workload = NULL, .remaining = maxRecords };
+    return runSource(&source, systems, numSystems);
+}
+
+/**
+ * @brief Run a synthetic workload through every system
+ *
+ * @param workload
+ * @param systems           systems to drive
+ * @param numSystems        number of systems
+ * @return unsigned long    number of records generated
+ */
+unsigned long runLockstepWorkload(workload_t *workload, system_t **systems, int numSystems) {
+    record_source_t source = { .trace = NULL, .workload = workload, .remaining = ULONG_MAX };
+    return runSource(&source, systems, numSystems);
+}
+
+/**
+ * @brief Print one row per system with its totals
+ *
+ * @param systems
+ * @param numSystems
+ */
+void printComparison(system_t **systems, int numSystems) {
+    printf("%-40s %12s %12s %12s %12s %12s %14s %10s %14s\n", "system", "hits", "misses",
+           "evictions", "invalidates", "messages", "cycles", "miss lat", "network bytes");
+    for (int i = 0; i < numSystems; i++) {
+        const system_t *sys = systems[i];
+        unsigned long hits = 0, misses = 0, evictions = 0, invalidations = 0, cycles = 0;
+        for (int p = 0; p < sys->config.numProcessors; p++) {
+            const cache_t *C = sys->processors[p].cache;
+            hits += C->hitCount;
+            misses += C->missCount;
+            evictions += C->evictionCount;
+            invalidations += C->invalidationCount;
+            cycles += C->cycleCount;
+        }
+        printf("%-40s %12lu %12lu %12lu %12lu %12lu %14lu %10.2f %14lu\n", sys->label, hits,
+               misses, evictions, invalidations, interconnectTotalMessages(sys->interconnect),
+               cycles, averageMissLatency(sys), interconnectTotalBytes(sys->interconnect));
+    }
+    if (!systems[0]->config.accounting) {
+        return;
+    }
+    printf("\n%-40s %12s %12s %12s %12s %12s\n", "system", "entry bits", "overhead %",
+           "sparse KB", "energy uJ", "pJ/access");
+    for (int i = 0; i < numSystems; i++) {
+        const system_t *sys = systems[i];
+        storage_report_t storage;
+        energy_report_t energy;
+        computeStorage(sys, &storage);
+        computeEnergy(sys, &energy);
+        printf("%-40s %12u %12.2f %12.2f %12.2f %12.2f\n", sys->label, storage.entryBits,
+               storage.overheadPercent, storage.sparseBytes / 1024.0, energy.totalPJ / 1e6,
+               sys->accessCount ? energy.totalPJ / sys->accessCount : 0.0);
+    }
+}
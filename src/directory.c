@@ -0,0 +1,122 @@
+/**
+ * @file directory.c
+ * @brief Lookup of directory schemes and sharer set helpers.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "directory.h"
+
+/** @brief Every scheme that can be selected by name */
+static const directory_ops_t *const directorySchemes[] = {
+    &centralDirectoryOps,
+    &limitedPointerDirectoryOps,
+    &hybridDirectoryOps,
+    &snoopBusOps,
+};
+
+#define NUM_SCHEMES (sizeof(directorySchemes) / sizeof(directorySchemes[0]))
+
+/**
+ * @brief Find a directory scheme by name.
+ *
+ * @param name
+ * @return const directory_ops_t*   NULL if no scheme has that name
+ */
+const directory_ops_t *findDirectoryOps(const char *name) {
+    for (size_t i = 0; i < NUM_SCHEMES; i++) {
+        if (strcmp(directorySchemes[i]->name, name) == 0) {
+            return directorySchemes[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Directory scheme by position in the table of schemes.
+ *
+ * @param index
+ * @return const directory_ops_t*   NULL past the last scheme
+ */
+const directory_ops_t *directoryScheme(int index) {
+    return index >= 0 && (size_t)index < NUM_SCHEMES ? directorySchemes[index] : NULL;
+}
+
+/**
+ * @brief Print the names of all directory schemes.
+ *
+ */
+void listDirectorySchemes(void) {
+    for (size_t i = 0; i < NUM_SCHEMES; i++) {
+        printf("%s%s", i ? ", " : "", directorySchemes[i]->name);
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Bits needed to name one of numProcessors processors
+ *
+ * @param numProcessors
+ * @return unsigned int
+ */
+unsigned int processorIdBits(int numProcessors) {
+    unsigned int bits = 0;
+    while ((1L << bits) < numProcessors) {
+        bits++;
+    }
+    return bits;
+}
+
+/**
+ * @brief Empty a sharer set
+ *
+ * @param set
+ */
+void sharerSetClear(sharer_set_t *set) {
+    memset(set->bits, 0, sizeof(set->bits));
+}
+
+/**
+ * @brief Add a processor to a sharer set
+ *
+ * @param set
+ * @param processorId
+ */
+void sharerSetAdd(sharer_set_t *set, int processorId) {
+    set->bits[processorId / 64] |= 1UL << (processorId % 64);
+}
+
+/**
+ * @brief Remove a processor from a sharer set
+ *
+ * @param set
+ * @param processorId
+ */
+void sharerSetRemove(sharer_set_t *set, int processorId) {
+    set->bits[processorId / 64] &= ~(1UL << (processorId % 64));
+}
+
+/**
+ * @brief Check whether a processor is in a sharer set
+ *
+ * @param set
+ * @param processorId
+ * @return true
+ * @return false
+ */
+bool sharerSetHas(const sharer_set_t *set, int processorId) {
+    return (set->bits[processorId / 64] >> (processorId % 64)) & 1UL;
+}
+
+/**
+ * @brief Number of processors in a sharer set
+ *
+ * @param set
+ * @return int
+ */
+int sharerSetCount(const sharer_set_t *set) {
+    int count = 0;
+    for (int i = 0; i < SHARER_WORDS; i++) {
+        count += __builtin_popcountl(set->bits[i]);
+    }
+    return count;
+}
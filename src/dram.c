@@ -0,0 +1,228 @@
+/**
+ * @file dram.c
+ * @brief Memory controller of a home node: banks with open row buffers,
+ *        a bounded read/write queue and first-ready scheduling.
+ *
+ * Rows are interleaved across the banks, and rows stay open after an
+ * access. A request waits for an entry in the queue, then for a gap in its
+ * bank's schedule; its latency runs from its arrival to the end of its
+ * data transfer.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dram.h"
+
+/**
+ * @brief Create a memory controller with every row buffer closed.
+ *
+ * @param numBanks          power of two, at most MAX_DRAM_BANKS
+ * @param queueDepth        1 to MAX_DRAM_QUEUE
+ * @return dram_controller_t*   newly allocated controller, NULL on failure
+ */
+dram_controller_t *createDramController(int numBanks, int queueDepth) {
+    if (numBanks < 1 || numBanks > MAX_DRAM_BANKS || (numBanks & (numBanks - 1)) != 0 ||
+        queueDepth < 1 || queueDepth > MAX_DRAM_QUEUE) {
+        return NULL;
+    }
+    dram_controller_t *dram = calloc(1, sizeof(dram_controller_t));
+    if (dram == NULL) {
+        return NULL;
+    }
+    dram->numBanks = numBanks;
+    while ((1 << dram->bankBits) < numBanks) {
+        dram->bankBits++;
+    }
+    dram->queueDepth = queueDepth;
+    for (int i = 0; i < numBanks; i++) {
+        dram->banks[i].rowBefore = DRAM_NO_ROW;
+    }
+    return dram;
+}
+
+/**
+ * @brief Cycles a bank takes for a request, given the row it has open
+ *
+ * @param openRow
+ * @param row               row the request needs
+ * @return unsigned long
+ */
+static unsigned long serviceCycles(unsigned long openRow, unsigned long row) {
+    if (openRow == row) {
+        return DRAM_CAS_CYCLES + DRAM_BURST_CYCLES;
+    }
+    if (openRow == DRAM_NO_ROW) {
+        return DRAM_RCD_CYCLES + DRAM_CAS_CYCLES + DRAM_BURST_CYCLES;
+    }
+    return DRAM_RP_CYCLES + DRAM_RCD_CYCLES + DRAM_CAS_CYCLES + DRAM_BURST_CYCLES;
+}
+
+/**
+ * @brief First cycle from arrival on at which the queue has a free entry
+ *
+ * @param dram
+ * @param arrival
+ * @return unsigned long
+ */
+static unsigned long waitForQueue(const dram_controller_t *dram, unsigned long arrival) {
+    unsigned long now = arrival;
+    for (;;) {
+        int queued = 0;
+        unsigned long firstDone = ~0UL;
+        for (int i = 0; i < MAX_DRAM_QUEUE; i++) {
+            const dram_request_t *request = &dram->recent[i];
+            if (request->arrival <= now && request->end > now) {
+                queued++;
+                if (request->end < firstDone) {
+                    firstDone = request->end;
+                }
+            }
+        }
+        if (queued < dram->queueDepth) {
+            return now;
+        }
+        now = firstDone;
+    }
+}
+
+/**
+ * @brief Remember a reservation, forgetting the oldest one if the bank's
+ *        schedule is full.
+ *
+ * @param bank
+ * @param index             position that keeps the schedule sorted
+ * @param reservation
+ */
+static void reserve(dram_bank_t *bank, int index, dram_reservation_t reservation) {
+    if (bank->count == DRAM_BANK_RESERVATIONS) {
+        if (index == 0) {
+            return;  // Earlier than anything remembered
+        }
+        bank->rowBefore = bank->reservations[0].row;
+        memmove(&bank->reservations[0], &bank->reservations[1],
+                (index - 1) * sizeof(dram_reservation_t));
+        bank->reservations[index - 1] = reservation;
+        return;
+    }
+    memmove(&bank->reservations[index + 1], &bank->reservations[index],
+            (bank->count - index) * sizeof(dram_reservation_t));
+    bank->reservations[index] = reservation;
+    bank->count++;
+}
+
+/**
+ * @brief Schedule a read or write of a line.
+ *
+ * @param dram
+ * @param address
+ * @param arrival           cycle the request reaches the controller
+ * @param isWrite           a writeback, whose latency nobody waits on
+ * @return unsigned long    cycles from arrival until the line is transferred
+ */
+unsigned long dramAccess(dram_controller_t *dram, unsigned long address, unsigned long arrival,
+                         bool isWrite) {
+    dram_bank_t *bank = &dram->banks[(address >> DRAM_ROW_BITS) & (dram->numBanks - 1)];
+    unsigned long row = address >> (DRAM_ROW_BITS + dram->bankBits);
+    unsigned long ready = waitForQueue(dram, arrival);
+    if (ready > arrival) {
+        dram->queueFullStalls++;
+        dram->queueCycles += ready - arrival;
+    }
+
+    // Earliest gap that fits, without taking the row from a request that needs it open
+    dram_reservation_t placed = { .row = row };
+    unsigned long openRow = bank->rowBefore;
+    int index = 0;
+    for (;; index++) {
+        openRow = index > 0 ? bank->reservations[index - 1].row : bank->rowBefore;
+        placed.start = ready;
+        if (index > 0 && bank->reservations[index - 1].end > placed.start) {
+            placed.start = bank->reservations[index - 1].end;
+        }
+        placed.end = placed.start + serviceCycles(openRow, row);
+        if (index == bank->count) {
+            break;
+        }
+        const dram_reservation_t *next = &bank->reservations[index];
+        if (placed.end <= next->start && (row == openRow || next->row != openRow)) {
+            break;
+        }
+    }
+    reserve(bank, index, placed);
+
+    if (openRow == row) {
+        dram->rowHits++;
+    } else if (openRow == DRAM_NO_ROW) {
+        dram->rowEmpty++;
+    } else {
+        dram->rowConflicts++;
+    }
+    dram->bankCycles += placed.start - ready;
+    dram->recent[dram->nextRecent].arrival = arrival;
+    dram->recent[dram->nextRecent].end = placed.end;
+    dram->nextRecent = (dram->nextRecent + 1) % MAX_DRAM_QUEUE;
+    if (isWrite) {
+        dram->writes++;
+    } else {
+        dram->reads++;
+        dram->readCycles += placed.end - arrival;
+    }
+    return placed.end - arrival;
+}
+
+/**
+ * @brief Parse a memory controller configuration from the command line.
+ *
+ * @param text              "<banks>[:<queue depth>]"
+ * @param numBanks          filled in on success
+ * @param queueDepth        filled in on success, DEFAULT_DRAM_QUEUE if not given
+ * @return true             text was recognized
+ */
+bool parseDramConfig(const char *text, int *numBanks, int *queueDepth) {
+    char *end;
+    long banks = strtol(text, &end, 10);
+    long depth = DEFAULT_DRAM_QUEUE;
+    if (end == text) {
+        return false;
+    }
+    if (*end == ':') {
+        const char *depthText = end + 1;
+        depth = strtol(depthText, &end, 10);
+        if (end == depthText) {
+            return false;
+        }
+    }
+    if (*end != '\0' || banks < 1 || banks > MAX_DRAM_BANKS || (banks & (banks - 1)) != 0 ||
+        depth < 1 || depth > MAX_DRAM_QUEUE) {
+        return false;
+    }
+    *numBanks = (int)banks;
+    *queueDepth = (int)depth;
+    return true;
+}
+
+/**
+ * @brief Prints the row buffer and queueing counters of a controller.
+ *
+ * @param dram
+ * @param home              home node the controller belongs to
+ */
+void printDramController(const dram_controller_t *dram, int home) {
+    unsigned long requests = dram->reads + dram->writes;
+    printf("Memory %d: reads: %lu, writes: %lu, row hits: %lu, row empty: %lu, "
+           "row conflicts: %lu, row hit rate: %.4f, average read latency: %.2f, "
+           "queue full: %lu (%lu cycles), bank wait cycles: %lu\n",
+           home, dram->reads, dram->writes, dram->rowHits, dram->rowEmpty, dram->rowConflicts,
+           requests ? (double)dram->rowHits / requests : 0.0,
+           dram->reads ? (double)dram->readCycles / dram->reads : 0.0,
+           dram->queueFullStalls, dram->queueCycles, dram->bankCycles);
+}
+
+/**
+ * @brief Free a memory controller.
+ *
+ * @param dram
+ */
+void freeDramController(dram_controller_t *dram) {
+    free(dram);
+}
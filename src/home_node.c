@@ -0,0 +1,166 @@
+/**
+ * @file home_node.c
+ * @brief Map memory addresses to their home node on a NUMA machine.
+ *
+ * Memory is split across the processors (slide deck #12), so every miss has
+ * to find the node whose directory slice tracks the address. The mapping is
+ * pluggable so placement policies can be compared on the same trace.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "home_node.h"
+
+/**
+ * @brief Create a home node mapping.
+ *
+ * @param policy            placement policy
+ * @param numNodes          number of home nodes
+ * @param granularityBits   log2 of the interleaving unit in bytes
+ * @return home_map_t*      newly allocated mapping, NULL on failure
+ */
+home_map_t *createHomeMap(home_policy policy, int numNodes, unsigned int granularityBits) {
+    if (numNodes <= 0) {
+        return NULL;
+    }
+    home_map_t *map = malloc(sizeof(home_map_t));
+    if (map == NULL) {
+        return NULL;
+    }
+    map->policy = policy;
+    map->numNodes = numNodes;
+    map->granularityBits = granularityBits;
+
+    // Fold just enough bits to cover every node
+    map->xorFoldBits = 1;
+    while ((1 << map->xorFoldBits) < numNodes) {
+        map->xorFoldBits++;
+    }
+
+    map->pages = NULL;
+    if (policy == HOME_FIRST_TOUCH) {
+        map->pages = createLineTable(sizeof(int), FIRST_TOUCH_INITIAL_SLOTS);
+        if (map->pages == NULL) {
+            freeHomeMap(map);
+            return NULL;
+        }
+    }
+    return map;
+}
+
+/**
+ * @brief Find the home of a page, placing it on the requester on first touch.
+ *
+ * @param map
+ * @param page
+ * @param requesterId
+ * @return int
+ */
+static int firstTouchHome(home_map_t *map, unsigned long page, int requesterId) {
+    bool created;
+    int *home = lineTableInsert(map->pages, page, &created);
+    if (home == NULL) {
+        // Out of memory: fall back to page interleaving for new pages
+        return (int)(page % map->numNodes);
+    }
+    if (created) {
+        *home = requesterId;
+    }
+    return *home;
+}
+
+/**
+ * @brief Find the home node of an address.
+ *
+ * @param map
+ * @param address           address being accessed
+ * @param requesterId       processor making the access (used by first touch)
+ * @return int              home node of the address
+ */
+int homeNode(home_map_t *map, unsigned long address, int requesterId) {
+    unsigned long unit = address >> map->granularityBits;
+
+    switch (map->policy) {
+        case HOME_LINE_INTERLEAVE:
+        case HOME_PAGE_INTERLEAVE:
+            return (int)(unit % map->numNodes);
+        case HOME_XOR_INTERLEAVE: {
+            unsigned long folded = 0;
+            for (unsigned long rest = unit; rest != 0; rest >>= map->xorFoldBits) {
+                folded ^= rest;
+            }
+            return (int)((folded & ((1UL << map->xorFoldBits) - 1)) % map->numNodes);
+        }
+        case HOME_FIRST_TOUCH:
+            return firstTouchHome(map, unit, requesterId);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Find the home node an access would go to, without placing the page.
+ *
+ * @param map
+ * @param address           address about to be accessed
+ * @param requesterId       processor about to access it, or -1 to only look
+ * @return int              home node of the address, requesterId for an
+ *                          unplaced first-touch page
+ */
+int peekHomeNode(home_map_t *map, unsigned long address, int requesterId) {
+    if (map->policy != HOME_FIRST_TOUCH) {
+        return homeNode(map, address, requesterId);
+    }
+    int *home = lineTableFind(map->pages, address >> map->granularityBits);
+    return home != NULL ? *home : requesterId;
+}
+
+/**
+ * @brief Parse a policy name from the command line.
+ *
+ * @param name              one of "line", "page", "xor", "first-touch"
+ * @param policy            filled in on success
+ * @return true             name was recognized
+ */
+bool parseHomePolicy(const char *name, home_policy *policy) {
+    if (strcmp(name, "line") == 0) {
+        *policy = HOME_LINE_INTERLEAVE;
+    } else if (strcmp(name, "page") == 0) {
+        *policy = HOME_PAGE_INTERLEAVE;
+    } else if (strcmp(name, "xor") == 0) {
+        *policy = HOME_XOR_INTERLEAVE;
+    } else if (strcmp(name, "first-touch") == 0) {
+        *policy = HOME_FIRST_TOUCH;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Name of a policy, for reports.
+ *
+ * @param policy
+ * @return const char*
+ */
+const char *homePolicyName(home_policy policy) {
+    switch (policy) {
+        case HOME_LINE_INTERLEAVE: return "line";
+        case HOME_PAGE_INTERLEAVE: return "page";
+        case HOME_XOR_INTERLEAVE:  return "xor";
+        case HOME_FIRST_TOUCH:     return "first-touch";
+        default:                   return "unknown";
+    }
+}
+
+/**
+ * @brief Free the home node mapping.
+ *
+ * @param map
+ */
+void freeHomeMap(home_map_t *map) {
+    if (map != NULL) {
+        freeLineTable(map->pages);
+        free(map);
+    }
+}
@@ -0,0 +1,562 @@
+/**
+ * @file hybrid_directory.c
+ * @brief Implement a directory that keeps limited pointers for lines with
+ *        few sharers and a full bit vector for widely shared ones.
+ *
+ * Every entry starts with HYBRID_POINTERS sharer pointers. The sharer that
+ * would overflow them promotes the entry: its sharers move to a full bit
+ * vector taken from a pool beside the entry table, so no sharer is ever
+ * dropped to make room. Once only HYBRID_DEMOTE_SHARERS are left, or the
+ * line is invalidated, the vector goes back to the pool. The gap between
+ * the two thresholds keeps a line hovering around the pointer count from
+ * switching back and forth on every request.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <hybrid_directory.h>
+
+/**
+ * @brief Initialize the directory
+ *
+ * @param numLines          initial capacity, the slice grows past it
+ * @return void*
+ */
+static void* initializeDirectory(int numLines) {
+    hybrid_directory_t* dir = calloc(1, sizeof(hybrid_directory_t));
+    if (dir == NULL) {
+        return NULL;
+    }
+    dir->lines = createLineTable(sizeof(hybrid_directory_entry_t), (size_t)numLines);
+    if (dir->lines == NULL) {
+        free(dir);
+        return NULL;
+    }
+    pthread_mutex_init(&dir->lock, NULL);
+    return dir;
+}
+
+/**
+ * @brief Take a cleared full vector from the pool, growing it if needed
+ *
+ * @param pool
+ * @return int              index of the vector, -1 if out of memory
+ */
+static int takeVector(sharer_vector_pool_t* pool) {
+    if (pool->numFree == 0) {
+        int capacity = pool->capacity ? 2 * pool->capacity : HYBRID_INITIAL_VECTORS;
+        sharer_set_t* vectors = realloc(pool->vectors, capacity * sizeof(sharer_set_t));
+        if (vectors == NULL) {
+            return -1;
+        }
+        pool->vectors = vectors;
+        int* freeList = realloc(pool->freeList, capacity * sizeof(int));
+        if (freeList == NULL) {
+            return -1;
+        }
+        pool->freeList = freeList;
+        // Hand out the lowest new index first
+        for (int i = capacity - 1; i >= pool->capacity; i--) {
+            pool->freeList[pool->numFree++] = i;
+        }
+        pool->capacity = capacity;
+    }
+    int index = pool->freeList[--pool->numFree];
+    sharerSetClear(&pool->vectors[index]);
+    pool->inUse++;
+    if (pool->inUse > pool->peak) {
+        pool->peak = pool->inUse;
+    }
+    return index;
+}
+
+/**
+ * @brief Give a full vector back to the pool
+ *
+ * @param pool
+ * @param index
+ */
+static void releaseVector(sharer_vector_pool_t* pool, int index) {
+    pool->freeList[pool->numFree++] = index;
+    pool->inUse--;
+}
+
+/**
+ * @brief Helper function to find the directory entry for a given block
+ *
+ * @param directory
+ * @param block
+ * @return hybrid_directory_entry_t*  NULL if no cache holds the block
+ */
+static hybrid_directory_entry_t* directoryEntry(hybrid_directory_t* directory, unsigned long block) {
+    return lineTableFind(directory->lines, block);
+}
+
+/**
+ * @brief Find the directory entry for a given block, creating an uncached one
+ *
+ * @param directory
+ * @param block
+ * @return hybrid_directory_entry_t*  NULL if out of memory
+ */
+static hybrid_directory_entry_t* claimEntry(hybrid_directory_t* directory, unsigned long block) {
+    bool created;
+    hybrid_directory_entry_t* entry = lineTableInsert(directory->lines, block, &created);
+    if (entry != NULL && created) {
+        entry->state = DIR_UNCACHED;
+        entry->owner = -1;
+        entry->numSharedBy = 0;
+        entry->vector = -1;
+        for (int i = 0; i < HYBRID_POINTERS; i++) {
+            entry->nodes[i] = -1;
+        }
+    }
+    return entry;
+}
+
+/**
+ * @brief Drop the entry for a block, returning its full vector to the pool
+ *
+ * @param directory
+ * @param block
+ */
+static void removeEntry(hybrid_directory_t* directory, unsigned long block) {
+    hybrid_directory_entry_t* entry = directoryEntry(directory, block);
+    if (entry == NULL) {
+        return;
+    }
+    if (entry->vector >= 0) {
+        releaseVector(&directory->pool, entry->vector);
+        directory->demotions++;
+    }
+    lineTableRemove(directory->lines, block);
+}
+
+/**
+ * @brief Collect the sharers of an entry, whichever way it holds them
+ *
+ * @param directory
+ * @param entry             may be NULL
+ * @param sharers           filled in
+ */
+static void entrySharers(const hybrid_directory_t* directory, const hybrid_directory_entry_t* entry,
+                         sharer_set_t* sharers) {
+    sharerSetClear(sharers);
+    if (entry == NULL) {
+        return;
+    }
+    if (entry->vector >= 0) {
+        *sharers = directory->pool.vectors[entry->vector];
+        return;
+    }
+    for (int i = 0; i < entry->numSharedBy; i++) {
+        sharerSetAdd(sharers, entry->nodes[i]);
+    }
+}
+
+/**
+ * @brief Move the sharers of an entry from its pointers to a full vector
+ *
+ * @param directory
+ * @param entry
+ * @return bool             false if the pool could not grow
+ */
+static bool promoteEntry(hybrid_directory_t* directory, hybrid_directory_entry_t* entry) {
+    int index = takeVector(&directory->pool);
+    if (index < 0) {
+        return false;
+    }
+    for (int i = 0; i < entry->numSharedBy; i++) {
+        sharerSetAdd(&directory->pool.vectors[index], entry->nodes[i]);
+        entry->nodes[i] = -1;
+    }
+    entry->vector = index;
+    directory->promotions++;
+    return true;
+}
+
+/**
+ * @brief Move the sharers of an entry from its full vector back to pointers
+ *
+ * @param directory
+ * @param entry             must have at most HYBRID_POINTERS sharers
+ */
+static void demoteEntry(hybrid_directory_t* directory, hybrid_directory_entry_t* entry) {
+    const sharer_set_t* vector = &directory->pool.vectors[entry->vector];
+    int kept = 0;
+    for (int i = 0; i < NUM_PROCESSORS && kept < entry->numSharedBy; i++) {
+        if (sharerSetHas(vector, i)) {
+            entry->nodes[kept++] = i;
+        }
+    }
+    releaseVector(&directory->pool, entry->vector);
+    entry->vector = -1;
+    directory->demotions++;
+}
+
+/**
+ * @brief Get the state and owner of the directory entry for a given block
+ *
+ * @param dir
+ * @param block
+ * @param owner             filled in with the owner, -1 if none
+ * @return directory_state
+ */
+static directory_state getDirectoryState(void* dir, unsigned long block, int* owner) {
+    hybrid_directory_t* directory = dir;
+    pthread_mutex_lock(&directory->lock);
+    hybrid_directory_entry_t* entry = directoryEntry(directory, block);
+    directory_state state = entry != NULL ? entry->state : DIR_UNCACHED;
+    if (owner != NULL) {
+        *owner = entry != NULL ? entry->owner : -1;
+    }
+    pthread_mutex_unlock(&directory->lock);
+    return state;
+}
+
+/**
+ * @brief Get the processors the pointers or the full vector name
+ *
+ * @param dir
+ * @param block
+ * @param sharers
+ */
+static void getSharers(void* dir, unsigned long block, sharer_set_t* sharers) {
+    hybrid_directory_t* directory = dir;
+    pthread_mutex_lock(&directory->lock);
+    entrySharers(directory, directoryEntry(directory, block), sharers);
+    pthread_mutex_unlock(&directory->lock);
+}
+
+/**
+ * @brief Update the directory entry for a given block
+ *
+ * @param dir
+ * @param block
+ * @param processorId
+ * @param newState
+ */
+static void updateDirectoryEntry(void* dir, unsigned long block, int processorId, directory_state newState) {
+    hybrid_directory_t* directory = dir;
+    pthread_mutex_lock(&directory->lock);
+    if (newState == DIR_UNCACHED) {
+        removeEntry(directory, block);
+    } else {
+        hybrid_directory_entry_t* entry = claimEntry(directory, block);
+        if (entry != NULL) {
+            entry->state = newState;
+            entry->owner = (newState == DIR_EXCLUSIVE_MODIFIED || newState == DIR_OWNED) ? processorId : -1;
+        }
+    }
+    pthread_mutex_unlock(&directory->lock);
+}
+
+/**
+ * @brief Invalidate the directory entry for a given block
+ *
+ * @param dir
+ * @param block
+ */
+static void invalidateDirectoryEntry(void* dir, unsigned long block) {
+    hybrid_directory_t* directory = dir;
+    pthread_mutex_lock(&directory->lock);
+    removeEntry(directory, block);
+    pthread_mutex_unlock(&directory->lock);
+}
+
+/**
+ * @brief Add a processor to the directory entry, promoting it when its
+ *        pointers are full
+ *
+ * Should the pool fail to grow, the oldest sharer other than the owner
+ * loses its pointer as in the limited pointer scheme, and the caller must
+ * invalidate its copy.
+ *
+ * @param dir
+ * @param block
+ * @param processorId
+ * @return int              sharer that lost its pointer, -1 if none
+ */
+static int addProcessorToEntry(void* dir, unsigned long block, int processorId) {
+    hybrid_directory_t* directory = dir;
+    int evicted = -1;
+    pthread_mutex_lock(&directory->lock);
+    hybrid_directory_entry_t* entry = claimEntry(directory, block);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&directory->lock);
+        return -1;
+    }
+    sharer_set_t sharers;
+    entrySharers(directory, entry, &sharers);
+    if (sharerSetHas(&sharers, processorId)) {
+        pthread_mutex_unlock(&directory->lock);
+        return -1;
+    }
+    if (entry->vector < 0 && entry->numSharedBy == HYBRID_POINTERS &&
+        !promoteEntry(directory, entry)) {
+        int victim = (entry->nodes[0] == entry->owner) ? 1 : 0;
+        evicted = entry->nodes[victim];
+        for (int i = victim + 1; i < HYBRID_POINTERS; i++) {
+            entry->nodes[i - 1] = entry->nodes[i];
+        }
+        entry->numSharedBy--;
+    }
+    if (entry->vector >= 0) {
+        sharerSetAdd(&directory->pool.vectors[entry->vector], processorId);
+    } else {
+        entry->nodes[entry->numSharedBy] = processorId;
+    }
+    entry->numSharedBy++;
+    pthread_mutex_unlock(&directory->lock);
+    return evicted;
+}
+
+/**
+ * @brief Remove a processor from the directory entry
+ *
+ * A promoted entry is demoted once few enough sharers are left, and the
+ * entry is dropped once none is.
+ *
+ * @param dir
+ * @param block
+ * @param processorId
+ */
+static void removeProcessorFromEntry(void* dir, unsigned long block, int processorId) {
+    hybrid_directory_t* directory = dir;
+    pthread_mutex_lock(&directory->lock);
+    hybrid_directory_entry_t* entry = directoryEntry(directory, block);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&directory->lock);
+        return;
+    }
+    if (entry->vector >= 0) {
+        sharer_set_t* vector = &directory->pool.vectors[entry->vector];
+        if (sharerSetHas(vector, processorId)) {
+            sharerSetRemove(vector, processorId);
+            entry->numSharedBy--;
+        }
+    } else {
+        int kept = 0;
+        for (int i = 0; i < entry->numSharedBy; i++) {
+            if (entry->nodes[i] != processorId) {
+                entry->nodes[kept++] = entry->nodes[i];
+            }
+        }
+        for (int i = kept; i < entry->numSharedBy; i++) {
+            entry->nodes[i] = -1;
+        }
+        entry->numSharedBy = kept;
+    }
+    if (entry->owner == processorId) {
+        // The owner's copy is gone; any remaining sharers hold clean copies
+        entry->owner = -1;
+        entry->state = DIR_SHARED;
+    }
+    if (entry->numSharedBy == 0) {
+        removeEntry(directory, block);
+    } else if (entry->vector >= 0 && entry->numSharedBy <= HYBRID_DEMOTE_SHARERS) {
+        demoteEntry(directory, entry);
+    }
+    pthread_mutex_unlock(&directory->lock);
+}
+
+/**
+ * @brief Check that the entry for a block is well formed
+ *
+ * On top of the state rules of the full bit vector scheme, an entry using
+ * pointers must name distinct processors with the unused ones -1, and a
+ * promoted entry must own a vector of the pool whose count matches and
+ * leave its pointers unused.
+ *
+ * @param dir
+ * @param block
+ * @param processorId       processor that must be listed, -1 for none
+ * @return bool             false if the entry breaks an invariant
+ */
+static bool checkCacheConsistency(void* dir, unsigned long block, int processorId) {
+    hybrid_directory_t* directory = dir;
+    bool consistent = true;
+    pthread_mutex_lock(&directory->lock);
+    hybrid_directory_entry_t* entry = directoryEntry(directory, block);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&directory->lock);
+        return processorId < 0;
+    }
+    sharer_set_t sharers;
+    sharerSetClear(&sharers);
+    if (entry->vector >= 0) {
+        if (entry->vector >= directory->pool.capacity) {
+            pthread_mutex_unlock(&directory->lock);
+            return false;
+        }
+        sharers = directory->pool.vectors[entry->vector];
+        consistent = sharerSetCount(&sharers) == entry->numSharedBy &&
+                     entry->numSharedBy > HYBRID_DEMOTE_SHARERS;
+        for (int i = 0; i < HYBRID_POINTERS; i++) {
+            consistent = consistent && entry->nodes[i] == -1;
+        }
+    } else {
+        if (entry->numSharedBy < 1 || entry->numSharedBy > HYBRID_POINTERS) {
+            pthread_mutex_unlock(&directory->lock);
+            return false;
+        }
+        for (int i = 0; i < HYBRID_POINTERS; i++) {
+            int node = entry->nodes[i];
+            if (i >= entry->numSharedBy) {
+                consistent = consistent && node == -1;
+            } else if (node < 0 || node >= NUM_PROCESSORS || sharerSetHas(&sharers, node)) {
+                consistent = false;
+            } else {
+                sharerSetAdd(&sharers, node);
+            }
+        }
+    }
+    bool ownerListed = entry->owner >= 0 && entry->owner < NUM_PROCESSORS &&
+                       sharerSetHas(&sharers, entry->owner);
+    switch (entry->state) {
+        case DIR_SHARED:
+            consistent = consistent && entry->owner == -1;
+            break;
+        case DIR_EXCLUSIVE_MODIFIED:
+            consistent = consistent && entry->numSharedBy == 1 && ownerListed;
+            break;
+        case DIR_OWNED:
+            consistent = consistent && ownerListed;
+            break;
+        default:
+            consistent = false;
+            break;
+    }
+    if (processorId >= 0 && !sharerSetHas(&sharers, processorId)) {
+        consistent = false;
+    }
+    pthread_mutex_unlock(&directory->lock);
+    return consistent;
+}
+
+/**
+ * @brief Report the occupancy of the entry table
+ *
+ * @param dir
+ * @param stats
+ */
+static void getTableStats(void* dir, line_table_stats_t* stats) {
+    hybrid_directory_t* directory = dir;
+    pthread_mutex_lock(&directory->lock);
+    lineTableStats(directory->lines, stats);
+    pthread_mutex_unlock(&directory->lock);
+}
+
+/**
+ * @brief Directory visitor passed through lineTableForEach
+ *
+ */
+typedef struct {
+    hybrid_directory_t* directory;
+    directory_visit_fn visit;
+    void* arg;
+} line_visitor_t;
+
+/**
+ * @brief Hand one entry to the directory visitor
+ *
+ * @param arg               line_visitor_t
+ * @param block
+ * @param entry
+ */
+static void visitEntry(void* arg, unsigned long block, void* entry) {
+    line_visitor_t* visitor = arg;
+    hybrid_directory_entry_t* e = entry;
+    sharer_set_t sharers;
+    entrySharers(visitor->directory, e, &sharers);
+    visitor->visit(visitor->arg, block, e->state, e->owner, &sharers);
+}
+
+/**
+ * @brief Visit every line some cache holds
+ *
+ * @param dir
+ * @param visit
+ * @param arg
+ */
+static void forEachLine(void* dir, directory_visit_fn visit, void* arg) {
+    hybrid_directory_t* directory = dir;
+    line_visitor_t visitor = { directory, visit, arg };
+    pthread_mutex_lock(&directory->lock);
+    lineTableForEach(directory->lines, visitEntry, &visitor);
+    pthread_mutex_unlock(&directory->lock);
+}
+
+/**
+ * @brief Print the promotions, demotions and memory of the two representations
+ *
+ * Memory is what the simulator holds: the entry table's slots and the
+ * pool's vectors, allocated or at their peak use.
+ *
+ * @param dir
+ * @param homeId
+ */
+static void printRepresentation(void* dir, int homeId) {
+    hybrid_directory_t* directory = dir;
+    pthread_mutex_lock(&directory->lock);
+    line_table_stats_t stats;
+    lineTableStats(directory->lines, &stats);
+    const sharer_vector_pool_t* pool = &directory->pool;
+    printf("Directory %d representation: promotions: %lu, demotions: %lu, full vectors: "
+           "%d in use, %d peak, memory: %.2f KB of pointer entries, %.2f KB of full vectors "
+           "(%.2f KB at the peak)\n",
+           homeId, directory->promotions, directory->demotions, pool->inUse, pool->peak,
+           stats.slots * sizeof(hybrid_directory_entry_t) / 1024.0,
+           pool->capacity * sizeof(sharer_set_t) / 1024.0,
+           pool->peak * sizeof(sharer_set_t) / 1024.0);
+    pthread_mutex_unlock(&directory->lock);
+}
+
+/**
+ * @brief Free the directory
+ *
+ * @param directory
+ */
+static void freeDirectory(void* directory) {
+    hybrid_directory_t* dir = directory;
+    if (dir != NULL) {
+        freeLineTable(dir->lines);
+        free(dir->pool.vectors);
+        free(dir->pool.freeList);
+        pthread_mutex_destroy(&dir->lock);
+        free(dir);
+    }
+}
+
+/**
+ * @brief Hardware bits of an entry: state, a representation bit,
+ *        HYBRID_POINTERS sharer pointers, their count and an owner pointer
+ *
+ * A promoted entry keeps its pool index in the pointer bits; the full
+ * vectors in the pool are numProcessors bits each on top of this.
+ *
+ * @param numProcessors
+ * @return unsigned int
+ */
+static unsigned int entryBits(int numProcessors) {
+    unsigned int pointerBits = processorIdBits(numProcessors);
+    return DIRECTORY_STATE_BITS + 1 + HYBRID_POINTERS * pointerBits +
+           processorIdBits(numProcessors + 1) + pointerBits;
+}
+
+/** @brief Hybrid directory, HYBRID_POINTERS pointers promoted to a full vector */
+const directory_ops_t hybridDirectoryOps = {
+    .name = "hybrid",
+    .create = initializeDirectory,
+    .destroy = freeDirectory,
+    .getState = getDirectoryState,
+    .getSharers = getSharers,
+    .setState = updateDirectoryEntry,
+    .addSharer = addProcessorToEntry,
+    .removeSharer = removeProcessorFromEntry,
+    .invalidate = invalidateDirectoryEntry,
+    .checkConsistency = checkCacheConsistency,
+    .tableStats = getTableStats,
+    .forEachLine = forEachLine,
+    .entryBits = entryBits,
+    .printStats = printRepresentation,
+};
@@ -1,83 +1,86 @@
 /**
  * @file interconnect.c
- * @brief 
+ * @brief Point-to-point network between the processors and home nodes.
+ *
+ * Messages are delivered synchronously: sending a message runs the
+ * destination's handler before returning, so a whole coherence transaction
+ * completes inside the access that started it. When snooping, the
+ * requests caches send to home nodes go on the bus instead.
  */
-#include <interconnect.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interconnect.h"
 #include "processor.h"
-
-interconnect_t interconnects[NUM_PROCESSORS];
+#include "snoop_bus.h"
 
 /**
- * @brief 
- * 
- * @param interconnect 
- * @param message 
+ * @brief Create the interconnect
+ *
+ * @param processors        nodes attached to the interconnect
+ * @param numNodes          number of nodes
+ * @return interconnect_t*
  */
-void interconnectSendMessage(interconnect_t *interconnect, message_t message) {
-   if (interconnect == NULL || interconnect->queue == NULL) return;
-
-   pthread_mutex_lock(&interconnect->mutex);
-
-   // Copy the message into dynamically allocated memory
-   message_t *messageCopy = (message_t *)malloc(sizeof(message_t));
-   if (!messageCopy) {
-      pthread_mutex_unlock(&interconnect->mutex);
-      return; // Memory allocation failure
-   }
-   *messageCopy = message;
-
-   // Enqueue the message copy
-   // enqueue(interconnect->queue, messageCopy);
-
-   pthread_mutex_unlock(&interconnect->mutex);
-
-   processMessage(processors[message->destId], message);
+interconnect_t *createInterconnect(struct processor *processors, int numNodes) {
+   interconnect_t *interconnect = malloc(sizeof(interconnect_t));
+   if (interconnect == NULL) return NULL;
+
+   interconnect->processors = processors;
+   interconnect->numNodes = numNodes;
+   interconnect->bus = NULL;
+   memset(interconnect->messageCount, 0, sizeof(interconnect->messageCount));
+   interconnect->localMessages = 0;
+   interconnect->remoteMessages = 0;
+   interconnect->hopCycles = 0;
+   interconnect->headerBytes = 0;
+   interconnect->dataBytes = 0;
+   pthread_mutex_init(&interconnect->mutex, NULL);
+   return interconnect;
 }
 
 /**
- * @brief 
- * 
- * @param arg 
- * @return void* 
+ * @brief Send a message and deliver it to its destination
+ *
+ * A message that crosses the network arrives HOP_CYCLES later than it
+ * was sent; a message to the sender's own node is free.
+ *
+ * @param interconnect
+ * @param message
  */
-void *interconnectProcessMessages(void *arg) {
-   interconnect_t *interconnect = (interconnect_t *)arg;
-   if (interconnect == NULL || interconnect->queue == NULL) return;
-
-   while (true) { // Replace with a condition to stop the thread
-      pthread_mutex_lock(&interconnect->mutex);
-
-      if (isQueueEmpty(interconnect->queue)) {
-         pthread_mutex_unlock(&interconnect->mutex);
-         continue; // Consider adding a wait condition here
-      }
-
-      message_t *message = (message_t *)dequeue(interconnect->queue);
-      pthread_mutex_unlock(&interconnect->mutex);
-
-      if (message) {
-            // Process the message
-            // e.g., if (message->type == READ_REQUEST) { ... }
+void interconnectSendMessage(interconnect_t *interconnect, message_t message) {
+   if (interconnect == NULL) return;
+   if (interconnect->bus != NULL) {
+      busTransaction(interconnect->bus, &message);
+      return;
+   }
 
-         free(message); // Free the dequeued message
-      }
+   pthread_mutex_lock(&interconnect->mutex);
+   interconnect->messageCount[message.type]++;
+   if (message.sourceId == message.destId) {
+      interconnect->localMessages++;
+   } else {
+      interconnect->remoteMessages++;
+      interconnect->hopCycles += HOP_CYCLES;
+      interconnect->headerBytes += MESSAGE_HEADER_BYTES;
+      interconnect->dataBytes += message.dataBytes;
+      message.latency += HOP_CYCLES;
    }
+   pthread_mutex_unlock(&interconnect->mutex);
 
-   return NULL;
+   processMessage(&interconnect->processors[message.destId], &message);
 }
 
 /**
- * @brief 
- * 
- * @param source 
- * @param message 
- * @param interconnect 
- * @return int 
+ * @brief
+ *
+ * @param source
+ * @param message
+ * @param interconnect
+ * @return int
  */
 int broadcastMessage(int source, message_t message, interconnect_t *interconnect) {
    if (!interconnect) return -1;
 
-   for (int i = 0; i < NUM_PROCESSORS; ++i) {
+   for (int i = 0; i < interconnect->numNodes; ++i) {
       if (i == source) continue; // Skip the source processor
 
       message_t newMessage = message;
@@ -90,43 +93,91 @@ int broadcastMessage(int source, message_t message, interconnect_t *interconnect
    return 0;
 }
 
+/**
+ * @brief Total number of messages sent
+ *
+ * @param interconnect
+ * @return unsigned long
+ */
+unsigned long interconnectTotalMessages(const interconnect_t *interconnect) {
+   return interconnect->localMessages + interconnect->remoteMessages;
+}
 
-// Function to connect cache to interconnect
 /**
- * @brief 
- * 
- * @param cache 
- * @param interconnect 
+ * @brief Bytes that crossed the network, headers and data
+ *
+ * @param interconnect
+ * @return unsigned long
  */
-void connectCacheToInterconnect(cache_t* cache, interconnect_t* interconnect) {
-    if (cache != NULL) {
-        cache->interconnect = interconnect;
-    }
+unsigned long interconnectTotalBytes(const interconnect_t *interconnect) {
+   return interconnect->headerBytes + interconnect->dataBytes;
 }
 
-// Function to connect interconnect to directory
 /**
- * @brief 
- * 
- * @param interconnect 
- * @param directory 
+ * @brief Whether a message of this type normally carries the line's data
+ *
+ * A WRITE_ACKNOWLEDGE to a requester that already holds the line is the
+ * exception; its sender clears the data itself. A WRITE_THROUGH carries
+ * only the words its stores wrote, which its sender sizes.
+ *
+ * @param type
+ * @return bool
  */
-void connectInterconnectToDirectory(interconnect_t* interconnect, directory_t* directory) {
-    if (directory != NULL) {
-        directory->interconnect = interconnect;
-    }
+bool messageCarriesData(message_type type) {
+   switch (type) {
+      case READ_ACKNOWLEDGE:
+      case EXCLUSIVE_ACKNOWLEDGE:
+      case WRITE_ACKNOWLEDGE:
+      case WRITE_UPDATE:
+      case UPDATE:
+      case SHARING_WRITEBACK:
+      case DATA_REPLY:
+      case WRITE_THROUGH:
+         return true;
+      default:
+         return false;
+   }
+}
+
+/**
+ * @brief Name of a message type, for reports
+ *
+ * @param type
+ * @return const char*
+ */
+const char *messageTypeName(message_type type) {
+   switch (type) {
+      case READ_REQUEST:      return "READ_REQUEST";
+      case READ_ACKNOWLEDGE:  return "READ_ACKNOWLEDGE";
+      case INVALIDATE:        return "INVALIDATE";
+      case INVALIDATE_ACK:    return "INVALIDATE_ACK";
+      case WRITE_REQUEST:     return "WRITE_REQUEST";
+      case WRITE_UPDATE:      return "WRITE_UPDATE";
+      case WRITE_ACKNOWLEDGE: return "WRITE_ACKNOWLEDGE";
+      case UPDATE:            return "UPDATE";
+      case FETCH:             return "FETCH";
+      case EVICTION_NOTICE:   return "EVICTION_NOTICE";
+      case FORWARD_READ:      return "FORWARD_READ";
+      case FORWARD_WRITE:     return "FORWARD_WRITE";
+      case SHARING_WRITEBACK: return "SHARING_WRITEBACK";
+      case OWNERSHIP_TRANSFER: return "OWNERSHIP_TRANSFER";
+      case NACK:              return "NACK";
+      case EXCLUSIVE_ACKNOWLEDGE: return "EXCLUSIVE_ACKNOWLEDGE";
+      case DATA_REPLY:        return "DATA_REPLY";
+      case OWNED_ACK:         return "OWNED_ACK";
+      case WRITE_THROUGH:     return "WRITE_THROUGH";
+      case WRITE_THROUGH_ACK: return "WRITE_THROUGH_ACK";
+      default:                return "UNKNOWN";
+   }
 }
 
 /**
- * @brief 
- * 
- * @param interconnect 
+ * @brief
+ *
+ * @param interconnect
  */
 void freeInterconnect(interconnect_t *interconnect) {
     if (interconnect != NULL) {
-        if (interconnect->queue != NULL) {
-            freeQueue(interconnect->queue);
-        }
         pthread_mutex_destroy(&interconnect->mutex);
         free(interconnect);
     }
@@ -0,0 +1,753 @@
+/**
+ * @file interleave.c
+ * @brief Interleaving of the processors' access streams, its record and
+ *        replay, and the spread of results across interleavings.
+ *
+ * Every mode issues records through systemAccess one at a time, so the
+ * simulated machine is the same whichever thread drives it; only the order
+ * differs. The threaded mode serializes its threads on one lock and takes
+ * the order they acquire it in, which changes from run to run. The seeded
+ * mode is what those threads would do if each home node granted its
+ * requests in a fixed pseudo-random order: the processor with the earliest
+ * clock is due next, and every processor within INTERLEAVE_WINDOW_CYCLES
+ * of it whose next access goes to the same home contends with it there.
+ *
+ * The log is a header followed by one varint per run of consecutive
+ * records by one processor, (length - 1) * processors + processor, so a
+ * run costs a byte or two however the interleaving was produced.
+ */
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interleave.h"
+#include "trace_pipeline.h"
+
+/**
+ * @brief Header of an interleaving log
+ *
+ */
+typedef struct interleave_log_header {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int numProcessors;
+    unsigned int reserved;
+    unsigned long records;              // Records in the trace, dropped ones included
+    unsigned long traceHash;            // processor_streams_t hash of the trace
+    unsigned long runs;
+} interleave_log_header_t;
+
+/**
+ * @brief Key metrics compared across seeds
+ *
+ */
+typedef enum {
+    METRIC_CYCLES,
+    METRIC_MESSAGES,
+    METRIC_NETWORK_BYTES,
+    METRIC_MISSES,
+    METRIC_INVALIDATIONS,
+    METRIC_MISS_LATENCY,
+    NUM_VARIANCE_METRICS
+} variance_metric;
+
+/** @brief Names of the variance metrics, in variance_metric order */
+static const char *const metricNames[NUM_VARIANCE_METRICS] = {
+    "cycles", "messages", "network bytes", "misses", "invalidations", "miss latency",
+};
+
+/**
+ * @brief Parse "trace", "threads[:<runs>]" or "seeded[:<seeds>]".
+ *
+ * Seeds are separated by commas and may be ranges, as in "seeded:1-8" or
+ * "seeded:3,7,11".
+ *
+ * @param text
+ * @param config            mode and seeds filled in on success
+ * @return bool             false if the text is malformed
+ */
+bool parseInterleaveMode(const char *text, interleave_config_t *config) {
+    const char *colon = strchr(text, ':');
+    size_t nameLength = colon != NULL ? (size_t)(colon - text) : strlen(text);
+    config->numSeeds = 0;
+    if (strncmp(text, "trace", nameLength) == 0 && nameLength == 5 && colon == NULL) {
+        config->mode = INTERLEAVE_TRACE;
+    } else if (strncmp(text, "threads", nameLength) == 0 && nameLength == 7) {
+        config->mode = INTERLEAVE_THREADS;
+        long runs = colon != NULL ? strtol(colon + 1, NULL, 10) : 1;
+        if (runs < 1 || runs > MAX_INTERLEAVE_SEEDS) {
+            return false;
+        }
+        for (long i = 0; i < runs; i++) {
+            config->seeds[config->numSeeds++] = (unsigned long)(i + 1);
+        }
+        return true;
+    } else if (strncmp(text, "seeded", nameLength) == 0 && nameLength == 6) {
+        config->mode = INTERLEAVE_SEEDED;
+    } else {
+        return false;
+    }
+    if (colon == NULL) {
+        config->seeds[config->numSeeds++] = 1;
+        return true;
+    }
+    const char *cursor = colon + 1;
+    while (true) {
+        char *end;
+        unsigned long first = strtoul(cursor, &end, 10);
+        unsigned long last = first;
+        if (end == cursor) {
+            return false;
+        }
+        if (*end == '-') {
+            cursor = end + 1;
+            last = strtoul(cursor, &end, 10);
+            if (end == cursor || last < first) {
+                return false;
+            }
+        }
+        for (unsigned long seed = first; seed <= last; seed++) {
+            if (config->numSeeds == MAX_INTERLEAVE_SEEDS) {
+                return false;
+            }
+            config->seeds[config->numSeeds++] = seed;
+        }
+        if (*end == '\0') {
+            return true;
+        }
+        if (*end != ',') {
+            return false;
+        }
+        cursor = end + 1;
+    }
+}
+
+/**
+ * @brief Append records to the growing array of a trace
+ *
+ * @param streams
+ * @param capacity          records the array has room for, updated
+ * @param records
+ * @param count
+ * @return bool             false if out of memory
+ */
+static bool appendRecords(processor_streams_t *streams, unsigned long *capacity,
+                          const access_t *records, size_t count) {
+    if (streams->count + count > *capacity) {
+        unsigned long grown = *capacity ? *capacity : TRACE_CHUNK_RECORDS;
+        while (grown < streams->count + count) {
+            grown *= 2;
+        }
+        access_t *larger = realloc(streams->records, grown * sizeof(access_t));
+        if (larger == NULL) {
+            return false;
+        }
+        streams->records = larger;
+        *capacity = grown;
+    }
+    memcpy(&streams->records[streams->count], records, count * sizeof(access_t));
+    streams->count += count;
+    return true;
+}
+
+/**
+ * @brief Read every record of a trace or workload into memory
+ *
+ * @param streams
+ * @param input             open trace, or NULL to use the workload
+ * @param workload
+ * @return bool             false if the trace could not be read or held
+ */
+static bool readAllRecords(processor_streams_t *streams, trace_input_t *input,
+                           workload_t *workload) {
+    unsigned long capacity = 0;
+    trace_pipeline_t *pipeline = input != NULL ? startTracePipeline(input, 1) : NULL;
+    if (pipeline != NULL) {
+        bool ok = true;
+        record_batch_t *batch;
+        while ((batch = nextBatch(pipeline)) != NULL) {
+            ok = ok && appendRecords(streams, &capacity, batch->records, batch->count);
+            releaseBatch(pipeline, batch);
+        }
+        return stopTracePipeline(pipeline, NULL) && ok;
+    }
+    if (input != NULL && input->compression != TRACE_PLAIN) {
+        return false;
+    }
+
+    access_t *chunk = malloc(TRACE_CHUNK_RECORDS * sizeof(access_t));
+    if (chunk == NULL) {
+        return false;
+    }
+    bool ok = true;
+    size_t count;
+    while (ok && (count = input != NULL
+                              ? decodeTraceChunk(input->file, chunk, TRACE_CHUNK_RECORDS)
+                              : generateAccesses(workload, chunk, TRACE_CHUNK_RECORDS)) > 0) {
+        ok = appendRecords(streams, &capacity, chunk, count);
+    }
+    free(chunk);
+    return ok;
+}
+
+/**
+ * @brief Read a whole trace or workload and split it into one stream per processor.
+ *
+ * @param input             open trace, or NULL to use the workload
+ * @param workload
+ * @return processor_streams_t*  newly allocated streams, NULL on failure
+ */
+processor_streams_t *loadStreams(trace_input_t *input, workload_t *workload) {
+    processor_streams_t *streams = calloc(1, sizeof(processor_streams_t));
+    if (streams == NULL) {
+        return NULL;
+    }
+    if (!readAllRecords(streams, input, workload)) {
+        freeStreams(streams);
+        return NULL;
+    }
+
+    // FNV-1a over each record's fields
+    streams->hash = 0xcbf29ce484222325UL;
+    for (unsigned long i = 0; i < streams->count; i++) {
+        const access_t *record = &streams->records[i];
+        unsigned long fields[3] = { (unsigned long)record->processorId,
+                                    (unsigned long)record->type, record->address };
+        for (int f = 0; f < 3; f++) {
+            streams->hash = (streams->hash ^ fields[f]) * 0x100000001b3UL;
+        }
+        if (record->processorId < 0 || record->processorId >= NUM_PROCESSORS) {
+            streams->stray++;
+        } else {
+            streams->lengths[record->processorId]++;
+        }
+    }
+    for (int p = 0; p < NUM_PROCESSORS; p++) {
+        streams->positions[p] = malloc((streams->lengths[p] ? streams->lengths[p] : 1) *
+                                       sizeof(unsigned long));
+        if (streams->positions[p] == NULL) {
+            freeStreams(streams);
+            return NULL;
+        }
+        streams->lengths[p] = 0;
+    }
+    for (unsigned long i = 0; i < streams->count; i++) {
+        int p = streams->records[i].processorId;
+        if (p >= 0 && p < NUM_PROCESSORS) {
+            streams->positions[p][streams->lengths[p]++] = i;
+        }
+    }
+    return streams;
+}
+
+/**
+ * @brief One interleaved run of a system in progress
+ *
+ */
+typedef struct interleave_state {
+    const processor_streams_t *streams;
+    system_t *sys;
+    int numProcessors;
+    unsigned long next[NUM_PROCESSORS];     // Position in each processor's stream
+    unsigned long remaining;                // Records still to issue
+
+    int runProcessor;                       // Processor of the run in progress, -1 before any
+    unsigned long runLength;
+    FILE *log;                              // Recording to, NULL if not recording
+    bool logFailed;
+    interleave_run_t *run;
+
+    pthread_mutex_t lock;                   // Threaded mode: one access at a time
+} interleave_state_t;
+
+/**
+ * @brief Write an unsigned LEB128 varint
+ *
+ * @param out
+ * @param value
+ * @return bool
+ */
+static bool writeVarint(FILE *out, unsigned long value) {
+    do {
+        int byte = value & 0x7f;
+        value >>= 7;
+        if (putc(value ? byte | 0x80 : byte, out) == EOF) {
+            return false;
+        }
+    } while (value != 0);
+    return true;
+}
+
+/**
+ * @brief Read an unsigned LEB128 varint
+ *
+ * @param in
+ * @param value             filled in
+ * @return bool             false at the end of the log or if it is truncated
+ */
+static bool readVarint(FILE *in, unsigned long *value) {
+    *value = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        int byte = getc(in);
+        if (byte == EOF) {
+            return false;
+        }
+        *value |= (unsigned long)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Close the run in progress, writing it to the log if recording
+ *
+ * @param state
+ */
+static void endRun(interleave_state_t *state) {
+    if (state->runProcessor < 0) {
+        return;
+    }
+    state->run->runs++;
+    if (state->log != NULL &&
+        !writeVarint(state->log, (state->runLength - 1) * state->numProcessors +
+                                     state->runProcessor)) {
+        state->logFailed = true;
+    }
+}
+
+/**
+ * @brief Issue the next record of a processor's stream
+ *
+ * @param state
+ * @param processorId       must have records left
+ */
+static void issueNext(interleave_state_t *state, int processorId) {
+    const processor_streams_t *streams = state->streams;
+    systemAccess(state->sys,
+                 &streams->records[streams->positions[processorId][state->next[processorId]++]]);
+    state->remaining--;
+    if (processorId == state->runProcessor) {
+        state->runLength++;
+        return;
+    }
+    endRun(state);
+    state->runProcessor = processorId;
+    state->runLength = 1;
+}
+
+/**
+ * @brief Next record of a processor's stream
+ *
+ * @param state
+ * @param processorId       must have records left
+ * @return const access_t*
+ */
+static const access_t *nextRecord(const interleave_state_t *state, int processorId) {
+    const processor_streams_t *streams = state->streams;
+    return &streams->records[streams->positions[processorId][state->next[processorId]]];
+}
+
+/**
+ * @brief Issue the records in trace order
+ *
+ * @param state
+ */
+static void runTraceOrder(interleave_state_t *state) {
+    const processor_streams_t *streams = state->streams;
+    for (unsigned long i = 0; i < streams->count; i++) {
+        int p = streams->records[i].processorId;
+        if (p >= 0 && p < state->numProcessors) {
+            issueNext(state, p);
+        }
+    }
+}
+
+/**
+ * @brief Thread issuing one processor's stream
+ *
+ */
+typedef struct stream_thread {
+    interleave_state_t *state;
+    int processorId;
+    pthread_t thread;
+} stream_thread_t;
+
+/**
+ * @brief Issue a processor's records one at a time, letting the others in between
+ *
+ * @param arg               stream_thread_t
+ * @return void*
+ */
+static void *issueStream(void *arg) {
+    stream_thread_t *self = arg;
+    interleave_state_t *state = self->state;
+    for (unsigned long i = 0; i < state->streams->lengths[self->processorId]; i++) {
+        pthread_mutex_lock(&state->lock);
+        issueNext(state, self->processorId);
+        pthread_mutex_unlock(&state->lock);
+        sched_yield();
+    }
+    return NULL;
+}
+
+/**
+ * @brief Issue every stream from a thread of its own
+ *
+ * @param state
+ * @return bool             false if the threads could not be started
+ */
+static bool runThreads(interleave_state_t *state) {
+    stream_thread_t threads[NUM_PROCESSORS];
+    int started = 0;
+    pthread_mutex_init(&state->lock, NULL);
+    // Hold the threads back until all of them exist
+    pthread_mutex_lock(&state->lock);
+    for (; started < state->numProcessors; started++) {
+        threads[started].state = state;
+        threads[started].processorId = started;
+        if (pthread_create(&threads[started].thread, NULL, issueStream, &threads[started]) != 0) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&state->lock);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i].thread, NULL);
+    }
+    pthread_mutex_destroy(&state->lock);
+    // Streams whose thread did not start are issued here, after the others
+    for (int p = started; p < state->numProcessors; p++) {
+        while (state->next[p] < state->streams->lengths[p]) {
+            issueNext(state, p);
+        }
+    }
+    return started == state->numProcessors;
+}
+
+/**
+ * @brief Next pseudo-random number of an arbiter (xorshift64*)
+ *
+ * @param arbiter
+ * @return unsigned long
+ */
+static unsigned long nextArbitration(unsigned long *arbiter) {
+    *arbiter ^= *arbiter >> 12;
+    *arbiter ^= *arbiter << 25;
+    *arbiter ^= *arbiter >> 27;
+    return *arbiter * 0x2545f4914f6cdd1dUL;
+}
+
+/**
+ * @brief Issue the records earliest clock first, arbitrating near ties at each home
+ *
+ * @param state
+ * @param seed
+ */
+static void runSeeded(interleave_state_t *state, unsigned long seed) {
+    system_t *sys = state->sys;
+    unsigned long arbiters[NUM_PROCESSORS];
+    for (int h = 0; h < state->numProcessors; h++) {
+        arbiters[h] = (seed + 1) * 0x9e3779b97f4a7c15UL ^ (unsigned long)(h + 1) * 0xbf58476d1ce4e5b9UL;
+        if (arbiters[h] == 0) {
+            arbiters[h] = 0x9e3779b97f4a7c15UL;
+        }
+    }
+
+    while (state->remaining > 0) {
+        int first = -1;
+        unsigned long earliest = 0;
+        for (int p = 0; p < state->numProcessors; p++) {
+            unsigned long clock = sys->processors[p].cache->cycleCount;
+            if (state->next[p] < state->streams->lengths[p] && (first < 0 || clock < earliest)) {
+                first = p;
+                earliest = clock;
+            }
+        }
+        const access_t *access = nextRecord(state, first);
+        // A fence goes to no home and has nothing to contend for
+        if (access->type == ACCESS_FENCE) {
+            issueNext(state, first);
+            continue;
+        }
+        int home = peekHomeNode(sys->homeMap, access->address, first);
+        int candidates[NUM_PROCESSORS];
+        int numCandidates = 0;
+        for (int p = 0; p < state->numProcessors; p++) {
+            if (state->next[p] == state->streams->lengths[p] ||
+                sys->processors[p].cache->cycleCount > earliest + INTERLEAVE_WINDOW_CYCLES) {
+                continue;
+            }
+            const access_t *other = nextRecord(state, p);
+            if (other->type != ACCESS_FENCE &&
+                peekHomeNode(sys->homeMap, other->address, p) == home) {
+                candidates[numCandidates++] = p;
+            }
+        }
+        state->run->arbitrations++;
+        if (numCandidates > 1) {
+            state->run->contested++;
+        }
+        issueNext(state, candidates[(nextArbitration(&arbiters[home]) >> 11) % numCandidates]);
+    }
+}
+
+/**
+ * @brief Issue the runs of a recorded interleaving
+ *
+ * @param state
+ * @param in                log positioned after its header
+ * @param runs              runs the header promises
+ * @return bool             false if the log does not fit the streams
+ */
+static bool runReplay(interleave_state_t *state, FILE *in, unsigned long runs) {
+    for (unsigned long r = 0; r < runs; r++) {
+        unsigned long value;
+        if (!readVarint(in, &value)) {
+            return false;
+        }
+        int p = (int)(value % state->numProcessors);
+        unsigned long length = value / state->numProcessors + 1;
+        if (length > state->streams->lengths[p] - state->next[p]) {
+            return false;
+        }
+        for (unsigned long i = 0; i < length; i++) {
+            issueNext(state, p);
+        }
+    }
+    return state->remaining == 0;
+}
+
+/**
+ * @brief Run a system through its processors' streams.
+ *
+ * Replays the log named in the configuration if there is one, and records
+ * the interleaving to the log named there if asked to. Records naming a
+ * processor the system does not have are dropped up front.
+ *
+ * @param streams
+ * @param sys               freshly created or restored system
+ * @param config
+ * @param seed              seed of the home arbiters in the seeded mode
+ * @param run               filled in
+ * @return bool             false if the log could not be read, written or
+ *                          did not match the trace, or threads failed to start
+ */
+bool runInterleaving(const processor_streams_t *streams, system_t *sys,
+                     const interleave_config_t *config, unsigned long seed,
+                     interleave_run_t *run) {
+    memset(run, 0, sizeof(*run));
+    run->records = streams->count;
+    interleave_state_t state;
+    memset(&state, 0, sizeof(state));
+    state.streams = streams;
+    state.sys = sys;
+    state.numProcessors = sys->config.numProcessors;
+    state.runProcessor = -1;
+    state.run = run;
+    sys->droppedCount += streams->stray;
+    for (int p = 0; p < NUM_PROCESSORS; p++) {
+        if (p < state.numProcessors) {
+            state.remaining += streams->lengths[p];
+        } else {
+            sys->droppedCount += streams->lengths[p];
+        }
+    }
+
+    interleave_log_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = INTERLEAVE_LOG_MAGIC;
+    header.version = INTERLEAVE_LOG_VERSION;
+    header.numProcessors = (unsigned int)state.numProcessors;
+    header.records = streams->count;
+    header.traceHash = streams->hash;
+
+    if (config->replayPath != NULL) {
+        FILE *in = fopen(config->replayPath, "rb");
+        if (in == NULL) {
+            perror(config->replayPath);
+            return false;
+        }
+        interleave_log_header_t recorded;
+        bool ok = fread(&recorded, sizeof(recorded), 1, in) == 1 &&
+                  recorded.magic == header.magic && recorded.version == header.version &&
+                  recorded.numProcessors == header.numProcessors &&
+                  recorded.records == header.records && recorded.traceHash == header.traceHash &&
+                  runReplay(&state, in, recorded.runs);
+        fclose(in);
+        endRun(&state);
+        return ok;
+    }
+
+    if (config->recordPath != NULL) {
+        state.log = fopen(config->recordPath, "wb");
+        if (state.log == NULL) {
+            perror(config->recordPath);
+            return false;
+        }
+        // Rewritten with the number of runs at the end
+        state.logFailed = fwrite(&header, sizeof(header), 1, state.log) != 1;
+    }
+    bool ok = true;
+    switch (config->mode) {
+        case INTERLEAVE_THREADS:
+            ok = runThreads(&state);
+            break;
+        case INTERLEAVE_SEEDED:
+            runSeeded(&state, seed);
+            break;
+        default:
+            runTraceOrder(&state);
+            break;
+    }
+    endRun(&state);
+    if (state.log != NULL) {
+        header.runs = run->runs;
+        run->logBytes = ftell(state.log);
+        state.logFailed |= fseek(state.log, 0, SEEK_SET) != 0 ||
+                           fwrite(&header, sizeof(header), 1, state.log) != 1;
+        state.logFailed |= fclose(state.log) != 0;
+        ok = ok && !state.logFailed;
+    }
+    return ok;
+}
+
+/**
+ * @brief Key metrics of a finished system
+ *
+ * @param sys
+ * @param values            NUM_VARIANCE_METRICS of them, filled in
+ */
+static void collectMetrics(const system_t *sys, double *values) {
+    unsigned long misses = 0, invalidations = 0;
+    for (int i = 0; i < sys->config.numProcessors; i++) {
+        misses += sys->processors[i].cache->missCount;
+        invalidations += sys->processors[i].cache->invalidationCount;
+    }
+    values[METRIC_CYCLES] = (double)machineCycles(sys);
+    values[METRIC_MESSAGES] = (double)interconnectTotalMessages(sys->interconnect);
+    values[METRIC_NETWORK_BYTES] = (double)interconnectTotalBytes(sys->interconnect);
+    values[METRIC_MISSES] = (double)misses;
+    values[METRIC_INVALIDATIONS] = (double)invalidations;
+    values[METRIC_MISS_LATENCY] = averageMissLatency(sys);
+}
+
+/**
+ * @brief Run every system again under each seed after the first.
+ *
+ * The systems themselves are run under the first seed by the caller; each
+ * further seed gets fresh systems of the same configuration, without
+ * interval statistics.
+ *
+ * @param streams
+ * @param systems
+ * @param numSystems
+ * @param config            more than one seed for any variance to measure
+ * @return seed_variance_t* newly allocated, NULL if there is one seed or on failure
+ */
+seed_variance_t *measureSeedVariance(const processor_streams_t *streams, system_t **systems,
+                                     int numSystems, const interleave_config_t *config) {
+    if (config->numSeeds < 2) {
+        return NULL;
+    }
+    seed_variance_t *variance = calloc(1, sizeof(seed_variance_t));
+    if (variance == NULL) {
+        return NULL;
+    }
+    variance->numSystems = numSystems;
+    variance->numSeeds = config->numSeeds;
+    variance->threads = config->mode == INTERLEAVE_THREADS;
+    variance->values = calloc((size_t)numSystems * config->numSeeds * NUM_VARIANCE_METRICS,
+                              sizeof(double));
+    if (variance->values == NULL) {
+        freeSeedVariance(variance);
+        return NULL;
+    }
+
+    interleave_config_t unlogged = *config;
+    unlogged.recordPath = NULL;
+    unlogged.replayPath = NULL;
+    for (int s = 1; s < config->numSeeds; s++) {
+        for (int i = 0; i < numSystems; i++) {
+            system_config_t systemConfig = systems[i]->config;
+            systemConfig.statsPath = NULL;
+            system_t *sys = initializeSystem(&systemConfig);
+            interleave_run_t run;
+            if (sys == NULL || !runInterleaving(streams, sys, &unlogged, config->seeds[s], &run)) {
+                cleanupSystem(sys);
+                freeSeedVariance(variance);
+                return NULL;
+            }
+            finishSystem(sys);
+            collectMetrics(sys, &variance->values[((size_t)i * variance->numSeeds + s) *
+                                                  NUM_VARIANCE_METRICS]);
+            cleanupSystem(sys);
+        }
+    }
+    return variance;
+}
+
+/**
+ * @brief Print the mean and spread of the key metrics of every system.
+ *
+ * @param variance
+ * @param systems           the systems run under the first seed, finished
+ */
+void printSeedVariance(seed_variance_t *variance, system_t **systems) {
+    printf("Variance across %d %s\n", variance->numSeeds,
+           variance->threads ? "threaded runs" : "seeds");
+    printf("%-40s %-14s %16s %14s %8s %16s %16s\n", "system", "metric", "mean", "stddev",
+           "cv %", "min", "max");
+    for (int i = 0; i < variance->numSystems; i++) {
+        double *values = &variance->values[(size_t)i * variance->numSeeds * NUM_VARIANCE_METRICS];
+        collectMetrics(systems[i], values);
+        for (int m = 0; m < NUM_VARIANCE_METRICS; m++) {
+            double sum = 0, min = values[m], max = values[m];
+            for (int s = 0; s < variance->numSeeds; s++) {
+                double value = values[s * NUM_VARIANCE_METRICS + m];
+                sum += value;
+                min = value < min ? value : min;
+                max = value > max ? value : max;
+            }
+            double mean = sum / variance->numSeeds;
+            double squares = 0;
+            for (int s = 0; s < variance->numSeeds; s++) {
+                double deviation = values[s * NUM_VARIANCE_METRICS + m] - mean;
+                squares += deviation * deviation;
+            }
+            double stddev = variance->numSeeds > 1 ? sqrt(squares / (variance->numSeeds - 1)) : 0;
+            printf("%-40s %-14s %16.2f %14.2f %8.3f %16.2f %16.2f\n",
+                   m == 0 ? systems[i]->label : "", metricNames[m], mean, stddev,
+                   mean != 0 ? 100 * stddev / mean : 0.0, min, max);
+        }
+    }
+}
+
+/**
+ * @brief Free the metrics gathered across seeds.
+ *
+ * @param variance
+ */
+void freeSeedVariance(seed_variance_t *variance) {
+    if (variance != NULL) {
+        free(variance->values);
+        free(variance);
+    }
+}
+
+/**
+ * @brief Free the records and streams of a trace.
+ *
+ * @param streams
+ */
+void freeStreams(processor_streams_t *streams) {
+    if (streams == NULL) {
+        return;
+    }
+    for (int p = 0; p < NUM_PROCESSORS; p++) {
+        free(streams->positions[p]);
+    }
+    free(streams->records);
+    free(streams);
+}
@@ -0,0 +1,267 @@
+/**
+ * @file interval_stats.c
+ * @brief Periodic snapshots of a machine's counters, streamed to a file by
+ *        a background writer thread.
+ */
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interval_stats.h"
+
+/** @brief Bytes of the machine-wide fields leading each snapshot */
+#define SNAPSHOT_HEADER_BYTES offsetof(interval_snapshot_t, nodes)
+
+/**
+ * @brief Difference of two cumulative snapshots
+ *
+ * @param stats
+ * @param current
+ * @param delta             counters of the interval ending at current
+ */
+static void snapshotDelta(const interval_stats_t *stats, const interval_snapshot_t *current,
+                          interval_snapshot_t *delta) {
+    const interval_snapshot_t *previous = &stats->previous;
+    delta->interval = current->interval;
+    delta->accesses = current->accesses - previous->accesses;
+    delta->cycles = current->cycles - previous->cycles;
+    delta->messages = current->messages - previous->messages;
+    for (int i = 0; i < stats->numProcessors; i++) {
+        const interval_counters_t *now = &current->nodes[i];
+        const interval_counters_t *before = &previous->nodes[i];
+        interval_counters_t *node = &delta->nodes[i];
+        node->hits = now->hits - before->hits;
+        node->misses = now->misses - before->misses;
+        node->upgrades = now->upgrades - before->upgrades;
+        node->invalidations = now->invalidations - before->invalidations;
+        node->evictions = now->evictions - before->evictions;
+        node->cycles = now->cycles - before->cycles;
+        node->memoryReads = now->memoryReads - before->memoryReads;
+        node->memoryWrites = now->memoryWrites - before->memoryWrites;
+        node->forwards = now->forwards - before->forwards;
+    }
+}
+
+/**
+ * @brief Write one interval out
+ *
+ * @param stats
+ * @param current           cumulative snapshot at the end of the interval
+ * @return bool             false if the file could not be written
+ */
+static bool writeSnapshot(interval_stats_t *stats, const interval_snapshot_t *current) {
+    interval_snapshot_t delta;
+    snapshotDelta(stats, current, &delta);
+    stats->previous = *current;
+
+    if (stats->format == INTERVAL_BINARY) {
+        return fwrite(&delta, SNAPSHOT_HEADER_BYTES, 1, stats->out) == 1 &&
+               fwrite(delta.nodes, sizeof(interval_counters_t), stats->numProcessors,
+                      stats->out) == (size_t)stats->numProcessors;
+    }
+    for (int i = 0; i < stats->numProcessors; i++) {
+        const interval_counters_t *node = &delta.nodes[i];
+        if (fprintf(stats->out, "%lu,%lu,%lu,%lu,%lu,%d,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+                    delta.interval, current->accesses, current->cycles, delta.accesses,
+                    delta.messages, i, node->hits, node->misses, node->upgrades,
+                    node->invalidations, node->evictions, node->cycles, node->memoryReads,
+                    node->memoryWrites, node->forwards) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Writer thread: drains the ring until the stats are freed
+ *
+ * @param arg               interval_stats_t
+ * @return void*
+ */
+static void *intervalWriter(void *arg) {
+    interval_stats_t *stats = arg;
+    pthread_mutex_lock(&stats->lock);
+    while (true) {
+        while (stats->tail == stats->head && !stats->done) {
+            pthread_cond_wait(&stats->notEmpty, &stats->lock);
+        }
+        if (stats->tail == stats->head) {
+            break;
+        }
+        // The slot stays ours until tail moves past it
+        const interval_snapshot_t *current = &stats->ring[stats->tail % INTERVAL_RING_SNAPSHOTS];
+        pthread_mutex_unlock(&stats->lock);
+        bool written = writeSnapshot(stats, current);
+        pthread_mutex_lock(&stats->lock);
+        if (!written) {
+            stats->writeFailed = true;
+        }
+        stats->tail++;
+        pthread_cond_signal(&stats->notFull);
+    }
+    pthread_mutex_unlock(&stats->lock);
+    return NULL;
+}
+
+/**
+ * @brief Open the output file and start the writer thread.
+ *
+ * @param path              file to write the intervals to
+ * @param format            CSV or binary
+ * @param unit              what period counts
+ * @param period            accesses or cycles per interval
+ * @param numProcessors
+ * @return interval_stats_t*    newly allocated stats, NULL on failure
+ */
+interval_stats_t *createIntervalStats(const char *path, interval_format format,
+                                      interval_unit unit, unsigned long period,
+                                      int numProcessors) {
+    if (period == 0 || numProcessors < 1 || numProcessors > NUM_PROCESSORS) {
+        return NULL;
+    }
+    interval_stats_t *stats = calloc(1, sizeof(interval_stats_t));
+    if (stats == NULL) {
+        return NULL;
+    }
+    stats->unit = unit;
+    stats->period = period;
+    stats->nextSnapshot = period;
+    stats->numProcessors = numProcessors;
+    stats->format = format;
+    stats->out = fopen(path, format == INTERVAL_BINARY ? "wb" : "w");
+    if (stats->out == NULL) {
+        free(stats);
+        return NULL;
+    }
+
+    bool ok;
+    if (format == INTERVAL_BINARY) {
+        interval_file_header_t header = {
+            .magic = INTERVAL_MAGIC,
+            .version = INTERVAL_VERSION,
+            .numProcessors = (unsigned int)numProcessors,
+            .unit = unit,
+            .recordSize = (unsigned int)(SNAPSHOT_HEADER_BYTES +
+                                         numProcessors * sizeof(interval_counters_t)),
+            .period = period,
+        };
+        ok = fwrite(&header, sizeof(header), 1, stats->out) == 1;
+    } else {
+        ok = fprintf(stats->out, "interval,accesses,cycles,interval_accesses,messages,"
+                                 "processor,hits,misses,upgrades,invalidations,evictions,"
+                                 "core_cycles,memory_reads,memory_writes,forwards\n") >= 0;
+    }
+    pthread_mutex_init(&stats->lock, NULL);
+    pthread_cond_init(&stats->notEmpty, NULL);
+    pthread_cond_init(&stats->notFull, NULL);
+    if (!ok || pthread_create(&stats->writer, NULL, intervalWriter, stats) != 0) {
+        pthread_mutex_destroy(&stats->lock);
+        pthread_cond_destroy(&stats->notEmpty);
+        pthread_cond_destroy(&stats->notFull);
+        fclose(stats->out);
+        free(stats);
+        return NULL;
+    }
+    return stats;
+}
+
+/**
+ * @brief Slot for the next snapshot, waiting for the writer if the ring is full.
+ *
+ * The caller fills in the cumulative counters and then calls publishSnapshot.
+ *
+ * @param stats
+ * @return interval_snapshot_t*
+ */
+interval_snapshot_t *beginSnapshot(interval_stats_t *stats) {
+    pthread_mutex_lock(&stats->lock);
+    if (stats->head - stats->tail == INTERVAL_RING_SNAPSHOTS) {
+        stats->writerStalls++;
+        while (stats->head - stats->tail == INTERVAL_RING_SNAPSHOTS) {
+            pthread_cond_wait(&stats->notFull, &stats->lock);
+        }
+    }
+    pthread_mutex_unlock(&stats->lock);
+    interval_snapshot_t *snapshot = &stats->ring[stats->head % INTERVAL_RING_SNAPSHOTS];
+    snapshot->interval = stats->head;
+    return snapshot;
+}
+
+/**
+ * @brief Hand the snapshot from beginSnapshot to the writer.
+ *
+ * @param stats
+ * @param now               access count or machine clock the snapshot was taken at
+ */
+void publishSnapshot(interval_stats_t *stats, unsigned long now) {
+    // Skip every boundary the clock jumped over, one snapshot covers them
+    stats->nextSnapshot = (now / stats->period + 1) * stats->period;
+    stats->lastAccesses = stats->ring[stats->head % INTERVAL_RING_SNAPSHOTS].accesses;
+    pthread_mutex_lock(&stats->lock);
+    stats->head++;
+    pthread_cond_signal(&stats->notEmpty);
+    pthread_mutex_unlock(&stats->lock);
+}
+
+/**
+ * @brief Print how many snapshots were published and how many of them
+ *        waited for the writer to free a slot.
+ *
+ * @param stats
+ */
+void printIntervalStats(const interval_stats_t *stats) {
+    printf("Interval snapshots: %lu, waited for the writer: %lu\n", stats->head,
+           stats->writerStalls);
+}
+
+/**
+ * @brief Parse an interval period: a count of accesses, or of cycles with
+ *        a trailing 'c'.
+ *
+ * @param text              "<n>" or "<n>c"
+ * @param period
+ * @param unit
+ * @return bool             false if text is not a positive period
+ */
+bool parseIntervalPeriod(const char *text, unsigned long *period, interval_unit *unit) {
+    char *end;
+    unsigned long value = strtoul(text, &end, 0);
+    if (end == text || value == 0) {
+        return false;
+    }
+    if (*end == '\0') {
+        *unit = INTERVAL_ACCESSES;
+    } else if (strcmp(end, "c") == 0) {
+        *unit = INTERVAL_CYCLES;
+    } else {
+        return false;
+    }
+    *period = value;
+    return true;
+}
+
+/**
+ * @brief Let the writer drain the ring, stop it and close the file.
+ *
+ * @param stats
+ * @return bool             false if any interval could not be written
+ */
+bool freeIntervalStats(interval_stats_t *stats) {
+    if (stats == NULL) {
+        return true;
+    }
+    pthread_mutex_lock(&stats->lock);
+    stats->done = true;
+    pthread_cond_signal(&stats->notEmpty);
+    pthread_mutex_unlock(&stats->lock);
+    pthread_join(stats->writer, NULL);
+
+    bool ok = !stats->writeFailed;
+    if (fclose(stats->out) != 0) {
+        ok = false;
+    }
+    pthread_mutex_destroy(&stats->lock);
+    pthread_cond_destroy(&stats->notEmpty);
+    pthread_cond_destroy(&stats->notFull);
+    free(stats);
+    return ok;
+}
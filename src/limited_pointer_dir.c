@@ -1,227 +1,373 @@
 /**
  * @file limited_pointer_directory.c
- * @brief Implement a limited pointer scheme based cache coherence protocol. 
+ * @brief Implement a limited pointer scheme based cache coherence protocol.
  */
+#include <stdlib.h>
+#include <limited_pointer_dir.h>
 
-#include <limited_pointer_dir.h> 
 /**
  * @brief Initialize the directory
- * 
- * @param numLines 
- * @return lp_directory_t* 
+ *
+ * @param numLines          initial capacity, the slice grows past it
+ * @return void*
  */
-lp_directory_t* initializeDirectory(int numLines) {
+static void* initializeDirectory(int numLines) {
     lp_directory_t* dir = (lp_directory_t*)malloc(sizeof(lp_directory_t));
-    dir->lines = (lp_directory_entry_t*)malloc(sizeof(lp_directory_entry_t) * numLines);
-    dir->numLines = numLines;
-    pthread_mutex_init(&dir->lock, NULL);
-    
-    for (int i = 0; i < numLines; i++) {
-        dir->lines[i].numSharedBy = 0;
-        dir->lines[i].state = DIR_UNCACHED;
-        for(int j = 0; j < NUM_POINTERS; j++){
-            dir->lines[i].nodes[j] = -1;
-        }
-        dir->lines[i].owner = -1;
-        pthread_mutex_init(&dir->lines[i].lock, NULL);
+    if (dir == NULL) {
+        return NULL;
     }
+    dir->lines = createLineTable(sizeof(lp_directory_entry_t), (size_t)numLines);
+    if (dir->lines == NULL) {
+        free(dir);
+        return NULL;
+    }
+    pthread_mutex_init(&dir->lock, NULL);
     return dir;
 }
 
 /**
- * @brief Helper function to find the directory index for a given address
- * 
- * @param address 
- * @return int 
+ * @brief Helper function to find the directory entry for a given block
+ *
+ * @param directory
+ * @param block
+ * @return lp_directory_entry_t*  NULL if no cache holds the block
  */
- // Are you assuming a NUMA machine? The central directory source has a single directory for all caches so we can just index into the directory using the address 
- // if NUMA machines, the mmenry is split across processors (slide deck #12) so we should find the home node for this address and then search for the entry there. 
-int directoryIndex(int address) {
-    return address / cache[0].block_size; // IS THIS CORRECT
+static lp_directory_entry_t* directoryEntry(lp_directory_t* directory, unsigned long block) {
+    return lineTableFind(directory->lines, block);
 }
 
 /**
- * @brief Update the directory entry for a given address
- * 
- * @param directory 
- * @param address 
- * @param processorId 
- * @param newState 
- */
-void updateDirectoryEntry(lp_directory_t* directory, int address, int processorId, directory_state newState) {
-    int index = directoryIndex(address);
-    lp_directory_entry_t* entry = directory->lines[index];
-    pthread_mutex_lock(entry->lock);
-    entry->state = newState;
-    entry->owner = (newState == DIR_EXCLUSIVE_MODIFIED) ? processorId : -1;
-    entry->nodes[numSharedBy] = processorId;
-    entry->numSharedBy++;
-    pthread_mutex_unlock(entry->lock);
+ * @brief Find the directory entry for a given block, creating an uncached one
+ *
+ * @param directory
+ * @param block
+ * @return lp_directory_entry_t*  NULL if out of memory
+ */
+static lp_directory_entry_t* claimEntry(lp_directory_t* directory, unsigned long block) {
+    bool created;
+    lp_directory_entry_t* entry = lineTableInsert(directory->lines, block, &created);
+    if (entry != NULL && created) {
+        entry->numSharedBy = 0;
+        entry->state = DIR_UNCACHED;
+        for(int j = 0; j < NUM_POINTERS; j++){
+            entry->nodes[j] = -1;
+        }
+        entry->owner = -1;
+    }
+    return entry;
 }
 
 /**
- * @brief Invalidate the directory entry for a given address
- * 
- * @param directory 
- * @param address 
+ * @brief Get the state and owner of the directory entry for a given block
+ *
+ * @param dir
+ * @param block
+ * @param owner             filled in with the owner, -1 if none
+ * @return directory_state
  */
-void invalidateDirectoryEntry(lp_directory_t* directory, int address) {
-   int index = directoryIndex(address);
-   lp_directory_entry_t* entry = directory->lines[index];
-   pthread_mutex_lock(entry->lock);
-   entry->numSharedBy = 0;
-   entry->state = DIR_UNCACHED;
-
-   for(int j = 0; j < NUM_POINTERS; j++){
-      entry->nodes[j] = -1;
-   }
-   entry->owner = -1;
-   pthread_mutex_unlock(entry->lock);
+static directory_state getDirectoryState(void* dir, unsigned long block, int* owner) {
+    lp_directory_t* directory = dir;
+    pthread_mutex_lock(&directory->lock);
+    lp_directory_entry_t* entry = directoryEntry(directory, block);
+    directory_state state = entry != NULL ? entry->state : DIR_UNCACHED;
+    if (owner != NULL) {
+        *owner = entry != NULL ? entry->owner : -1;
+    }
+    pthread_mutex_unlock(&directory->lock);
+    return state;
 }
 
-// TODO: error check, if overflow we need to kick old sharer out or http://15418.courses.cs.cmu.edu/spring2013/article/25? 
 /**
- * @brief Add a processor to the directory entry's existsInCache bits
- * 
- * @param directory 
- * @param address 
- * @param processorId 
+ * @brief Get the processors the pointers refer to
+ *
+ * @param dir
+ * @param block
+ * @param sharers
  */
-void addProcessorToEntry(lp_directory_t* directory, int address, int processorId) {
-   int index = directoryIndex(address);
-   lp_directory_entry_t* entry = directory->lines[index];
-   pthread_mutex_lock(entry->lock);
-   entry->nodes[numSharedBy] = processorId;
-   entry->numSharedBy++;
-   pthread_mutex_unlock(entry->lock);
+static void getSharers(void* dir, unsigned long block, sharer_set_t* sharers) {
+    lp_directory_t* directory = dir;
+    sharerSetClear(sharers);
+    pthread_mutex_lock(&directory->lock);
+    lp_directory_entry_t* entry = directoryEntry(directory, block);
+    for (int i = 0; entry != NULL && i < entry->numSharedBy; i++) {
+        sharerSetAdd(sharers, entry->nodes[i]);
+    }
+    pthread_mutex_unlock(&directory->lock);
 }
 
 /**
- * @brief Remove a processor from the directory entry's existsInCache bits
- * 
- * @param directory 
- * @param address 
- * @param processorId 
+ * @brief Update the directory entry for a given block
+ *
+ * @param dir
+ * @param block
+ * @param processorId
+ * @param newState
  */
-void removeProcessorFromEntry(lp_directory_t* directory, int address, int processorId) {
-   int index = directoryIndex(address);
-   lp_directory_entry_t* entry = directory->lines[index];
-   pthread_mutex_lock(entry->lock);
-   for(int i = 0; i < entry->numSharedBy; i++) {
-    if(entry->nodes[i] == processorId) {
-        entry->nodes[i] = -1; 
+static void updateDirectoryEntry(void* dir, unsigned long block, int processorId, directory_state newState) {
+    lp_directory_t* directory = dir;
+    pthread_mutex_lock(&directory->lock);
+    if (newState == DIR_UNCACHED) {
+        lineTableRemove(directory->lines, block);
+    } else {
+        lp_directory_entry_t* entry = claimEntry(directory, block);
+        if (entry != NULL) {
+            entry->state = newState;
+            entry->owner = (newState == DIR_EXCLUSIVE_MODIFIED || newState == DIR_OWNED) ? processorId : -1;
+        }
     }
-   }
-   // Do we have to update the state here or does updateDirectoryEntry handle that? 
-   pthread_mutex_unlock(entry->lock);
+    pthread_mutex_unlock(&directory->lock);
 }
 
 /**
- * @brief Broadcast an invalidate to all processors except the owner for a given address
- * 
- * @param directory 
- * @param address 
- */
-void broadcastInvalidate(lp_directory_t* directory, int address) {
-    int index = directoryIndex(address);
-    lp_directory_entry_t* entry = directory->lines[index];
-    pthread_mutex_lock(entry->lock);
-    if(entry->state != DIR_UNCACHED) {
-        // Send invalidate message to all processors except the owner
-        for(int j = 0; j < numSharedBy; j++){
-            if(entry->node[j] != entry->owner){
-                // sendMessage(INVALIDATE, address, j);
-            }
-        }
-    }
-    pthread_mutex_unlock(entry->lock);
+ * @brief Invalidate the directory entry for a given block
+ *
+ * @param dir
+ * @param block
+ */
+static void invalidateDirectoryEntry(void* dir, unsigned long block) {
+   lp_directory_t* directory = dir;
+   pthread_mutex_lock(&directory->lock);
+   lineTableRemove(directory->lines, block);
+   pthread_mutex_unlock(&directory->lock);
 }
 
+/**
+ * @brief Add a processor to the directory entry's pointers
+ *
+ * When every pointer is in use the oldest sharer other than the owner is kicked out
+ * (http://15418.courses.cs.cmu.edu/spring2013/article/25) and the caller
+ * must invalidate its copy.
+ *
+ * @param dir
+ * @param block
+ * @param processorId
+ * @return int              sharer that lost its pointer, -1 if none
+ */
+static int addProcessorToEntry(void* dir, unsigned long block, int processorId) {
+   lp_directory_t* directory = dir;
+   int evicted = -1;
+   pthread_mutex_lock(&directory->lock);
+   lp_directory_entry_t* entry = claimEntry(directory, block);
+   if(entry == NULL) {
+      pthread_mutex_unlock(&directory->lock);
+      return -1;
+   }
+   for(int i = 0; i < entry->numSharedBy; i++) {
+      if(entry->nodes[i] == processorId) {
+         pthread_mutex_unlock(&directory->lock);
+         return -1;
+      }
+   }
+   if(entry->numSharedBy == NUM_POINTERS) {
+      // Kick out the oldest sharer that is not the owner
+      int victim = (entry->nodes[0] == entry->owner) ? 1 : 0;
+      evicted = entry->nodes[victim];
+      for(int i = victim + 1; i < NUM_POINTERS; i++) {
+         entry->nodes[i - 1] = entry->nodes[i];
+      }
+      entry->numSharedBy--;
+   }
+   entry->nodes[entry->numSharedBy] = processorId;
+   entry->numSharedBy++;
+   pthread_mutex_unlock(&directory->lock);
+   return evicted;
+}
 
-// Check if the cache is in a consistent state with the directory
-bool checkCacheConsistency(lp_directory_t* directory, int lineIndex, int processorId) {
-   // Implement consistency checking logic here
-   return true; // placeholder return
+/**
+ * @brief Remove a processor from the directory entry's pointers
+ *
+ * The entry is dropped once no pointer is left.
+ *
+ * @param dir
+ * @param block
+ * @param processorId
+ */
+static void removeProcessorFromEntry(void* dir, unsigned long block, int processorId) {
+   lp_directory_t* directory = dir;
+   pthread_mutex_lock(&directory->lock);
+   lp_directory_entry_t* entry = directoryEntry(directory, block);
+   if(entry == NULL) {
+      pthread_mutex_unlock(&directory->lock);
+      return;
+   }
+   int kept = 0;
+   for(int i = 0; i < entry->numSharedBy; i++) {
+      if(entry->nodes[i] != processorId) {
+         entry->nodes[kept++] = entry->nodes[i];
+      }
+   }
+   for(int i = kept; i < entry->numSharedBy; i++) {
+      entry->nodes[i] = -1;
+   }
+   entry->numSharedBy = kept;
+   if(entry->owner == processorId) {
+      // The owner's copy is gone; any remaining sharers hold clean copies
+      entry->owner = -1;
+      entry->state = DIR_SHARED;
+   }
+   if(entry->numSharedBy == 0) {
+      lineTableRemove(directory->lines, block);
+   }
+   pthread_mutex_unlock(&directory->lock);
 }
 
 
 /**
- * @brief Free the directory
- * 
- * @param dir 
+ * @brief Check that the entry for a block is well formed
+ *
+ * On top of the state rules of the full bit vector scheme, the pointers in
+ * use must name distinct processors and the unused ones must be -1.
+ *
+ * @param dir
+ * @param block
+ * @param processorId       processor that must hold a pointer, -1 for none
+ * @return bool             false if the entry breaks an invariant
  */
-void freeDirectory(lp_directory_t* dir) {
-   if(dir != NULL) {
-      if(dir->lines != NULL) {
-         for(int i = 0; i < dir->numLines; i++) {
-            pthread_mutex_destroy(&dir->lines[i].lock);
-         }
-         free(dir->lines);
+static bool checkCacheConsistency(void* dir, unsigned long block, int processorId) {
+   lp_directory_t* directory = dir;
+   bool consistent = true;
+   pthread_mutex_lock(&directory->lock);
+   lp_directory_entry_t* entry = directoryEntry(directory, block);
+   if(entry == NULL) {
+      pthread_mutex_unlock(&directory->lock);
+      return processorId < 0;
+   }
+   if(entry->numSharedBy < 1 || entry->numSharedBy > NUM_POINTERS) {
+      pthread_mutex_unlock(&directory->lock);
+      return false;
+   }
+   sharer_set_t sharers;
+   sharerSetClear(&sharers);
+   for(int i = 0; i < NUM_POINTERS; i++) {
+      int node = entry->nodes[i];
+      if(i >= entry->numSharedBy) {
+         consistent = consistent && node == -1;
+      } else if(node < 0 || node >= NUM_PROCESSORS || sharerSetHas(&sharers, node)) {
+         consistent = false;
+      } else {
+         sharerSetAdd(&sharers, node);
       }
-      pthread_mutex_destroy(&dir->lock);
-      free(dir);
    }
+   bool ownerListed = entry->owner >= 0 && entry->owner < NUM_PROCESSORS &&
+                      sharerSetHas(&sharers, entry->owner);
+   switch(entry->state) {
+      case DIR_SHARED:
+         consistent = consistent && entry->owner == -1;
+         break;
+      case DIR_EXCLUSIVE_MODIFIED:
+         consistent = consistent && entry->numSharedBy == 1 && ownerListed;
+         break;
+      case DIR_OWNED:
+         consistent = consistent && ownerListed;
+         break;
+      default:
+         consistent = false;
+         break;
+   }
+   if(processorId >= 0 && !sharerSetHas(&sharers, processorId)) {
+      consistent = false;
+   }
+   pthread_mutex_unlock(&directory->lock);
+   return consistent;
 }
 
 /**
- * @brief initializeSystem
- * 
+ * @brief Report the occupancy of the entry table
+ *
+ * @param dir
+ * @param stats
  */
-void initializeSystem(void) {
-    // Initialize the central directory
-    lp_directory_t* directory = initializeDirectory(NUM_LINES);
-
-    // Initialize the interconnect
-    interconnect_t* interconnect = createInterconnect();
+static void getTableStats(void* dir, line_table_stats_t* stats) {
+   lp_directory_t* directory = dir;
+   pthread_mutex_lock(&directory->lock);
+   lineTableStats(directory->lines, stats);
+   pthread_mutex_unlock(&directory->lock);
+}
 
-    // Initialize and connect all caches to the interconnect
-    for (int i = 0; i < NUM_PROCESSORS; ++i) {
-        caches[i] = initializeCache(S, E, B, i);  // Initialize cache for processor 'i'
-        connectCacheToInterconnect(caches[i], interconnect);
-    }
 
-    // Connect the interconnect to the central directory
-    connectInterconnectToDirectory(interconnect, directory);
+/**
+ * @brief Directory visitor passed through lineTableForEach
+ *
+ */
+typedef struct {
+   directory_visit_fn visit;
+   void* arg;
+} line_visitor_t;
 
+/**
+ * @brief Hand one entry to the directory visitor
+ *
+ * @param arg               line_visitor_t
+ * @param block
+ * @param entry
+ */
+static void visitEntry(void* arg, unsigned long block, void* entry) {
+   line_visitor_t* visitor = arg;
+   lp_directory_entry_t* e = entry;
+   sharer_set_t sharers;
+   sharerSetClear(&sharers);
+   for (int i = 0; i < e->numSharedBy; i++) {
+      sharerSetAdd(&sharers, e->nodes[i]);
+   }
+   visitor->visit(visitor->arg, block, e->state, e->owner, &sharers);
 }
 
 /**
- * @brief cleanup System
- * 
+ * @brief Visit every line some cache holds
+ *
+ * @param dir
+ * @param visit
+ * @param arg
  */
-void cleanupSystem(void) {
-    // Cleanup caches
-    for (int i = 0; i < NUM_PROCESSORS; ++i) {
-        if (caches[i] != NULL) {
-            freeCache(caches[i]);
-        }
-    }
-
-    // Cleanup interconnect
-    if (interconnect != NULL) {
-        freeInterconnect(interconnect);
-    }
-
-    // Finally, free the central directory
-    if (directory != NULL) {
-        freeDirectory(directory);
-    }
+static void forEachLine(void* dir, directory_visit_fn visit, void* arg) {
+   lp_directory_t* directory = dir;
+   line_visitor_t visitor = { visit, arg };
+   pthread_mutex_lock(&directory->lock);
+   lineTableForEach(directory->lines, visitEntry, &visitor);
+   pthread_mutex_unlock(&directory->lock);
 }
 
+
 /**
- * @brief 
- * 
- * @param request_line 
+ * @brief Free the directory
+ *
+ * @param directory
  */
-void executeInstruction(char *request_line) {
-   // Implement instruction execution logic...
+static void freeDirectory(void* directory) {
+   lp_directory_t* dir = directory;
+   if(dir != NULL) {
+      freeLineTable(dir->lines);
+      pthread_mutex_destroy(&dir->lock);
+      free(dir);
+   }
 }
 
 /**
- * @brief Prints information about what parameters the program requires and it's format.
- * 
-*/
-void displayUsage(void) {
-   return;
+ * @brief Hardware bits of an entry: state, NUM_POINTERS sharer pointers,
+ *        their count and an owner pointer
+ *
+ * @param numProcessors
+ * @return unsigned int
+ */
+static unsigned int entryBits(int numProcessors) {
+   unsigned int pointerBits = processorIdBits(numProcessors);
+   return DIRECTORY_STATE_BITS + NUM_POINTERS * pointerBits +
+          processorIdBits(NUM_POINTERS + 1) + pointerBits;
 }
 
+/** @brief Limited pointer directory, NUM_POINTERS sharer pointers per line */
+const directory_ops_t limitedPointerDirectoryOps = {
+    .name = "limited-pointer",
+    .create = initializeDirectory,
+    .destroy = freeDirectory,
+    .getState = getDirectoryState,
+    .getSharers = getSharers,
+    .setState = updateDirectoryEntry,
+    .addSharer = addProcessorToEntry,
+    .removeSharer = removeProcessorFromEntry,
+    .invalidate = invalidateDirectoryEntry,
+    .checkConsistency = checkCacheConsistency,
+    .tableStats = getTableStats,
+    .forEachLine = forEachLine,
+    .entryBits = entryBits,
+};
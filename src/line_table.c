@@ -0,0 +1,447 @@
+/**
+ * @file line_table.c
+ * @brief Robin-hood hash table keyed on full block (or page) numbers.
+ *
+ * Keys are stored as key + 1 so that 0 marks an empty slot. Every slot
+ * remembers how far it sits from its home slot; an insert that meets a
+ * slot closer to home than itself takes that slot and carries the evicted
+ * key further, which keeps probe lengths short and lets a lookup stop as
+ * soon as it passes where its key would have been placed.
+ *
+ * Growing allocates an array twice the size and drains the old array
+ * into it a few slots at a time. The old array never takes inserts, so
+ * removing from it only leaves a tombstone and nothing in it ever moves.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "line_table.h"
+
+/** @brief Key of an empty slot */
+#define EMPTY_KEY 0UL
+
+/** @brief Key of a slot removed from the old array while growing */
+#define TOMBSTONE_KEY (~0UL)
+
+/** @brief Slot index returned when a key is not present */
+#define NOT_FOUND SIZE_MAX
+
+/**
+ * @brief Header at the start of every slot
+ *
+ */
+typedef struct slot_header {
+    unsigned long key;             // key + 1, EMPTY_KEY or TOMBSTONE_KEY
+    unsigned int distance;         // Slots away from the home slot
+} slot_header_t;
+
+/** @brief Bytes of header before each entry, keeping entries 8 byte aligned */
+#define HEADER_SIZE ((sizeof(slot_header_t) + 7) & ~(size_t)7)
+
+/**
+ * @brief Mix a key into a slot number.
+ *
+ * @param key
+ * @param numSlots          always a power of two
+ * @return size_t
+ */
+static size_t homeSlot(unsigned long key, size_t numSlots) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdUL;
+    key ^= key >> 33;
+    return key & (numSlots - 1);
+}
+
+/**
+ * @brief Header of a slot.
+ *
+ * @param table
+ * @param array
+ * @param index
+ * @return slot_header_t*
+ */
+static slot_header_t *slotAt(const line_table_t *table, const line_table_array_t *array,
+                             size_t index) {
+    return (slot_header_t *)(array->slots + index * table->slotSize);
+}
+
+/**
+ * @brief Caller data of a slot.
+ *
+ * @param slot
+ * @return void*
+ */
+static void *slotEntry(slot_header_t *slot) {
+    return (unsigned char *)slot + HEADER_SIZE;
+}
+
+/**
+ * @brief Allocate an array of empty slots.
+ *
+ * @param table
+ * @param array
+ * @param numSlots          power of two
+ * @return true             allocation succeeded
+ */
+static bool allocateArray(line_table_t *table, line_table_array_t *array, size_t numSlots) {
+    array->slots = calloc(numSlots, table->slotSize);
+    if (array->slots == NULL) {
+        return false;
+    }
+    array->numSlots = numSlots;
+    array->count = 0;
+    return true;
+}
+
+/**
+ * @brief Create a line table.
+ *
+ * @param entrySize         bytes of caller data per key
+ * @param initialSlots      expected number of keys, rounded up to a power of two
+ * @return line_table_t*    newly allocated table, NULL on failure
+ */
+line_table_t *createLineTable(size_t entrySize, size_t initialSlots) {
+    line_table_t *table = calloc(1, sizeof(line_table_t));
+    if (table == NULL) {
+        return NULL;
+    }
+    table->entrySize = entrySize;
+    table->slotSize = (HEADER_SIZE + entrySize + 7) & ~(size_t)7;
+
+    size_t numSlots = LINE_TABLE_MIN_SLOTS;
+    while (numSlots < initialSlots) {
+        numSlots *= 2;
+    }
+    table->scratch = malloc(2 * table->slotSize);
+    if (table->scratch == NULL || !allocateArray(table, &table->current, numSlots)) {
+        freeLineTable(table);
+        return NULL;
+    }
+    return table;
+}
+
+/**
+ * @brief Find the slot holding a key in one array.
+ *
+ * @param table
+ * @param array
+ * @param stored            key + 1
+ * @return size_t           slot index, NOT_FOUND if absent
+ */
+static size_t arrayFind(line_table_t *table, const line_table_array_t *array,
+                        unsigned long stored) {
+    if (array->count == 0) {
+        return NOT_FOUND;
+    }
+    size_t mask = array->numSlots - 1;
+    size_t index = homeSlot(stored, array->numSlots);
+    for (unsigned int distance = 0;; distance++) {
+        slot_header_t *slot = slotAt(table, array, index);
+        table->probes++;
+        if (slot->key == stored) {
+            return index;
+        }
+        if (slot->key == EMPTY_KEY ||
+            (slot->key != TOMBSTONE_KEY && slot->distance < distance)) {
+            // The key would have displaced this slot had it been inserted
+            return NOT_FOUND;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+/**
+ * @brief Insert a key known to be absent into one array.
+ *
+ * @param table
+ * @param array
+ * @param stored            key + 1
+ * @param entry             data to copy in, NULL for a zeroed entry
+ * @return void*            entry of the new key
+ */
+static void *arrayInsert(line_table_t *table, line_table_array_t *array,
+                         unsigned long stored, const void *entry) {
+    slot_header_t *carry = (slot_header_t *)table->scratch;
+    unsigned char *swap = table->scratch + table->slotSize;
+    memset(carry, 0, table->slotSize);
+    carry->key = stored;
+    if (entry != NULL) {
+        memcpy(slotEntry(carry), entry, table->entrySize);
+    }
+
+    size_t mask = array->numSlots - 1;
+    size_t index = homeSlot(stored, array->numSlots);
+    slot_header_t *placed = NULL;
+    for (;;) {
+        slot_header_t *slot = slotAt(table, array, index);
+        if (slot->key == EMPTY_KEY) {
+            memcpy(slot, carry, table->slotSize);
+            array->count++;
+            return slotEntry(placed != NULL ? placed : slot);
+        }
+        if (slot->distance < carry->distance) {
+            // Rob the richer slot and carry its key onwards
+            memcpy(swap, slot, table->slotSize);
+            memcpy(slot, carry, table->slotSize);
+            memcpy(carry, swap, table->slotSize);
+            if (placed == NULL) {
+                placed = slot;
+            }
+        }
+        index = (index + 1) & mask;
+        carry->distance++;
+    }
+}
+
+/**
+ * @brief Remove the key in a slot of the current array.
+ *
+ * Later keys of the same run shift back one slot, so no tombstone is left.
+ *
+ * @param table
+ * @param array
+ * @param index
+ */
+static void arrayRemoveAt(line_table_t *table, line_table_array_t *array, size_t index) {
+    size_t mask = array->numSlots - 1;
+    for (;;) {
+        size_t next = (index + 1) & mask;
+        slot_header_t *slot = slotAt(table, array, index);
+        slot_header_t *following = slotAt(table, array, next);
+        if (following->key == EMPTY_KEY || following->distance == 0) {
+            memset(slot, 0, table->slotSize);
+            break;
+        }
+        memcpy(slot, following, table->slotSize);
+        slot->distance--;
+        index = next;
+    }
+    array->count--;
+}
+
+/**
+ * @brief Move up to steps slots of the old array into the current one.
+ *
+ * @param table
+ * @param steps
+ */
+static void migrate(line_table_t *table, size_t steps) {
+    line_table_array_t *old = &table->old;
+    while (old->slots != NULL && steps-- > 0) {
+        if (old->count == 0 || table->migrateCursor == old->numSlots) {
+            free(old->slots);
+            memset(old, 0, sizeof(*old));
+            return;
+        }
+        slot_header_t *slot = slotAt(table, old, table->migrateCursor++);
+        if (slot->key != EMPTY_KEY && slot->key != TOMBSTONE_KEY) {
+            arrayInsert(table, &table->current, slot->key, slotEntry(slot));
+            slot->key = TOMBSTONE_KEY;
+            old->count--;
+        }
+    }
+}
+
+/**
+ * @brief Start draining into an array twice the size once the table is full enough.
+ *
+ * If the larger array cannot be allocated the current one keeps filling
+ * up past its load limit.
+ *
+ * @param table
+ * @return true             there is room for one more key
+ */
+static bool reserveSlot(line_table_t *table) {
+    line_table_array_t *current = &table->current;
+    if ((current->count + 1) * 100 <= current->numSlots * LINE_TABLE_MAX_LOAD) {
+        return true;
+    }
+    // Normally the previous growth has long finished by now
+    migrate(table, SIZE_MAX);
+
+    line_table_array_t bigger;
+    if (!allocateArray(table, &bigger, current->numSlots * 2)) {
+        return current->count + 1 < current->numSlots;
+    }
+    table->old = *current;
+    table->current = bigger;
+    table->migrateCursor = 0;
+    return true;
+}
+
+/**
+ * @brief Find the entry of a key.
+ *
+ * Entries move on inserts and removes; the pointer is only valid until
+ * the next one.
+ *
+ * @param table
+ * @param key
+ * @return void*            entry, NULL if the key is absent
+ */
+void *lineTableFind(line_table_t *table, unsigned long key) {
+    unsigned long stored = key + 1;
+    table->lookups++;
+    size_t index = arrayFind(table, &table->current, stored);
+    if (index != NOT_FOUND) {
+        return slotEntry(slotAt(table, &table->current, index));
+    }
+    index = arrayFind(table, &table->old, stored);
+    if (index != NOT_FOUND) {
+        return slotEntry(slotAt(table, &table->old, index));
+    }
+    return NULL;
+}
+
+/**
+ * @brief Find the entry of a key, adding a zeroed one if it is absent.
+ *
+ * @param table
+ * @param key
+ * @param created           set to whether the entry is new, may be NULL
+ * @return void*            entry, NULL if out of memory
+ */
+void *lineTableInsert(line_table_t *table, unsigned long key, bool *created) {
+    unsigned long stored = key + 1;
+    if (created != NULL) {
+        *created = false;
+    }
+    migrate(table, LINE_TABLE_MIGRATE_STEP);
+    if (!reserveSlot(table)) {
+        return NULL;
+    }
+
+    table->lookups++;
+    size_t index = arrayFind(table, &table->current, stored);
+    if (index != NOT_FOUND) {
+        return slotEntry(slotAt(table, &table->current, index));
+    }
+    index = arrayFind(table, &table->old, stored);
+    if (index != NOT_FOUND) {
+        // Bring it over early so the caller's pointer stays in the current array
+        slot_header_t *slot = slotAt(table, &table->old, index);
+        void *entry = arrayInsert(table, &table->current, stored, slotEntry(slot));
+        slot->key = TOMBSTONE_KEY;
+        table->old.count--;
+        return entry;
+    }
+    if (created != NULL) {
+        *created = true;
+    }
+    return arrayInsert(table, &table->current, stored, NULL);
+}
+
+/**
+ * @brief Remove a key, if present.
+ *
+ * @param table
+ * @param key
+ */
+void lineTableRemove(line_table_t *table, unsigned long key) {
+    unsigned long stored = key + 1;
+    migrate(table, LINE_TABLE_MIGRATE_STEP);
+
+    table->lookups++;
+    size_t index = arrayFind(table, &table->current, stored);
+    if (index != NOT_FOUND) {
+        arrayRemoveAt(table, &table->current, index);
+        return;
+    }
+    index = arrayFind(table, &table->old, stored);
+    if (index != NOT_FOUND) {
+        slotAt(table, &table->old, index)->key = TOMBSTONE_KEY;
+        table->old.count--;
+    }
+}
+
+/**
+ * @brief Number of keys in the table.
+ *
+ * @param table
+ * @return size_t
+ */
+size_t lineTableCount(const line_table_t *table) {
+    return table->current.count + table->old.count;
+}
+
+/**
+ * @brief Visit every key of one array.
+ *
+ * @param table
+ * @param array
+ * @param visit
+ * @param arg
+ */
+static void arrayForEach(line_table_t *table, line_table_array_t *array,
+                         line_table_visit_fn visit, void *arg) {
+    for (size_t i = 0; i < array->numSlots; i++) {
+        slot_header_t *slot = slotAt(table, array, i);
+        if (slot->key != EMPTY_KEY && slot->key != TOMBSTONE_KEY) {
+            visit(arg, slot->key - 1, slotEntry(slot));
+        }
+    }
+}
+
+/**
+ * @brief Visit every key in the table, in no particular order.
+ *
+ * The visitor may change entries but must not insert or remove keys.
+ *
+ * @param table
+ * @param visit
+ * @param arg
+ */
+void lineTableForEach(line_table_t *table, line_table_visit_fn visit, void *arg) {
+    arrayForEach(table, &table->current, visit, arg);
+    arrayForEach(table, &table->old, visit, arg);
+}
+
+/**
+ * @brief Furthest any live key of an array sits from its home slot.
+ *
+ * @param table
+ * @param array
+ * @return unsigned int
+ */
+static unsigned int maxDisplacement(const line_table_t *table, const line_table_array_t *array) {
+    unsigned int max = 0;
+    for (size_t i = 0; i < array->numSlots; i++) {
+        const slot_header_t *slot = slotAt(table, array, i);
+        if (slot->key != EMPTY_KEY && slot->key != TOMBSTONE_KEY && slot->distance > max) {
+            max = slot->distance;
+        }
+    }
+    return max;
+}
+
+/**
+ * @brief Report occupancy and probe lengths.
+ *
+ * @param table
+ * @param stats
+ */
+void lineTableStats(const line_table_t *table, line_table_stats_t *stats) {
+    stats->entries = lineTableCount(table);
+    stats->slots = table->current.numSlots + table->old.numSlots;
+    stats->loadFactor = (double)stats->entries / table->current.numSlots;
+    stats->averageProbe = table->lookups ? (double)table->probes / table->lookups : 0.0;
+    stats->maxDisplacement = maxDisplacement(table, &table->current);
+    unsigned int oldMax = maxDisplacement(table, &table->old);
+    if (oldMax > stats->maxDisplacement) {
+        stats->maxDisplacement = oldMax;
+    }
+}
+
+/**
+ * @brief Free a line table.
+ *
+ * @param table
+ */
+void freeLineTable(line_table_t *table) {
+    if (table != NULL) {
+        free(table->current.slots);
+        free(table->old.slots);
+        free(table->scratch);
+        free(table);
+    }
+}
@@ -0,0 +1,657 @@
+/**
+ * @file main.c
+ * @brief Command line driver: run a trace through one or more simulated
+ *        machines.
+ *
+ * Giving several directory schemes (-d a,b), cache configurations (-c) or
+ * sector sizes (-x) runs comparison mode: the trace is decoded once and
+ * every combination of them is driven from the same records.
+ * A synthetic workload (-w) can stand in for the trace file, or be written
+ * out as one (-o). A machine warmed up on the start of a trace can be
+ * saved (-C, -N) and every compared system restored from it (-R).
+ * Sharing patterns and false sharing are profiled per line with -L, and
+ * misses split into cold, capacity, conflict and coherence misses with -M.
+ * Counters can be snapshotted every interval into a file (-S, -I), and the
+ * coherence invariants checked on all, every Nth or sampled lines (-K).
+ * Traces, plain or gzip/zstd compressed, are read and decoded on
+ * background threads (-j). Per-thread files captured from a real program
+ * with trace_capture.h are merged into a trace with -m. Directory storage
+ * and the dynamic energy of the run are reported with -A and -e.
+ * The processors' streams can be interleaved by threads or by seeded
+ * arbitration at the home nodes instead of in trace order (-i), and the
+ * interleaving recorded (-X) and replayed exactly (-Y).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "checkpoint.h"
+#include "compare.h"
+#include "interleave.h"
+#include "simulator.h"
+#include "system.h"
+#include "trace_capture.h"
+
+/** @brief Most cache configurations given with -c */
+#define MAX_CACHE_CONFIGS 8
+
+/** @brief Most sector sizes given with -x */
+#define MAX_SECTOR_SIZES 4
+
+/** @brief Smallest sector size accepted by -x, in bytes */
+#define MIN_SECTOR_BYTES 4
+
+/** @brief Longest interval statistics file name, with the system suffix */
+#define STATS_PATH_LEN 256
+
+/**
+ * @brief Prints information about what parameters the program requires and it's format.
+ *
+*/
+void displayUsage(void) {
+   printf("Usage: ./dirsim [-hv] (-t <tracefile> | -w <workload>) [-p <procs>] [-s <s>] [-E <E>]\n"
+          "                [-b <b>] [-d <scheme>[,<scheme>...]] [-c <s>:<E>:<b>]... [-l <lines>]\n"
+          "                [-H <policy>] [-g <bits>] [-f <hops>[,<hops>]] [-P <proto>[,<proto>...]]\n"
+          "                [-x <bytes>[,<bytes>...]] [-n <accesses>] [-F <lines>] [-r <seed>]\n"
+          "                [-o <file>]\n"
+          "                [-C <file> -N <records>] [-R <file>] [-L <lines>] [-M]\n"
+          "                [-S <file> [-I <period>]] [-K <checks>] [-j <threads>]\n"
+          "                [-A] [-e <dir>:<cache>:<hop>:<dram>]\n"
+          "                [-i <interleaving>] [-X <file> | -Y <file>]\n"
+          "       ./dirsim -m <prefix> -o <file>\n");
+   printf("  -h            Print this help message\n");
+   printf("  -v            Print the full summary of every system\n");
+   printf("  -t <file>     Trace file of \"<pid> <R|W> <hexaddr>\" lines, may be gzip or\n"
+          "                zstd compressed; T, C and A are test-and-set, compare-and-swap\n"
+          "                and fetch-add, F is a fence\n");
+   printf("  -p <procs>    Number of processors (default and maximum %d)\n", NUM_PROCESSORS);
+   printf("  -s <s>        Number of set bits (default 6)\n");
+   printf("  -E <E>        Associativity (default 4)\n");
+   printf("  -b <b>        Number of block bits (default 6)\n");
+   printf("  -d <schemes>  Directory schemes to compare, snoop for a snooping bus\n"
+          "                (default central): ");
+   listDirectorySchemes();
+   printf("  -c <s:E:b>    Cache configuration to compare, may be repeated\n");
+   printf("  -l <lines>    Initial directory entries per home node (default %d)\n", NUM_LINES);
+   printf("  -H <policy>   Home node placement: line, page, xor, first-touch (default line)\n");
+   printf("  -g <bits>     log2 of the placement unit in bytes (default: block size for\n"
+          "                line/xor, %d for page/first-touch)\n", DEFAULT_PAGE_BITS);
+   printf("  -f <hops>     Dirty misses: 4 goes through the home node, 3 forwards to the\n"
+          "                owner; \"3,4\" compares both (default 4)\n");
+   printf("  -P <protos>   Cache protocols to compare: msi, mesi, moesi (default msi)\n");
+   printf("  -x <bytes>    Sector sizes to compare; coherence is kept per sector and a\n"
+          "                size of at least the line leaves lines unsectored\n");
+   printf("  -W <policy>   Write policy: write-back or write-through, optionally followed\n"
+          "                by :no-allocate (default write-back)\n");
+   printf("  -B <depth>    Coalescing write buffer entries per core for written-through\n"
+          "                stores, up to %d, with :full or :timed drains (default 0)\n",
+          MAX_WRITE_BUFFER_DEPTH);
+   printf("  -V <lines>    Victim cache lines per core, up to %d (default 0)\n", MAX_VICTIM_LINES);
+   printf("  -O <mshrs>    Misses each core keeps in flight, up to %d; 0 blocks on every\n"
+          "                miss (default 0)\n", MAX_MSHRS);
+   printf("  -D <banks>    Model each home's memory controller with this many banks and\n"
+          "                an optional :<queue depth> (default %d), instead of a flat\n"
+          "                %d cycles per memory read\n", DEFAULT_DRAM_QUEUE, MISS_CYCLES);
+   printf("  -G <bits>     Track regions of 2^bits bytes, at least a line, and let misses\n"
+          "                to a region only one core has missed in skip the directory\n"
+          "                (suggested %d)\n", REGION_DEFAULT_BITS);
+   printf("  -w <name>     Synthetic workload instead of a trace: producer-consumer,\n"
+          "                migratory, false-sharing, read-mostly, lock-contention, uniform\n");
+   printf("  -n <count>    Accesses the workload generates (default %lu)\n", DEFAULT_WORKLOAD_ACCESSES);
+   printf("  -F <lines>    Distinct lines the workload touches (default %lu)\n", DEFAULT_WORKLOAD_LINES);
+   printf("  -r <seed>     Workload random seed (default 1)\n");
+   printf("  -o <file>     Write the workload to a trace file instead of simulating it\n");
+   printf("  -m <prefix>   Merge the capture files <prefix>.<n> into the trace file -o\n");
+   printf("  -C <file>     Checkpoint the machine after -N trace records, then stop\n");
+   printf("  -N <records>  Trace records to warm up on before the checkpoint\n");
+   printf("  -R <file>     Restore every system from a checkpoint and resume the trace there\n");
+   printf("  -L <lines>    Profile sharing patterns and list the most invalidated lines\n"
+          "                (suggested %d)\n", PROFILE_DEFAULT_TOP_LINES);
+   printf("  -M            Split misses into cold, capacity, conflict and coherence misses\n");
+   printf("  -S <file>     Write per-interval counters to a CSV file, or binary if it ends\n"
+          "                in .bin; compared systems get .<n> appended\n");
+   printf("  -I <period>   Interval in accesses, or in cycles with a trailing c (default %d)\n",
+          DEFAULT_STATS_PERIOD);
+   printf("  -j <threads>  Trace decoder threads, 0 to decode on the simulation thread\n"
+          "                (default %d)\n", DEFAULT_DECODER_THREADS);
+   printf("  -K <checks>   Check coherence invariants: all (every access), every:<n>\n"
+          "                (every nth access) or sample:<n> (one line in n); every\n"
+          "                cached line is checked again at the end\n");
+   printf("  -A            Report directory storage overhead and dynamic energy\n");
+   printf("  -e <costs>    Energy per directory lookup, cache lookup, network hop and DRAM\n"
+          "                access in pJ, as <dir>:<cache>:<hop>:<dram> (default %g:%g:%g:%g)\n",
+          DEFAULT_DIRECTORY_PJ, DEFAULT_CACHE_PJ, DEFAULT_HOP_PJ, DEFAULT_DRAM_PJ);
+   printf("  -i <order>    Interleave the processors' streams: trace (default),\n"
+          "                threads[:<runs>] with a thread per processor, or\n"
+          "                seeded[:<seeds>] arbitrating at each home node, e.g. seeded:1-8;\n"
+          "                several runs or seeds report the variance of the results\n");
+   printf("  -X <file>     Record the interleaving of the one system and seed to a log\n");
+   printf("  -Y <file>     Replay a recorded interleaving instead of interleaving\n");
+}
+
+int main(int argc, char **argv) {
+    system_config_t base;
+    defaultSimulatorConfig(&base);
+    const directory_ops_t *schemes[MAX_SYSTEMS];
+    int numSchemes = 0;
+    unsigned int cacheConfigs[MAX_CACHE_CONFIGS][3];
+    int numCacheConfigs = 0;
+    bool forwardingModes[2];
+    int numForwardingModes = 0;
+    coherence_protocol protocols[3];
+    int numProtocols = 0;
+    unsigned int sectorBits[MAX_SECTOR_SIZES];
+    int numSectorSizes = 0;
+    int granularityBits = -1;
+    bool writeAllocate = true;
+    bool verbose = false;
+    char *traceFile = NULL;
+    bool useWorkload = false;
+    workload_config_t workloadConfig = {
+        .accesses = DEFAULT_WORKLOAD_ACCESSES,
+        .footprintLines = DEFAULT_WORKLOAD_LINES,
+        .writePercent = -1,
+        .seed = 1,
+    };
+    char *outputFile = NULL;
+    char *capturePrefix = NULL;
+    char *checkpointFile = NULL;
+    unsigned long warmupRecords = 0;
+    char *restoreFile = NULL;
+    int decoderThreads = DEFAULT_DECODER_THREADS;
+    ingest_stats_t ingest = { 0, 0, 0, false };
+    interleave_config_t interleaving = { .mode = INTERLEAVE_TRACE, .seeds = { 1 }, .numSeeds = 1 };
+    bool interleaved = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hvt:p:s:E:b:d:c:l:H:g:f:P:W:B:V:O:D:G:w:n:F:r:o:m:x:C:N:R:L:MS:I:K:j:Ae:i:X:Y:")) != -1) {
+        switch (opt) {
+            case 'h':
+                displayUsage();
+                return 0;
+            case 'v':
+                verbose = true;
+                break;
+            case 't':
+                traceFile = optarg;
+                break;
+            case 'p':
+                base.numProcessors = atoi(optarg);
+                break;
+            case 's':
+                base.s = (unsigned int)atoi(optarg);
+                break;
+            case 'E':
+                base.E = (unsigned int)atoi(optarg);
+                break;
+            case 'b':
+                base.b = (unsigned int)atoi(optarg);
+                break;
+            case 'd':
+                for (char *name = strtok(optarg, ","); name != NULL; name = strtok(NULL, ",")) {
+                    if (numSchemes == MAX_SYSTEMS || (schemes[numSchemes] = findDirectoryOps(name)) == NULL) {
+                        fprintf(stderr, "Unknown or too many directory schemes: %s\n", name);
+                        return 1;
+                    }
+                    numSchemes++;
+                }
+                break;
+            case 'c':
+                if (numCacheConfigs == MAX_CACHE_CONFIGS ||
+                    sscanf(optarg, "%u:%u:%u", &cacheConfigs[numCacheConfigs][0],
+                           &cacheConfigs[numCacheConfigs][1],
+                           &cacheConfigs[numCacheConfigs][2]) != 3) {
+                    fprintf(stderr, "Bad or too many cache configurations: %s\n", optarg);
+                    return 1;
+                }
+                numCacheConfigs++;
+                break;
+            case 'l':
+                base.directoryLines = atoi(optarg);
+                break;
+            case 'H':
+                if (!parseHomePolicy(optarg, &base.homePolicy)) {
+                    fprintf(stderr, "Unknown home policy: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'g':
+                granularityBits = atoi(optarg);
+                break;
+            case 'f':
+                for (char *hops = strtok(optarg, ","); hops != NULL; hops = strtok(NULL, ",")) {
+                    if (numForwardingModes == 2 || (strcmp(hops, "3") != 0 && strcmp(hops, "4") != 0)) {
+                        fprintf(stderr, "Hops must be 3 or 4: %s\n", hops);
+                        return 1;
+                    }
+                    forwardingModes[numForwardingModes++] = strcmp(hops, "3") == 0;
+                }
+                break;
+            case 'P':
+                for (char *name = strtok(optarg, ","); name != NULL; name = strtok(NULL, ",")) {
+                    if (numProtocols == 3 || !parseProtocol(name, &protocols[numProtocols])) {
+                        fprintf(stderr, "Unknown or too many protocols: %s\n", name);
+                        return 1;
+                    }
+                    numProtocols++;
+                }
+                break;
+            case 'W':
+                if (!parseWritePolicy(optarg, &base.writePolicy, &writeAllocate)) {
+                    fprintf(stderr, "Bad write policy: %s\n", optarg);
+                    return 1;
+                }
+                base.noWriteAllocate = !writeAllocate;
+                break;
+            case 'B':
+                if (!parseWriteBuffer(optarg, &base.writeBufferDepth, &base.writeBufferDrain)) {
+                    fprintf(stderr, "Bad write buffer: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'V':
+                base.victimLines = atoi(optarg);
+                if (base.victimLines < 0 || base.victimLines > MAX_VICTIM_LINES) {
+                    fprintf(stderr, "Victim cache lines must be 0 to %d\n", MAX_VICTIM_LINES);
+                    return 1;
+                }
+                break;
+            case 'O':
+                base.mshrs = atoi(optarg);
+                if (base.mshrs < 0 || base.mshrs > MAX_MSHRS) {
+                    fprintf(stderr, "MSHRs must be 0 to %d\n", MAX_MSHRS);
+                    return 1;
+                }
+                break;
+            case 'D':
+                if (!parseDramConfig(optarg, &base.dramBanks, &base.dramQueueDepth)) {
+                    fprintf(stderr, "Bad memory controller: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'G':
+                base.regionBits = (unsigned int)atoi(optarg);
+                break;
+            case 'x':
+                for (char *size = strtok(optarg, ","); size != NULL; size = strtok(NULL, ",")) {
+                    unsigned long bytes = strtoul(size, NULL, 0);
+                    if (numSectorSizes == MAX_SECTOR_SIZES || bytes < MIN_SECTOR_BYTES ||
+                        (bytes & (bytes - 1)) != 0) {
+                        fprintf(stderr, "Bad or too many sector sizes: %s\n", size);
+                        return 1;
+                    }
+                    sectorBits[numSectorSizes] = 0;
+                    while ((1UL << sectorBits[numSectorSizes]) < bytes) {
+                        sectorBits[numSectorSizes]++;
+                    }
+                    numSectorSizes++;
+                }
+                break;
+            case 'w':
+                if (!parseWorkloadKind(optarg, &workloadConfig.kind)) {
+                    fprintf(stderr, "Unknown workload: %s\n", optarg);
+                    return 1;
+                }
+                useWorkload = true;
+                break;
+            case 'n':
+                workloadConfig.accesses = strtoul(optarg, NULL, 0);
+                break;
+            case 'F':
+                workloadConfig.footprintLines = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                workloadConfig.seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'o':
+                outputFile = optarg;
+                break;
+            case 'm':
+                capturePrefix = optarg;
+                break;
+            case 'C':
+                checkpointFile = optarg;
+                break;
+            case 'N':
+                warmupRecords = strtoul(optarg, NULL, 0);
+                break;
+            case 'R':
+                restoreFile = optarg;
+                break;
+            case 'L':
+                base.profileTopLines = atoi(optarg);
+                break;
+            case 'M':
+                base.classifyMisses = true;
+                break;
+            case 'A':
+                base.accounting = true;
+                break;
+            case 'e':
+                if (!parseEnergyCosts(optarg, &base.energyCosts)) {
+                    fprintf(stderr, "Bad energy costs: %s\n", optarg);
+                    return 1;
+                }
+                base.accounting = true;
+                break;
+            case 'S':
+                base.statsPath = optarg;
+                break;
+            case 'j':
+                decoderThreads = atoi(optarg);
+                if (decoderThreads < 0 || decoderThreads > MAX_DECODER_THREADS) {
+                    fprintf(stderr, "Decoder threads must be 0 to %d\n", MAX_DECODER_THREADS);
+                    return 1;
+                }
+                break;
+            case 'K':
+                if (!parseCheckMode(optarg, &base.checkMode, &base.checkPeriod)) {
+                    fprintf(stderr, "Bad coherence checks: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'i':
+                if (!parseInterleaveMode(optarg, &interleaving)) {
+                    fprintf(stderr, "Bad interleaving: %s\n", optarg);
+                    return 1;
+                }
+                interleaved = true;
+                break;
+            case 'X':
+                interleaving.recordPath = optarg;
+                interleaved = true;
+                break;
+            case 'Y':
+                interleaving.replayPath = optarg;
+                interleaved = true;
+                break;
+            case 'I':
+                if (!parseIntervalPeriod(optarg, &base.statsPeriod, &base.statsUnit)) {
+                    fprintf(stderr, "Bad interval: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            default:
+                displayUsage();
+                return 1;
+        }
+    }
+
+    if (capturePrefix != NULL) {
+        if (outputFile == NULL) {
+            fprintf(stderr, "Merging a capture needs an output trace file (-o)\n");
+            return 1;
+        }
+        FILE *out = fopen(outputFile, "w");
+        if (out == NULL) {
+            perror(outputFile);
+            return 1;
+        }
+        long merged = mergeCapture(capturePrefix, out);
+        if (fclose(out) != 0 || merged < 0) {
+            fprintf(stderr, "Could not merge capture %s into %s\n", capturePrefix, outputFile);
+            return 1;
+        }
+        printf("Records: %ld\n", merged);
+        return 0;
+    }
+
+    workload_t *workload = NULL;
+    if (useWorkload) {
+        workloadConfig.numProcessors = base.numProcessors;
+        workloadConfig.lineBits = numCacheConfigs ? cacheConfigs[0][2] : base.b;
+        workload = createWorkload(&workloadConfig);
+        if (workload == NULL) {
+            fprintf(stderr, "Could not create workload %s\n", workloadKindName(workloadConfig.kind));
+            return 1;
+        }
+    }
+    if (workload != NULL && outputFile != NULL) {
+        FILE *out = fopen(outputFile, "w");
+        if (out == NULL) {
+            perror(outputFile);
+            return 1;
+        }
+        printf("Records: %lu\n", writeWorkloadTrace(workload, out));
+        fclose(out);
+        freeWorkload(workload);
+        return 0;
+    }
+    if (traceFile == NULL && workload == NULL) {
+        displayUsage();
+        return 1;
+    }
+    if (numSchemes == 0) {
+        schemes[numSchemes++] = base.dirOps;
+    }
+    if (numCacheConfigs == 0) {
+        cacheConfigs[0][0] = base.s;
+        cacheConfigs[0][1] = base.E;
+        cacheConfigs[0][2] = base.b;
+        numCacheConfigs = 1;
+    }
+    if (numForwardingModes == 0) {
+        forwardingModes[numForwardingModes++] = false;
+    }
+    if (numProtocols == 0) {
+        protocols[numProtocols++] = base.protocol;
+    }
+    if (numSectorSizes == 0) {
+        sectorBits[numSectorSizes++] = 0;
+    }
+    int numVariants = numSchemes * numForwardingModes * numProtocols * numSectorSizes;
+    if (numVariants * numCacheConfigs > MAX_SYSTEMS) {
+        fprintf(stderr, "At most %d systems can be compared\n", MAX_SYSTEMS);
+        return 1;
+    }
+    if ((checkpointFile != NULL || restoreFile != NULL) && workload != NULL) {
+        fprintf(stderr, "Checkpoints are taken on trace files; write the workload out with -o\n");
+        return 1;
+    }
+    if (checkpointFile != NULL && (numVariants * numCacheConfigs != 1 || warmupRecords == 0)) {
+        fprintf(stderr, "A checkpoint needs exactly one system and a warmup length (-N)\n");
+        return 1;
+    }
+    if (interleaved && (checkpointFile != NULL || restoreFile != NULL)) {
+        fprintf(stderr, "Interleaved runs start from an empty machine, not a checkpoint\n");
+        return 1;
+    }
+    if (interleaving.recordPath != NULL && interleaving.replayPath != NULL) {
+        fprintf(stderr, "An interleaving is either recorded or replayed\n");
+        return 1;
+    }
+    if ((interleaving.recordPath != NULL || interleaving.replayPath != NULL) &&
+        (numVariants * numCacheConfigs != 1 || interleaving.numSeeds != 1)) {
+        fprintf(stderr, "Recording or replaying an interleaving needs exactly one system and seed\n");
+        return 1;
+    }
+
+    trace_input_t *input = NULL;
+    FILE *trace = NULL;
+    if (workload == NULL) {
+        input = openTraceInput(traceFile);
+        if (input == NULL) {
+            return 1;
+        }
+        if (input->compression != TRACE_PLAIN && (checkpointFile != NULL || restoreFile != NULL)) {
+            fprintf(stderr, "Checkpoints need an uncompressed trace to seek in\n");
+            return 1;
+        }
+        // Compressed traces are always read through the pipeline
+        if (input->compression != TRACE_PLAIN && decoderThreads == 0) {
+            decoderThreads = 1;
+        }
+        trace = input->file;
+    }
+
+    if (base.statsPath != NULL) {
+        size_t length = strlen(base.statsPath);
+        base.statsFormat = length > 4 && strcmp(base.statsPath + length - 4, ".bin") == 0
+                               ? INTERVAL_BINARY : INTERVAL_CSV;
+    }
+    char statsPaths[MAX_SYSTEMS][STATS_PATH_LEN];
+
+    system_t *systems[MAX_SYSTEMS];
+    int numSystems = 0;
+    for (int c = 0; c < numCacheConfigs; c++) {
+        for (int v = 0; v < numVariants; v++) {
+            system_config_t config = base;
+            config.s = cacheConfigs[c][0];
+            config.E = cacheConfigs[c][1];
+            config.b = cacheConfigs[c][2];
+            config.dirOps = schemes[v / (numForwardingModes * numProtocols * numSectorSizes)];
+            config.forwarding =
+                forwardingModes[v / (numProtocols * numSectorSizes) % numForwardingModes];
+            config.protocol = protocols[v / numSectorSizes % numProtocols];
+            // A sector as large as the line leaves the line unsectored
+            config.sectorBits = sectorBits[v % numSectorSizes] < config.b
+                                    ? sectorBits[v % numSectorSizes] : 0;
+            if (granularityBits >= 0) {
+                config.homeGranularityBits = (unsigned int)granularityBits;
+            } else if (config.homePolicy == HOME_PAGE_INTERLEAVE ||
+                       config.homePolicy == HOME_FIRST_TOUCH) {
+                config.homeGranularityBits = DEFAULT_PAGE_BITS;
+            } else {
+                config.homeGranularityBits = config.b;
+            }
+            if (config.statsPath != NULL && numVariants * numCacheConfigs > 1) {
+                snprintf(statsPaths[numSystems], STATS_PATH_LEN, "%s.%d", config.statsPath,
+                         numSystems);
+                config.statsPath = statsPaths[numSystems];
+            }
+
+            systems[numSystems] = initializeSystem(&config);
+            if (systems[numSystems] == NULL) {
+                fprintf(stderr, "Could not create system %s s=%u E=%u b=%u\n",
+                        config.dirOps->name, config.s, config.E, config.b);
+                return 1;
+            }
+            numSystems++;
+        }
+    }
+
+    unsigned long resumedAfter = 0;
+    if (restoreFile != NULL) {
+        long offset = 0;
+        for (int i = 0; i < numSystems; i++) {
+            if (!restoreCheckpoint(systems[i], restoreFile, &resumedAfter, &offset)) {
+                fprintf(stderr, "Could not restore %s into %s\n", restoreFile, systems[i]->label);
+                return 1;
+            }
+        }
+        if (fseek(trace, offset, SEEK_SET) != 0) {
+            perror(traceFile);
+            return 1;
+        }
+    }
+    if (checkpointFile != NULL) {
+        unsigned long warmed = runLockstepUntil(trace, systems, 1, warmupRecords);
+        if (!saveCheckpoint(systems[0], checkpointFile, resumedAfter + warmed, ftell(trace))) {
+            fprintf(stderr, "Could not write checkpoint %s\n", checkpointFile);
+            return 1;
+        }
+        closeTraceInput(input);
+        printf("Checkpoint after %lu records: %s\n", resumedAfter + warmed, checkpointFile);
+        cleanupSystem(systems[0]);
+        return 0;
+    }
+
+    unsigned long records;
+    processor_streams_t *streams = NULL;
+    interleave_run_t run = { 0, 0, 0, 0, 0 };
+    if (interleaved) {
+        streams = loadStreams(input, workload);
+        freeWorkload(workload);
+        closeTraceInput(input);
+        if (streams == NULL) {
+            fprintf(stderr, "Could not read the trace into per-processor streams\n");
+            return 1;
+        }
+        for (int i = 0; i < numSystems; i++) {
+            if (!runInterleaving(streams, systems[i], &interleaving, interleaving.seeds[0], &run)) {
+                fprintf(stderr, "Could not interleave %s\n", systems[i]->label);
+                return 1;
+            }
+        }
+        records = run.records;
+    } else if (workload != NULL) {
+        records = runLockstepWorkload(workload, systems, numSystems);
+        freeWorkload(workload);
+    } else {
+        records = decoderThreads > 0
+                      ? runLockstepPipelined(input, systems, numSystems, decoderThreads, &ingest)
+                      : runLockstep(trace, systems, numSystems);
+        ingest.readFailed |= ferror(trace) != 0;
+        closeTraceInput(input);
+    }
+    if (ingest.readFailed) {
+        fprintf(stderr, "%s: could not read the trace past record %lu\n", traceFile, records);
+        for (int i = 0; i < numSystems; i++) {
+            cleanupSystem(systems[i]);
+        }
+        return 1;
+    }
+
+    seed_variance_t *variance = NULL;
+    if (streams != NULL) {
+        variance = measureSeedVariance(streams, systems, numSystems, &interleaving);
+        if (variance == NULL && interleaving.numSeeds > 1) {
+            fprintf(stderr, "Could not run the further seeds\n");
+            return 1;
+        }
+        freeStreams(streams);
+    }
+
+    unsigned long violations = 0;
+    for (int i = 0; i < numSystems; i++) {
+        finishSystem(systems[i]);
+        if (systems[i]->checker != NULL) {
+            checkMachine(systems[i]->checker, systems[i]);
+            violations += totalViolations(systems[i]->checker);
+        }
+    }
+
+    printf("Records: %lu\n", records);
+    if (verbose && ingest.batches != 0) {
+        printf("Ingest: %lu bytes in %lu batches, simulation waited for %lu\n",
+               ingest.bytesRead, ingest.batches, ingest.simulationWaits);
+    }
+    if (resumedAfter != 0) {
+        printf("Resumed after %lu records from %s\n", resumedAfter, restoreFile);
+    }
+    if (interleaving.replayPath != NULL) {
+        printf("Interleaving: replayed %lu runs from %s\n", run.runs, interleaving.replayPath);
+    } else if (interleaving.mode == INTERLEAVE_SEEDED) {
+        printf("Interleaving: seeded (seed %lu), contested arbitrations %lu of %lu, runs %lu\n",
+               interleaving.seeds[0], run.contested, run.arbitrations, run.runs);
+    } else if (interleaving.mode == INTERLEAVE_THREADS) {
+        printf("Interleaving: threads, runs %lu\n", run.runs);
+    }
+    if (interleaving.recordPath != NULL) {
+        printf("Interleaving log: %s, %ld bytes\n", interleaving.recordPath, run.logBytes);
+    }
+    if (verbose || numSystems == 1) {
+        for (int i = 0; i < numSystems; i++) {
+            printSystemSummary(systems[i]);
+        }
+    }
+    if (numSystems > 1) {
+        printComparison(systems, numSystems);
+    }
+    for (int i = 0; i < numSystems && !verbose && numSystems > 1; i++) {
+        if (systems[i]->checker != NULL) {
+            printf("%s: ", systems[i]->label);
+            printCheckerReport(systems[i]->checker);
+        }
+    }
+
+    if (variance != NULL) {
+        printSeedVariance(variance, systems);
+        freeSeedVariance(variance);
+    }
+
+    for (int i = 0; i < numSystems; i++) {
+        cleanupSystem(systems[i]);
+    }
+    return violations != 0 ? 2 : 0;
+}
@@ -0,0 +1,185 @@
+/**
+ * @file miss_classifier.c
+ * @brief Splits a cache's misses into cold, capacity, conflict and
+ *        coherence misses.
+ *
+ * A miss on a line the cache never referenced is cold. A miss on a line
+ * the directory took away is a coherence miss, split by the sharing
+ * profile into true and false sharing. The rest are capacity misses if a
+ * fully associative LRU cache of the same size would also have missed,
+ * and conflict misses otherwise.
+ */
+#include <stdlib.h>
+#include "miss_classifier.h"
+
+/** @brief Names used in reports, indexed by miss_class */
+static const char *const missClassNames[NUM_MISS_CLASSES] = {
+    "cold", "capacity", "conflict", "true sharing", "false sharing",
+};
+
+/**
+ * @brief Create a miss classifier for a cache of the given geometry.
+ *
+ * @param s                 number of set bits of the cache
+ * @param E                 associativity of the cache
+ * @param b                 number of block bits of the cache
+ * @return miss_classifier_t*   newly allocated classifier, NULL on failure
+ */
+miss_classifier_t *createMissClassifier(unsigned int s, unsigned int E, unsigned int b) {
+    unsigned long capacity = (1UL << s) * E;
+    if (capacity == 0 || capacity >= SHADOW_NONE) {
+        return NULL;
+    }
+    miss_classifier_t *classifier = calloc(1, sizeof(miss_classifier_t));
+    if (classifier == NULL) {
+        return NULL;
+    }
+    classifier->lineBits = b;
+    classifier->capacity = (unsigned int)capacity;
+    classifier->mru = SHADOW_NONE;
+    classifier->lru = SHADOW_NONE;
+    classifier->shadow = malloc(capacity * sizeof(shadow_line_t));
+    classifier->blocks = createLineTable(sizeof(unsigned int), capacity);
+    if (classifier->shadow == NULL || classifier->blocks == NULL) {
+        freeMissClassifier(classifier);
+        return NULL;
+    }
+    return classifier;
+}
+
+/**
+ * @brief Take a shadow line out of the LRU list
+ *
+ * @param classifier
+ * @param index
+ */
+static void unlinkShadowLine(miss_classifier_t *classifier, unsigned int index) {
+    shadow_line_t *line = &classifier->shadow[index];
+    if (line->prev != SHADOW_NONE) {
+        classifier->shadow[line->prev].next = line->next;
+    } else {
+        classifier->mru = line->next;
+    }
+    if (line->next != SHADOW_NONE) {
+        classifier->shadow[line->next].prev = line->prev;
+    } else {
+        classifier->lru = line->prev;
+    }
+}
+
+/**
+ * @brief Put a shadow line at the most recently used end of the list
+ *
+ * @param classifier
+ * @param index
+ */
+static void pushShadowLine(miss_classifier_t *classifier, unsigned int index) {
+    shadow_line_t *line = &classifier->shadow[index];
+    line->prev = SHADOW_NONE;
+    line->next = classifier->mru;
+    if (classifier->mru != SHADOW_NONE) {
+        classifier->shadow[classifier->mru].prev = index;
+    } else {
+        classifier->lru = index;
+    }
+    classifier->mru = index;
+}
+
+/**
+ * @brief Reference a block in the shadow cache
+ *
+ * @param classifier
+ * @param block
+ * @param position          the block's entry in classifier->blocks
+ * @return bool             whether the shadow cache held the block
+ */
+static bool shadowAccess(miss_classifier_t *classifier, unsigned long block,
+                         unsigned int *position) {
+    if (*position != SHADOW_NONE) {
+        if (*position != classifier->mru) {
+            unlinkShadowLine(classifier, *position);
+            pushShadowLine(classifier, *position);
+        }
+        return true;
+    }
+
+    unsigned int index;
+    if (classifier->used < classifier->capacity) {
+        index = classifier->used++;
+    } else {
+        index = classifier->lru;
+        unlinkShadowLine(classifier, index);
+        // Blocks stay in the table after leaving the shadow cache: they are not cold any more
+        unsigned int *victim = lineTableFind(classifier->blocks, classifier->shadow[index].block);
+        if (victim != NULL) {
+            *victim = SHADOW_NONE;
+        }
+    }
+    classifier->shadow[index].block = block;
+    pushShadowLine(classifier, index);
+    *position = index;
+    return false;
+}
+
+/**
+ * @brief Record one access of the cache and classify it if it missed.
+ *
+ * Hits are needed too, to keep the shadow cache in step with the real one.
+ *
+ * @param classifier
+ * @param address
+ * @param missed            the access missed in the real cache
+ * @param coherence         what the sharing profile made of the access
+ * @return miss_class       cause of the miss, NUM_MISS_CLASSES on a hit
+ */
+miss_class classifyAccess(miss_classifier_t *classifier, unsigned long address, bool missed,
+                          profile_miss_kind coherence) {
+    unsigned long block = address >> classifier->lineBits;
+    bool firstReference = false;
+    unsigned int *position = lineTableInsert(classifier->blocks, block, &firstReference);
+    if (position == NULL) {
+        return missed ? MISS_CAPACITY : NUM_MISS_CLASSES;
+    }
+    if (firstReference) {
+        *position = SHADOW_NONE;
+    }
+    bool shadowHit = shadowAccess(classifier, block, position);
+
+    if (!missed) {
+        return NUM_MISS_CLASSES;
+    }
+    if (firstReference) {
+        return MISS_COLD;
+    }
+    if (coherence == PROFILE_TRUE_SHARING) {
+        return MISS_TRUE_SHARING;
+    }
+    if (coherence == PROFILE_FALSE_SHARING) {
+        return MISS_FALSE_SHARING;
+    }
+    return shadowHit ? MISS_CONFLICT : MISS_CAPACITY;
+}
+
+/**
+ * @brief Name of a miss class, for reports.
+ *
+ * @param missClass
+ * @return const char*
+ */
+const char *missClassName(miss_class missClass) {
+    return (missClass >= 0 && missClass < NUM_MISS_CLASSES)
+               ? missClassNames[missClass] : "unknown";
+}
+
+/**
+ * @brief Free a miss classifier.
+ *
+ * @param classifier
+ */
+void freeMissClassifier(miss_classifier_t *classifier) {
+    if (classifier != NULL) {
+        free(classifier->shadow);
+        freeLineTable(classifier->blocks);
+        free(classifier);
+    }
+}
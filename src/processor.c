@@ -1,11 +1,528 @@
 /**
  * @file processor.c
- * @brief Implement a processor. 
+ * @brief Implement a processor.
+ *
+ * A processor plays two roles in the protocol: it is the home node for the
+ * lines its memory holds, and it owns a private cache that the home nodes
+ * send invalidations, fetches and forwarded requests to. The cache side
+ * follows MSI, MESI or MOESI; the directory side adapts its grants.
+ *
+ * Every message carries the cycles elapsed since its transaction started,
+ * so the acknowledgement that completes a miss tells the requester the
+ * latency along the critical path.
  */
+#include "processor.h"
 
 /**
- * Process a message 
+ * @brief Send a message from this processor, choosing whether it carries data
+ *
+ * @param processor
+ * @param type
+ * @param destId
+ * @param address
+ * @param requesterId       processor whose miss started the transaction
+ * @param latency           cycles since the transaction started
+ * @param withData          the message carries a sector of data
+ */
+static void sendDataMessage(processor_t* processor, message_type type, int destId,
+                            unsigned long address, int requesterId, unsigned long latency,
+                            bool withData) {
+    message_t message;
+    message.type = type;
+    message.sourceId = processor->processor_id;
+    message.destId = destId;
+    message.address = address;
+    message.requesterId = requesterId;
+    message.latency = latency;
+    message.dataBytes = withData ? 1U << processor->cache->sectorBits : 0;
+    interconnectSendMessage(processor->interconnect, message);
+}
+
+/**
+ * @brief Send a message from this processor
+ *
+ * @param processor
+ * @param type
+ * @param destId
+ * @param address
+ * @param requesterId       processor whose miss started the transaction
+ * @param latency           cycles since the transaction started
+ */
+static void sendMessage(processor_t* processor, message_type type, int destId,
+                        unsigned long address, int requesterId, unsigned long latency) {
+    sendDataMessage(processor, type, destId, address, requesterId, latency,
+                    messageCarriesData(type));
+}
+
+/**
+ * @brief Directory block number of an address
+ *
+ * The directory tracks sectors, which are whole lines unless the caches
+ * are sectored.
+ *
+ * @param processor
+ * @param address
+ * @return unsigned long
+ */
+static unsigned long blockOf(processor_t* processor, unsigned long address) {
+    return address >> processor->cache->sectorBits;
+}
+
+/**
+ * @brief Invalidate every sharer of a line except the requester
+ *
+ * @param home
+ * @param message           request being handled
+ * @return bool             true if any invalidation was sent
+ */
+static bool invalidateSharers(processor_t* home, message_t* message) {
+    sharer_set_t sharers;
+    bool sent = false;
+    home->dirOps->getSharers(home->directory, blockOf(home, message->address), &sharers);
+    for (int i = 0; i < home->interconnect->numNodes; i++) {
+        if (i != message->requesterId && sharerSetHas(&sharers, i)) {
+            sendMessage(home, INVALIDATE, i, message->address, message->requesterId,
+                        message->latency);
+            sent = true;
+        }
+    }
+    return sent;
+}
+
+/**
+ * @brief Record a new sharer, invalidating whoever lost their pointer
+ *
+ * @param home
+ * @param message           request being handled
+ * @param processorId
+ */
+static void addSharer(processor_t* home, message_t* message, int processorId) {
+    int dropped = home->dirOps->addSharer(home->directory, blockOf(home, message->address),
+                                          processorId);
+    if (dropped >= 0 && dropped != processorId) {
+        sendMessage(home, INVALIDATE, dropped, message->address, message->requesterId,
+                    message->latency);
+    }
+}
+
+/**
+ * @brief Reset the reply tracking before the home sends requests of its own
+ *
+ * @param home
+ * @param message           request being handled
+ */
+static void beginTransaction(processor_t* home, message_t* message) {
+    home->replyLatency = message->latency;
+    home->lastReply = NUM_MESSAGE_TYPES;
+    home->replyHadData = false;
+}
+
+/**
+ * @brief Cycle a request reaches the home node, on the requester's clock
+ *
+ * The requester's clock has not yet been charged for the transaction in
+ * progress.
+ *
+ * @param home
+ * @param message
+ * @return unsigned long
+ */
+static unsigned long arrivalCycle(processor_t* home, message_t* message) {
+    return home->interconnect->processors[message->requesterId].cache->cycleCount +
+           message->latency;
+}
+
+/**
+ * @brief Read a line from the home's memory
+ *
+ * @param home
+ * @param message           request being handled
+ * @return unsigned long    cycles until memory supplies the line
+ */
+static unsigned long memoryRead(processor_t* home, message_t* message) {
+    home->memoryReads++;
+    if (home->dram == NULL) {
+        return MISS_CYCLES;
+    }
+    return dramAccess(home->dram, message->address, arrivalCycle(home, message), false);
+}
+
+/**
+ * @brief Write a line back to the home's memory, off the critical path
+ *
+ * @param home
+ * @param message           message carrying the data
+ */
+static void memoryWrite(processor_t* home, message_t* message) {
+    home->memoryWrites++;
+    if (home->dram != NULL) {
+        dramAccess(home->dram, message->address, arrivalCycle(home, message), true);
+    }
+}
+
+/**
+ * @brief Forward a request to the owner of a line
+ *
+ * @param home
+ * @param message           request being handled
+ * @param type              FORWARD_READ or FORWARD_WRITE
+ * @param owner
+ * @return bool             true if the owner answered the requester
+ */
+static bool forwardToOwner(processor_t* home, message_t* message, message_type type, int owner) {
+    home->forwardCount++;
+    sendMessage(home, type, owner, message->address, message->requesterId, message->latency);
+    return home->lastReply != NACK;
+}
+
+/**
+ * @brief Home node handling of a read miss
+ *
+ * If another cache owns the line, the home either fetches it back and
+ * replies itself (request, fetch, writeback, reply: four hops), or
+ * forwards the request so the owner replies directly (three hops). Under
+ * MOESI a dirty owner keeps the line as OWNED and memory is not updated.
+ * Under MESI and MOESI a reader of an uncached line gets it EXCLUSIVE.
+ *
+ * @param home
+ * @param message
+ */
+static void handleReadRequest(processor_t* home, message_t* message) {
+    unsigned long block = blockOf(home, message->address);
+    int requesterId = message->requesterId;
+    int owner;
+    directory_state state = home->dirOps->getState(home->directory, block, &owner);
+    unsigned long latency = message->latency;
+
+    beginTransaction(home, message);
+    if ((state == DIR_EXCLUSIVE_MODIFIED || state == DIR_OWNED) &&
+        owner >= 0 && owner != requesterId) {
+        if (home->forwarding) {
+            if (forwardToOwner(home, message, FORWARD_READ, owner)) {
+                addSharer(home, message, owner);
+                addSharer(home, message, requesterId);
+                home->dirOps->setState(home->directory, block, owner,
+                                       home->lastReply == OWNED_ACK ? DIR_OWNED : DIR_SHARED);
+                return;
+            }
+            // The owner had already dropped the line; memory is up to date
+        } else {
+            sendMessage(home, FETCH, owner, message->address, requesterId, message->latency);
+            addSharer(home, message, owner);
+            if (home->replyHadData) {
+                addSharer(home, message, requesterId);
+                home->dirOps->setState(home->directory, block, owner,
+                                       home->lastReply == DATA_REPLY ? DIR_OWNED : DIR_SHARED);
+                sendMessage(home, READ_ACKNOWLEDGE, requesterId, message->address, requesterId,
+                            home->replyLatency);
+                return;
+            }
+            // A clean EXCLUSIVE owner kept a shared copy; memory supplies the data
+            latency = home->replyLatency;
+            state = DIR_SHARED;
+        }
+    }
+
+    unsigned long supplied = message->latency + memoryRead(home, message);
+    if (latency < supplied) {
+        latency = supplied;
+    }
+    if (state == DIR_UNCACHED && home->cache->protocol != PROTOCOL_MSI) {
+        home->dirOps->setState(home->directory, block, requesterId, DIR_EXCLUSIVE_MODIFIED);
+        addSharer(home, message, requesterId);
+        sendMessage(home, EXCLUSIVE_ACKNOWLEDGE, requesterId, message->address, requesterId,
+                    latency);
+        return;
+    }
+    addSharer(home, message, requesterId);
+    home->dirOps->setState(home->directory, block, requesterId, DIR_SHARED);
+    sendMessage(home, READ_ACKNOWLEDGE, requesterId, message->address, requesterId, latency);
+}
+
+/**
+ * @brief Home node handling of a write miss or a write to a shared line
+ *
+ * @param home
+ * @param message
+ */
+static void handleWriteRequest(processor_t* home, message_t* message) {
+    unsigned long block = blockOf(home, message->address);
+    int requesterId = message->requesterId;
+    int owner;
+    directory_state state = home->dirOps->getState(home->directory, block, &owner);
+    sharer_set_t sharers;
+    home->dirOps->getSharers(home->directory, block, &sharers);
+    bool hasCopy = sharerSetHas(&sharers, requesterId);
+
+    beginTransaction(home, message);
+    if (state == DIR_EXCLUSIVE_MODIFIED && owner >= 0 && owner != requesterId &&
+        home->forwarding) {
+        if (forwardToOwner(home, message, FORWARD_WRITE, owner)) {
+            home->dirOps->invalidate(home->directory, block);
+            home->dirOps->setState(home->directory, block, requesterId, DIR_EXCLUSIVE_MODIFIED);
+            addSharer(home, message, requesterId);
+            return;
+        }
+    } else if (state != DIR_UNCACHED) {
+        // Includes the owner, whose reply carries the data if it was dirty
+        invalidateSharers(home, message);
+    }
+    home->dirOps->invalidate(home->directory, block);
+    home->dirOps->setState(home->directory, block, requesterId, DIR_EXCLUSIVE_MODIFIED);
+    addSharer(home, message, requesterId);
+
+    unsigned long latency = home->replyLatency;
+    if (!hasCopy && !home->replyHadData) {
+        unsigned long supplied = message->latency + memoryRead(home, message);
+        if (supplied > latency) {
+            latency = supplied;
+        }
+    }
+    // An upgrade from a shared copy needs no data
+    sendDataMessage(home, WRITE_ACKNOWLEDGE, requesterId, message->address, requesterId, latency,
+                    !hasCopy);
+}
+
+/**
+ * @brief Home node handling of stores written through without ownership
+ *
+ * The other copies are invalidated, a dirty owner writing its data back
+ * first, and memory takes the stores. A writer that holds a copy keeps
+ * it: as the owner if it already was one, otherwise shared.
+ *
+ * @param home
+ * @param message
+ */
+static void handleWriteThrough(processor_t* home, message_t* message) {
+    unsigned long block = blockOf(home, message->address);
+    int requesterId = message->requesterId;
+    int owner;
+    directory_state state = home->dirOps->getState(home->directory, block, &owner);
+    sharer_set_t sharers;
+    home->dirOps->getSharers(home->directory, block, &sharers);
+    bool hasCopy = sharerSetHas(&sharers, requesterId);
+
+    beginTransaction(home, message);
+    if (state != DIR_UNCACHED) {
+        invalidateSharers(home, message);
+    }
+    home->dirOps->invalidate(home->directory, block);
+    if (hasCopy) {
+        bool isOwner = (state == DIR_EXCLUSIVE_MODIFIED || state == DIR_OWNED) &&
+                       owner == requesterId;
+        home->dirOps->setState(home->directory, block, requesterId,
+                               isOwner ? state : DIR_SHARED);
+        addSharer(home, message, requesterId);
+    }
+    memoryWrite(home, message);
+    sendMessage(home, WRITE_THROUGH_ACK, requesterId, message->address, requesterId,
+                home->replyLatency);
+}
+
+/**
+ * @brief Whether a cache state holds data newer than memory
+ *
+ * @param state
+ * @return bool
+ */
+static bool isDirtyState(block_state state) {
+    return state == MODIFIED || state == OWNED;
+}
+
+/**
+ * @brief Cache handling of an invalidation or fetch from a home node
+ *
+ * Dirty data goes back to the home with WRITE_UPDATE, or with DATA_REPLY
+ * when MOESI lets it bypass memory; a clean line is just acknowledged.
+ *
+ * @param processor
+ * @param message
+ */
+static void handleOwnershipRequest(processor_t* processor, message_t* message) {
+    bool moesi = processor->cache->protocol == PROTOCOL_MOESI;
+    block_state previous;
+    if (message->type == FETCH) {
+        previous = cacheDowngradeLine(processor->cache, message->address);
+    } else {
+        previous = cacheInvalidateLine(processor->cache, message->address);
+    }
+
+    message_type reply = INVALIDATE_ACK;
+    if (isDirtyState(previous)) {
+        reply = moesi ? DATA_REPLY : WRITE_UPDATE;
+    }
+    sendMessage(processor, reply, message->sourceId, message->address, message->requesterId,
+                message->latency);
+}
+
+/**
+ * @brief Owner handling of a request forwarded by the home node
+ *
+ * The owner supplies the line straight to the requester and tells the
+ * home node what happened, off the critical path.
+ *
+ * @param processor
+ * @param message
+ */
+static void handleForwardedRequest(processor_t* processor, message_t* message) {
+    bool isRead = message->type == FORWARD_READ;
+    bool moesi = processor->cache->protocol == PROTOCOL_MOESI;
+    block_state previous = isRead ? cacheDowngradeLine(processor->cache, message->address)
+                                  : cacheInvalidateLine(processor->cache, message->address);
+    if (previous == INVALID) {
+        sendMessage(processor, NACK, message->sourceId, message->address,
+                    message->requesterId, message->latency);
+        return;
+    }
+    sendMessage(processor, isRead ? READ_ACKNOWLEDGE : WRITE_ACKNOWLEDGE, message->requesterId,
+                message->address, message->requesterId, message->latency);
+
+    message_type notice = OWNERSHIP_TRANSFER;
+    if (isRead && isDirtyState(previous)) {
+        notice = moesi ? OWNED_ACK : SHARING_WRITEBACK;
+    }
+    sendMessage(processor, notice, message->sourceId, message->address, message->requesterId,
+                message->latency);
+}
+
+/**
+ * @brief Home node handling of a request in a region private to its requester
+ *
+ * No other cache can hold the line, so memory serves the request without
+ * the directory being read or given an entry. A reader is granted the line
+ * as it would be if the directory found it uncached.
+ *
+ * @param home
+ * @param message           READ_REQUEST, WRITE_REQUEST or WRITE_THROUGH
+ * @return bool             false if the request must go through the directory
+ */
+static bool handlePrivateRequest(processor_t* home, message_t* message) {
+    if (home->regions == NULL) {
+        return false;
+    }
+    int requesterId = message->requesterId;
+    cache_t* requester = home->interconnect->processors[requesterId].cache;
+    bool hasCopy = cacheLineState(requester, message->address) != INVALID;
+    bool fills = message->type != WRITE_THROUGH && !hasCopy;
+    if (!regionMiss(home->regions, requesterId, message->address, fills, &message->latency)) {
+        return false;
+    }
+
+    if (message->type == WRITE_THROUGH) {
+        memoryWrite(home, message);
+        sendMessage(home, WRITE_THROUGH_ACK, requesterId, message->address, requesterId,
+                    message->latency);
+        return true;
+    }
+    unsigned long latency = message->latency;
+    if (!hasCopy) {
+        latency += memoryRead(home, message);
+    }
+    if (message->type == WRITE_REQUEST) {
+        sendDataMessage(home, WRITE_ACKNOWLEDGE, requesterId, message->address, requesterId,
+                        latency, !hasCopy);
+    } else {
+        sendMessage(home, home->cache->protocol == PROTOCOL_MSI ? READ_ACKNOWLEDGE
+                                                                 : EXCLUSIVE_ACKNOWLEDGE,
+                    requesterId, message->address, requesterId, latency);
+    }
+    return true;
+}
+
+/**
+ * @brief Track the latest reply to the transaction in progress
+ *
+ * @param home
+ * @param message
+ */
+static void recordReply(processor_t* home, message_t* message) {
+    if (message->latency > home->replyLatency) {
+        home->replyLatency = message->latency;
+    }
+    home->lastReply = message->type;
+    if (message->type == WRITE_UPDATE || message->type == DATA_REPLY) {
+        home->replyHadData = true;
+    }
+}
+
+/**
+ * Process a message
 */
 void processMessage(processor_t* processor, message_t* message) {
+    switch (message->type) {
+        // Requests arriving at the home node
+        case READ_REQUEST:
+            if (handlePrivateRequest(processor, message)) {
+                break;
+            }
+            processor->directoryLookups++;
+            handleReadRequest(processor, message);
+            break;
+        case WRITE_REQUEST:
+            if (handlePrivateRequest(processor, message)) {
+                break;
+            }
+            processor->directoryLookups++;
+            handleWriteRequest(processor, message);
+            break;
+        case WRITE_THROUGH:
+            if (handlePrivateRequest(processor, message)) {
+                break;
+            }
+            processor->directoryLookups++;
+            handleWriteThrough(processor, message);
+            break;
+        case WRITE_UPDATE:
+            // The sender no longer holds the line modified (or at all)
+            memoryWrite(processor, message);
+            recordReply(processor, message);
+            // fall through
+        case EVICTION_NOTICE:
+            if (processor->regions != NULL &&
+                regionEviction(processor->regions, message->sourceId, message->address)) {
+                break;
+            }
+            processor->directoryLookups++;
+            processor->dirOps->removeSharer(processor->directory,
+                                            blockOf(processor, message->address),
+                                            message->sourceId);
+            break;
+        case SHARING_WRITEBACK:
+            memoryWrite(processor, message);
+            recordReply(processor, message);
+            break;
+        case INVALIDATE_ACK:
+        case DATA_REPLY:
+        case OWNERSHIP_TRANSFER:
+        case OWNED_ACK:
+        case NACK:
+            recordReply(processor, message);
+            break;
 
+        // Requests arriving at the cache
+        case INVALIDATE:
+        case FETCH:
+            processor->cacheProbes++;
+            handleOwnershipRequest(processor, message);
+            break;
+        case FORWARD_READ:
+        case FORWARD_WRITE:
+            processor->cacheProbes++;
+            handleForwardedRequest(processor, message);
+            break;
+        case READ_ACKNOWLEDGE:
+            cacheCompleteMiss(processor->cache, message->address, SHARED, message->latency);
+            break;
+        case EXCLUSIVE_ACKNOWLEDGE:
+            cacheCompleteMiss(processor->cache, message->address, EXCLUSIVE, message->latency);
+            break;
+        case WRITE_ACKNOWLEDGE:
+            cacheCompleteMiss(processor->cache, message->address, MODIFIED, message->latency);
+            break;
+        case WRITE_THROUGH_ACK:
+            cacheCompleteWrite(processor->cache, message->latency);
+            break;
+        default:
+            break;
+    }
 }
@@ -8,24 +8,40 @@
  * @return Queue* 
  */
 Queue* createQueue() {
+    return createBoundedQueue(0);
+}
+
+/**
+ * @brief Create a Queue object whose enqueue blocks while it is full
+ * 
+ * @param capacity          most elements held at once, 0 for no limit
+ * @return Queue* 
+ */
+Queue* createBoundedQueue(int capacity) {
     Queue* q = (Queue*)malloc(sizeof(Queue));
     if (q) {
         q->front = q->rear = NULL;
         q->size = 0;
+        q->capacity = capacity;
+        q->closed = false;
         pthread_mutex_init(&q->lock, NULL);
         pthread_cond_init(&q->cond, NULL);
+        pthread_cond_init(&q->notFull, NULL);
     }
     return q;
 }
 
 /**
- * @brief Add an element to the queue
+ * @brief Add an element to the queue, waiting for room if it is bounded
  * 
  * @param q 
  * @param data 
  */
 void enqueue(Queue* q, void* data) {
     pthread_mutex_lock(&q->lock);
+    while (q->capacity > 0 && q->size >= q->capacity && !q->closed) {
+        pthread_cond_wait(&q->notFull, &q->lock);
+    }
 
     QueueNode* newNode = (QueueNode*)malloc(sizeof(QueueNode));
     if (newNode == NULL) {
@@ -51,14 +67,20 @@ void enqueue(Queue* q, void* data) {
 /**
  * @brief Remove and return the front element from the queue
  * 
+ * Waits while the queue is empty.
+ * 
  * @param q 
- * @return void* 
+ * @return void*            NULL once the queue is closed and empty
  */
 void* dequeue(Queue* q) {
     pthread_mutex_lock(&q->lock);
-    while (q->size == 0) {
+    while (q->size == 0 && !q->closed) {
         pthread_cond_wait(&q->cond, &q->lock);
     }
+    if (q->size == 0) {
+        pthread_mutex_unlock(&q->lock);
+        return NULL;
+    }
 
     QueueNode* temp = q->front;
     void* data = temp->data;
@@ -69,10 +91,26 @@ void* dequeue(Queue* q) {
     free(temp);
     q->size--;
 
+    pthread_cond_signal(&q->notFull);
     pthread_mutex_unlock(&q->lock);
     return data;
 }
 
+/**
+ * @brief Mark the queue as having no more elements to come
+ * 
+ * Waiting consumers drain what is left and then get NULL.
+ * 
+ * @param q 
+ */
+void closeQueue(Queue* q) {
+    pthread_mutex_lock(&q->lock);
+    q->closed = true;
+    pthread_cond_broadcast(&q->cond);
+    pthread_cond_broadcast(&q->notFull);
+    pthread_mutex_unlock(&q->lock);
+}
+
 /**
  * @brief Peek the front element of the queue without removing it
  * 
@@ -114,13 +152,15 @@ bool isQueueEmpty(const Queue* q) {
  * @param q 
  */
 void freeQueue(Queue* q) {
-    pthread_mutex_lock(&q->lock);
-    while (!isQueueEmpty(q)) {
-        dequeue(q);
+    // The nodes are freed directly: dequeue would take the lock again
+    while (q->front != NULL) {
+        QueueNode* temp = q->front;
+        q->front = temp->next;
+        free(temp);
     }
-    pthread_mutex_unlock(&q->lock);
 
     pthread_mutex_destroy(&q->lock);
     pthread_cond_destroy(&q->cond);
+    pthread_cond_destroy(&q->notFull);
     free(q);
 }
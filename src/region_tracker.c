@@ -0,0 +1,242 @@
+/**
+ * @file region_tracker.c
+ * @brief Coarse regions private to one core, whose misses skip the directory.
+ *
+ * A region never goes back to private once shared: the lines the second
+ * core brought in are in the directory, and only invalidating every copy
+ * would make the directory's view of the region redundant again.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "processor.h"
+#include "region_tracker.h"
+
+/**
+ * @brief Create a region tracker with no region known.
+ *
+ * @param regionBits        log2 of the region size in bytes, at least sectorBits
+ * @param sectorBits        log2 of the coherence unit in bytes
+ * @param processors        caches and directory slices of the machine
+ * @param homeMap           places the lines handed over on their homes
+ * @return region_tracker_t*  newly allocated tracker, NULL on failure
+ */
+region_tracker_t *createRegionTracker(unsigned int regionBits, unsigned int sectorBits,
+                                      struct processor *processors, home_map_t *homeMap) {
+    region_tracker_t *tracker = calloc(1, sizeof(region_tracker_t));
+    if (tracker == NULL) {
+        return NULL;
+    }
+    tracker->regionBits = regionBits;
+    tracker->sectorBits = sectorBits;
+    tracker->processors = processors;
+    tracker->homeMap = homeMap;
+    tracker->regions = createLineTable(sizeof(region_t), REGION_INITIAL_REGIONS);
+    if (tracker->regions == NULL) {
+        free(tracker);
+        return NULL;
+    }
+    return tracker;
+}
+
+/**
+ * @brief Probe a region's core for the lines it holds and enter them in
+ *        their directories, then track the region line by line.
+ *
+ * @param tracker
+ * @param number            region number
+ * @param region
+ */
+static void makeShared(region_tracker_t *tracker, unsigned long number, region_t *region) {
+    int owner = region->owner;
+    region->owner = -1;
+    tracker->sharedRegions++;
+    if (owner < 0) {
+        return;
+    }
+    tracker->privateRegions--;
+    processor_t *processor = &tracker->processors[owner];
+    processor->cacheProbes++;
+
+    unsigned long start = number << tracker->regionBits;
+    unsigned long end = start + (1UL << tracker->regionBits);
+    for (unsigned long address = start; address < end; address += 1UL << tracker->sectorBits) {
+        block_state state = cacheLineState(processor->cache, address);
+        if (state == INVALID) {
+            continue;
+        }
+        processor_t *home = &tracker->processors[homeNode(tracker->homeMap, address, owner)];
+        unsigned long block = address >> tracker->sectorBits;
+        directory_state dirState = DIR_EXCLUSIVE_MODIFIED;
+        if (state == SHARED) {
+            dirState = DIR_SHARED;
+        } else if (state == OWNED) {
+            dirState = DIR_OWNED;
+        }
+        home->dirOps->setState(home->directory, block, owner, dirState);
+        home->dirOps->addSharer(home->directory, block, owner);
+        home->directoryLookups++;
+        tracker->handedOver++;
+        if (tracker->untrackedLines > 0) {
+            tracker->untrackedLines--;
+        }
+    }
+}
+
+/**
+ * @brief Look up the region of a miss at its home node.
+ *
+ * The first core to miss in a region gets it private. A miss by any
+ * other core shares the region, at the cost of a probe of the first core.
+ *
+ * @param tracker
+ * @param requesterId
+ * @param address
+ * @param fills             the miss brings the line into the requester's cache
+ * @param latency           cycles since the miss started, the probe is added to it
+ * @return bool             true if the miss can skip the directory
+ */
+bool regionMiss(region_tracker_t *tracker, int requesterId, unsigned long address, bool fills,
+                unsigned long *latency) {
+    unsigned long number = address >> tracker->regionBits;
+    bool created;
+    region_t *region = lineTableInsert(tracker->regions, number, &created);
+    if (region == NULL) {
+        tracker->trackedMisses++;
+        return false;
+    }
+    if (created) {
+        region->owner = requesterId;
+        tracker->privateRegions++;
+    }
+    if (region->owner == requesterId) {
+        tracker->filteredMisses++;
+        if (fills && ++tracker->untrackedLines > tracker->peakUntrackedLines) {
+            tracker->peakUntrackedLines = tracker->untrackedLines;
+        }
+        return true;
+    }
+    if (region->owner >= 0) {
+        makeShared(tracker, number, region);
+        *latency += REGION_PROBE_CYCLES;
+    }
+    tracker->trackedMisses++;
+    return false;
+}
+
+/**
+ * @brief Look up the region of an eviction notice or writeback at its home node.
+ *
+ * @param tracker
+ * @param processorId       core that replaced the line
+ * @param address
+ * @return bool             true if the line was never in the directory
+ */
+bool regionEviction(region_tracker_t *tracker, int processorId, unsigned long address) {
+    region_t *region = lineTableFind(tracker->regions, address >> tracker->regionBits);
+    if (region == NULL || region->owner != processorId) {
+        return false;
+    }
+    tracker->filteredNotices++;
+    if (tracker->untrackedLines > 0) {
+        tracker->untrackedLines--;
+    }
+    return true;
+}
+
+/**
+ * @brief Whether an address lies in a region private to one core.
+ *
+ * @param tracker
+ * @param address
+ * @param owner             filled in with the core, if private
+ * @return bool
+ */
+bool regionPrivateTo(region_tracker_t *tracker, unsigned long address, int *owner) {
+    region_t *region = lineTableFind(tracker->regions, address >> tracker->regionBits);
+    if (region == NULL || region->owner < 0) {
+        return false;
+    }
+    *owner = region->owner;
+    return true;
+}
+
+/**
+ * @brief Track the region of an address line by line from now on.
+ *
+ * A restored checkpoint calls this for every line its directories hold,
+ * so no core claims a region other cores have lines of.
+ *
+ * @param tracker
+ * @param address
+ */
+void shareRegion(region_tracker_t *tracker, unsigned long address) {
+    unsigned long number = address >> tracker->regionBits;
+    bool created;
+    region_t *region = lineTableInsert(tracker->regions, number, &created);
+    if (region == NULL) {
+        return;
+    }
+    if (created) {
+        region->owner = -1;
+        tracker->sharedRegions++;
+    } else if (region->owner >= 0) {
+        makeShared(tracker, number, region);
+    }
+}
+
+/**
+ * @brief Share one region if it is private
+ *
+ * @param arg               region_tracker_t
+ * @param number
+ * @param entry             region_t
+ */
+static void shareIfPrivate(void *arg, unsigned long number, void *entry) {
+    region_t *region = entry;
+    if (region->owner >= 0) {
+        makeShared(arg, number, region);
+    }
+}
+
+/**
+ * @brief Enter the lines of every private region in the directories.
+ *
+ * Checkpoints hold the directories only, so they are taken after this.
+ *
+ * @param tracker
+ */
+void shareAllRegions(region_tracker_t *tracker) {
+    lineTableForEach(tracker->regions, shareIfPrivate, tracker);
+}
+
+/**
+ * @brief Print the misses filtered and the directory entries saved.
+ *
+ * @param tracker
+ * @param directoryEntries  entries the directories hold at the end
+ */
+void printRegionTracker(const region_tracker_t *tracker, unsigned long directoryEntries) {
+    unsigned long misses = tracker->filteredMisses + tracker->trackedMisses;
+    unsigned long perLine = directoryEntries + tracker->untrackedLines;
+    printf("Regions: %lu private, %lu shared, %lu bytes each; misses that skipped the "
+           "directory: %lu of %lu (%.1f%%), evictions: %lu, lines handed to the directory: %lu\n",
+           tracker->privateRegions, tracker->sharedRegions, 1UL << tracker->regionBits,
+           tracker->filteredMisses, misses,
+           misses ? 100.0 * tracker->filteredMisses / misses : 0.0, tracker->filteredNotices,
+           tracker->handedOver);
+    printf("  directory entries saved: %lu at the end (%.1f%% of %lu), %lu at the peak\n",
+           tracker->untrackedLines, perLine ? 100.0 * tracker->untrackedLines / perLine : 0.0,
+           perLine, tracker->peakUntrackedLines);
+}
+
+/**
+ * @brief Free a region tracker.
+ *
+ * @param tracker
+ */
+void freeRegionTracker(region_tracker_t *tracker) {
+    if (tracker != NULL) {
+        freeLineTable(tracker->regions);
+        free(tracker);
+    }
+}
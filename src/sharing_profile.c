@@ -0,0 +1,359 @@
+/**
+ * @file sharing_profile.c
+ * @brief Per-line sharing pattern profiler with word-granularity false
+ *        sharing detection.
+ *
+ * Every line keeps who read and wrote it and, per word, who touched it
+ * last and when it was last written. When a processor misses on a line
+ * whose copy the directory invalidated, the miss is true sharing if the
+ * word it now wants was written by someone else since the invalidation,
+ * and false sharing otherwise: the line only moved because of other words
+ * in it, which padding or splitting the data structure would fix.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "sharing_profile.h"
+
+/** @brief Names used in reports, indexed by sharing_class */
+static const char *const sharingClassNames[NUM_SHARING_CLASSES] = {
+    "private", "read-only", "producer-consumer", "migratory", "widely-shared",
+};
+
+/**
+ * @brief Create a sharing profile.
+ *
+ * @param numProcessors
+ * @param lineBits          log2 of the cache line size in bytes
+ * @return sharing_profile_t*   newly allocated profile, NULL on failure
+ */
+sharing_profile_t *createSharingProfile(int numProcessors, unsigned int lineBits) {
+    sharing_profile_t *profile = calloc(1, sizeof(sharing_profile_t));
+    if (profile == NULL) {
+        return NULL;
+    }
+    profile->numProcessors = numProcessors;
+    profile->lineBits = lineBits;
+    profile->wordsPerLine = (1U << lineBits) / PROFILE_WORD_BYTES;
+    if (profile->wordsPerLine == 0) {
+        profile->wordsPerLine = 1;
+    } else if (profile->wordsPerLine > PROFILE_MAX_WORDS) {
+        profile->wordsPerLine = PROFILE_MAX_WORDS;
+    }
+
+    profile->lines = createLineTable(sizeof(line_profile_t) +
+                                     profile->wordsPerLine * sizeof(profile_word_t),
+                                     PROFILE_INITIAL_LINES);
+    bool ok = profile->lines != NULL;
+    for (int i = 0; ok && i < numProcessors; i++) {
+        profile->lostCopies[i] = createLineTable(sizeof(unsigned long), LINE_TABLE_MIN_SLOTS);
+        ok = profile->lostCopies[i] != NULL;
+    }
+    if (!ok) {
+        freeSharingProfile(profile);
+        return NULL;
+    }
+    return profile;
+}
+
+/**
+ * @brief Word history that follows a line profile
+ *
+ * @param line
+ * @return profile_word_t*
+ */
+static profile_word_t *lineWords(line_profile_t *line) {
+    return (profile_word_t *)(line + 1);
+}
+
+/**
+ * @brief Word of the line an address falls in
+ *
+ * @param profile
+ * @param address
+ * @return unsigned int
+ */
+static unsigned int wordOf(const sharing_profile_t *profile, unsigned long address) {
+    unsigned long offset = address & ((1UL << profile->lineBits) - 1);
+    unsigned long word = offset / PROFILE_WORD_BYTES;
+    return word < profile->wordsPerLine ? (unsigned int)word : profile->wordsPerLine - 1;
+}
+
+/**
+ * @brief Record one access after the cache has handled it.
+ *
+ * @param profile
+ * @param processorId
+ * @param address
+ * @param isWrite
+ * @param missed            the access missed in the processor's cache
+ * @return profile_miss_kind    whether the miss came from a lost copy, and of which kind
+ */
+profile_miss_kind profileAccess(sharing_profile_t *profile, int processorId,
+                                unsigned long address, bool isWrite, bool missed) {
+    unsigned long block = address >> profile->lineBits;
+    unsigned long now = profile->clock++;
+    bool created;
+    line_profile_t *line = lineTableInsert(profile->lines, block, &created);
+    if (line == NULL) {
+        return PROFILE_NOT_COHERENCE;
+    }
+    profile_word_t *words = lineWords(line);
+    if (created) {
+        line->lastWriter = -1;
+        line->lastAccessor = -1;
+        for (unsigned int i = 0; i < profile->wordsPerLine; i++) {
+            words[i].lastWriter = -1;
+            words[i].lastAccessor = -1;
+        }
+    }
+    unsigned int wordIndex = wordOf(profile, address);
+    profile_word_t *word = &words[wordIndex];
+    unsigned long wordBit = 1UL << wordIndex;
+
+    profile_miss_kind kind = PROFILE_NOT_COHERENCE;
+    unsigned long *lostAt = missed ? lineTableFind(profile->lostCopies[processorId], block) : NULL;
+    if (lostAt != NULL) {
+        bool trueSharing = word->lastWriter >= 0 && word->lastWriter != processorId &&
+                           word->lastWriteTime >= *lostAt;
+        lineTableRemove(profile->lostCopies[processorId], block);
+        profile->coherenceMisses++;
+        if (trueSharing) {
+            line->trueSharingMisses++;
+            profile->trueSharingMisses++;
+            kind = PROFILE_TRUE_SHARING;
+        } else {
+            line->falseSharingMisses++;
+            profile->falseSharingMisses++;
+            kind = PROFILE_FALSE_SHARING;
+        }
+    }
+
+    if (word->lastAccessor >= 0 && word->lastAccessor != processorId) {
+        line->sharedWords |= wordBit;
+    }
+    word->lastAccessor = processorId;
+
+    if (isWrite) {
+        line->writes++;
+        sharerSetAdd(&line->writers, processorId);
+        line->writtenWords |= wordBit;
+        if (line->lastWriter >= 0 && line->lastWriter != processorId) {
+            line->writerChanges++;
+            if (line->lastAccessor == processorId && line->lastAccessWasRead) {
+                line->migratoryHandoffs++;
+            }
+        }
+        line->lastWriter = processorId;
+        word->lastWriter = processorId;
+        word->lastWriteTime = now;
+    } else {
+        line->reads++;
+        sharerSetAdd(&line->readers, processorId);
+    }
+    line->lastAccessor = processorId;
+    line->lastAccessWasRead = !isWrite;
+    return kind;
+}
+
+/**
+ * @brief Record that the directory invalidated a processor's copy of a line.
+ *
+ * @param profile
+ * @param processorId       processor that lost its copy
+ * @param address
+ */
+void profileInvalidation(sharing_profile_t *profile, int processorId, unsigned long address) {
+    unsigned long block = address >> profile->lineBits;
+    unsigned long *lostAt = lineTableInsert(profile->lostCopies[processorId], block, NULL);
+    if (lostAt != NULL) {
+        // Invalidations happen while the access that caused them is handled
+        *lostAt = profile->clock;
+    }
+    line_profile_t *line = lineTableFind(profile->lines, block);
+    if (line != NULL) {
+        line->invalidations++;
+    }
+}
+
+/**
+ * @brief Number of processors in the union of two sharer sets
+ *
+ * @param a
+ * @param b
+ * @return int
+ */
+static int unionCount(const sharer_set_t *a, const sharer_set_t *b) {
+    int count = 0;
+    for (int i = 0; i < SHARER_WORDS; i++) {
+        count += __builtin_popcountl(a->bits[i] | b->bits[i]);
+    }
+    return count;
+}
+
+/**
+ * @brief Sharing pattern of a line from its whole history.
+ *
+ * @param profile
+ * @param line
+ * @return sharing_class
+ */
+sharing_class classifyLine(const sharing_profile_t *profile, const line_profile_t *line) {
+    (void)profile;
+    if (unionCount(&line->readers, &line->writers) <= 1) {
+        return SHARING_PRIVATE;
+    }
+    int writers = sharerSetCount(&line->writers);
+    if (writers == 0) {
+        return SHARING_READ_ONLY;
+    }
+    if (writers == 1) {
+        return SHARING_PRODUCER_CONSUMER;
+    }
+    if (2 * line->migratoryHandoffs >= line->writerChanges) {
+        return SHARING_MIGRATORY;
+    }
+    return SHARING_WIDELY_SHARED;
+}
+
+/**
+ * @brief Name of a sharing class, for reports.
+ *
+ * @param sharingClass
+ * @return const char*
+ */
+const char *sharingClassName(sharing_class sharingClass) {
+    return (sharingClass >= 0 && sharingClass < NUM_SHARING_CLASSES)
+               ? sharingClassNames[sharingClass] : "unknown";
+}
+
+/**
+ * @brief One line kept for the top offenders list
+ *
+ */
+typedef struct ranked_line {
+    unsigned long block;
+    line_profile_t line;
+} ranked_line_t;
+
+/**
+ * @brief Totals and top offenders gathered by one pass over the lines
+ *
+ */
+typedef struct profile_report {
+    const sharing_profile_t *profile;
+    unsigned long lines[NUM_SHARING_CLASSES];
+    unsigned long accesses[NUM_SHARING_CLASSES];
+    unsigned long invalidations[NUM_SHARING_CLASSES];
+    unsigned long falseSharingMisses[NUM_SHARING_CLASSES];
+    ranked_line_t *top;
+    int topCount;
+    int topLines;
+} profile_report_t;
+
+/**
+ * @brief Whether one line offends more than another
+ *
+ * @param a
+ * @param b
+ * @return bool
+ */
+static bool offendsMore(const line_profile_t *a, const line_profile_t *b) {
+    if (a->invalidations != b->invalidations) {
+        return a->invalidations > b->invalidations;
+    }
+    return a->falseSharingMisses > b->falseSharingMisses;
+}
+
+/**
+ * @brief Add one line to the report
+ *
+ * @param arg               profile_report_t
+ * @param block
+ * @param entry             line_profile_t
+ */
+static void reportLine(void *arg, unsigned long block, void *entry) {
+    profile_report_t *report = arg;
+    const line_profile_t *line = entry;
+    sharing_class sharingClass = classifyLine(report->profile, line);
+    report->lines[sharingClass]++;
+    report->accesses[sharingClass] += line->reads + line->writes;
+    report->invalidations[sharingClass] += line->invalidations;
+    report->falseSharingMisses[sharingClass] += line->falseSharingMisses;
+
+    if (line->invalidations == 0 || report->topLines == 0) {
+        return;
+    }
+    // Insertion into the small sorted list of worst lines
+    int position = report->topCount;
+    if (position == report->topLines) {
+        if (!offendsMore(line, &report->top[position - 1].line)) {
+            return;
+        }
+        position--;
+    } else {
+        report->topCount++;
+    }
+    while (position > 0 && offendsMore(line, &report->top[position - 1].line)) {
+        report->top[position] = report->top[position - 1];
+        position--;
+    }
+    report->top[position].block = block;
+    report->top[position].line = *line;
+}
+
+/**
+ * @brief Print the sharing classes and the lines invalidated most often.
+ *
+ * @param profile
+ * @param topLines          number of lines to list
+ */
+void printSharingProfile(sharing_profile_t *profile, int topLines) {
+    profile_report_t report;
+    memset(&report, 0, sizeof(report));
+    report.profile = profile;
+    report.topLines = topLines > 0 ? topLines : 0;
+    report.top = calloc(report.topLines ? report.topLines : 1, sizeof(ranked_line_t));
+    if (report.top == NULL) {
+        report.topLines = 0;
+    }
+    lineTableForEach(profile->lines, reportLine, &report);
+
+    printf("Sharing profile: %lu coherence misses (true sharing: %lu, false sharing: %lu)\n",
+           profile->coherenceMisses, profile->trueSharingMisses, profile->falseSharingMisses);
+    printf("  %-18s %10s %12s %14s %14s\n", "class", "lines", "accesses", "invalidations",
+           "false sharing");
+    for (int c = 0; c < NUM_SHARING_CLASSES; c++) {
+        printf("  %-18s %10lu %12lu %14lu %14lu\n", sharingClassName(c), report.lines[c],
+               report.accesses[c], report.invalidations[c], report.falseSharingMisses[c]);
+    }
+
+    if (report.topCount > 0) {
+        printf("  Most invalidated lines:\n");
+        printf("  %-18s %-18s %7s %7s %13s %8s %8s %18s\n", "address", "class", "readers",
+               "writers", "invalidations", "true", "false", "shared words");
+    }
+    for (int i = 0; i < report.topCount; i++) {
+        const line_profile_t *line = &report.top[i].line;
+        printf("  %-18lx %-18s %7d %7d %13lu %8lu %8lu %18lx\n",
+               report.top[i].block << profile->lineBits,
+               sharingClassName(classifyLine(profile, line)), sharerSetCount(&line->readers),
+               sharerSetCount(&line->writers), line->invalidations, line->trueSharingMisses,
+               line->falseSharingMisses, line->sharedWords);
+    }
+    free(report.top);
+}
+
+/**
+ * @brief Free a sharing profile.
+ *
+ * @param profile
+ */
+void freeSharingProfile(sharing_profile_t *profile) {
+    if (profile != NULL) {
+        freeLineTable(profile->lines);
+        for (int i = 0; i < profile->numProcessors; i++) {
+            freeLineTable(profile->lostCopies[i]);
+        }
+        free(profile);
+    }
+}
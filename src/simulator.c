@@ -0,0 +1,170 @@
+/**
+ * @file simulator.c
+ * @brief Library interface for embedding the simulator in other programs.
+ *
+ * The handle wraps a system_t; every piece of simulator state hangs off
+ * it, so the library needs no globals and no locking of its own.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "simulator.h"
+
+/**
+ * @brief A simulated machine behind an opaque handle
+ *
+*/
+struct simulator {
+    system_t *sys;
+    bool finished;              // Misses in flight have been let complete
+};
+
+/**
+ * @brief Fill in the configuration the command line starts from.
+ *
+ * 4 processors of 64 sets of 4 lines of 64 bytes, a central directory,
+ * line-interleaved homes, 4-hop MSI with write-back caches and flat
+ * memory latency.
+ *
+ * @param config
+ */
+void defaultSimulatorConfig(system_config_t *config) {
+    memset(config, 0, sizeof(*config));
+    config->numProcessors = NUM_PROCESSORS;
+    config->s = 6;
+    config->E = 4;
+    config->b = 6;
+    config->dirOps = &centralDirectoryOps;
+    config->directoryLines = NUM_LINES;
+    config->homePolicy = HOME_LINE_INTERLEAVE;
+    config->homeGranularityBits = config->b;
+    config->protocol = PROTOCOL_MSI;
+    config->writePolicy = POLICY_WRITE_BACK;
+    config->statsUnit = INTERVAL_ACCESSES;
+    config->statsPeriod = DEFAULT_STATS_PERIOD;
+    defaultEnergyCosts(&config->energyCosts);
+}
+
+/**
+ * @brief Create a simulator.
+ *
+ * @param config            copied, so the caller may reuse it
+ * @return simulator_t*     newly allocated simulator, NULL if the configuration is invalid
+ */
+simulator_t *createSimulator(const system_config_t *config) {
+    simulator_t *sim = calloc(1, sizeof(simulator_t));
+    if (sim == NULL) {
+        return NULL;
+    }
+    sim->sys = initializeSystem(config);
+    if (sim->sys == NULL) {
+        free(sim);
+        return NULL;
+    }
+    return sim;
+}
+
+/**
+ * @brief Simulate a batch of records, in order, after every earlier batch.
+ *
+ * @param sim
+ * @param records
+ * @param count
+ * @return size_t           records simulated, leaving out those naming a
+ *                          processor that does not exist
+ */
+size_t simulateBatch(simulator_t *sim, const access_t *records, size_t count) {
+    unsigned long dropped = sim->sys->droppedCount;
+    simulateAccesses(sim->sys, records, count);
+    return count - (size_t)(sim->sys->droppedCount - dropped);
+}
+
+/**
+ * @brief Let the misses still in flight complete after the last batch.
+ *
+ * Only non-blocking caches have any; their clocks then include the last
+ * fills. With coherence checking on, every cached line is checked too.
+ *
+ * @param sim
+ */
+void finishSimulator(simulator_t *sim) {
+    if (sim->finished) {
+        return;
+    }
+    finishSystem(sim->sys);
+    if (sim->sys->checker != NULL) {
+        checkMachine(sim->sys->checker, sim->sys);
+    }
+    sim->finished = true;
+}
+
+/**
+ * @brief Copy out the counters of a simulator.
+ *
+ * @param sim
+ * @param stats             filled in
+ */
+void simulatorStats(const simulator_t *sim, simulator_stats_t *stats) {
+    const system_t *sys = sim->sys;
+    const interconnect_t *net = sys->interconnect;
+    memset(stats, 0, sizeof(*stats));
+    stats->numProcessors = sys->config.numProcessors;
+    stats->accesses = sys->accessCount;
+    stats->dropped = sys->droppedCount;
+    stats->cycles = machineCycles(sys);
+    stats->averageMissLatency = averageMissLatency(sys);
+    stats->messages = interconnectTotalMessages(net);
+    stats->remoteMessages = net->remoteMessages;
+    stats->networkBytes = interconnectTotalBytes(net);
+    memcpy(stats->messageCount, net->messageCount, sizeof(stats->messageCount));
+    stats->violations = sys->checker != NULL ? totalViolations(sys->checker) : 0;
+    stats->atomicHandoffs = sys->syncProfile->handoffs;
+    stats->contendedAtomics = sys->syncProfile->contended;
+    for (int i = 0; i < sys->config.numProcessors; i++) {
+        const processor_t *processor = &sys->processors[i];
+        const cache_t *C = processor->cache;
+        simulator_node_stats_t *node = &stats->nodes[i];
+        node->hits = C->hitCount;
+        node->misses = C->missCount;
+        node->upgrades = C->upgradeCount;
+        node->evictions = C->evictionCount;
+        node->invalidations = C->invalidationCount;
+        node->cycles = C->cycleCount;
+        node->memoryReads = processor->memoryReads;
+        node->memoryWrites = processor->memoryWrites;
+        node->directoryLookups = processor->directoryLookups;
+        node->atomics = C->atomicCount;
+        node->fences = C->fenceCount;
+    }
+}
+
+/**
+ * @brief Scheme and cache configuration of a simulator, for reports.
+ *
+ * @param sim
+ * @return const char*      valid until the simulator is destroyed
+ */
+const char *simulatorLabel(const simulator_t *sim) {
+    return sim->sys->label;
+}
+
+/**
+ * @brief Print the full summary the command line prints for a system.
+ *
+ * @param sim
+ */
+void printSimulatorSummary(const simulator_t *sim) {
+    printSystemSummary(sim->sys);
+}
+
+/**
+ * @brief Free a simulator and everything it owns.
+ *
+ * @param sim
+ */
+void destroySimulator(simulator_t *sim) {
+    if (sim == NULL) {
+        return;
+    }
+    cleanupSystem(sim->sys);
+    free(sim);
+}
@@ -8,9 +8,6 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
-#include <unistd.h>
-#include <getopt.h>
-#include <assert.h>
 #include "single_cache.h"
 
 
@@ -20,12 +17,14 @@
  * @param s                 number of set bits in the address
  * @param e                 number of lines in each set
  * @param b                 number of block bits in the address
+ * @param sectorBits        log2 of the sector size, b for unsectored lines
  * @param processor_id      processor number to identify cache 
  * @return cache_t*         newly allocated Cache
  */
-cache_t *initializeCache(unsigned int s, unsigned int e, unsigned int b, int processor_id) {
+cache_t *initializeCache(unsigned int s, unsigned int e, unsigned int b, unsigned int sectorBits,
+                         int processor_id) {
     unsigned int S = 1U << s;
-    if (e == 0) {
+    if (e == 0 || sectorBits > b || (1UL << (b - sectorBits)) > MAX_SECTORS) {
         return NULL;
     }
     cache_t *new = malloc(sizeof(cache_t));
@@ -33,13 +32,45 @@ cache_t *initializeCache(unsigned int s, unsigned int e, unsigned int b, int pro
         return NULL;
     }
     new->processor_id = processor_id;
+    new->interconnect = NULL;
+    new->homeMap = NULL;
+    new->profile = NULL;
+    new->writePolicy = POLICY_WRITE_BACK;
+    new->writeAllocate = true;
+    new->writeBuffer = NULL;
+    new->victims = NULL;
+    new->mshrs = NULL;
+    new->numMSHRs = 0;
     new->S = s;
     new->E = e;
     new->B = b;
+    new->sectorBits = sectorBits;
+    new->numSectors = 1UL << (b - sectorBits);
     new->hitCount = 0;
     new->missCount = 0;
+    new->sectorMissCount = 0;
     new->evictionCount = 0;
     new->dirtyEvictionCount = 0;
+    new->localMissCount = 0;
+    new->remoteMissCount = 0;
+    new->protocol = PROTOCOL_MSI;
+    new->upgradeCount = 0;
+    new->silentUpgradeCount = 0;
+    new->writebacksAvoided = 0;
+    new->invalidationCount = 0;
+    new->cycleCount = 0;
+    new->missLatencyCycles = 0;
+    new->writeThroughCount = 0;
+    new->unallocatedWriteCount = 0;
+    new->writeStallCycles = 0;
+    new->writeLatency = 0;
+    new->victimHitCount = 0;
+    new->victimMissCount = 0;
+    new->secondaryMissCount = 0;
+    new->secondaryStallCycles = 0;
+    new->mshrFullStalls = 0;
+    new->mshrStallCycles = 0;
+    memset(new->missClassCount, 0, sizeof(new->missClassCount));
 
     // Initialize sets
     new->setList = (set_t *)malloc(S * sizeof(set_t));
@@ -49,51 +80,22 @@ cache_t *initializeCache(unsigned int s, unsigned int e, unsigned int b, int pro
     }
     for (unsigned int i = 0; i < S; i++) {
         new->setList[i].lines = (line_t *)malloc(e * sizeof(line_t));
+        new->setList[i].sectors = (sector_t *)calloc(e * new->numSectors, sizeof(sector_t));
         new->setList[i].lruCounter = (unsigned long *)malloc(e * sizeof(unsigned long));
-        // Initialize lines 
+        new->setList[i].maxLines = e;
+        // Initialize lines; calloc left every sector invalid
         for (unsigned int j = 0; j < e; j++) {
             new->setList[i].lines[j].lineNum = j;
+            new->setList[i].lines[j].tag = 0;
             new->setList[i].lines[j].valid = false;
-             new->setList[i].lines[j].isDirty = false;
+            new->setList[i].lines[j].sectors = &new->setList[i].sectors[j * new->numSectors];
             new->setList[i].lruCounter[j] = 0;
         }
     }
 
-    /*
-    Ensure that each cache and directory instance can communicate with 
-    the interconnect. This might involve passing a reference to the 
-    interconnect to each cache and directory upon their initialization.
-    */
-
     return new; 
 }
 
-/**
- * @brief Simulates the execution of an instruction by a processor.
- * 
- * @param cache         Cache struct for a given processor
- * @param line          Line from tracefile
- */
-void executeInstruction(cache_t *cache, char *line) {
-    char instruction;
-    unsigned long address;
-    int processor_id;  // Used only for write instructions
-
-    sscanf(line, "%d %c %lx", &processor_id, &instruction, &address);
-
-    switch(instruction) {
-        case 'R':
-            readFromCache(cache, address);
-            break;
-        case 'W':
-            writeToCache(cache, address);
-            break;
-        default:
-            // Invalid instruction type
-            break;
-    }
-}
-
 
 /**
  * @brief Update the counters to implement LRU 
@@ -110,34 +112,505 @@ void updateLRUCounter(set_t *set, unsigned long lineNum) {
     set->lruCounter[lineNum] = 0;
 }
 
-
 /**
- * @brief Handles read operations from the processor's cache.
+ * @brief Find the line holding an address.
  * 
  * @param cache             Cache struct for a given processor
- * @param address           Address of memory being read
- * @return int 
+ * @param address           Address of memory being looked up
+ * @param setOut            filled in with the set the address maps to
+ * @return line_t*          the valid line holding the address, NULL on a miss
  */
-int readFromCache(cache_t *cache, unsigned long address) {
+static line_t *findLine(cache_t *cache, unsigned long address, set_t **setOut) {
     unsigned long setIndex = (address >> cache->B) & ((1UL << cache->S) - 1);
     unsigned long tag = address >> (cache->B + cache->S);
     set_t *set = &cache->setList[setIndex];
-    bool hit = false;
-    unsigned long hitLineIndex = 0;
 
-    // Check if the address is in cache
+    if (setOut != NULL) {
+        *setOut = set;
+    }
     for (unsigned int i = 0; i < set->maxLines; i++) {
         if (set->lines[i].valid && set->lines[i].tag == tag) {
-            // Cache hit
-            hit = true;
-            hitLineIndex = i;
+            return &set->lines[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Sector of a line an address falls in
+ * 
+ * @param cache 
+ * @param line 
+ * @param address 
+ * @return sector_t* 
+ */
+static sector_t *sectorOf(const cache_t *cache, line_t *line, unsigned long address) {
+    return &line->sectors[(address >> cache->sectorBits) & (cache->numSectors - 1)];
+}
+
+/**
+ * @brief Find the line holding an address in the victim cache.
+ * 
+ * @param cache 
+ * @param address 
+ * @return victim_line_t*   NULL if there is no victim cache or it does not hold the line
+ */
+static victim_line_t *findVictim(cache_t *cache, unsigned long address) {
+    if (cache->victims == NULL) {
+        return NULL;
+    }
+    unsigned long block = address >> cache->B;
+    for (unsigned long i = 0; i < cache->victims->numLines; i++) {
+        victim_line_t *victim = &cache->victims->lines[i];
+        if (victim->valid && victim->block == block) {
+            return victim;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Find the sector an address falls in, in its set or in the victim
+ *        cache.
+ * 
+ * @param cache 
+ * @param address 
+ * @param lineOut           filled in with the line in the set, NULL if in the victim cache
+ * @param victimOut         filled in with the victim cache line, NULL if in the set
+ * @return sector_t*        NULL if neither holds the line
+ */
+static sector_t *locateSector(cache_t *cache, unsigned long address, line_t **lineOut,
+                              victim_line_t **victimOut) {
+    *lineOut = findLine(cache, address, NULL);
+    *victimOut = NULL;
+    if (*lineOut != NULL) {
+        return sectorOf(cache, *lineOut, address);
+    }
+    *victimOut = findVictim(cache, address);
+    if (*victimOut != NULL) {
+        return &(*victimOut)->sectors[(address >> cache->sectorBits) & (cache->numSectors - 1)];
+    }
+    return NULL;
+}
+
+/**
+ * @brief Find the valid sector holding an address.
+ * 
+ * @param cache 
+ * @param address 
+ * @return sector_t*        NULL if the line or the sector is not cached
+ */
+static sector_t *findSector(cache_t *cache, unsigned long address) {
+    line_t *line;
+    victim_line_t *victim;
+    sector_t *sector = locateSector(cache, address, &line, &victim);
+    return sector != NULL && sector->valid ? sector : NULL;
+}
+
+/**
+ * @brief Whether any sector of a line is valid
+ * 
+ * @param cache 
+ * @param sectors 
+ * @return bool 
+ */
+static bool anySectorValid(const cache_t *cache, const sector_t *sectors) {
+    for (unsigned long i = 0; i < cache->numSectors; i++) {
+        if (sectors[i].valid) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Find the processor whose memory holds the address.
+ * 
+ * @param cache             Cache struct for the requesting processor
+ * @param address           Address of memory being accessed
+ * @return int              Home node of the address
+ */
+static int addrProcessor(cache_t *cache, unsigned long address) {
+    if (cache->homeMap == NULL) {
+        return cache->processor_id;
+    }
+    return homeNode(cache->homeMap, address, cache->processor_id);
+}
+
+/**
+ * @brief Send a message about a line to its home node.
+ * 
+ * @param cache             Cache struct for the sending processor
+ * @param type              Message type
+ * @param address           Address of the line
+ * @param home              Home node of the line
+ */
+static void sendToHome(cache_t *cache, message_type type, unsigned long address, int home) {
+    message_t message;
+    message.type = type;
+    message.sourceId = cache->processor_id;
+    message.destId = home;
+    message.address = address & ~((1UL << cache->sectorBits) - 1);
+    message.requesterId = cache->processor_id;
+    message.latency = 0;
+    message.dataBytes = messageCarriesData(type) ? 1U << cache->sectorBits : 0;
+    interconnectSendMessage(cache->interconnect, message);
+}
+
+/**
+ * @brief Add cycles the core spent waiting for its stores.
+ * 
+ * @param cache 
+ * @param cycles 
+ */
+static void stallForWrites(cache_t *cache, unsigned long cycles) {
+    cache->cycleCount += cycles;
+    cache->writeStallCycles += cycles;
+}
+
+/**
+ * @brief Wait until a miss status holding register is free.
+ * 
+ * @param cache 
+ */
+static void waitForMSHR(cache_t *cache) {
+    if (cache->mshrs == NULL) {
+        return;
+    }
+    unsigned long firstReady = ~0UL;
+    for (unsigned long i = 0; i < cache->numMSHRs; i++) {
+        if (cache->mshrs[i].readyAt <= cache->cycleCount) {
+            return;
+        }
+        if (cache->mshrs[i].readyAt < firstReady) {
+            firstReady = cache->mshrs[i].readyAt;
+        }
+    }
+    cache->mshrFullStalls++;
+    cache->mshrStallCycles += firstReady - cache->cycleCount;
+    cache->cycleCount = firstReady;
+}
+
+/**
+ * @brief Wait for the fill of a sector that is still in flight.
+ * 
+ * The access is a secondary miss: it joins the outstanding miss instead of
+ * sending a request, and the core stalls until the fill arrives.
+ * 
+ * @param cache 
+ * @param address 
+ * @return bool             true if the sector was still being filled
+ */
+static bool waitForFill(cache_t *cache, unsigned long address) {
+    unsigned long block = address >> cache->sectorBits;
+    for (unsigned long i = 0; i < cache->numMSHRs; i++) {
+        if (cache->mshrs[i].readyAt > cache->cycleCount && cache->mshrs[i].block == block) {
+            cache->secondaryMissCount++;
+            cache->secondaryStallCycles += cache->mshrs[i].readyAt - cache->cycleCount;
+            cache->cycleCount = cache->mshrs[i].readyAt;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Send stores to a sector on to its home node.
+ * 
+ * @param cache 
+ * @param block             sector number
+ * @param wordMask          words of the sector the stores wrote
+ * @return unsigned long    cycles until the home node acknowledged them
+ */
+static unsigned long writeThrough(cache_t *cache, unsigned long block, unsigned long wordMask) {
+    unsigned long address = block << cache->sectorBits;
+    unsigned long bytes = (unsigned long)__builtin_popcountl(wordMask) * WRITE_BUFFER_WORD_BYTES;
+    message_t message;
+    message.type = WRITE_THROUGH;
+    message.sourceId = cache->processor_id;
+    message.destId = addrProcessor(cache, address);
+    message.address = address;
+    message.requesterId = cache->processor_id;
+    message.latency = 0;
+    message.dataBytes = bytes < (1UL << cache->sectorBits) ? bytes : 1U << cache->sectorBits;
+    cache->writeThroughCount++;
+    cache->writeLatency = 0;
+    interconnectSendMessage(cache->interconnect, message);
+    return cache->writeLatency;
+}
+
+/**
+ * @brief Write through the oldest entry of the write buffer.
+ * 
+ * @param cache 
+ * @return unsigned long    cycles the write-through took
+ */
+static unsigned long drainOldest(cache_t *cache) {
+    write_buffer_entry_t *entry = writeBufferOldest(cache->writeBuffer);
+    unsigned long latency = writeThrough(cache, entry->block, entry->wordMask);
+    writeBufferPop(cache->writeBuffer);
+    return latency;
+}
+
+/**
+ * @brief Drain entries that have waited long enough under the timed
+ *        policy, off the core's critical path.
+ * 
+ * @param cache 
+ */
+static void drainExpired(cache_t *cache) {
+    write_buffer_t *buffer = cache->writeBuffer;
+    if (buffer == NULL || buffer->drain != DRAIN_AFTER_DELAY) {
+        return;
+    }
+    write_buffer_entry_t *entry;
+    while ((entry = writeBufferOldest(buffer)) != NULL &&
+           cache->cycleCount - entry->enqueuedAt >= WRITE_BUFFER_DRAIN_DELAY) {
+        drainOldest(cache);
+    }
+}
+
+/**
+ * @brief Make a load wait until buffered stores to its sector have drained.
+ * 
+ * Entries drain in order, so everything older goes first; the load waits
+ * for the slowest of them.
+ * 
+ * @param cache 
+ * @param address 
+ */
+static void drainForLoad(cache_t *cache, unsigned long address) {
+    write_buffer_t *buffer = cache->writeBuffer;
+    unsigned long block = address >> cache->sectorBits;
+    if (buffer == NULL || writeBufferFind(buffer, block) == NULL) {
+        return;
+    }
+    buffer->loadDrains++;
+    unsigned long waited = 0;
+    bool drained = false;
+    while (!drained) {
+        drained = writeBufferOldest(buffer)->block == block;
+        unsigned long latency = drainOldest(cache);
+        if (latency > waited) {
+            waited = latency;
+        }
+    }
+    stallForWrites(cache, waited);
+}
+
+/**
+ * @brief Send a store on to the home node, through the write buffer if
+ *        there is one.
+ * 
+ * A store to a sector already in the buffer is merged into its entry. A
+ * store that finds the buffer full waits for the oldest entry to drain;
+ * without a buffer every store waits for its own write-through.
+ * 
+ * @param cache 
+ * @param address 
+ */
+static void bufferStore(cache_t *cache, unsigned long address) {
+    unsigned long block = address >> cache->sectorBits;
+    unsigned long word = (address & ((1UL << cache->sectorBits) - 1)) / WRITE_BUFFER_WORD_BYTES;
+    unsigned long wordBit = 1UL << (word < 64 ? word : 63);
+    write_buffer_t *buffer = cache->writeBuffer;
+    if (buffer == NULL) {
+        stallForWrites(cache, writeThrough(cache, block, wordBit));
+        return;
+    }
+    buffer->stores++;
+    write_buffer_entry_t *entry = writeBufferFind(buffer, block);
+    if (entry != NULL) {
+        entry->wordMask |= wordBit;
+        entry->stores++;
+        buffer->coalescedStores++;
+        return;
+    }
+    if (buffer->count == buffer->depth) {
+        buffer->fullStalls++;
+        stallForWrites(cache, drainOldest(cache));
+    }
+    writeBufferPush(buffer, block, wordBit, cache->cycleCount);
+}
+
+
+/**
+ * @brief Give up a line, telling the home node of each of its valid sectors.
+ * 
+ * @param cache 
+ * @param lineAddress       address of the line's first byte
+ * @param sectors           the line's sectors, all invalid afterwards
+ */
+static void releaseSectors(cache_t *cache, unsigned long lineAddress, sector_t *sectors) {
+    bool dirty = false;
+
+    cache->evictionCount++;
+    for (unsigned long i = 0; i < cache->numSectors; i++) {
+        sector_t *sector = &sectors[i];
+        if (!sector->valid) {
+            continue;
+        }
+        unsigned long sectorAddress = lineAddress | (i << cache->sectorBits);
+        int home = addrProcessor(cache, sectorAddress);
+        sector->valid = false;
+        sector->state = INVALID;
+        if (sector->isDirty) {
+            // Write back the dirty sector to memory
+            dirty = true;
+            sector->isDirty = false;
+            sendToHome(cache, WRITE_UPDATE, sectorAddress, home);
+        } else {
+            sendToHome(cache, EVICTION_NOTICE, sectorAddress, home);
+        }
+    }
+    if (dirty) {
+        cache->dirtyEvictionCount++;
+    }
+}
+
+/**
+ * @brief Move a replaced line into the victim cache, casting out its
+ *        oldest line if it is full.
+ * 
+ * @param cache 
+ * @param line 
+ * @param setIndex          set the line is in
+ */
+static void moveToVictimCache(cache_t *cache, line_t *line, unsigned long setIndex) {
+    victim_cache_t *victims = cache->victims;
+    victim_line_t *slot = &victims->lines[0];
+    for (unsigned long i = 0; i < victims->numLines; i++) {
+        victim_line_t *victim = &victims->lines[i];
+        if (!victim->valid) {
+            slot = victim;
             break;
         }
+        if (victim->insertedAt < slot->insertedAt) {
+            slot = victim;
+        }
     }
+    if (slot->valid) {
+        releaseSectors(cache, slot->block << cache->B, slot->sectors);
+    }
+    slot->block = (line->tag << cache->S) | setIndex;
+    slot->valid = true;
+    slot->insertedAt = victims->insertions++;
+    memcpy(slot->sectors, line->sectors, cache->numSectors * sizeof(sector_t));
+    memset(line->sectors, 0, cache->numSectors * sizeof(sector_t));
+    line->valid = false;
+}
 
-    if (hit) {
-        cache->hitCount++;
-        updateLRUCounter(set, hitLineIndex);
+/**
+ * @brief Evict a line, into the victim cache if there is one.
+ * 
+ * @param cache 
+ * @param line 
+ * @param setIndex          set the line is in
+ */
+static void evictLine(cache_t *cache, line_t *line, unsigned long setIndex) {
+    if (cache->victims != NULL) {
+        moveToVictimCache(cache, line, setIndex);
+        return;
+    }
+    line->valid = false;
+    releaseSectors(cache, ((line->tag << cache->S) | setIndex) << cache->B, line->sectors);
+}
+
+/**
+ * @brief Pick a line for a new tag, evicting the LRU line if the set is full.
+ * 
+ * @param cache 
+ * @param set 
+ * @param setIndex 
+ * @param tag 
+ * @return line_t*          the line, valid with every sector invalid
+ */
+static line_t *installLine(cache_t *cache, set_t *set, unsigned long setIndex,
+                           unsigned long tag) {
+    // Variables to track the least recently used line
+    unsigned long lruLineIndex = 0;
+    unsigned long maxLRUValue = 0;
+    bool setFull = true;
+
+    // Check each line in the set to find an empty line or the LRU line
+    for (unsigned int i = 0; i < set->maxLines; i++) {
+        if (!set->lines[i].valid) {
+            // An empty line is found
+            setFull = false;
+            lruLineIndex = i;
+            break;
+        } else if (set->lruCounter[i] > maxLRUValue) {
+            // Update LRU line information
+            maxLRUValue = set->lruCounter[i];
+            lruLineIndex = i;
+        }
+    }
+
+    // Evict the old line if the set is full, telling its home node
+    line_t *line = &set->lines[lruLineIndex];
+    if (setFull) {
+        evictLine(cache, line, setIndex);
+    }
+    line->tag = tag;
+    line->valid = true;
+    return line;
+}
+
+/**
+ * @brief Find the line holding an address, swapping it back into its set
+ *        if the victim cache has it.
+ * 
+ * @param cache 
+ * @param address 
+ * @param setOut            filled in with the set the address maps to
+ * @return line_t*          the valid line holding the address, NULL on a miss
+ */
+static line_t *recallLine(cache_t *cache, unsigned long address, set_t **setOut) {
+    line_t *line = findLine(cache, address, setOut);
+    if (line != NULL || cache->victims == NULL) {
+        return line;
+    }
+    victim_line_t *victim = findVictim(cache, address);
+    if (victim == NULL) {
+        cache->victimMissCount++;
+        return NULL;
+    }
+    // Free the victim's slot first, so the line it replaces can take it
+    sector_t sectors[MAX_SECTORS];
+    memcpy(sectors, victim->sectors, cache->numSectors * sizeof(sector_t));
+    victim->valid = false;
+    unsigned long setIndex = (address >> cache->B) & ((1UL << cache->S) - 1);
+    line = installLine(cache, *setOut, setIndex, address >> (cache->B + cache->S));
+    memcpy(line->sectors, sectors, cache->numSectors * sizeof(sector_t));
+    cache->victimHitCount++;
+    cache->cycleCount += VICTIM_SWAP_CYCLES;
+    return line;
+}
+
+/**
+ * @brief Handles read operations from the processor's cache.
+ * 
+ * A read of a sector whose fill is still in flight waits for the fill and
+ * is counted as a secondary miss rather than a hit.
+ * 
+ * @param cache             Cache struct for a given processor
+ * @param address           Address of memory being read
+ * @return int 
+ */
+int readFromCache(cache_t *cache, unsigned long address) {
+    if (cache->writeBuffer != NULL) {
+        drainExpired(cache);
+        drainForLoad(cache, address);
+    }
+    set_t *set;
+    line_t *line = recallLine(cache, address, &set);
+
+    if (line != NULL && sectorOf(cache, line, address)->valid) {
+        if (cache->mshrs == NULL || !waitForFill(cache, address)) {
+            cache->hitCount++;
+        }
+        cache->cycleCount += HIT_CYCLES;
+        updateLRUCounter(set, line->lineNum);
         return 0; 
     } else {
         cache->missCount++;
@@ -149,52 +622,142 @@ int readFromCache(cache_t *cache, unsigned long address) {
 /**
  * @brief Handles write operations to the processor's cache.
  * 
+ * A write hit on a SHARED or OWNED line still has to get ownership from
+ * the home directory, which invalidates the other copies. An EXCLUSIVE
+ * line is upgraded silently. Under write-through the line keeps its state
+ * and the store goes on to the home node; a write-through cache that
+ * allocates on write misses fills the line with a read first.
+ * 
  * @param cache             Cache struct for a given processor
  * @param address           Address of memory being read
  * @return int              Status of the write operation.
  */
 int writeToCache(cache_t *cache, unsigned long address) {
-    unsigned long setIndex = (address >> cache->B) & ((1UL << cache->S) - 1);
-    unsigned long tag = address >> (cache->B + cache->S);
-    set_t *set = &cache->setList[setIndex];
-    bool hit = false;
-    unsigned long hitLineIndex = 0;
+    set_t *set;
+    line_t *line = recallLine(cache, address, &set);
+    sector_t *sector = line != NULL ? sectorOf(cache, line, address) : NULL;
 
-    // Check if the address is in cache
-    for (unsigned int i = 0; i < set->maxLines; i++) {
-        if (set->lines[i].valid && set->lines[i].tag == tag) {
-            // Cache hit
-            hit = true;
-            hitLineIndex = i;
-            break;
+    drainExpired(cache);
+    if (sector != NULL && sector->valid) {
+        if (cache->mshrs == NULL || !waitForFill(cache, address)) {
+            cache->hitCount++;
         }
-    }
-
-    if (hit) {
-        cache->hitCount++;
-        updateLRUCounter(set, hitLineIndex);
-        set->lines[hitLineIndex].isDirty = true;
+        updateLRUCounter(set, line->lineNum);
+        if (cache->writePolicy == POLICY_WRITE_THROUGH) {
+            cache->cycleCount += HIT_CYCLES;
+            bufferStore(cache, address);
+            return 0;
+        }
+        if (sector->state == EXCLUSIVE) {
+            // The directory already recorded us as the owner
+            cache->silentUpgradeCount++;
+            cache->cycleCount += HIT_CYCLES;
+            sector->state = MODIFIED;
+        } else if (sector->state != MODIFIED) {
+            cache->upgradeCount++;
+            waitForMSHR(cache);
+            sendToHome(cache, WRITE_REQUEST, address, addrProcessor(cache, address));
+        } else {
+            cache->cycleCount += HIT_CYCLES;
+        }
+        sector->isDirty = true;
         return 0; // Successful write
     } else {
         cache->missCount++;
-        cacheMissHandler(cache, address, true); // Handle cache miss
+        if (!cache->writeAllocate) {
+            cache->unallocatedWriteCount++;
+            cache->cycleCount += HIT_CYCLES;
+            bufferStore(cache, address);
+        } else if (cache->writePolicy == POLICY_WRITE_THROUGH) {
+            cacheMissHandler(cache, address, false);
+            bufferStore(cache, address);
+        } else {
+            cacheMissHandler(cache, address, true); // Handle cache miss
+        }
         // Indicates that a miss occurred and write is pending
         return 1; 
     }
 }
 
 /**
- * TODO: Should we split the memory addresses so that processor 0 owns addr 0 to x, processor 1 owns x+1 to 2x etc? 
-*/
-static int addrProcessor(int addr) {
-    return addr/NUM_LINES;
+ * @brief Wait until every earlier access has completed.
+ * 
+ * Buffered stores are written through and misses in flight finish; the
+ * core waits for the slowest of them.
+ * 
+ * @param cache 
+ */
+void fenceCache(cache_t *cache) {
+    unsigned long issuedAt = cache->cycleCount;
+    unsigned long waited = 0;
+    while (cache->writeBuffer != NULL && cache->writeBuffer->count > 0) {
+        unsigned long latency = drainOldest(cache);
+        if (latency > waited) {
+            waited = latency;
+        }
+    }
+    stallForWrites(cache, waited);
+    if (cache->mshrs != NULL) {
+        cacheWaitForMisses(cache);
+    }
+    cache->fenceCount++;
+    cache->fenceStallCycles += cache->cycleCount - issuedAt;
+}
+
+/**
+ * @brief Handles an atomic read-modify-write.
+ * 
+ * Atomics order like a fence around them, and are performed in the cache
+ * with the line held MODIFIED whatever the write policy: the line is
+ * fetched or upgraded through the home directory like a write-back store,
+ * and the core waits for it even with MSHRs free.
+ * 
+ * @param cache 
+ * @param address 
+ * @return int              1 if the line was not in the cache
+ */
+int atomicToCache(cache_t *cache, unsigned long address) {
+    fenceCache(cache);
+    cache->atomicCount++;
+    set_t *set;
+    line_t *line = recallLine(cache, address, &set);
+    sector_t *sector = line != NULL ? sectorOf(cache, line, address) : NULL;
+    int missed = 0;
+
+    if (sector != NULL && sector->valid) {
+        cache->hitCount++;
+        updateLRUCounter(set, line->lineNum);
+        if (sector->state == EXCLUSIVE) {
+            cache->silentUpgradeCount++;
+            cache->cycleCount += HIT_CYCLES;
+            sector->state = MODIFIED;
+        } else if (sector->state != MODIFIED) {
+            cache->upgradeCount++;
+            sendToHome(cache, WRITE_REQUEST, address, addrProcessor(cache, address));
+        } else {
+            cache->cycleCount += HIT_CYCLES;
+        }
+        sector->isDirty = true;
+    } else {
+        cache->missCount++;
+        cacheMissHandler(cache, address, true);
+        missed = 1;
+    }
+    if (cache->mshrs != NULL) {
+        cacheWaitForMisses(cache);
+    }
+    return missed;
 }
+
 /**
  * @brief Manages cache miss scenarios.
  * 
+ * A miss on a sector of a line whose tag is present only fetches that
+ * sector; otherwise the LRU line is evicted, all of its sectors with it.
+ * 
  * @param cache             Cache struct for a given processor
  * @param address           Address of memory being read
- * @param isDirty 
+ * @param isDirty           true if the miss is a write
  * @return int 
  */
 int cacheMissHandler(cache_t *cache, unsigned long address, bool isDirty) {
@@ -204,66 +767,476 @@ int cacheMissHandler(cache_t *cache, unsigned long address, bool isDirty) {
 
     // Get the corresponding set from the cache
     set_t *set = &cache->setList[setIndex];
+    line_t *line = findLine(cache, address, NULL);
+    if (line != NULL) {
+        cache->sectorMissCount++;
+    } else {
+        line = installLine(cache, set, setIndex, tag);
+    }
 
-    // Variables to track the least recently used line
-    unsigned long lruLineIndex = 0;
-    unsigned long maxLRUValue = 0;
-    bool setFull = true;
+    // Fill the sector; the home node's acknowledgement sets its state
+    sector_t *sector = sectorOf(cache, line, address);
+    sector->valid = true;
+    sector->isDirty = isDirty;
+    sector->state = INVALID;
+    updateLRUCounter(set, line->lineNum);
 
-    // Check each line in the set to find an empty line or the LRU line
-    for (unsigned int i = 0; i < set->maxLines; i++) {
-        if (!set->lines[i].valid) {
-            // An empty line is found
-            setFull = false;
-            lruLineIndex = i;
-            break;
-        } else if (set->lruCounter[i] > maxLRUValue) {
-            // Update LRU line information
-            maxLRUValue = set->lruCounter[i];
-            lruLineIndex = i;
+    // find processor that has the requested address in its main memory 
+    int home = addrProcessor(cache, address);
+    if(home == cache->processor_id) {
+        cache->localMissCount++;
+    } else {
+        cache->remoteMissCount++;
+    }
+    waitForMSHR(cache);
+    sendToHome(cache, isDirty ? WRITE_REQUEST : READ_REQUEST, address, home);
+
+    return 0;
+}
+
+/**
+ * @brief Invalidate a sector at the request of its home directory.
+ * 
+ * The sector may be in the victim cache. The line's tag is dropped with
+ * its last valid sector.
+ * 
+ * @param cache 
+ * @param address 
+ * @return block_state      state of the sector before the invalidation
+ */
+block_state cacheInvalidateLine(cache_t *cache, unsigned long address) {
+    line_t *line;
+    victim_line_t *victim;
+    sector_t *sector = locateSector(cache, address, &line, &victim);
+    if (sector == NULL || !sector->valid) {
+        return INVALID;
+    }
+    block_state previous = sector->state;
+    sector->valid = false;
+    sector->isDirty = false;
+    sector->state = INVALID;
+    if (line != NULL) {
+        line->valid = anySectorValid(cache, line->sectors);
+    } else {
+        victim->valid = anySectorValid(cache, victim->sectors);
+    }
+    cache->invalidationCount++;
+    if (cache->profile != NULL) {
+        profileInvalidation(cache->profile, cache->processor_id, address);
+    }
+    return previous;
+}
+
+/**
+ * @brief State of the sector holding an address, without touching LRU order.
+ * 
+ * @param cache 
+ * @param address 
+ * @return block_state      INVALID if the cache does not hold it
+ */
+block_state cacheLineState(cache_t *cache, unsigned long address) {
+    sector_t *sector = findSector(cache, address);
+    return sector != NULL ? sector->state : INVALID;
+}
+
+/**
+ * @brief Downgrade a sector so another cache can read it, at the request of
+ *        its home directory.
+ * 
+ * Under MOESI a dirty sector stays dirty as OWNED; otherwise it becomes
+ * SHARED and the caller writes back the data if it was modified.
+ * 
+ * @param cache 
+ * @param address 
+ * @return block_state      state of the sector before the downgrade
+ */
+block_state cacheDowngradeLine(cache_t *cache, unsigned long address) {
+    sector_t *sector = findSector(cache, address);
+    if (sector == NULL) {
+        return INVALID;
+    }
+    block_state previous = sector->state;
+    if (cache->protocol == PROTOCOL_MOESI && (previous == MODIFIED || previous == OWNED)) {
+        if (previous == MODIFIED) {
+            cache->writebacksAvoided++;
         }
+        sector->state = OWNED;
+    } else {
+        sector->isDirty = false;
+        sector->state = SHARED;
     }
+    return previous;
+}
 
-    // If the set is full and the selected line is dirty, write back to memory
-    if (setFull && set->lines[lruLineIndex].isDirty) {
-        // Write back the dirty line to memory (code not shown)
-        // This would involve memory write operations
-        cache->dirtyEvictionCount++;
+/**
+ * @brief Complete a miss or upgrade when its acknowledgement arrives.
+ * 
+ * A blocking cache waits for the latency. A cache with MSHRs only pays
+ * for issuing the miss and holds an MSHR until the fill would complete;
+ * waitForMSHR made sure one was free.
+ * 
+ * @param cache 
+ * @param address 
+ * @param state             state granted by the directory
+ * @param latency           cycles the transaction took on its critical path
+ */
+void cacheCompleteMiss(cache_t *cache, unsigned long address, block_state state,
+                       unsigned long latency) {
+    sector_t *sector = findSector(cache, address);
+    if (sector != NULL) {
+        sector->state = state;
+    }
+    cache->missLatencyCycles += latency;
+    if (cache->mshrs == NULL) {
+        cache->cycleCount += latency;
+        return;
+    }
+    // A non-blocking cache keeps going while the fill is in flight
+    mshr_t *mshr = &cache->mshrs[0];
+    for (unsigned long i = 0; i < cache->numMSHRs; i++) {
+        if (cache->mshrs[i].readyAt < mshr->readyAt) {
+            mshr = &cache->mshrs[i];
+        }
     }
+    mshr->block = address >> cache->sectorBits;
+    mshr->readyAt = cache->cycleCount + latency;
+    cache->cycleCount += HIT_CYCLES;
+}
 
-    // Evict the old line if the set is full
-    if (setFull) {
-        cache->evictionCount++;
+/**
+ * @brief Record the latency of a write-through when its acknowledgement
+ *        arrives.
+ * 
+ * @param cache 
+ * @param latency           cycles from the write-through to the acknowledgement
+ */
+void cacheCompleteWrite(cache_t *cache, unsigned long latency) {
+    cache->writeLatency = latency;
+}
+
+/**
+ * @brief Attach the interconnect used to reach the home nodes.
+ * 
+ * @param cache 
+ * @param interconnect 
+ */
+void connectCacheToInterconnect(cache_t *cache, interconnect_t *interconnect) {
+    if (cache != NULL) {
+        cache->interconnect = interconnect;
     }
-    
-    // find processor that has the requested address in its main memory 
-    // construct message 
-    if(addrProcessor(address) != cache->processor_id) {
-        message_t* m = malloc(sizeof(message_t));
-        m->type = READ_REQUEST; // TODO: only for now 
-        m->sourceId = cache->processor_id;
-        m->destId = addrProcessor(address);
-        m->address = address;
-        interconnectSendMessage(interconnects[m->destId], message);
-        // increment interconnect activity counter 
-    }
-
-    // Update the LRU line with new data
-    set->lines[lruLineIndex].tag = tag;
-    set->lines[lruLineIndex].valid = true;
-    set->lines[lruLineIndex].isDirty = isDirty; // New data is not dirty yet
-    set->lines[lruLineIndex].state = SHARED;   // Initially in SHARED state
-
-    // Reset LRU counters
-    for (unsigned int i = 0; i < set->maxLines; i++) {
-        set->lruCounter[i]++;
+}
+
+/**
+ * @brief Attach the home node mapping used to route misses.
+ * 
+ * @param cache 
+ * @param homeMap 
+ */
+void connectCacheToHomeMap(cache_t *cache, home_map_t *homeMap) {
+    if (cache != NULL) {
+        cache->homeMap = homeMap;
     }
-    set->lruCounter[lruLineIndex] = 0;
+}
 
-    // Load the new block of data into the cache line
-    // This would typically involve fetching data from main memory or other caches
+/**
+ * @brief Connect a cache to the sharing profile of its system.
+ * 
+ * @param cache 
+ * @param profile 
+ */
+void connectCacheToProfile(cache_t *cache, sharing_profile_t *profile) {
+    if (cache != NULL) {
+        cache->profile = profile;
+    }
+}
 
-    return 0;
+/**
+ * @brief Select the coherence protocol the cache follows.
+ * 
+ * @param cache 
+ * @param protocol 
+ */
+void setCacheProtocol(cache_t *cache, coherence_protocol protocol) {
+    if (cache != NULL) {
+        cache->protocol = protocol;
+    }
+}
+
+/**
+ * @brief Select what write hits and write misses do.
+ * 
+ * @param cache 
+ * @param policy 
+ * @param writeAllocate     write misses fill the line
+ */
+void setCacheWritePolicy(cache_t *cache, write_policy policy, bool writeAllocate) {
+    if (cache != NULL) {
+        cache->writePolicy = policy;
+        cache->writeAllocate = writeAllocate;
+    }
+}
+
+/**
+ * @brief Give the cache a coalescing write buffer.
+ * 
+ * @param cache 
+ * @param depth             entries, 0 to send every store on unbuffered
+ * @param drain 
+ * @return true             the buffer was created, or none was asked for
+ */
+bool attachWriteBuffer(cache_t *cache, int depth, drain_policy drain) {
+    if (depth == 0) {
+        return true;
+    }
+    cache->writeBuffer = createWriteBuffer(depth, drain);
+    return cache->writeBuffer != NULL;
+}
+
+/**
+ * @brief Give the cache a victim cache for the lines its sets replace.
+ * 
+ * @param cache 
+ * @param numLines          lines, 0 for none
+ * @return true             the victim cache was created, or none was asked for
+ */
+bool attachVictimCache(cache_t *cache, unsigned long numLines) {
+    if (numLines == 0) {
+        return true;
+    }
+    if (numLines > MAX_VICTIM_LINES) {
+        return false;
+    }
+    victim_cache_t *victims = calloc(1, sizeof(victim_cache_t));
+    if (victims == NULL) {
+        return false;
+    }
+    victims->lines = calloc(numLines, sizeof(victim_line_t));
+    victims->sectors = calloc(numLines * cache->numSectors, sizeof(sector_t));
+    if (victims->lines == NULL || victims->sectors == NULL) {
+        free(victims->lines);
+        free(victims->sectors);
+        free(victims);
+        return false;
+    }
+    victims->numLines = numLines;
+    for (unsigned long i = 0; i < numLines; i++) {
+        victims->lines[i].sectors = &victims->sectors[i * cache->numSectors];
+    }
+    cache->victims = victims;
+    return true;
+}
+
+/**
+ * @brief Give the cache miss status holding registers, making it non-blocking.
+ * 
+ * @param cache 
+ * @param numMSHRs          misses in flight at once, 0 for a blocking cache
+ * @return true             the registers were created, or none were asked for
+ */
+bool attachMSHRs(cache_t *cache, unsigned long numMSHRs) {
+    if (numMSHRs == 0) {
+        return true;
+    }
+    if (numMSHRs > MAX_MSHRS) {
+        return false;
+    }
+    cache->mshrs = calloc(numMSHRs, sizeof(mshr_t));
+    cache->numMSHRs = numMSHRs;
+    return cache->mshrs != NULL;
+}
+
+/**
+ * @brief Cast out every line of the victim cache.
+ * 
+ * @param cache 
+ */
+void cacheFlushVictims(cache_t *cache) {
+    for (unsigned long i = 0; cache->victims != NULL && i < cache->victims->numLines; i++) {
+        victim_line_t *victim = &cache->victims->lines[i];
+        if (victim->valid) {
+            releaseSectors(cache, victim->block << cache->B, victim->sectors);
+            victim->valid = false;
+        }
+    }
+}
+
+/**
+ * @brief Advance the clock of a non-blocking cache until its misses in
+ *        flight have completed.
+ * 
+ * @param cache 
+ */
+void cacheWaitForMisses(cache_t *cache) {
+    for (unsigned long i = 0; i < cache->numMSHRs; i++) {
+        if (cache->mshrs[i].readyAt > cache->cycleCount) {
+            cache->cycleCount = cache->mshrs[i].readyAt;
+        }
+    }
+}
+
+/**
+ * @brief Write through every buffered store, without charging the core.
+ * 
+ * @param cache 
+ */
+void drainWriteBuffer(cache_t *cache) {
+    while (cache->writeBuffer != NULL && cache->writeBuffer->count > 0) {
+        drainOldest(cache);
+    }
+}
+
+/**
+ * @brief Parse a write policy from the command line.
+ * 
+ * @param text              "write-back" or "write-through", optionally
+ *                          followed by ":no-allocate"
+ * @param policy            filled in on success
+ * @param writeAllocate     filled in on success
+ * @return true             text was recognized
+ */
+bool parseWritePolicy(const char *text, write_policy *policy, bool *writeAllocate) {
+    const char *colon = strchr(text, ':');
+    size_t length = colon != NULL ? (size_t)(colon - text) : strlen(text);
+    if (length == 10 && strncmp(text, "write-back", length) == 0) {
+        *policy = POLICY_WRITE_BACK;
+    } else if (length == 13 && strncmp(text, "write-through", length) == 0) {
+        *policy = POLICY_WRITE_THROUGH;
+    } else {
+        return false;
+    }
+    *writeAllocate = colon == NULL;
+    return colon == NULL || strcmp(colon + 1, "no-allocate") == 0;
+}
+
+/**
+ * @brief Name of a write policy, for reports.
+ * 
+ * @param policy 
+ * @param writeAllocate 
+ * @return const char* 
+ */
+const char *writePolicyName(write_policy policy, bool writeAllocate) {
+    if (policy == POLICY_WRITE_THROUGH) {
+        return writeAllocate ? "write-through" : "write-through no-allocate";
+    }
+    return writeAllocate ? "write-back" : "write-back no-allocate";
+}
+
+/**
+ * @brief Parse a protocol name from the command line.
+ * 
+ * @param name              one of "msi", "mesi", "moesi"
+ * @param protocol          filled in on success
+ * @return true             name was recognized
+ */
+bool parseProtocol(const char *name, coherence_protocol *protocol) {
+    if (strcmp(name, "msi") == 0) {
+        *protocol = PROTOCOL_MSI;
+    } else if (strcmp(name, "mesi") == 0) {
+        *protocol = PROTOCOL_MESI;
+    } else if (strcmp(name, "moesi") == 0) {
+        *protocol = PROTOCOL_MOESI;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Name of a protocol, for reports.
+ * 
+ * @param protocol 
+ * @return const char* 
+ */
+const char *protocolName(coherence_protocol protocol) {
+    switch (protocol) {
+        case PROTOCOL_MSI:   return "MSI";
+        case PROTOCOL_MESI:  return "MESI";
+        case PROTOCOL_MOESI: return "MOESI";
+        default:             return "unknown";
+    }
+}
+
+/**
+ * @brief Prints the split of a processor's misses between its own memory
+ *        and remote home nodes.
+ * 
+ * @param C 
+ */
+void printMissLocality(const cache_t *C) {
+    unsigned long total = C->localMissCount + C->remoteMissCount;
+    double remoteRatio = total ? (double)C->remoteMissCount / total : 0.0;
+    printf("P%d: local misses: %lu, remote misses: %lu, remote ratio: %.4f\n",
+           C->processor_id, C->localMissCount, C->remoteMissCount, remoteRatio);
+}
+
+/**
+ * @brief Prints a processor's misses by cause, from makeSummary.
+ * 
+ * @param C 
+ */
+void printMissClasses(cache_t *C) {
+    const csim_stats_t *stats = makeSummary(C);
+    if (stats == NULL) {
+        return;
+    }
+    printf("P%d: misses: %lu", C->processor_id, stats->misses);
+    for (int i = 0; i < NUM_MISS_CLASSES; i++) {
+        printf(", %s: %lu", missClassName(i), stats->miss_classes[i]);
+    }
+    printf("\n");
+    free((void *)stats);
+}
+
+/**
+ * @brief Prints a processor's write-throughs and write buffer counters.
+ * 
+ * A store merged into a buffered entry saves a WRITE_THROUGH and its
+ * acknowledgement.
+ * 
+ * @param C 
+ */
+void printWritePolicy(const cache_t *C) {
+    printf("P%d: write-throughs: %lu, unallocated write misses: %lu, write stall cycles: %lu\n",
+           C->processor_id, C->writeThroughCount, C->unallocatedWriteCount, C->writeStallCycles);
+    const write_buffer_t *buffer = C->writeBuffer;
+    if (buffer != NULL) {
+        printf("P%d: buffered stores: %lu, coalesced: %lu, messages saved: %lu, "
+               "full-buffer stalls: %lu, load drains: %lu, still buffered: %d\n",
+               C->processor_id, buffer->stores, buffer->coalescedStores,
+               2 * buffer->coalescedStores, buffer->fullStalls, buffer->loadDrains,
+               buffer->count);
+    }
+}
+
+/**
+ * @brief Prints a processor's victim cache and MSHR counters.
+ * 
+ * @param C 
+ */
+void printMissHandling(const cache_t *C) {
+    if (C->victims != NULL) {
+        unsigned long lookups = C->victimHitCount + C->victimMissCount;
+        printf("P%d: victim hits: %lu of %lu lookups, victim hit rate: %.4f\n",
+               C->processor_id, C->victimHitCount, lookups,
+               lookups ? (double)C->victimHitCount / lookups : 0.0);
+    }
+    if (C->mshrs != NULL) {
+        printf("P%d: secondary misses: %lu (%lu cycles waiting for fills), "
+               "MSHR-full stalls: %lu (%lu cycles)\n",
+               C->processor_id, C->secondaryMissCount, C->secondaryStallCycles,
+               C->mshrFullStalls, C->mshrStallCycles);
+    }
+}
+
+/**
+ * @brief Prints a processor's atomic and fence counters.
+ * 
+ * @param C 
+ */
+void printSynchronization(const cache_t *C) {
+    printf("P%d: atomics: %lu, fences: %lu, fence stall cycles: %lu\n",
+           C->processor_id, C->atomicCount, C->fenceCount, C->fenceStallCycles);
 }
 
 /**
@@ -278,8 +1251,8 @@ void printCache(cache_t *C) {
         return;
     }
     printf("Cache Structure (Processor ID: %d)\n", C->processor_id);
-    printf("Total Sets: %lu, Lines per Set: %lu, Block Size: %lu\n", 
-           (1UL << C->S), C->E, (1UL << C->B));
+    printf("Total Sets: %lu, Lines per Set: %lu, Block Size: %lu, Sector Size: %lu\n", 
+           (1UL << C->S), C->E, (1UL << C->B), (1UL << C->sectorBits));
     printf("Hit Count: %lu, Miss Count: %lu, Eviction Count: %lu\n", 
            C->hitCount, C->missCount, C->evictionCount);
 
@@ -287,8 +1260,11 @@ void printCache(cache_t *C) {
         printf("Set %lu:\n", i);
         for (unsigned long j = 0; j < C->E; j++) {
             line_t *line = &C->setList[i].lines[j];
-            printf("  Line %lu: Tag: %lx, Valid: %d, Dirty: %d, State: %d\n", 
-                   j, line->tag, line->valid, line->isDirty, line->state);
+            printf("  Line %lu: Tag: %lx, Valid: %d\n", j, line->tag, line->valid);
+            for (unsigned long k = 0; k < C->numSectors; k++) {
+                printf("    Sector %lu: Valid: %d, Dirty: %d, State: %d\n", k,
+                       line->sectors[k].valid, line->sectors[k].isDirty, line->sectors[k].state);
+            }
         }
     }
 }
@@ -308,8 +1284,9 @@ void freeCache(cache_t *cache) {
     // Free each set and its constituent structures
     for (unsigned long i = 0; i < (1UL << cache->S); i++) {
         set_t *set = &cache->setList[i];
-        // Free the array of lines in each set
+        // Free the array of lines in each set, and their sectors
         free(set->lines);
+        free(set->sectors);
 
         // Free the LRU counter array if it exists
         if (set->lruCounter != NULL) {
@@ -319,6 +1296,13 @@ void freeCache(cache_t *cache) {
 
     // Free the array of sets
     free(cache->setList);
+    freeWriteBuffer(cache->writeBuffer);
+    if (cache->victims != NULL) {
+        free(cache->victims->lines);
+        free(cache->victims->sectors);
+        free(cache->victims);
+    }
+    free(cache->mshrs);
 
     // Finally, free the cache itself
     free(cache);
@@ -347,22 +1331,29 @@ const csim_stats_t *makeSummary(cache_t *C) {
     stats->evictions = C->evictionCount;
 
     unsigned long dirtyByteCount = 0;
-    // Loop through all sets and lines, count all dirty lines
+    // Loop through all sets and lines, count all dirty sectors
     for (unsigned int i = 0; i < (1UL << C->S); i++) {
         set_t *currSet = &C->setList[i];
-        for (unsigned int j = 0; j < C->E; j++) {
-            if (currSet->lines[j].valid && currSet->lines[j].isDirty) {
+        for (unsigned int j = 0; j < C->E * C->numSectors; j++) {
+            if (currSet->sectors[j].valid && currSet->sectors[j].isDirty) {
                 dirtyByteCount++;
             }
         }
     }
     
-    // Calculate dirty bytes: number of dirty lines multiplied by block size
-    stats->dirty_bytes = dirtyByteCount * (1UL << C->B);
+    for (unsigned long i = 0; C->victims != NULL && i < C->victims->numLines * C->numSectors; i++) {
+        if (C->victims->sectors[i].valid && C->victims->sectors[i].isDirty) {
+            dirtyByteCount++;
+        }
+    }
+    
+    // Calculate dirty bytes: number of dirty sectors multiplied by sector size
+    stats->dirty_bytes = dirtyByteCount * (1UL << C->sectorBits);
 
     // Calculate dirty evictions: number of dirty evictions multiplied by block size
     stats->dirty_evictions = C->dirtyEvictionCount * (1UL << C->B);
 
+    memcpy(stats->miss_classes, C->missClassCount, sizeof(stats->miss_classes));
     return stats;
 }
 
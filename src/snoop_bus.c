@@ -0,0 +1,511 @@
+/**
+ * @file snoop_bus.c
+ * @brief Snooping bus that replaces the directories and the network when
+ *        the "snoop" scheme is selected.
+ *
+ * The caches are the same as under a directory: they send their requests
+ * to the line's home node, and the interconnect hands those to the bus.
+ * A read miss downgrades the other copies and is granted EXCLUSIVE under
+ * MESI and MOESI when no other cache asserted the shared line; a write
+ * miss or upgrade invalidates them. A dirty owner supplies the data: under
+ * MSI and MESI memory picks up the flush, under MOESI the owner keeps the
+ * line OWNED instead. Clean lines are replaced silently.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "processor.h"
+#include "snoop_bus.h"
+
+/**
+ * @brief What the other caches answered to a snoop
+ *
+*/
+typedef struct snoop_result {
+    bool shared;        // Some other cache held the line
+    int supplier;       // Cache that held it dirty, -1 if none
+} snoop_result_t;
+
+/**
+ * @brief Create a snooping bus with an empty schedule.
+ *
+ * @param processors        caches and home memories on the bus
+ * @param numNodes
+ * @param interconnect      counts the bus traffic like network traffic
+ * @return snoop_bus_t*     newly allocated bus, NULL on failure
+ */
+snoop_bus_t *createSnoopBus(struct processor *processors, int numNodes,
+                            interconnect_t *interconnect) {
+    snoop_bus_t *bus = calloc(1, sizeof(snoop_bus_t));
+    if (bus == NULL) {
+        return NULL;
+    }
+    bus->processors = processors;
+    bus->numNodes = numNodes;
+    bus->interconnect = interconnect;
+    return bus;
+}
+
+/**
+ * @brief Bus cycles to transfer some bytes
+ *
+ * @param bytes
+ * @return unsigned long
+ */
+static unsigned long dataCycles(unsigned long bytes) {
+    return (bytes + BUS_WIDTH_BYTES - 1) / BUS_WIDTH_BYTES;
+}
+
+/**
+ * @brief Hold the bus in the earliest gap after a cycle that is long enough.
+ *
+ * Back to back transactions merge into one busy interval, so a saturated
+ * bus keeps few of them. Once the schedule is full its oldest gap is given
+ * up as busy: time is never handed out twice, a late request just cannot
+ * use an idle stretch that long ago.
+ *
+ * @param bus
+ * @param ready             cycle the requester won arbitration
+ * @param cycles            cycles the transaction holds the bus
+ * @return unsigned long    cycle the transaction starts
+ */
+static unsigned long scheduleBus(snoop_bus_t *bus, unsigned long ready, unsigned long cycles) {
+    unsigned long start = ready;
+    int index = 0;
+    for (; index < bus->count; index++) {
+        const bus_reservation_t *reservation = &bus->reservations[index];
+        if (reservation->end <= start) {
+            continue;
+        }
+        if (start + cycles <= reservation->start) {
+            break;
+        }
+        start = reservation->end;
+    }
+    unsigned long end = start + cycles;
+    bus->transactions++;
+    bus->busyCycles += cycles;
+    bus->waitCycles += start - ready;
+
+    bool joinsPrevious = index > 0 && bus->reservations[index - 1].end == start;
+    bool joinsNext = index < bus->count && bus->reservations[index].start == end;
+    if (joinsPrevious && joinsNext) {
+        bus->reservations[index - 1].end = bus->reservations[index].end;
+        memmove(&bus->reservations[index], &bus->reservations[index + 1],
+                (bus->count - index - 1) * sizeof(bus_reservation_t));
+        bus->count--;
+    } else if (joinsPrevious) {
+        bus->reservations[index - 1].end = end;
+    } else if (joinsNext) {
+        bus->reservations[index].start = start;
+    } else {
+        if (bus->count == BUS_RESERVATIONS) {
+            bus->reservations[1].start = bus->reservations[0].start;
+            memmove(&bus->reservations[0], &bus->reservations[1],
+                    (bus->count - 1) * sizeof(bus_reservation_t));
+            bus->count--;
+            index = index > 0 ? index - 1 : 0;
+        }
+        memmove(&bus->reservations[index + 1], &bus->reservations[index],
+                (bus->count - index) * sizeof(bus_reservation_t));
+        bus->reservations[index].start = start;
+        bus->reservations[index].end = end;
+        bus->count++;
+    }
+    return start;
+}
+
+/**
+ * @brief Count a bus message with the network's counters
+ *
+ * @param bus
+ * @param type
+ * @param headerBytes       0 for a data phase, which follows its request's address
+ * @param dataBytes
+ */
+static void countMessage(snoop_bus_t *bus, message_type type, unsigned long headerBytes,
+                         unsigned long dataBytes) {
+    interconnect_t *net = bus->interconnect;
+    net->messageCount[type]++;
+    net->remoteMessages++;
+    net->headerBytes += headerBytes;
+    net->dataBytes += dataBytes;
+}
+
+/**
+ * @brief Have every other cache look up a line, downgrading or invalidating it.
+ *
+ * @param bus
+ * @param message           request on the bus
+ * @param invalidate        invalidate the copies instead of downgrading them
+ * @param result            filled in
+ */
+static void snoop(snoop_bus_t *bus, const message_t *message, bool invalidate,
+                  snoop_result_t *result) {
+    result->shared = false;
+    result->supplier = -1;
+    for (int i = 0; i < bus->numNodes; i++) {
+        if (i == message->requesterId) {
+            continue;
+        }
+        processor_t *processor = &bus->processors[i];
+        cache_t *cache = processor->cache;
+        bus->snoopLookups++;
+        processor->cacheProbes++;
+        cache->cycleCount += SNOOP_TAG_CYCLES;
+        if (cacheLineState(cache, message->address) == INVALID) {
+            continue;
+        }
+        block_state previous = invalidate ? cacheInvalidateLine(cache, message->address)
+                                          : cacheDowngradeLine(cache, message->address);
+        result->shared = true;
+        if (previous == MODIFIED || previous == OWNED) {
+            result->supplier = i;
+        }
+    }
+}
+
+/**
+ * @brief Read a line from its home's memory
+ *
+ * @param home
+ * @param address
+ * @param arrival           cycle the address reaches the memory controller
+ * @return unsigned long    cycles until memory supplies the line
+ */
+static unsigned long memoryRead(processor_t *home, unsigned long address, unsigned long arrival) {
+    home->memoryReads++;
+    if (home->dram == NULL) {
+        return MISS_CYCLES;
+    }
+    return dramAccess(home->dram, address, arrival, false);
+}
+
+/**
+ * @brief Write a line back to its home's memory, off the critical path
+ *
+ * @param home
+ * @param address
+ * @param arrival           cycle the data reaches the memory controller
+ */
+static void memoryWrite(processor_t *home, unsigned long address, unsigned long arrival) {
+    home->memoryWrites++;
+    if (home->dram != NULL) {
+        dramAccess(home->dram, address, arrival, true);
+    }
+}
+
+/**
+ * @brief Read miss (BusRd) or write miss and upgrade (BusRdX)
+ *
+ * @param bus
+ * @param message           READ_REQUEST or WRITE_REQUEST
+ */
+static void busRequest(snoop_bus_t *bus, const message_t *message) {
+    bool isWrite = message->type == WRITE_REQUEST;
+    cache_t *requester = bus->processors[message->requesterId].cache;
+    processor_t *home = &bus->processors[message->destId];
+    unsigned long sectorBytes = 1UL << requester->sectorBits;
+    // An upgrade from a shared or owned copy needs no data
+    bool needsData = !isWrite || cacheLineState(requester, message->address) == INVALID;
+
+    snoop_result_t result;
+    snoop(bus, message, isWrite, &result);
+    unsigned long issuedAt = requester->cycleCount;
+    unsigned long hold = BUS_ADDRESS_CYCLES + SNOOP_CYCLES +
+                         (needsData ? dataCycles(sectorBytes) : 0);
+    unsigned long start = scheduleBus(bus, issuedAt + BUS_ARBITRATION_CYCLES, hold);
+    unsigned long snooped = start + BUS_ADDRESS_CYCLES + SNOOP_CYCLES;
+    unsigned long latency = snooped - issuedAt;
+    countMessage(bus, message->type, MESSAGE_HEADER_BYTES, 0);
+
+    block_state granted = MODIFIED;
+    if (!isWrite) {
+        bool exclusive = !result.shared && requester->protocol != PROTOCOL_MSI;
+        granted = exclusive ? EXCLUSIVE : SHARED;
+    }
+    if (needsData) {
+        message_type reply = isWrite ? WRITE_ACKNOWLEDGE
+                                     : granted == EXCLUSIVE ? EXCLUSIVE_ACKNOWLEDGE
+                                                            : READ_ACKNOWLEDGE;
+        if (result.supplier >= 0) {
+            bus->cacheToCache++;
+            reply = DATA_REPLY;
+            latency += CACHE_SUPPLY_CYCLES;
+            // Memory picks up the flush unless MOESI leaves the line OWNED
+            if (!isWrite && requester->protocol != PROTOCOL_MOESI) {
+                memoryWrite(home, message->address, snooped + CACHE_SUPPLY_CYCLES);
+            }
+        } else {
+            latency += memoryRead(home, message->address, start + BUS_ADDRESS_CYCLES);
+        }
+        latency += dataCycles(sectorBytes);
+        bus->dataTransfers++;
+        countMessage(bus, reply, 0, sectorBytes);
+    }
+    cacheCompleteMiss(requester, message->address, granted, latency);
+}
+
+/**
+ * @brief Writeback of a dirty line being replaced
+ *
+ * Other caches ignore writebacks, so nobody looks the line up.
+ *
+ * @param bus
+ * @param message           WRITE_UPDATE
+ */
+static void busWriteback(snoop_bus_t *bus, const message_t *message) {
+    cache_t *writer = bus->processors[message->sourceId].cache;
+    unsigned long start = scheduleBus(bus, writer->cycleCount + BUS_ARBITRATION_CYCLES,
+                                      BUS_ADDRESS_CYCLES + dataCycles(message->dataBytes));
+    bus->dataTransfers++;
+    countMessage(bus, WRITE_UPDATE, MESSAGE_HEADER_BYTES, message->dataBytes);
+    memoryWrite(&bus->processors[message->destId], message->address, start + BUS_ADDRESS_CYCLES);
+}
+
+/**
+ * @brief Stores written through to memory, invalidating the other copies
+ *
+ * A dirty copy is flushed to memory before the stores.
+ *
+ * @param bus
+ * @param message           WRITE_THROUGH
+ */
+static void busWriteThrough(snoop_bus_t *bus, const message_t *message) {
+    cache_t *writer = bus->processors[message->requesterId].cache;
+    processor_t *home = &bus->processors[message->destId];
+    snoop_result_t result;
+    snoop(bus, message, true, &result);
+
+    unsigned long issuedAt = writer->cycleCount;
+    unsigned long hold = BUS_ADDRESS_CYCLES + SNOOP_CYCLES + dataCycles(message->dataBytes);
+    unsigned long start = scheduleBus(bus, issuedAt + BUS_ARBITRATION_CYCLES, hold);
+    bus->dataTransfers++;
+    countMessage(bus, WRITE_THROUGH, MESSAGE_HEADER_BYTES, message->dataBytes);
+    if (result.supplier >= 0) {
+        memoryWrite(home, message->address, start + BUS_ADDRESS_CYCLES + SNOOP_CYCLES);
+    }
+    memoryWrite(home, message->address, start + hold);
+    cacheCompleteWrite(writer, start + hold - issuedAt);
+}
+
+/**
+ * @brief Carry out a request a cache sent to a home node.
+ *
+ * @param bus
+ * @param message
+ */
+void busTransaction(snoop_bus_t *bus, const message_t *message) {
+    switch (message->type) {
+        case READ_REQUEST:
+        case WRITE_REQUEST:
+            busRequest(bus, message);
+            break;
+        case WRITE_UPDATE:
+            busWriteback(bus, message);
+            break;
+        case WRITE_THROUGH:
+            busWriteThrough(bus, message);
+            break;
+        default:
+            // A clean line is dropped without telling anyone
+            break;
+    }
+}
+
+/**
+ * @brief Prints the occupancy and snoop counters of a bus.
+ *
+ * @param bus
+ * @param machineCycles     length of the run
+ */
+void printSnoopBus(const snoop_bus_t *bus, unsigned long machineCycles) {
+    printf("Bus: transactions: %lu, data transfers: %lu, cache-to-cache: %lu, "
+           "snoop lookups: %lu, busy cycles: %lu, utilization: %.4f, "
+           "average arbitration wait: %.2f cycles\n",
+           bus->transactions, bus->dataTransfers, bus->cacheToCache, bus->snoopLookups,
+           bus->busyCycles, machineCycles ? (double)bus->busyCycles / machineCycles : 0.0,
+           bus->transactions ? (double)bus->waitCycles / bus->transactions : 0.0);
+}
+
+/**
+ * @brief Free a snooping bus.
+ *
+ * @param bus
+ */
+void freeSnoopBus(snoop_bus_t *bus) {
+    free(bus);
+}
+
+/** @brief Handle every home node gets from the snooping scheme; there is nothing in it */
+static int noDirectory;
+
+/**
+ * @brief Directory of a home node under snooping: none
+ *
+ * @param numLines
+ * @return void*
+ */
+static void *createNoDirectory(int numLines) {
+    (void)numLines;
+    return &noDirectory;
+}
+
+/**
+ * @brief Nothing to free
+ *
+ * @param directory
+ */
+static void destroyNoDirectory(void *directory) {
+    (void)directory;
+}
+
+/**
+ * @brief No line is ever tracked
+ *
+ * @param directory
+ * @param block
+ * @param owner             set to -1
+ * @return directory_state
+ */
+static directory_state getNoState(void *directory, unsigned long block, int *owner) {
+    (void)directory;
+    (void)block;
+    *owner = -1;
+    return DIR_UNCACHED;
+}
+
+/**
+ * @brief No line has tracked sharers
+ *
+ * @param directory
+ * @param block
+ * @param sharers           emptied
+ */
+static void getNoSharers(void *directory, unsigned long block, sharer_set_t *sharers) {
+    (void)directory;
+    (void)block;
+    sharerSetClear(sharers);
+}
+
+/**
+ * @brief Nothing to record
+ *
+ * @param directory
+ * @param block
+ * @param processorId
+ * @param newState
+ */
+static void setNoState(void *directory, unsigned long block, int processorId,
+                       directory_state newState) {
+    (void)directory;
+    (void)block;
+    (void)processorId;
+    (void)newState;
+}
+
+/**
+ * @brief Nothing to record
+ *
+ * @param directory
+ * @param block
+ * @param processorId
+ * @return int              -1, nobody is dropped
+ */
+static int addNoSharer(void *directory, unsigned long block, int processorId) {
+    (void)directory;
+    (void)block;
+    (void)processorId;
+    return -1;
+}
+
+/**
+ * @brief Nothing to forget
+ *
+ * @param directory
+ * @param block
+ * @param processorId
+ */
+static void removeNoSharer(void *directory, unsigned long block, int processorId) {
+    (void)directory;
+    (void)block;
+    (void)processorId;
+}
+
+/**
+ * @brief Nothing to forget
+ *
+ * @param directory
+ * @param block
+ */
+static void invalidateNothing(void *directory, unsigned long block) {
+    (void)directory;
+    (void)block;
+}
+
+/**
+ * @brief An entry that does not exist is never malformed
+ *
+ * @param directory
+ * @param block
+ * @param processorId
+ * @return true
+ */
+static bool checkNoEntry(void *directory, unsigned long block, int processorId) {
+    (void)directory;
+    (void)block;
+    (void)processorId;
+    return true;
+}
+
+/**
+ * @brief An empty table
+ *
+ * @param directory
+ * @param stats             zeroed
+ */
+static void noTableStats(void *directory, line_table_stats_t *stats) {
+    (void)directory;
+    memset(stats, 0, sizeof(*stats));
+}
+
+/**
+ * @brief Visit nothing
+ *
+ * @param directory
+ * @param visit
+ * @param arg
+ */
+static void forNoLine(void *directory, directory_visit_fn visit, void *arg) {
+    (void)directory;
+    (void)visit;
+    (void)arg;
+}
+
+/**
+ * @brief No storage per line
+ *
+ * @param numProcessors
+ * @return unsigned int
+ */
+static unsigned int noEntryBits(int numProcessors) {
+    (void)numProcessors;
+    return 0;
+}
+
+const directory_ops_t snoopBusOps = {
+    .name = "snoop",
+    .create = createNoDirectory,
+    .destroy = destroyNoDirectory,
+    .getState = getNoState,
+    .getSharers = getNoSharers,
+    .setState = setNoState,
+    .addSharer = addNoSharer,
+    .removeSharer = removeNoSharer,
+    .invalidate = invalidateNothing,
+    .checkConsistency = checkNoEntry,
+    .tableStats = noTableStats,
+    .forEachLine = forNoLine,
+    .entryBits = noEntryBits,
+    .broadcast = true,
+};
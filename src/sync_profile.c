@@ -0,0 +1,214 @@
+/**
+ * @file sync_profile.c
+ * @brief Per-line contention and ownership ping-pong of atomic operations.
+ *
+ * Locks and counters live on a handful of lines, so the profile only
+ * holds lines that saw an atomic. A handoff is an atomic by a processor
+ * other than the one that performed the previous atomic on the line: the
+ * line's ownership ping-pongs between caches. Test-and-set locks hand off
+ * on nearly every attempt, test-and-test-and-set locks only when the lock
+ * is released, and ticket locks once per acquire.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sync_profile.h"
+
+/**
+ * @brief Create a synchronization profile.
+ *
+ * @param sectorBits        log2 of the coherence unit in bytes
+ * @return sync_profile_t*  newly allocated profile, NULL on failure
+ */
+sync_profile_t *createSyncProfile(unsigned int sectorBits) {
+    sync_profile_t *profile = calloc(1, sizeof(sync_profile_t));
+    if (profile == NULL) {
+        return NULL;
+    }
+    profile->sectorBits = sectorBits;
+    profile->lines = createLineTable(sizeof(sync_line_t), SYNC_INITIAL_LINES);
+    if (profile->lines == NULL) {
+        free(profile);
+        return NULL;
+    }
+    return profile;
+}
+
+/**
+ * @brief Record one atomic read-modify-write.
+ *
+ * @param profile
+ * @param access
+ * @param issuedAt          processor's clock before the atomic
+ * @param completedAt       processor's clock after it
+ * @param neededOwnership   the line was missing or not held exclusively
+ */
+void profileAtomic(sync_profile_t *profile, const access_t *access, unsigned long issuedAt,
+                   unsigned long completedAt, bool neededOwnership) {
+    bool created;
+    sync_line_t *line = lineTableInsert(profile->lines, access->address >> profile->sectorBits,
+                                        &created);
+    if (line == NULL) {
+        return;
+    }
+    if (created) {
+        line->lastProcessor = -1;
+        line->busyProcessor = -1;
+    }
+    switch (access->type) {
+        case ACCESS_TEST_AND_SET:
+            line->testAndSets++;
+            break;
+        case ACCESS_COMPARE_AND_SWAP:
+            line->compareAndSwaps++;
+            break;
+        default:
+            line->fetchAdds++;
+            break;
+    }
+    if (neededOwnership) {
+        line->ownershipRequests++;
+    }
+    if (line->lastProcessor >= 0 && line->lastProcessor != access->processorId) {
+        line->handoffs++;
+        profile->handoffs++;
+    }
+    if (line->busyProcessor >= 0 && line->busyProcessor != access->processorId &&
+        issuedAt < line->busyUntil) {
+        line->contended++;
+        profile->contended++;
+    }
+    if (completedAt >= line->busyUntil) {
+        line->busyUntil = completedAt;
+        line->busyProcessor = access->processorId;
+    }
+    line->cycles += completedAt - issuedAt;
+    sharerSetAdd(&line->processors, access->processorId);
+    line->lastProcessor = access->processorId;
+    profile->atomics++;
+}
+
+/**
+ * @brief One line kept for the most handed off list
+ *
+ */
+typedef struct ranked_sync_line {
+    unsigned long sector;
+    sync_line_t line;
+} ranked_sync_line_t;
+
+/**
+ * @brief Totals and top lines gathered by one pass over the lines
+ *
+ */
+typedef struct sync_report {
+    unsigned long lines;
+    unsigned long testAndSets;
+    unsigned long compareAndSwaps;
+    unsigned long fetchAdds;
+    unsigned long ownershipRequests;
+    unsigned long cycles;
+    ranked_sync_line_t *top;
+    int topCount;
+    int topLines;
+} sync_report_t;
+
+/**
+ * @brief Whether one line ping-pongs more than another
+ *
+ * @param a
+ * @param b
+ * @return bool
+ */
+static bool pingPongsMore(const sync_line_t *a, const sync_line_t *b) {
+    if (a->handoffs != b->handoffs) {
+        return a->handoffs > b->handoffs;
+    }
+    return a->contended > b->contended;
+}
+
+/**
+ * @brief Add one line to the report
+ *
+ * @param arg               sync_report_t
+ * @param sector
+ * @param entry             sync_line_t
+ */
+static void reportSyncLine(void *arg, unsigned long sector, void *entry) {
+    sync_report_t *report = arg;
+    const sync_line_t *line = entry;
+    report->lines++;
+    report->testAndSets += line->testAndSets;
+    report->compareAndSwaps += line->compareAndSwaps;
+    report->fetchAdds += line->fetchAdds;
+    report->ownershipRequests += line->ownershipRequests;
+    report->cycles += line->cycles;
+
+    if (report->topLines == 0) {
+        return;
+    }
+    int position = report->topCount;
+    if (position == report->topLines) {
+        if (!pingPongsMore(line, &report->top[position - 1].line)) {
+            return;
+        }
+        position--;
+    } else {
+        report->topCount++;
+    }
+    while (position > 0 && pingPongsMore(line, &report->top[position - 1].line)) {
+        report->top[position] = report->top[position - 1];
+        position--;
+    }
+    report->top[position].sector = sector;
+    report->top[position].line = *line;
+}
+
+/**
+ * @brief Print the atomic totals and the lines handed off most often.
+ *
+ * @param profile
+ * @param topLines          number of lines to list
+ */
+void printSyncProfile(sync_profile_t *profile, int topLines) {
+    sync_report_t report;
+    memset(&report, 0, sizeof(report));
+    report.topLines = topLines > 0 ? topLines : 0;
+    report.top = calloc(report.topLines ? report.topLines : 1, sizeof(ranked_sync_line_t));
+    if (report.top == NULL) {
+        report.topLines = 0;
+    }
+    lineTableForEach(profile->lines, reportSyncLine, &report);
+
+    printf("Atomics: %lu on %lu lines (test-and-set: %lu, compare-and-swap: %lu, "
+           "fetch-add: %lu), ownership requests: %lu, handoffs: %lu, contended: %lu, "
+           "average latency: %.2f\n",
+           profile->atomics, report.lines, report.testAndSets, report.compareAndSwaps,
+           report.fetchAdds, report.ownershipRequests, profile->handoffs, profile->contended,
+           profile->atomics ? (double)report.cycles / profile->atomics : 0.0);
+    if (report.topCount > 0) {
+        printf("  %-18s %10s %10s %10s %10s %10s %12s\n", "address", "atomics", "processors",
+               "ownership", "handoffs", "contended", "avg latency");
+    }
+    for (int i = 0; i < report.topCount; i++) {
+        const sync_line_t *line = &report.top[i].line;
+        unsigned long atomics = line->testAndSets + line->compareAndSwaps + line->fetchAdds;
+        printf("  %-18lx %10lu %10d %10lu %10lu %10lu %12.2f\n",
+               report.top[i].sector << profile->sectorBits, atomics,
+               sharerSetCount(&line->processors), line->ownershipRequests, line->handoffs,
+               line->contended, atomics ? (double)line->cycles / atomics : 0.0);
+    }
+    free(report.top);
+}
+
+/**
+ * @brief Free a synchronization profile.
+ *
+ * @param profile
+ */
+void freeSyncProfile(sync_profile_t *profile) {
+    if (profile != NULL) {
+        freeLineTable(profile->lines);
+        free(profile);
+    }
+}
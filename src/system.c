@@ -0,0 +1,492 @@
+/**
+ * @file system.c
+ * @brief A complete simulated machine: processors, caches, directory slices,
+ *        interconnect and home node mapping.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "system.h"
+
+/**
+ * @brief initializeSystem
+ *
+ * @param config            parameters of the machine
+ * @return system_t*        newly allocated machine, NULL on failure
+ */
+system_t *initializeSystem(const system_config_t *config) {
+    if (config->numProcessors < 1 || config->numProcessors > NUM_PROCESSORS ||
+        config->dirOps == NULL || config->directoryLines < 1 ||
+        (config->regionBits > 0 && config->regionBits < config->b)) {
+        return NULL;
+    }
+    system_t *sys = calloc(1, sizeof(system_t));
+    if (sys == NULL) {
+        return NULL;
+    }
+    sys->config = *config;
+    if (sys->config.sectorBits == 0) {
+        sys->config.sectorBits = config->b;
+    }
+    const char *hops = config->forwarding ? "3-hop" : "4-hop";
+    size_t length = snprintf(sys->label, sizeof(sys->label), "%s %s %s s=%u E=%u b=%u",
+                             config->dirOps->name, protocolName(config->protocol),
+                             config->dirOps->broadcast ? "bus" : hops,
+                             config->s, config->E, config->b);
+    if (sys->config.sectorBits != config->b && length < sizeof(sys->label)) {
+        length += snprintf(sys->label + length, sizeof(sys->label) - length, " x=%u",
+                           sys->config.sectorBits);
+    }
+    if ((config->writePolicy != POLICY_WRITE_BACK || config->noWriteAllocate) &&
+        length < sizeof(sys->label)) {
+        length += snprintf(sys->label + length, sizeof(sys->label) - length, " %s",
+                           writePolicyName(config->writePolicy, !config->noWriteAllocate));
+    }
+    if (config->writeBufferDepth > 0 && length < sizeof(sys->label)) {
+        length += snprintf(sys->label + length, sizeof(sys->label) - length, " wbuf=%d:%s",
+                           config->writeBufferDepth, drainPolicyName(config->writeBufferDrain));
+    }
+    if (config->victimLines > 0 && length < sizeof(sys->label)) {
+        length += snprintf(sys->label + length, sizeof(sys->label) - length, " vc=%d",
+                           config->victimLines);
+    }
+    if (config->mshrs > 0 && length < sizeof(sys->label)) {
+        length += snprintf(sys->label + length, sizeof(sys->label) - length, " mshr=%d",
+                           config->mshrs);
+    }
+    if (config->dramBanks > 0 && length < sizeof(sys->label)) {
+        length += snprintf(sys->label + length, sizeof(sys->label) - length, " dram=%d:%d",
+                           config->dramBanks, config->dramQueueDepth);
+    }
+    if (config->regionBits > 0 && !config->dirOps->broadcast && length < sizeof(sys->label)) {
+        snprintf(sys->label + length, sizeof(sys->label) - length, " region=%lu",
+                 1UL << config->regionBits);
+    }
+
+    // Every address is homed on one processor's memory and directory slice
+    sys->homeMap = createHomeMap(config->homePolicy, config->numProcessors,
+                                 config->homeGranularityBits);
+    sys->interconnect = createInterconnect(sys->processors, config->numProcessors);
+    if (sys->homeMap == NULL || sys->interconnect == NULL) {
+        cleanupSystem(sys);
+        return NULL;
+    }
+    if (config->dirOps->broadcast) {
+        sys->bus = createSnoopBus(sys->processors, config->numProcessors, sys->interconnect);
+        if (sys->bus == NULL) {
+            cleanupSystem(sys);
+            return NULL;
+        }
+        sys->interconnect->bus = sys->bus;
+    }
+    // A snooping bus has no directory lookups to filter
+    if (config->regionBits > 0 && !config->dirOps->broadcast) {
+        sys->regions = createRegionTracker(config->regionBits, sys->config.sectorBits,
+                                           sys->processors, sys->homeMap);
+        if (sys->regions == NULL) {
+            cleanupSystem(sys);
+            return NULL;
+        }
+    }
+    sys->syncProfile = createSyncProfile(sys->config.sectorBits);
+    if (sys->syncProfile == NULL) {
+        cleanupSystem(sys);
+        return NULL;
+    }
+    // Coherence misses are told apart by the sharing profile
+    if (config->profileTopLines > 0 || config->classifyMisses) {
+        sys->profile = createSharingProfile(config->numProcessors, config->b);
+        if (sys->profile == NULL) {
+            cleanupSystem(sys);
+            return NULL;
+        }
+    }
+
+    // Initialize and connect all caches to the interconnect
+    for (int i = 0; i < config->numProcessors; ++i) {
+        processor_t *processor = &sys->processors[i];
+        processor->processor_id = i;
+        processor->interconnect = sys->interconnect;
+        processor->dirOps = config->dirOps;
+        processor->forwarding = config->forwarding;
+        processor->regions = sys->regions;
+        processor->directory = config->dirOps->create(config->directoryLines);
+        processor->cache = initializeCache(config->s, config->E, config->b,
+                                           sys->config.sectorBits, i);
+        if (processor->directory == NULL || processor->cache == NULL) {
+            cleanupSystem(sys);
+            return NULL;
+        }
+        if (config->dramBanks > 0) {
+            processor->dram = createDramController(config->dramBanks, config->dramQueueDepth);
+            if (processor->dram == NULL) {
+                cleanupSystem(sys);
+                return NULL;
+            }
+        }
+        if (config->classifyMisses) {
+            processor->classifier = createMissClassifier(config->s, config->E, config->b);
+            if (processor->classifier == NULL) {
+                cleanupSystem(sys);
+                return NULL;
+            }
+        }
+        connectCacheToInterconnect(processor->cache, sys->interconnect);
+        connectCacheToHomeMap(processor->cache, sys->homeMap);
+        setCacheProtocol(processor->cache, config->protocol);
+        setCacheWritePolicy(processor->cache, config->writePolicy, !config->noWriteAllocate);
+        if (!attachWriteBuffer(processor->cache, config->writeBufferDepth,
+                               config->writeBufferDrain) ||
+            !attachVictimCache(processor->cache, config->victimLines) ||
+            !attachMSHRs(processor->cache, config->mshrs)) {
+            cleanupSystem(sys);
+            return NULL;
+        }
+        connectCacheToProfile(processor->cache, sys->profile);
+    }
+    if (config->checkMode != CHECK_OFF) {
+        sys->checker = createCoherenceChecker(config->checkMode, config->checkPeriod);
+        if (sys->checker == NULL) {
+            cleanupSystem(sys);
+            return NULL;
+        }
+    }
+    if (config->statsPath != NULL) {
+        sys->intervals = createIntervalStats(config->statsPath, config->statsFormat,
+                                             config->statsUnit, config->statsPeriod,
+                                             config->numProcessors);
+        if (sys->intervals == NULL) {
+            cleanupSystem(sys);
+            return NULL;
+        }
+    }
+    return sys;
+}
+
+/**
+ * @brief Copy the machine's counters into the next interval snapshot
+ *
+ * @param sys
+ */
+static void takeSnapshot(system_t *sys) {
+    interval_snapshot_t *snapshot = beginSnapshot(sys->intervals);
+    snapshot->accesses = sys->accessCount;
+    snapshot->cycles = machineCycles(sys);
+    snapshot->messages = interconnectTotalMessages(sys->interconnect);
+    for (int i = 0; i < sys->config.numProcessors; i++) {
+        const processor_t *processor = &sys->processors[i];
+        const cache_t *C = processor->cache;
+        interval_counters_t *node = &snapshot->nodes[i];
+        node->hits = C->hitCount;
+        node->misses = C->missCount;
+        node->upgrades = C->upgradeCount;
+        node->invalidations = C->invalidationCount;
+        node->evictions = C->evictionCount;
+        node->cycles = C->cycleCount;
+        node->memoryReads = processor->memoryReads;
+        node->memoryWrites = processor->memoryWrites;
+        node->forwards = processor->forwardCount;
+    }
+    publishSnapshot(sys->intervals, sys->intervals->unit == INTERVAL_ACCESSES
+                                        ? sys->intervals->count : snapshot->cycles);
+}
+
+/**
+ * @brief Perform a read, write or atomic and feed the profiles with it
+ *
+ * @param sys
+ * @param processor
+ * @param access
+ */
+static void memoryAccess(system_t *sys, processor_t *processor, const access_t *access) {
+    cache_t *cache = processor->cache;
+    int missed = 0;
+
+    switch (access->type) {
+        case ACCESS_READ:
+            missed = readFromCache(cache, access->address);
+            break;
+        case ACCESS_WRITE:
+            missed = writeToCache(cache, access->address);
+            break;
+        case ACCESS_TEST_AND_SET:
+        case ACCESS_COMPARE_AND_SWAP:
+        case ACCESS_FETCH_ADD: {
+            unsigned long issuedAt = cache->cycleCount;
+            unsigned long requests = cache->missCount + cache->upgradeCount;
+            missed = atomicToCache(cache, access->address);
+            profileAtomic(sys->syncProfile, access, issuedAt, cache->cycleCount,
+                          cache->missCount + cache->upgradeCount != requests);
+            break;
+        }
+        default:
+            break;
+    }
+    profile_miss_kind coherence = PROFILE_NOT_COHERENCE;
+    if (sys->profile != NULL) {
+        coherence = profileAccess(sys->profile, access->processorId, access->address,
+                                  access->type != ACCESS_READ, missed != 0);
+    }
+    if (processor->classifier != NULL) {
+        miss_class missClass = classifyAccess(processor->classifier, access->address,
+                                              missed != 0, coherence);
+        if (missClass != NUM_MISS_CLASSES) {
+            cache->missClassCount[missClass]++;
+        }
+    }
+}
+
+/**
+ * @brief Simulate one decoded trace record
+ *
+ * @param sys
+ * @param access
+ */
+void systemAccess(system_t *sys, const access_t *access) {
+    if (access->processorId < 0 || access->processorId >= sys->config.numProcessors) {
+        sys->droppedCount++;
+        return;
+    }
+    processor_t *processor = &sys->processors[access->processorId];
+    cache_t *cache = processor->cache;
+
+    bool fence = access->type == ACCESS_FENCE;
+    if (fence) {
+        fenceCache(cache);
+    } else {
+        memoryAccess(sys, processor, access);
+    }
+    sys->accessCount++;
+    if (!fence && sys->checker != NULL &&
+        checkDue(sys->checker, access->address >> sys->config.sectorBits)) {
+        checkLine(sys->checker, sys, access->address);
+    }
+    if (sys->intervals != NULL && intervalDue(sys->intervals, cache->cycleCount)) {
+        takeSnapshot(sys);
+    }
+}
+
+/**
+ * @brief Simulate a batch of decoded trace records in order
+ *
+ * @param sys
+ * @param accesses
+ * @param count
+ */
+void simulateAccesses(system_t *sys, const access_t *accesses, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        systemAccess(sys, &accesses[i]);
+    }
+}
+
+/**
+ * @brief Simulates the execution of one trace line.
+ *
+ * @param sys
+ * @param request_line      "<pid> <R|W|T|C|A|F> <hexaddr>"
+ */
+void executeInstruction(system_t *sys, char *request_line) {
+    access_t access;
+    if (decodeTraceLine(request_line, &access)) {
+        systemAccess(sys, &access);
+    }
+}
+
+/**
+ * @brief Let the misses still in flight complete once the trace has ended
+ *
+ * @param sys
+ */
+void finishSystem(system_t *sys) {
+    for (int i = 0; i < sys->config.numProcessors; i++) {
+        cacheWaitForMisses(sys->processors[i].cache);
+    }
+}
+
+/**
+ * @brief Print the per-processor and interconnect statistics of a machine
+ *
+ * @param sys
+ */
+void printSystemSummary(const system_t *sys) {
+    printf("=== %s (%d processors, home: %s) ===\n", sys->label,
+           sys->config.numProcessors, homePolicyName(sys->config.homePolicy));
+    for (int i = 0; i < sys->config.numProcessors; i++) {
+        const cache_t *C = sys->processors[i].cache;
+        printf("P%d: hits: %lu, misses: %lu, evictions: %lu, dirty evictions: %lu, "
+               "upgrades: %lu, silent upgrades: %lu, writebacks avoided: %lu, "
+               "invalidations: %lu, cycles: %lu\n",
+               C->processor_id, C->hitCount, C->missCount, C->evictionCount,
+               C->dirtyEvictionCount, C->upgradeCount, C->silentUpgradeCount,
+               C->writebacksAvoided, C->invalidationCount, C->cycleCount);
+    }
+    for (int i = 0; i < sys->config.numProcessors; i++) {
+        printMissLocality(sys->processors[i].cache);
+    }
+    for (int i = 0; i < sys->config.numProcessors && sys->config.sectorBits != sys->config.b; i++) {
+        const cache_t *C = sys->processors[i].cache;
+        printf("P%d: sector misses (tag present): %lu of %lu misses, %lu byte sectors\n",
+               C->processor_id, C->sectorMissCount, C->missCount, 1UL << C->sectorBits);
+    }
+    for (int i = 0; i < sys->config.numProcessors && sys->config.classifyMisses; i++) {
+        printMissClasses(sys->processors[i].cache);
+    }
+    bool storesWrittenThrough = sys->config.writePolicy != POLICY_WRITE_BACK ||
+                                sys->config.noWriteAllocate;
+    for (int i = 0; i < sys->config.numProcessors && storesWrittenThrough; i++) {
+        printWritePolicy(sys->processors[i].cache);
+    }
+    bool missHandling = sys->config.victimLines > 0 || sys->config.mshrs > 0;
+    for (int i = 0; i < sys->config.numProcessors && missHandling; i++) {
+        printMissHandling(sys->processors[i].cache);
+    }
+    bool synchronized = sys->syncProfile->atomics > 0;
+    for (int i = 0; i < sys->config.numProcessors && !synchronized; i++) {
+        synchronized = sys->processors[i].cache->fenceCount > 0;
+    }
+    for (int i = 0; i < sys->config.numProcessors && synchronized; i++) {
+        printSynchronization(sys->processors[i].cache);
+    }
+    for (int i = 0; i < sys->config.numProcessors; i++) {
+        const processor_t *home = &sys->processors[i];
+        printf("Home %d: memory reads: %lu, memory writes: %lu, forwarded: %lu\n",
+               i, home->memoryReads, home->memoryWrites, home->forwardCount);
+    }
+    for (int i = 0; i < sys->config.numProcessors && sys->config.dramBanks > 0; i++) {
+        printDramController(sys->processors[i].dram, i);
+    }
+    if (sys->bus != NULL) {
+        printSnoopBus(sys->bus, machineCycles(sys));
+    }
+    for (int i = 0; i < sys->config.numProcessors && sys->bus == NULL; i++) {
+        const processor_t *home = &sys->processors[i];
+        line_table_stats_t stats;
+        home->dirOps->tableStats(home->directory, &stats);
+        printf("Directory %d: entries: %zu, slots: %zu, load factor: %.2f, "
+               "average probe: %.2f, max displacement: %u\n",
+               i, stats.entries, stats.slots, stats.loadFactor, stats.averageProbe,
+               stats.maxDisplacement);
+        if (home->dirOps->printStats != NULL) {
+            home->dirOps->printStats(home->directory, i);
+        }
+    }
+    if (sys->regions != NULL) {
+        unsigned long entries = 0;
+        for (int i = 0; i < sys->config.numProcessors; i++) {
+            const processor_t *home = &sys->processors[i];
+            line_table_stats_t stats;
+            home->dirOps->tableStats(home->directory, &stats);
+            entries += stats.entries;
+        }
+        printRegionTracker(sys->regions, entries);
+    }
+    printf("Average miss latency: %.2f cycles\n", averageMissLatency(sys));
+
+    const interconnect_t *net = sys->interconnect;
+    printf("Messages: %lu (local: %lu, remote: %lu)\n",
+           interconnectTotalMessages(net), net->localMessages, net->remoteMessages);
+    printf("Network bytes: %lu (headers: %lu, data: %lu)\n", interconnectTotalBytes(net),
+           net->headerBytes, net->dataBytes);
+    for (int type = 0; type < NUM_MESSAGE_TYPES; type++) {
+        if (net->messageCount[type] != 0) {
+            printf("  %s: %lu\n", messageTypeName(type), net->messageCount[type]);
+        }
+    }
+    if (sys->droppedCount != 0) {
+        printf("Dropped records: %lu\n", sys->droppedCount);
+    }
+    if (sys->intervals != NULL) {
+        printIntervalStats(sys->intervals);
+    }
+    if (sys->checker != NULL) {
+        printCheckerReport(sys->checker);
+    }
+    if (sys->syncProfile->atomics > 0) {
+        printSyncProfile(sys->syncProfile, SYNC_TOP_LINES);
+    }
+    if (sys->config.profileTopLines > 0) {
+        printSharingProfile(sys->profile, sys->config.profileTopLines);
+    }
+    if (sys->config.accounting) {
+        printAccounting(sys);
+    }
+}
+
+/**
+ * @brief Average cycles a miss or upgrade waited on the directory
+ *
+ * Write misses sent on without filling the line wait on the write buffer
+ * instead, so they are left out.
+ *
+ * @param sys
+ * @return double
+ */
+double averageMissLatency(const system_t *sys) {
+    unsigned long cycles = 0, transactions = 0;
+    for (int i = 0; i < sys->config.numProcessors; i++) {
+        const cache_t *C = sys->processors[i].cache;
+        cycles += C->missLatencyCycles;
+        transactions += C->missCount - C->unallocatedWriteCount + C->upgradeCount;
+    }
+    return transactions ? (double)cycles / transactions : 0.0;
+}
+
+/**
+ * @brief Machine clock: processors run in parallel, so the busiest one's cycles
+ *
+ * @param sys
+ * @return unsigned long
+ */
+unsigned long machineCycles(const system_t *sys) {
+    unsigned long cycles = 0;
+    for (int i = 0; i < sys->config.numProcessors; i++) {
+        if (sys->processors[i].cache->cycleCount > cycles) {
+            cycles = sys->processors[i].cache->cycleCount;
+        }
+    }
+    return cycles;
+}
+
+/**
+ * @brief cleanup System
+ *
+ * @param sys
+ */
+void cleanupSystem(system_t *sys) {
+    if (sys == NULL) {
+        return;
+    }
+    // The last, partial interval is written before the writer stops
+    if (sys->intervals != NULL) {
+        if (sys->accessCount != sys->intervals->lastAccesses) {
+            takeSnapshot(sys);
+        }
+        if (!freeIntervalStats(sys->intervals)) {
+            fprintf(stderr, "Could not write interval statistics to %s\n", sys->config.statsPath);
+        }
+    }
+
+    // Cleanup caches and directory slices
+    for (int i = 0; i < sys->config.numProcessors; ++i) {
+        processor_t *processor = &sys->processors[i];
+        if (processor->cache != NULL) {
+            freeCache(processor->cache);
+        }
+        if (processor->directory != NULL) {
+            processor->dirOps->destroy(processor->directory);
+        }
+        freeMissClassifier(processor->classifier);
+        freeDramController(processor->dram);
+    }
+
+    // Cleanup interconnect
+    if (sys->interconnect != NULL) {
+        freeInterconnect(sys->interconnect);
+    }
+    freeSnoopBus(sys->bus);
+    freeRegionTracker(sys->regions);
+    freeHomeMap(sys->homeMap);
+    freeSharingProfile(sys->profile);
+    freeCoherenceChecker(sys->checker);
+    freeSyncProfile(sys->syncProfile);
+    free(sys);
+}
@@ -0,0 +1,151 @@
+/**
+ * @file trace.c
+ * @brief Decode "<pid> <R|W> <hexaddr>" trace lines into fixed-size records.
+ *
+ * Decoding is done by hand rather than with sscanf since parsing is a large
+ * share of the cost of a run; a trace is decoded once per run no matter how
+ * many systems consume the records.
+ */
+#include "directory.h"
+#include "trace.h"
+
+/** @brief Letter of each access type in a trace line, indexed by access_type */
+static const char accessLetters[NUM_ACCESS_TYPES] = { 'R', 'W', 'T', 'C', 'A', 'F' };
+
+/**
+ * @brief Skip spaces and tabs
+ *
+ * @param p
+ * @return const char*
+ */
+static const char *skipBlanks(const char *p) {
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * @brief Value of a hex digit, -1 if the character is not one
+ *
+ * @param c
+ * @return int
+ */
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * @brief Decode one trace line.
+ *
+ * @param line              "<pid> <R|W|T|C|A|F> <hexaddr>", the address may start
+ *                          with 0x and may be left out of a fence
+ * @param access            filled in on success
+ * @return true             line was a valid record
+ */
+bool decodeTraceLine(const char *line, access_t *access) {
+    const char *p = skipBlanks(line);
+
+    if (*p < '0' || *p > '9') {
+        return false;
+    }
+    // Ids up to NUM_PROCESSORS still reach the system, which counts the
+    // ones past its processor count as dropped; larger ones are malformed
+    int processorId = 0;
+    while (*p >= '0' && *p <= '9') {
+        processorId = processorId * 10 + (*p - '0');
+        if (processorId > NUM_PROCESSORS) {
+            return false;
+        }
+        p++;
+    }
+
+    p = skipBlanks(p);
+    switch (*p) {
+        case 'R':
+            access->type = ACCESS_READ;
+            break;
+        case 'W':
+            access->type = ACCESS_WRITE;
+            break;
+        case 'T':
+            access->type = ACCESS_TEST_AND_SET;
+            break;
+        case 'C':
+            access->type = ACCESS_COMPARE_AND_SWAP;
+            break;
+        case 'A':
+            access->type = ACCESS_FETCH_ADD;
+            break;
+        case 'F':
+            access->type = ACCESS_FENCE;
+            break;
+        default:
+            return false;
+    }
+    p = skipBlanks(p + 1);
+    if (access->type == ACCESS_FENCE && hexValue(*p) < 0) {
+        access->processorId = processorId;
+        access->address = 0;
+        return true;
+    }
+
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        p += 2;
+    }
+    if (hexValue(*p) < 0) {
+        return false;
+    }
+    unsigned long address = 0;
+    for (int digit = hexValue(*p); digit >= 0; digit = hexValue(*++p)) {
+        address = (address << 4) | (unsigned long)digit;
+    }
+
+    access->processorId = processorId;
+    access->address = address;
+    return true;
+}
+
+/**
+ * @brief Decode the next chunk of a trace file, skipping malformed lines.
+ *
+ * @param trace             open trace file
+ * @param records           buffer for the decoded records
+ * @param maxRecords        capacity of the buffer
+ * @return size_t           number of records decoded, 0 at end of file
+ */
+size_t decodeTraceChunk(FILE *trace, access_t *records, size_t maxRecords) {
+    char line[MAX_TRACE_LINE];
+    size_t count = 0;
+
+    while (count < maxRecords && fgets(line, sizeof(line), trace) != NULL) {
+        if (decodeTraceLine(line, &records[count])) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Letter an access type is written as in a trace line.
+ *
+ * @param type
+ * @return char
+ */
+char accessTypeLetter(access_type type) {
+    return type >= 0 && type < NUM_ACCESS_TYPES ? accessLetters[type] : '?';
+}
+
+/**
+ * @brief Whether an access is an atomic read-modify-write
+ *
+ * @param type
+ * @return bool
+ */
+bool isAtomicAccess(access_type type) {
+    return type == ACCESS_TEST_AND_SET || type == ACCESS_COMPARE_AND_SWAP ||
+           type == ACCESS_FETCH_ADD;
+}
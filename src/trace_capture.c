@@ -0,0 +1,486 @@
+/**
+ * @file trace_capture.c
+ * @brief Per-thread capture buffers, their background writer, and the merge
+ *        of per-thread files into one trace.
+ *
+ * A thread fills its buffers in ring order and hands each one over by
+ * setting its full flag; the writer takes them in the same order, so each
+ * file holds its thread's records in program order. Only attaching a new
+ * thread takes a lock. The thread waits, yielding, only when the writer has
+ * fallen behind by every buffer it has, so no record is ever dropped.
+ *
+ * captureStop must be called once the instrumented threads have stopped
+ * recording, typically after joining them: it hands over the buffers they
+ * were still filling and frees them.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "trace_capture.h"
+
+unsigned int captureGeneration;
+__thread capture_thread_t *captureThread;
+__thread unsigned int captureThreadGeneration;
+
+/** @brief Threads attached to the running capture; only grows while it runs */
+static capture_thread_t *threads[CAPTURE_MAX_THREADS];
+static int numThreads;
+
+/** @brief Serializes attaching threads, starting and stopping */
+static pthread_mutex_t captureLock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t writer;
+static int stopping;
+static unsigned int lastGeneration;
+static char capturePrefix[CAPTURE_PREFIX_LEN];
+static unsigned long bytesWritten;
+static bool writeFailed;
+
+/** @brief Hands over a thread's last buffer when the thread exits */
+static pthread_key_t exitKey;
+static pthread_once_t exitKeyOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Hand a thread's partly filled buffer to the writer
+ *
+ * @param thread
+ */
+static void handOverCurrent(capture_thread_t *thread) {
+    capture_buffer_t *buffer = thread->current;
+    if (buffer->count != 0 && !__atomic_load_n(&buffer->full, __ATOMIC_ACQUIRE)) {
+        thread->records += buffer->count;
+        __atomic_store_n(&buffer->full, 1, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @brief Thread exit destructor: hand over what the thread recorded last
+ *
+ * @param arg               capture_thread_t
+ */
+static void threadExited(void *arg) {
+    // A stale value from a capture that already stopped has been freed
+    if (captureThreadGeneration == __atomic_load_n(&captureGeneration, __ATOMIC_ACQUIRE)) {
+        handOverCurrent(arg);
+    }
+}
+
+/**
+ * @brief Create the thread exit key, once per process
+ *
+ */
+static void createExitKey(void) {
+    pthread_key_create(&exitKey, threadExited);
+}
+
+/**
+ * @brief Write every buffer a thread has handed over, in order
+ *
+ * @param thread
+ * @return bool             whether anything was written
+ */
+static bool writeThread(capture_thread_t *thread) {
+    bool wrote = false;
+    capture_buffer_t *buffer = &thread->buffers[thread->writeNext];
+    while (__atomic_load_n(&buffer->full, __ATOMIC_ACQUIRE)) {
+        size_t written = fwrite(buffer->records, sizeof(capture_record_t), buffer->count,
+                                thread->file);
+        if (written != buffer->count) {
+            writeFailed = true;
+        }
+        bytesWritten += written * sizeof(capture_record_t);
+        buffer->count = 0;
+        __atomic_store_n(&buffer->full, 0, __ATOMIC_RELEASE);
+        wrote = true;
+        thread->writeNext = (thread->writeNext + 1) % CAPTURE_BUFFERS_PER_THREAD;
+        buffer = &thread->buffers[thread->writeNext];
+    }
+    return wrote;
+}
+
+/**
+ * @brief Writer thread: poll every thread for full buffers until stopped
+ *
+ * @param arg               unused
+ * @return void*
+ */
+static void *writerMain(void *arg) {
+    (void)arg;
+    for (;;) {
+        // Read before the pass, so buffers handed over before the stop are written
+        bool stop = __atomic_load_n(&stopping, __ATOMIC_ACQUIRE);
+        int count = __atomic_load_n(&numThreads, __ATOMIC_ACQUIRE);
+        bool wrote = false;
+        for (int i = 0; i < count; i++) {
+            wrote |= writeThread(threads[i]);
+        }
+        if (!wrote) {
+            if (stop) {
+                break;
+            }
+            usleep(CAPTURE_POLL_MICROSECONDS);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Free a thread's buffers and close its file
+ *
+ * @param thread
+ * @return bool             whether the file was closed without error
+ */
+static bool freeCaptureThread(capture_thread_t *thread) {
+    bool ok = true;
+    if (thread != NULL) {
+        if (thread->file != NULL) {
+            ok = fclose(thread->file) == 0;
+        }
+        for (int i = 0; i < CAPTURE_BUFFERS_PER_THREAD; i++) {
+            free(thread->buffers[i].records);
+        }
+        free(thread);
+    }
+    return ok;
+}
+
+/**
+ * @brief Allocate the buffers and open the file of the next thread to attach
+ *
+ * @param processorId       pid for its accesses, -1 for the order it attached in
+ * @return capture_thread_t*    NULL on failure
+ */
+static capture_thread_t *createCaptureThread(int processorId) {
+    capture_thread_t *thread = calloc(1, sizeof(capture_thread_t));
+    bool ok = thread != NULL;
+    for (int i = 0; ok && i < CAPTURE_BUFFERS_PER_THREAD; i++) {
+        size_t bytes = CAPTURE_BUFFER_RECORDS * sizeof(capture_record_t);
+        thread->buffers[i].records = malloc(bytes);
+        ok = thread->buffers[i].records != NULL;
+        if (ok) {
+            // Fault the pages in now rather than on the recording path
+            memset(thread->buffers[i].records, 0, bytes);
+        }
+    }
+    if (ok) {
+        char path[CAPTURE_PREFIX_LEN + 16];
+        snprintf(path, sizeof(path), "%s.%d", capturePrefix, numThreads);
+        thread->file = fopen(path, "wb");
+        ok = thread->file != NULL;
+        if (!ok) {
+            perror(path);
+        }
+    }
+    if (ok) {
+        capture_header_t header = { CAPTURE_MAGIC, CAPTURE_VERSION, 0 };
+        thread->processorId = processorId >= 0 ? processorId : numThreads;
+        header.processorId = thread->processorId;
+        ok = fwrite(&header, sizeof(header), 1, thread->file) == 1;
+    }
+    if (!ok) {
+        freeCaptureThread(thread);
+        return NULL;
+    }
+    thread->current = &thread->buffers[0];
+    thread->next = 1 % CAPTURE_BUFFERS_PER_THREAD;
+    return thread;
+}
+
+/**
+ * @brief Start capturing; each thread's accesses go to "<prefix>.<n>".
+ *
+ * @param prefix
+ * @return bool             false if a capture is running or the writer could not start
+ */
+bool captureStart(const char *prefix) {
+    pthread_once(&exitKeyOnce, createExitKey);
+    pthread_mutex_lock(&captureLock);
+    if (captureGeneration != 0 || strlen(prefix) >= CAPTURE_PREFIX_LEN) {
+        pthread_mutex_unlock(&captureLock);
+        return false;
+    }
+    strcpy(capturePrefix, prefix);
+    numThreads = 0;
+    stopping = 0;
+    bytesWritten = 0;
+    writeFailed = false;
+    if (pthread_create(&writer, NULL, writerMain, NULL) != 0) {
+        pthread_mutex_unlock(&captureLock);
+        return false;
+    }
+    if (++lastGeneration == 0) {
+        lastGeneration = 1;
+    }
+    __atomic_store_n(&captureGeneration, lastGeneration, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&captureLock);
+    return true;
+}
+
+/**
+ * @brief Give the calling thread its buffers and file.
+ *
+ * Called on a thread's first access of a capture. A thread that cannot be
+ * attached records nothing until the next capture.
+ *
+ * @param generation        generation the thread saw
+ * @param processorId       pid for its accesses, -1 for the order it attached in
+ * @return capture_thread_t*    NULL if the capture stopped or the thread could not be attached
+ */
+capture_thread_t *captureAttachThread(unsigned int generation, int processorId) {
+    pthread_mutex_lock(&captureLock);
+    capture_thread_t *thread = NULL;
+    if (captureGeneration == generation && numThreads < CAPTURE_MAX_THREADS) {
+        thread = createCaptureThread(processorId);
+    }
+    if (thread != NULL) {
+        threads[numThreads] = thread;
+        __atomic_store_n(&numThreads, numThreads + 1, __ATOMIC_RELEASE);
+    }
+
+    // A thread that was refused remembers it, so it does not retry every access
+    pthread_setspecific(exitKey, thread);
+    captureThread = thread;
+    captureThreadGeneration = generation;
+    pthread_mutex_unlock(&captureLock);
+    return thread;
+}
+
+/**
+ * @brief Hand the calling thread's full buffer to the writer and move to the next.
+ *
+ * @param thread
+ */
+void captureBufferFull(capture_thread_t *thread) {
+    thread->records += thread->current->count;
+    __atomic_store_n(&thread->current->full, 1, __ATOMIC_RELEASE);
+
+    capture_buffer_t *next = &thread->buffers[thread->next];
+    if (__atomic_load_n(&next->full, __ATOMIC_ACQUIRE)) {
+        thread->waits++;
+        while (__atomic_load_n(&next->full, __ATOMIC_ACQUIRE)) {
+            sched_yield();
+        }
+    }
+    thread->current = next;
+    thread->next = (thread->next + 1) % CAPTURE_BUFFERS_PER_THREAD;
+}
+
+/**
+ * @brief Choose the pid written for the calling thread's accesses.
+ *
+ * Must be called before the thread's first access of the capture.
+ *
+ * @param processorId
+ * @return bool             false if no capture is running or the thread is already attached
+ */
+bool captureThreadProcessor(int processorId) {
+    unsigned int generation = __atomic_load_n(&captureGeneration, __ATOMIC_ACQUIRE);
+    if (generation == 0 || captureThreadGeneration == generation) {
+        return false;
+    }
+    return captureAttachThread(generation, processorId) != NULL;
+}
+
+/**
+ * @brief Stop capturing, write what is left and close the files.
+ *
+ * @param stats             filled with the capture's totals, may be NULL
+ * @return bool             false if no capture was running or a file could not be written
+ */
+bool captureStop(capture_stats_t *stats) {
+    pthread_mutex_lock(&captureLock);
+    if (captureGeneration == 0) {
+        pthread_mutex_unlock(&captureLock);
+        return false;
+    }
+    __atomic_store_n(&captureGeneration, 0, __ATOMIC_RELEASE);
+    for (int i = 0; i < numThreads; i++) {
+        handOverCurrent(threads[i]);
+    }
+    __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+    pthread_join(writer, NULL);
+
+    capture_stats_t totals;
+    memset(&totals, 0, sizeof(totals));
+    totals.threads = numThreads;
+    for (int i = 0; i < numThreads; i++) {
+        totals.records += threads[i]->records;
+        totals.waits += threads[i]->waits;
+        if (!freeCaptureThread(threads[i])) {
+            writeFailed = true;
+        }
+        threads[i] = NULL;
+    }
+    numThreads = 0;
+    totals.bytesWritten = bytesWritten;
+    totals.writeFailed = writeFailed;
+    if (stats != NULL) {
+        *stats = totals;
+    }
+    pthread_mutex_unlock(&captureLock);
+    return !totals.writeFailed;
+}
+
+/**
+ * @brief Records of one per-thread file being merged
+ *
+*/
+typedef struct capture_stream {
+    FILE *file;
+    int processorId;
+    int index;                  // File number, to break timestamp ties
+    size_t count;
+    size_t position;
+    capture_record_t records[CAPTURE_MERGE_RECORDS];
+} capture_stream_t;
+
+/**
+ * @brief Make the next record of a stream current
+ *
+ * @param stream
+ * @return bool             false at the end of the file
+ */
+static bool advanceStream(capture_stream_t *stream) {
+    if (++stream->position < stream->count) {
+        return true;
+    }
+    stream->count = fread(stream->records, sizeof(capture_record_t), CAPTURE_MERGE_RECORDS,
+                          stream->file);
+    stream->position = 0;
+    return stream->count != 0;
+}
+
+/**
+ * @brief Whether a stream's current record goes before another's
+ *
+ * @param a
+ * @param b
+ * @return bool
+ */
+static bool streamBefore(const capture_stream_t *a, const capture_stream_t *b) {
+    unsigned long timeA = a->records[a->position].timestamp;
+    unsigned long timeB = b->records[b->position].timestamp;
+    return timeA != timeB ? timeA < timeB : a->index < b->index;
+}
+
+/**
+ * @brief Move the stream at the top of the heap down to its place
+ *
+ * @param heap
+ * @param size
+ */
+static void siftDown(capture_stream_t **heap, int size) {
+    int i = 0;
+    for (;;) {
+        int smallest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < size && streamBefore(heap[left], heap[smallest])) {
+            smallest = left;
+        }
+        if (right < size && streamBefore(heap[right], heap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return;
+        }
+        capture_stream_t *swap = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = swap;
+        i = smallest;
+    }
+}
+
+/**
+ * @brief Merge the per-thread files of a capture into trace lines, by timestamp.
+ *
+ * @param prefix            prefix given to captureStart
+ * @param out
+ * @return long             records written, -1 on error
+ */
+long mergeCapture(const char *prefix, FILE *out) {
+    capture_stream_t *streams[CAPTURE_MAX_THREADS];
+    int numStreams = 0;
+    long merged = 0;
+    bool ok = true;
+
+    for (int i = 0; ok && i < CAPTURE_MAX_THREADS; i++) {
+        char path[CAPTURE_PREFIX_LEN + 16];
+        snprintf(path, sizeof(path), "%s.%d", prefix, i);
+        FILE *file = fopen(path, "rb");
+        if (file == NULL) {
+            if (errno != ENOENT) {
+                perror(path);
+                ok = false;
+            }
+            continue;
+        }
+        capture_header_t header;
+        if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != CAPTURE_MAGIC ||
+            header.version != CAPTURE_VERSION) {
+            fprintf(stderr, "%s: not a capture file\n", path);
+            fclose(file);
+            ok = false;
+            continue;
+        }
+        capture_stream_t *stream = malloc(sizeof(capture_stream_t));
+        if (stream == NULL) {
+            fclose(file);
+            ok = false;
+            continue;
+        }
+        stream->file = file;
+        stream->processorId = header.processorId;
+        stream->index = i;
+        stream->count = 0;
+        stream->position = 0;
+        streams[numStreams++] = stream;
+    }
+    if (ok && numStreams == 0) {
+        fprintf(stderr, "No capture files %s.<n>\n", prefix);
+        ok = false;
+    }
+
+    // Heap of the streams that still have records, earliest current record on top
+    capture_stream_t *heap[CAPTURE_MAX_THREADS];
+    int heapSize = 0;
+    for (int i = 0; ok && i < numStreams; i++) {
+        streams[i]->position = CAPTURE_MERGE_RECORDS;
+        if (advanceStream(streams[i])) {
+            heap[heapSize++] = streams[i];
+            for (int j = heapSize - 1; j > 0 && streamBefore(heap[j], heap[(j - 1) / 2]);
+                 j = (j - 1) / 2) {
+                capture_stream_t *swap = heap[j];
+                heap[j] = heap[(j - 1) / 2];
+                heap[(j - 1) / 2] = swap;
+            }
+        }
+    }
+    while (ok && heapSize > 0) {
+        capture_stream_t *stream = heap[0];
+        const capture_record_t *record = &stream->records[stream->position];
+        fprintf(out, "%d %c %lx\n", stream->processorId,
+                (record->address & CAPTURE_WRITE_BIT) ? 'W' : 'R',
+                record->address & ~CAPTURE_WRITE_BIT);
+        merged++;
+        if (!advanceStream(stream)) {
+            heap[0] = heap[--heapSize];
+        }
+        siftDown(heap, heapSize);
+    }
+
+    for (int i = 0; i < numStreams; i++) {
+        if (ferror(streams[i]->file)) {
+            ok = false;
+        }
+        fclose(streams[i]->file);
+        free(streams[i]);
+    }
+    if (ok && ferror(out)) {
+        ok = false;
+    }
+    return ok ? merged : -1;
+}
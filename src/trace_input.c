@@ -0,0 +1,378 @@
+/**
+ * @file trace_input.c
+ * @brief Trace files read as a byte stream, plain or compressed.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "trace_input.h"
+
+/** @brief First bytes of a gzip member */
+static const unsigned char gzipMagic[] = { 0x1f, 0x8b };
+
+/** @brief First bytes of a zstd frame */
+static const unsigned char zstdMagic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+/**
+ * @brief Tell the compression of a file from its first bytes
+ *
+ * @param file              rewound to the start afterwards
+ * @return trace_compression
+ */
+static trace_compression detectCompression(FILE *file) {
+    unsigned char magic[sizeof(zstdMagic)];
+    size_t length = fread(magic, 1, sizeof(magic), file);
+    rewind(file);
+    if (length >= sizeof(gzipMagic) && memcmp(magic, gzipMagic, sizeof(gzipMagic)) == 0) {
+        return TRACE_GZIP;
+    }
+    if (length >= sizeof(zstdMagic) && memcmp(magic, zstdMagic, sizeof(zstdMagic)) == 0) {
+        return TRACE_ZSTD;
+    }
+    return TRACE_PLAIN;
+}
+
+#ifdef HAVE_ZLIB
+/**
+ * @brief Decompress gzip input until the buffer is full or the file ends
+ *
+ * Concatenated gzip members are read one after the other.
+ *
+ * @param input
+ * @param out
+ * @param capacity
+ * @return size_t           bytes decompressed
+ */
+static size_t inflateInto(trace_input_t *input, char *out, size_t capacity) {
+    z_stream *stream = &input->zstream;
+    stream->next_out = (Bytef *)out;
+    stream->avail_out = (uInt)capacity;
+    while (stream->avail_out > 0) {
+        if (stream->avail_in == 0) {
+            size_t length = fread(input->compressed, 1, COMPRESSED_READ_BYTES, input->file);
+            if (length == 0) {
+                // A member cut short is an error, a clean end between members is not
+                input->failed |= ferror(input->file) != 0 || stream->total_in != 0;
+                break;
+            }
+            stream->next_in = input->compressed;
+            stream->avail_in = (uInt)length;
+        }
+        int status = inflate(stream, Z_NO_FLUSH);
+        if (status == Z_STREAM_END) {
+            if (inflateReset(stream) != Z_OK) {
+                input->failed = true;
+                break;
+            }
+        } else if (status != Z_OK) {
+            input->failed = true;
+            break;
+        }
+    }
+    return capacity - stream->avail_out;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+/**
+ * @brief Decompress zstd input until the buffer is full or the file ends
+ *
+ * @param input
+ * @param out
+ * @param capacity
+ * @return size_t           bytes decompressed
+ */
+static size_t zstdInto(trace_input_t *input, char *out, size_t capacity) {
+    ZSTD_outBuffer output = { out, capacity, 0 };
+    while (output.pos < output.size) {
+        if (input->compressedOffset == input->compressedLength) {
+            input->compressedLength = fread(input->compressed, 1, COMPRESSED_READ_BYTES,
+                                            input->file);
+            input->compressedOffset = 0;
+            // At the end of the file, a frame still in progress may only have
+            // output left to flush; it is tried once more below
+            if (input->compressedLength == 0 &&
+                (ferror(input->file) || input->zstdStatus == 0)) {
+                input->failed |= ferror(input->file) != 0;
+                break;
+            }
+        }
+        ZSTD_inBuffer compressed = { input->compressed, input->compressedLength,
+                                     input->compressedOffset };
+        size_t flushed = output.pos;
+        size_t status = ZSTD_decompressStream(input->zstd, &output, &compressed);
+        input->compressedOffset = compressed.pos;
+        if (ZSTD_isError(status)) {
+            input->failed = true;
+            break;
+        }
+        input->zstdStatus = status;
+        if (input->compressedLength == 0 && output.pos == flushed) {
+            // Out of input with nothing left to flush: the frame was cut short
+            input->failed = true;
+            break;
+        }
+    }
+    return output.pos;
+}
+#endif
+
+/**
+ * @brief Decompress the next stretch of the file
+ *
+ * @param input
+ * @param out
+ * @param capacity
+ * @return size_t           bytes decompressed, less than capacity at the end
+ */
+static size_t decompressInto(trace_input_t *input, char *out, size_t capacity) {
+    // Unused when built without either library
+    (void)out;
+    (void)capacity;
+    switch (input->compression) {
+#ifdef HAVE_ZLIB
+        case TRACE_GZIP:
+            return inflateInto(input, out, capacity);
+#endif
+#ifdef HAVE_ZSTD
+        case TRACE_ZSTD:
+            return zstdInto(input, out, capacity);
+#endif
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Decompression thread: fill the two buffers in turn
+ *
+ * @param arg               trace_input_t
+ * @return void*
+ */
+static void *decompressTrace(void *arg) {
+    trace_input_t *input = arg;
+    int index = 0;
+    bool ended = false;
+    while (!ended) {
+        pthread_mutex_lock(&input->lock);
+        while (input->full[index] && !input->stopping) {
+            pthread_cond_wait(&input->changed, &input->lock);
+        }
+        bool stopping = input->stopping;
+        pthread_mutex_unlock(&input->lock);
+        if (stopping) {
+            break;
+        }
+
+        // The buffer is ours until it is marked full
+        size_t length = decompressInto(input, input->buffers[index], DECOMPRESS_BUFFER_BYTES);
+        ended = length < DECOMPRESS_BUFFER_BYTES || input->failed;
+
+        pthread_mutex_lock(&input->lock);
+        input->lengths[index] = length;
+        input->full[index] = length > 0;
+        input->ended = ended;
+        pthread_cond_broadcast(&input->changed);
+        pthread_mutex_unlock(&input->lock);
+        index ^= 1;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Set up the decompressor of a compressed trace
+ *
+ * @param input
+ * @param path              for error messages
+ * @return bool
+ */
+static bool startDecompressor(trace_input_t *input, const char *path) {
+    // Only reported when built without a library
+    (void)path;
+    switch (input->compression) {
+        case TRACE_GZIP:
+#ifdef HAVE_ZLIB
+            // 15 + 32: largest window, gzip or zlib header detected automatically
+            if (inflateInit2(&input->zstream, 15 + 32) != Z_OK) {
+                return false;
+            }
+            break;
+#else
+            fprintf(stderr, "%s: gzip trace, but built without zlib (-DHAVE_ZLIB)\n", path);
+            return false;
+#endif
+        case TRACE_ZSTD:
+#ifdef HAVE_ZSTD
+            input->zstd = ZSTD_createDStream();
+            if (input->zstd == NULL) {
+                return false;
+            }
+            ZSTD_initDStream(input->zstd);
+            break;
+#else
+            fprintf(stderr, "%s: zstd trace, but built without zstd (-DHAVE_ZSTD)\n", path);
+            return false;
+#endif
+        default:
+            return false;
+    }
+
+    input->compressed = malloc(COMPRESSED_READ_BYTES);
+    input->buffers[0] = malloc(DECOMPRESS_BUFFER_BYTES);
+    input->buffers[1] = malloc(DECOMPRESS_BUFFER_BYTES);
+    if (input->compressed == NULL || input->buffers[0] == NULL || input->buffers[1] == NULL) {
+        return false;
+    }
+    pthread_mutex_init(&input->lock, NULL);
+    pthread_cond_init(&input->changed, NULL);
+    if (pthread_create(&input->decompressor, NULL, decompressTrace, input) != 0) {
+        pthread_mutex_destroy(&input->lock);
+        pthread_cond_destroy(&input->changed);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Free what startDecompressor set up, apart from the thread
+ *
+ * @param input
+ */
+static void freeDecompressor(trace_input_t *input) {
+#ifdef HAVE_ZLIB
+    if (input->compression == TRACE_GZIP) {
+        inflateEnd(&input->zstream);
+    }
+#endif
+#ifdef HAVE_ZSTD
+    if (input->compression == TRACE_ZSTD) {
+        ZSTD_freeDStream(input->zstd);
+    }
+#endif
+    free(input->compressed);
+    free(input->buffers[0]);
+    free(input->buffers[1]);
+}
+
+/**
+ * @brief Open a trace file, starting its decompressor if it is compressed.
+ *
+ * @param path
+ * @return trace_input_t*   open input, NULL on failure (reported on stderr)
+ */
+trace_input_t *openTraceInput(const char *path) {
+    trace_input_t *input = calloc(1, sizeof(trace_input_t));
+    if (input == NULL) {
+        return NULL;
+    }
+    input->file = fopen(path, "rb");
+    if (input->file == NULL) {
+        perror(path);
+        free(input);
+        return NULL;
+    }
+    input->compression = detectCompression(input->file);
+    if (input->compression != TRACE_PLAIN && !startDecompressor(input, path)) {
+        fprintf(stderr, "%s: could not start %s decompression\n", path,
+                compressionName(input->compression));
+        freeDecompressor(input);
+        fclose(input->file);
+        free(input);
+        return NULL;
+    }
+    return input;
+}
+
+/**
+ * @brief Read the next bytes of the (decompressed) trace.
+ *
+ * @param input
+ * @param buffer
+ * @param length
+ * @return size_t           bytes read, less than length only at the end
+ */
+size_t readTraceInput(trace_input_t *input, char *buffer, size_t length) {
+    if (input->compression == TRACE_PLAIN) {
+        size_t read = fread(buffer, 1, length, input->file);
+        input->failed |= ferror(input->file) != 0;
+        return read;
+    }
+
+    size_t copied = 0;
+    pthread_mutex_lock(&input->lock);
+    while (copied < length) {
+        int index = input->readIndex;
+        while (!input->full[index] && !input->ended) {
+            pthread_cond_wait(&input->changed, &input->lock);
+        }
+        if (!input->full[index]) {
+            break;
+        }
+        // A full buffer belongs to the reader until it is drained
+        pthread_mutex_unlock(&input->lock);
+        size_t available = input->lengths[index] - input->readOffset;
+        size_t chunk = length - copied < available ? length - copied : available;
+        memcpy(buffer + copied, input->buffers[index] + input->readOffset, chunk);
+        copied += chunk;
+        input->readOffset += chunk;
+        pthread_mutex_lock(&input->lock);
+
+        if (input->readOffset == input->lengths[index]) {
+            input->full[index] = false;
+            input->readIndex ^= 1;
+            input->readOffset = 0;
+            pthread_cond_broadcast(&input->changed);
+        }
+    }
+    pthread_mutex_unlock(&input->lock);
+    return copied;
+}
+
+/**
+ * @brief Whether reading or decompressing the trace failed.
+ *
+ * @param input
+ * @return bool
+ */
+bool traceInputFailed(const trace_input_t *input) {
+    return input->failed;
+}
+
+/**
+ * @brief Name of a compression format, for messages.
+ *
+ * @param compression
+ * @return const char*
+ */
+const char *compressionName(trace_compression compression) {
+    switch (compression) {
+        case TRACE_GZIP:
+            return "gzip";
+        case TRACE_ZSTD:
+            return "zstd";
+        default:
+            return "plain";
+    }
+}
+
+/**
+ * @brief Stop the decompressor, if any, and close the file.
+ *
+ * @param input
+ */
+void closeTraceInput(trace_input_t *input) {
+    if (input == NULL) {
+        return;
+    }
+    if (input->compression != TRACE_PLAIN) {
+        pthread_mutex_lock(&input->lock);
+        input->stopping = true;
+        pthread_cond_broadcast(&input->changed);
+        pthread_mutex_unlock(&input->lock);
+        pthread_join(input->decompressor, NULL);
+        pthread_mutex_destroy(&input->lock);
+        pthread_cond_destroy(&input->changed);
+        freeDecompressor(input);
+    }
+    fclose(input->file);
+    free(input);
+}
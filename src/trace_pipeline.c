@@ -0,0 +1,299 @@
+/**
+ * @file trace_pipeline.c
+ * @brief Read and decode a trace on background threads while the systems
+ *        simulate.
+ *
+ * A decoder takes a free batch before it takes a chunk. Chunks are taken
+ * in trace order, so the chunk the dispatcher is waiting for always has a
+ * batch to be decoded into, and at most PIPELINE_BATCHES sequences are
+ * outstanding: the dispatcher's reorder window never overflows.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "trace_pipeline.h"
+
+/**
+ * @brief Last newline in a buffer
+ *
+ * @param text
+ * @param length
+ * @return char*            NULL if there is none
+ */
+static char *lastNewline(char *text, size_t length) {
+    while (length > 0) {
+        if (text[--length] == '\n') {
+            return &text[length];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Reader thread: fill chunks with whole lines until end of file
+ *
+ * @param arg               trace_pipeline_t
+ * @return void*
+ */
+static void *readTrace(void *arg) {
+    trace_pipeline_t *pipeline = arg;
+    char carry[PIPELINE_CHUNK_BYTES];
+    size_t carried = 0;
+    unsigned long sequence = 0;
+
+    while (true) {
+        text_chunk_t *chunk = dequeue(pipeline->freeChunks);
+        memcpy(chunk->text, carry, carried);
+        size_t length = carried + readTraceInput(pipeline->input, chunk->text + carried,
+                                                 PIPELINE_CHUNK_BYTES - carried);
+        pipeline->stats.bytesRead += length - carried;
+        bool atEnd = length < PIPELINE_CHUNK_BYTES;
+
+        // Hold back a partial last line for the next chunk
+        carried = 0;
+        if (!atEnd) {
+            char *newline = lastNewline(chunk->text, length);
+            if (newline != NULL) {
+                carried = length - (size_t)(newline + 1 - chunk->text);
+                memcpy(carry, newline + 1, carried);
+                length -= carried;
+            }
+        }
+        if (length == 0) {
+            enqueue(pipeline->freeChunks, chunk);
+            break;
+        }
+        chunk->text[length] = '\0';
+        chunk->length = length;
+        chunk->sequence = sequence++;
+        enqueue(pipeline->text, chunk);
+        if (atEnd) {
+            break;
+        }
+    }
+    pipeline->readFailed = traceInputFailed(pipeline->input);
+    closeQueue(pipeline->text);
+    return NULL;
+}
+
+/**
+ * @brief Decode every record line of a chunk, skipping malformed lines
+ *
+ * @param chunk
+ * @param batch
+ */
+static void decodeChunk(const text_chunk_t *chunk, record_batch_t *batch) {
+    const char *p = chunk->text;
+    const char *end = chunk->text + chunk->length;
+    size_t count = 0;
+    while (p < end && count < PIPELINE_BATCH_RECORDS) {
+        if (decodeTraceLine(p, &batch->records[count])) {
+            count++;
+        }
+        const char *newline = memchr(p, '\n', (size_t)(end - p));
+        p = newline != NULL ? newline + 1 : end;
+    }
+    batch->sequence = chunk->sequence;
+    batch->count = count;
+}
+
+/**
+ * @brief Decoder thread: turn chunks into batches until the text runs out
+ *
+ * @param arg               trace_pipeline_t
+ * @return void*
+ */
+static void *decodeTrace(void *arg) {
+    trace_pipeline_t *pipeline = arg;
+    while (true) {
+        record_batch_t *batch = dequeue(pipeline->freeBatches);
+        text_chunk_t *chunk = dequeue(pipeline->text);
+        if (chunk == NULL) {
+            enqueue(pipeline->freeBatches, batch);
+            break;
+        }
+        decodeChunk(chunk, batch);
+        enqueue(pipeline->freeChunks, chunk);
+        enqueue(pipeline->decoded, batch);
+    }
+
+    pthread_mutex_lock(&pipeline->lock);
+    bool last = --pipeline->runningDecoders == 0;
+    pthread_mutex_unlock(&pipeline->lock);
+    if (last) {
+        closeQueue(pipeline->decoded);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Dispatcher thread: pass batches on in trace order
+ *
+ * @param arg               trace_pipeline_t
+ * @return void*
+ */
+static void *dispatchBatches(void *arg) {
+    trace_pipeline_t *pipeline = arg;
+    record_batch_t *pending[PIPELINE_BATCHES] = { NULL };
+    unsigned long next = 0;
+
+    record_batch_t *batch;
+    while ((batch = dequeue(pipeline->decoded)) != NULL) {
+        pending[batch->sequence % PIPELINE_BATCHES] = batch;
+        while (pending[next % PIPELINE_BATCHES] != NULL) {
+            enqueue(pipeline->ready, pending[next % PIPELINE_BATCHES]);
+            pending[next % PIPELINE_BATCHES] = NULL;
+            next++;
+        }
+    }
+    closeQueue(pipeline->ready);
+    return NULL;
+}
+
+/**
+ * @brief Start reading and decoding a trace from its current position.
+ *
+ * @param input             open trace, read from here on by the pipeline only
+ * @param numDecoders       decoder threads, at most MAX_DECODER_THREADS
+ * @return trace_pipeline_t*    running pipeline, NULL on failure
+ */
+trace_pipeline_t *startTracePipeline(trace_input_t *input, int numDecoders) {
+    if (numDecoders < 1 || numDecoders > MAX_DECODER_THREADS) {
+        return NULL;
+    }
+    trace_pipeline_t *pipeline = calloc(1, sizeof(trace_pipeline_t));
+    if (pipeline == NULL) {
+        return NULL;
+    }
+    pipeline->input = input;
+    pipeline->numDecoders = numDecoders;
+    pipeline->runningDecoders = numDecoders;
+    pthread_mutex_init(&pipeline->lock, NULL);
+    pipeline->chunks = malloc(PIPELINE_TEXT_CHUNKS * sizeof(text_chunk_t));
+    pipeline->batches = malloc(PIPELINE_BATCHES * sizeof(record_batch_t));
+    pipeline->freeChunks = createQueue();
+    pipeline->freeBatches = createQueue();
+    pipeline->text = createBoundedQueue(PIPELINE_TEXT_CHUNKS);
+    pipeline->decoded = createBoundedQueue(PIPELINE_BATCHES);
+    pipeline->ready = createBoundedQueue(PIPELINE_BATCHES);
+    if (pipeline->chunks == NULL || pipeline->batches == NULL || pipeline->freeChunks == NULL ||
+        pipeline->freeBatches == NULL || pipeline->text == NULL || pipeline->decoded == NULL ||
+        pipeline->ready == NULL) {
+        pipeline->finished = true;
+        stopTracePipeline(pipeline, NULL);
+        return NULL;
+    }
+    for (int i = 0; i < PIPELINE_TEXT_CHUNKS; i++) {
+        enqueue(pipeline->freeChunks, &pipeline->chunks[i]);
+    }
+    for (int i = 0; i < PIPELINE_BATCHES; i++) {
+        enqueue(pipeline->freeBatches, &pipeline->batches[i]);
+    }
+
+    // On a failed start the threads already running are shut down through their queues
+    bool dispatcherStarted =
+        pthread_create(&pipeline->dispatcher, NULL, dispatchBatches, pipeline) == 0;
+    int started = 0;
+    while (dispatcherStarted && started < numDecoders &&
+           pthread_create(&pipeline->decoders[started], NULL, decodeTrace, pipeline) == 0) {
+        started++;
+    }
+    bool readerStarted = started == numDecoders &&
+                         pthread_create(&pipeline->reader, NULL, readTrace, pipeline) == 0;
+    if (!readerStarted) {
+        pthread_mutex_lock(&pipeline->lock);
+        pipeline->runningDecoders = started;
+        pthread_mutex_unlock(&pipeline->lock);
+        closeQueue(pipeline->text);
+        if (started == 0) {
+            closeQueue(pipeline->decoded);
+        }
+        for (int i = 0; i < started; i++) {
+            pthread_join(pipeline->decoders[i], NULL);
+        }
+        if (dispatcherStarted) {
+            pthread_join(pipeline->dispatcher, NULL);
+        }
+        pipeline->numDecoders = 0;
+        pipeline->finished = true;
+        stopTracePipeline(pipeline, NULL);
+        return NULL;
+    }
+    return pipeline;
+}
+
+/**
+ * @brief Next batch of records in trace order.
+ *
+ * @param pipeline
+ * @return record_batch_t*  NULL at the end of the trace
+ */
+record_batch_t *nextBatch(trace_pipeline_t *pipeline) {
+    if (pipeline->finished) {
+        return NULL;
+    }
+    bool waited = isQueueEmpty(pipeline->ready);
+    record_batch_t *batch = dequeue(pipeline->ready);
+    if (batch == NULL) {
+        pipeline->finished = true;
+        return NULL;
+    }
+    if (waited) {
+        pipeline->stats.simulationWaits++;
+    }
+    pipeline->stats.batches++;
+    return batch;
+}
+
+/**
+ * @brief Give a batch back once every system has simulated it.
+ *
+ * @param pipeline
+ * @param batch
+ */
+void releaseBatch(trace_pipeline_t *pipeline, record_batch_t *batch) {
+    enqueue(pipeline->freeBatches, batch);
+}
+
+/**
+ * @brief Drain the pipeline, join its threads and free it.
+ *
+ * @param pipeline
+ * @param stats             filled in with what the pipeline did, may be NULL
+ * @return bool             false if the trace could not be read
+ */
+bool stopTracePipeline(trace_pipeline_t *pipeline, ingest_stats_t *stats) {
+    if (pipeline == NULL) {
+        return true;
+    }
+    if (!pipeline->finished) {
+        record_batch_t *batch;
+        while ((batch = nextBatch(pipeline)) != NULL) {
+            releaseBatch(pipeline, batch);
+        }
+    }
+    if (pipeline->numDecoders > 0) {
+        pthread_join(pipeline->reader, NULL);
+        for (int i = 0; i < pipeline->numDecoders; i++) {
+            pthread_join(pipeline->decoders[i], NULL);
+        }
+        pthread_join(pipeline->dispatcher, NULL);
+    }
+    bool ok = !pipeline->readFailed;
+    if (stats != NULL) {
+        *stats = pipeline->stats;
+        stats->readFailed = !ok;
+    }
+
+    Queue *queues[] = { pipeline->freeChunks, pipeline->freeBatches, pipeline->text,
+                        pipeline->decoded, pipeline->ready };
+    for (size_t i = 0; i < sizeof(queues) / sizeof(queues[0]); i++) {
+        if (queues[i] != NULL) {
+            freeQueue(queues[i]);
+        }
+    }
+    free(pipeline->chunks);
+    free(pipeline->batches);
+    pthread_mutex_destroy(&pipeline->lock);
+    free(pipeline);
+    return ok;
+}
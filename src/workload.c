@@ -0,0 +1,343 @@
+/**
+ * @file workload.c
+ * @brief Synthetic sharing patterns generated straight into trace records.
+ *
+ * Each pattern stresses a different part of the protocol: producer-consumer
+ * and migratory sharing move dirty lines between caches, false sharing and
+ * lock contention ping-pong a few lines, read-mostly builds up wide sharer
+ * sets, and uniform random gives a baseline. Records are produced in
+ * chunks, so they can feed the simulator directly or be written out in the
+ * "<pid> <R|W|T> <hexaddr>" trace format.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "workload.h"
+
+/** @brief Names accepted on the command line, indexed by workload_kind */
+static const char *const workloadNames[NUM_WORKLOADS] = {
+    "producer-consumer", "migratory", "false-sharing",
+    "read-mostly", "lock-contention", "uniform",
+};
+
+/** @brief Write share of each pattern when none is given, -1 where it does not apply */
+static const int defaultWritePercent[NUM_WORKLOADS] = {
+    -1, -1, 50, 2, 50, 30,
+};
+
+/**
+ * @brief Create a workload.
+ *
+ * @param config
+ * @return workload_t*      newly allocated workload, NULL on failure
+ */
+workload_t *createWorkload(const workload_config_t *config) {
+    if (config->kind < 0 || config->kind >= NUM_WORKLOADS || config->numProcessors < 1 ||
+        config->footprintLines < 1) {
+        return NULL;
+    }
+    workload_t *workload = calloc(1, sizeof(workload_t));
+    if (workload == NULL) {
+        return NULL;
+    }
+    workload->config = *config;
+    workload->rng = config->seed ? config->seed : 0x9e3779b97f4a7c15UL;
+    workload->writePercent = config->writePercent >= 0 ? config->writePercent
+                                                       : defaultWritePercent[config->kind];
+    workload->pendingProcessor = -1;
+    workload->lastProcessor = -1;
+
+    // One lock per eight processors keeps every lock contended
+    workload->numLocks = 1 + (unsigned long)config->numProcessors / 8;
+    workload->phase = calloc(config->numProcessors, sizeof(int));
+    workload->target = calloc(config->numProcessors, sizeof(unsigned long));
+    workload->lockHolder = malloc(workload->numLocks * sizeof(int));
+    if (workload->phase == NULL || workload->target == NULL || workload->lockHolder == NULL) {
+        freeWorkload(workload);
+        return NULL;
+    }
+    for (unsigned long i = 0; i < workload->numLocks; i++) {
+        workload->lockHolder[i] = -1;
+    }
+    return workload;
+}
+
+/**
+ * @brief Next pseudo-random number (xorshift64*)
+ *
+ * @param workload
+ * @return unsigned long
+ */
+static unsigned long nextRandom(workload_t *workload) {
+    workload->rng ^= workload->rng >> 12;
+    workload->rng ^= workload->rng << 25;
+    workload->rng ^= workload->rng >> 27;
+    return workload->rng * 0x2545f4914f6cdd1dUL;
+}
+
+/**
+ * @brief Pseudo-random number below a bound
+ *
+ * @param workload
+ * @param bound             must be positive
+ * @return unsigned long
+ */
+static unsigned long randomBelow(workload_t *workload, unsigned long bound) {
+    return (nextRandom(workload) >> 11) % bound;
+}
+
+/**
+ * @brief Fill in a record for one word of a line.
+ *
+ * @param workload
+ * @param access
+ * @param processorId
+ * @param line              line number within the workload's footprint
+ * @param word              word within the line
+ * @param isWrite
+ */
+static void emit(workload_t *workload, access_t *access, int processorId, unsigned long line,
+                 unsigned long word, bool isWrite) {
+    unsigned long wordsPerLine = (1UL << workload->config.lineBits) / WORKLOAD_WORD_BYTES;
+    access->processorId = processorId;
+    access->type = isWrite ? ACCESS_WRITE : ACCESS_READ;
+    access->address = (line << workload->config.lineBits) +
+                      (wordsPerLine ? word % wordsPerLine : 0) * WORKLOAD_WORD_BYTES;
+}
+
+/**
+ * @brief Whether the next access should be a write
+ *
+ * @param workload
+ * @return bool
+ */
+static bool randomWrite(workload_t *workload) {
+    return (int)randomBelow(workload, 100) < workload->writePercent;
+}
+
+/**
+ * @brief Producer-consumer: a producer writes a batch, then its consumer reads it
+ *
+ * Processors pair up (0 with 1, 2 with 3, ...) and the pairs take turns.
+ * Each pair cycles through its own ring buffer of a few batches.
+ *
+ * @param workload
+ * @param access
+ */
+static void producerConsumer(workload_t *workload, access_t *access) {
+    int numProcessors = workload->config.numProcessors;
+    unsigned long pairs = numProcessors > 1 ? (unsigned long)numProcessors / 2 : 1;
+    unsigned long round = workload->generated / (2 * PRODUCER_BATCH_LINES);
+    unsigned long position = workload->generated % (2 * PRODUCER_BATCH_LINES);
+    unsigned long pair = round % pairs;
+    unsigned long batch = round / pairs;
+
+    unsigned long bufferLines = workload->config.footprintLines / pairs;
+    if (bufferLines > PRODUCER_BUFFER_BATCHES * PRODUCER_BATCH_LINES) {
+        bufferLines = PRODUCER_BUFFER_BATCHES * PRODUCER_BATCH_LINES;
+    } else if (bufferLines < PRODUCER_BATCH_LINES) {
+        bufferLines = PRODUCER_BATCH_LINES;
+    }
+    unsigned long line = pair * bufferLines +
+                         (batch * PRODUCER_BATCH_LINES + position % PRODUCER_BATCH_LINES) % bufferLines;
+    bool producing = position < PRODUCER_BATCH_LINES;
+    int processorId = (int)(2 * pair + (producing ? 0 : 1)) % numProcessors;
+    emit(workload, access, processorId, line, 0, producing);
+}
+
+/**
+ * @brief Migratory: a processor reads an object and then writes it
+ *
+ * Consecutive objects go to different processors, so every object keeps
+ * moving from one cache to another in the modified state.
+ *
+ * @param workload
+ * @param access
+ */
+static void migratory(workload_t *workload, access_t *access) {
+    if (workload->pendingProcessor >= 0) {
+        emit(workload, access, workload->pendingProcessor, workload->pendingLine, 0, true);
+        workload->pendingProcessor = -1;
+        return;
+    }
+    int numProcessors = workload->config.numProcessors;
+    int processorId = (int)randomBelow(workload, (unsigned long)numProcessors);
+    if (numProcessors > 1 && processorId == workload->lastProcessor) {
+        processorId = (processorId + 1) % numProcessors;
+    }
+    unsigned long line = randomBelow(workload, workload->config.footprintLines);
+    emit(workload, access, processorId, line, 0, false);
+    workload->pendingProcessor = processorId;
+    workload->pendingLine = line;
+    workload->lastProcessor = processorId;
+}
+
+/**
+ * @brief False sharing: every processor only touches its own word of a line
+ *
+ * @param workload
+ * @param access
+ */
+static void falseSharing(workload_t *workload, access_t *access) {
+    int processorId = (int)randomBelow(workload, (unsigned long)workload->config.numProcessors);
+    unsigned long line = randomBelow(workload, workload->config.footprintLines);
+    emit(workload, access, processorId, line, (unsigned long)processorId, randomWrite(workload));
+}
+
+/**
+ * @brief Any processor, any word of any line; also used for read-mostly
+ *
+ * @param workload
+ * @param access
+ */
+static void uniformRandom(workload_t *workload, access_t *access) {
+    int processorId = (int)randomBelow(workload, (unsigned long)workload->config.numProcessors);
+    unsigned long line = randomBelow(workload, workload->config.footprintLines);
+    unsigned long word = randomBelow(workload, 1UL << workload->config.lineBits);
+    emit(workload, access, processorId, line, word, randomWrite(workload));
+}
+
+/**
+ * @brief Lock contention: spin, test-and-set, critical section, release
+ *
+ * A random processor takes its next step each access. Lock lines sit just
+ * past the footprint; each lock guards CRITICAL_SECTION_LINES data lines.
+ *
+ * @param workload
+ * @param access
+ */
+static void lockContention(workload_t *workload, access_t *access) {
+    int processorId = (int)randomBelow(workload, (unsigned long)workload->config.numProcessors);
+    int *phase = &workload->phase[processorId];
+    unsigned long *lock = &workload->target[processorId];
+    unsigned long lockLine = workload->config.footprintLines + *lock;
+
+    if (*phase == 0) {
+        // Spin on the lock until it looks free
+        if (workload->lockHolder[*lock] == -1 || workload->lockHolder[*lock] == processorId) {
+            *lock = randomBelow(workload, workload->numLocks);
+            lockLine = workload->config.footprintLines + *lock;
+        }
+        emit(workload, access, processorId, lockLine, 0, false);
+        if (workload->lockHolder[*lock] == -1) {
+            *phase = 1;
+        }
+    } else if (*phase == 1) {
+        // Test-and-set: takes ownership whether or not someone got there first
+        emit(workload, access, processorId, lockLine, 0, true);
+        access->type = ACCESS_TEST_AND_SET;
+        if (workload->lockHolder[*lock] == -1) {
+            workload->lockHolder[*lock] = processorId;
+            *phase = 2;
+        } else {
+            *phase = 0;
+        }
+    } else if (*phase < 2 + CRITICAL_SECTION_LINES) {
+        unsigned long line = (*lock * CRITICAL_SECTION_LINES + (unsigned long)(*phase - 2)) %
+                             workload->config.footprintLines;
+        emit(workload, access, processorId, line, 0, randomWrite(workload));
+        (*phase)++;
+    } else {
+        emit(workload, access, processorId, lockLine, 0, true);
+        workload->lockHolder[*lock] = -1;
+        *phase = 0;
+    }
+}
+
+/**
+ * @brief Generate the next chunk of records.
+ *
+ * @param workload
+ * @param records           buffer for the records
+ * @param maxRecords        capacity of the buffer
+ * @return size_t           number of records generated, 0 once the workload is done
+ */
+size_t generateAccesses(workload_t *workload, access_t *records, size_t maxRecords) {
+    size_t count = 0;
+    while (count < maxRecords && workload->generated < workload->config.accesses) {
+        access_t *access = &records[count];
+        switch (workload->config.kind) {
+            case WORKLOAD_PRODUCER_CONSUMER:
+                producerConsumer(workload, access);
+                break;
+            case WORKLOAD_MIGRATORY:
+                migratory(workload, access);
+                break;
+            case WORKLOAD_FALSE_SHARING:
+                falseSharing(workload, access);
+                break;
+            case WORKLOAD_LOCK_CONTENTION:
+                lockContention(workload, access);
+                break;
+            case WORKLOAD_READ_MOSTLY:
+            case WORKLOAD_UNIFORM_RANDOM:
+            default:
+                uniformRandom(workload, access);
+                break;
+        }
+        workload->generated++;
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Write the rest of a workload as a trace file.
+ *
+ * @param workload
+ * @param out               open output file
+ * @return unsigned long    number of records written
+ */
+unsigned long writeWorkloadTrace(workload_t *workload, FILE *out) {
+    access_t records[TRACE_CHUNK_RECORDS / 16];
+    unsigned long total = 0;
+    size_t count;
+    while ((count = generateAccesses(workload, records, sizeof(records) / sizeof(records[0]))) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            fprintf(out, "%d %c %lx\n", records[i].processorId,
+                    accessTypeLetter(records[i].type), records[i].address);
+        }
+        total += count;
+    }
+    return total;
+}
+
+/**
+ * @brief Parse a workload name from the command line.
+ *
+ * @param name
+ * @param kind              filled in on success
+ * @return true             name was recognized
+ */
+bool parseWorkloadKind(const char *name, workload_kind *kind) {
+    for (int i = 0; i < NUM_WORKLOADS; i++) {
+        if (strcmp(name, workloadNames[i]) == 0) {
+            *kind = (workload_kind)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Name of a workload, for reports.
+ *
+ * @param kind
+ * @return const char*
+ */
+const char *workloadKindName(workload_kind kind) {
+    return (kind >= 0 && kind < NUM_WORKLOADS) ? workloadNames[kind] : "unknown";
+}
+
+/**
+ * @brief Free a workload.
+ *
+ * @param workload
+ */
+void freeWorkload(workload_t *workload) {
+    if (workload != NULL) {
+        free(workload->phase);
+        free(workload->target);
+        free(workload->lockHolder);
+        free(workload);
+    }
+}
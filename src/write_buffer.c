@@ -0,0 +1,145 @@
+/**
+ * @file write_buffer.c
+ * @brief Per-core coalescing write buffer for write-through and
+ *        non-allocating stores.
+ *
+ * The buffer only holds entries and counts; the cache decides when an
+ * entry drains and sends it to the home node itself. Buffers are a few
+ * dozen entries deep at most, so looking for a sector to merge with is a
+ * scan of the ring.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "write_buffer.h"
+
+/**
+ * @brief Create an empty write buffer.
+ *
+ * @param depth             entries it may hold, 1 to MAX_WRITE_BUFFER_DEPTH
+ * @param drain
+ * @return write_buffer_t*  newly allocated buffer, NULL on failure
+ */
+write_buffer_t *createWriteBuffer(int depth, drain_policy drain) {
+    if (depth < 1 || depth > MAX_WRITE_BUFFER_DEPTH) {
+        return NULL;
+    }
+    write_buffer_t *buffer = calloc(1, sizeof(write_buffer_t));
+    if (buffer == NULL) {
+        return NULL;
+    }
+    buffer->depth = depth;
+    buffer->drain = drain;
+    return buffer;
+}
+
+/**
+ * @brief Find the entry of a sector.
+ *
+ * @param buffer
+ * @param block
+ * @return write_buffer_entry_t*    NULL if no store to the sector is waiting
+ */
+write_buffer_entry_t *writeBufferFind(write_buffer_t *buffer, unsigned long block) {
+    for (int i = 0; i < buffer->count; i++) {
+        write_buffer_entry_t *entry = &buffer->entries[(buffer->head + i) % buffer->depth];
+        if (entry->block == block) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Oldest entry, the next one to drain.
+ *
+ * @param buffer
+ * @return write_buffer_entry_t*    NULL if the buffer is empty
+ */
+write_buffer_entry_t *writeBufferOldest(write_buffer_t *buffer) {
+    return buffer->count ? &buffer->entries[buffer->head] : NULL;
+}
+
+/**
+ * @brief Append an entry for a sector with no entry yet; the caller makes
+ *        room first.
+ *
+ * @param buffer
+ * @param block
+ * @param wordMask          words written by the store
+ * @param now               core's cycle count
+ */
+void writeBufferPush(write_buffer_t *buffer, unsigned long block, unsigned long wordMask,
+                     unsigned long now) {
+    write_buffer_entry_t *entry = &buffer->entries[(buffer->head + buffer->count) % buffer->depth];
+    entry->block = block;
+    entry->wordMask = wordMask;
+    entry->stores = 1;
+    entry->enqueuedAt = now;
+    buffer->count++;
+}
+
+/**
+ * @brief Remove the oldest entry once it has drained.
+ *
+ * @param buffer
+ */
+void writeBufferPop(write_buffer_t *buffer) {
+    if (buffer->count == 0) {
+        return;
+    }
+    buffer->head = (buffer->head + 1) % buffer->depth;
+    buffer->count--;
+    buffer->drains++;
+}
+
+/**
+ * @brief Parse a write buffer from the command line.
+ *
+ * @param text              "<depth>[:full|:timed]", depth 0 for no buffer
+ * @param depth             filled in on success
+ * @param drain             filled in on success, DRAIN_WHEN_FULL if not given
+ * @return true             text was recognized
+ */
+bool parseWriteBuffer(const char *text, int *depth, drain_policy *drain) {
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (end == text || value < 0 || value > MAX_WRITE_BUFFER_DEPTH) {
+        return false;
+    }
+    *depth = (int)value;
+    *drain = DRAIN_WHEN_FULL;
+    if (*end == '\0') {
+        return true;
+    }
+    if (strcmp(end, ":full") == 0) {
+        return true;
+    }
+    if (strcmp(end, ":timed") == 0) {
+        *drain = DRAIN_AFTER_DELAY;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Name of a drain policy, for reports.
+ *
+ * @param drain
+ * @return const char*
+ */
+const char *drainPolicyName(drain_policy drain) {
+    switch (drain) {
+        case DRAIN_WHEN_FULL:   return "full";
+        case DRAIN_AFTER_DELAY: return "timed";
+        default:                return "unknown";
+    }
+}
+
+/**
+ * @brief Free a write buffer.
+ *
+ * @param buffer
+ */
+void freeWriteBuffer(write_buffer_t *buffer) {
+    free(buffer);
+}
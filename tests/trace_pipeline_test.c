@@ -0,0 +1,107 @@
+/**
+ * @file trace_pipeline_test.c
+ * @brief Check that the trace pipeline decodes every record of traces made
+ *        of the shortest record lines.
+ *
+ * A chunk of fence lines ("0F") or one-digit reads ("0R0") holds far more
+ * records than a chunk of ordinary lines, so each trace is decoded on the
+ * simulation thread and through the pipeline with one and several decoders,
+ * and the counts must agree.
+ *
+ * Build it from every file in src/ except main.c, linked with -lpthread -lm
+ * like the benchmark, and run it with no arguments; it exits non-zero on the
+ * first mismatch.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "trace_pipeline.h"
+
+/** @brief Records in each test trace, several chunks' worth */
+#define TEST_RECORDS 200000UL
+
+/**
+ * @brief Write a trace of the same line repeated
+ *
+ * @param path              filled in with the name of the file
+ * @param line              record line, without its newline
+ * @param lastNewline       end the last line with a newline
+ * @return bool
+ */
+static bool writeTrace(char *path, const char *line, bool lastNewline) {
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror(path);
+        return false;
+    }
+    FILE *out = fdopen(fd, "w");
+    if (out == NULL) {
+        close(fd);
+        return false;
+    }
+    for (unsigned long i = 0; i < TEST_RECORDS; i++) {
+        fprintf(out, "%s%s", line, i + 1 < TEST_RECORDS || lastNewline ? "\n" : "");
+    }
+    return fclose(out) == 0;
+}
+
+/**
+ * @brief Count the records of a trace decoded through the pipeline
+ *
+ * @param path
+ * @param numDecoders       0 to decode on this thread
+ * @return unsigned long
+ */
+static unsigned long countRecords(const char *path, int numDecoders) {
+    trace_input_t *input = openTraceInput(path);
+    if (input == NULL) {
+        return 0;
+    }
+    unsigned long count = 0;
+    if (numDecoders == 0) {
+        access_t *records = malloc(TRACE_CHUNK_RECORDS * sizeof(access_t));
+        size_t decoded;
+        while (records != NULL &&
+               (decoded = decodeTraceChunk(input->file, records, TRACE_CHUNK_RECORDS)) > 0) {
+            count += decoded;
+        }
+        free(records);
+    } else {
+        trace_pipeline_t *pipeline = startTracePipeline(input, numDecoders);
+        record_batch_t *batch;
+        while (pipeline != NULL && (batch = nextBatch(pipeline)) != NULL) {
+            count += batch->count;
+            releaseBatch(pipeline, batch);
+        }
+        if (pipeline == NULL || !stopTracePipeline(pipeline, NULL)) {
+            count = 0;
+        }
+    }
+    closeTraceInput(input);
+    return count;
+}
+
+int main(void) {
+    const char *lines[] = { "0F", "0R0", "3W0" };
+    int failures = 0;
+    for (size_t l = 0; l < sizeof(lines) / sizeof(lines[0]); l++) {
+        for (int lastNewline = 0; lastNewline <= 1; lastNewline++) {
+            char path[] = "/tmp/trace_pipeline_test.XXXXXX";
+            if (!writeTrace(path, lines[l], lastNewline)) {
+                return 1;
+            }
+            for (int decoders = 0; decoders <= 4; decoders += 2) {
+                unsigned long count = countRecords(path, decoders);
+                if (count != TEST_RECORDS) {
+                    printf("FAIL \"%s\"%s, %d decoders: %lu of %lu records\n", lines[l],
+                           lastNewline ? "" : " without a last newline", decoders, count,
+                           TEST_RECORDS);
+                    failures++;
+                }
+            }
+            unlink(path);
+        }
+    }
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}